@@ -0,0 +1,339 @@
+/*
+ * NdefRead.ino
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/******************************************************************************
+ *           Purpose of this sketch
+ *
+ * The purpose of this sketch is to provide an example of NDEF message
+ * read by using a simple but efficient NFC stack.
+  
+ * The NFC stack implements a tag API which drives an NFC controller
+ * through the NCI (NFC Controller Interface) as defined by the NFC Forum.
+ * The NFC stack
+ * consists in:
+ * - NfcTagsi   : high level tag API for detection, deactivation
+ * - NfcTagsIntf: tag interface to read tags
+ * - NfcNdef    : NDEF message parser
+ * - NfcNci     : NCI implementation, hardware independent
+ * - NfcHw      : NFC hardaware interface
+ *
+ * The NFC stack configures the NFC Controller to detect tag of types 1,
+ * 2 or 3 as per the NFC Forum specifications.
+ *
+ * This sketch:
+ * 1. initializes the NFC controller
+ * 2. configures the RF discovery parameters
+ * 3. prints NFCID of the detected tag
+ * 4. reads the NDEF message of the tag and prints its records
+ * 5. restart the tag detection back to step 2
+ *
+ * The HW configuration used to test that sketch is: Intel Arduino 101
+ * with NXP PN7120 SBC kit.
+ *****************************************************************************/
+
+#include <Nfc.h>
+
+/**********************************************
+ *      NFC controller hardware configuration
+ *
+ * - NXP PN7120 NFC chipset
+ * - Connected with I2C (Fast-mode) + IRQ + RESET
+ *********************************************/
+
+#define PN7120_IRQ          2  // pin 2 configured as input for IRQ
+#define PN7120_RESET        4  // pin 4 configured as input for VEN (reset)
+#define PN7120_I2C_ADDRESS  40 // 0x28
+
+/**********************************************
+ *          Sketch application class
+ *
+ * Implements the state machine and event
+ * handler of the sketch. Besides, interfaces
+ * with the NfcTags class which offers the
+ * NFC API for tags detection and handling.
+ * Each callback is called upon NFC controller
+ * response or event received from Tags class.
+ * The callbacks are used to:
+ * - check the reponse / event status and data,
+ * - change the current state accordingly.
+ **********************************************/
+
+// state definition
+enum
+{
+    STATE_RESET = 0,
+    STATE_RESET_RESPONSE,
+    STATE_DISCOVER,
+    STATE_DISCOVER_RESPONSE,
+    STATE_DISCOVERING,
+    STATE_NDEF,
+    STATE_NDEF_RESPONSE,
+    STATE_DEACTIVATE,
+    STATE_DEACTIVATE_RESPONSE,
+    STATE_ERROR,
+    STATE_END
+};
+
+const char *tagDetectStateToStr[] = {
+    "STATE_RESET",
+    "STATE_RESET_RESPONSE",
+    "STATE_DISCOVER",
+    "STATE_DISCOVER_RESPONSE",
+    "STATE_DISCOVERING",
+    "STATE_NDEF",
+    "STATE_NDEF_RESPONSE",
+    "STATE_DEACTIVATE",
+    "STATE_DEACTIVATE_RESPONSE",
+    "STATE_ERROR",
+    "STATE_END"
+};
+
+// Sketch application object to interface with NfcTags API
+class NfcApps : public NfcTagsCb
+{
+    public:
+        NfcApps(NfcLog& log, NfcTags& tags) : _state(STATE_RESET), _log(log), _tags(tags) {;}
+        void init(void) {;}
+        void handleEvent(void);
+        void cbReset(uint8_t status, uint16_t id, void *data);
+        void cbDiscover(uint8_t status, uint16_t id, void *data);
+        void cbDiscoverNtf(uint8_t status, uint16_t id, void *data);
+        void cbDeactivate(uint8_t status, uint16_t id, void *data);
+        void cbDump(uint8_t status, uint16_t id, void *data) {;}
+        void cbNdef(uint8_t status, uint16_t id, void *data);
+
+    private:
+        uint8_t _state;
+        uint8_t _ndef[256];
+        NfcLog& _log;
+        NfcTags& _tags;
+};
+
+// State machine event handler
+void NfcApps::handleEvent(void)
+{
+    uint8_t status = TAGS_STATUS_FAILED;
+
+    _log.d("TagDetect: %s state = %s\n", __func__, tagDetectStateToStr[_state]);
+
+    switch(_state) {
+        case STATE_RESET:
+            // reset NFC stack and hw
+            status = _tags.cmdReset();
+            _state = STATE_RESET_RESPONSE;
+            break;
+        case STATE_RESET_RESPONSE:
+            // wait for reset
+            status = TAGS_STATUS_OK;
+            break;
+        case STATE_DISCOVER:
+            // find tags
+            status = _tags.cmdDiscover();
+            _state = STATE_DISCOVER_RESPONSE;
+            break;
+        case STATE_DISCOVER_RESPONSE:
+            // wait for find tags response
+            status = TAGS_STATUS_OK;
+            break;
+        case STATE_DISCOVERING:
+            // waiting for a tag to be detected
+            status = TAGS_STATUS_OK;
+            break;
+        case STATE_NDEF:
+            // read NDEF message
+            status = _tags.cmdReadNdef(_ndef, sizeof(_ndef));
+            _state = STATE_NDEF_RESPONSE;
+            break;
+        case STATE_NDEF_RESPONSE:
+            // waiting for NDEF message
+            status = TAGS_STATUS_OK;
+            break;
+        case STATE_DEACTIVATE:
+            // disconnect from tag and restart discovery loop
+            status = _tags.cmdDeactivate();
+            _state = STATE_DEACTIVATE_RESPONSE;
+            break;
+        case STATE_DEACTIVATE_RESPONSE:
+            // wait for tag deactivation
+            status = TAGS_STATUS_OK;
+            break;
+        case STATE_ERROR:
+        case STATE_END:
+        default:
+            break;
+    }
+
+    // handle error
+    if (status != TAGS_STATUS_OK) {
+        _log.e("TagDetect error: %s status = %d state = %d\n", __func__, status, _state);
+        _state = STATE_ERROR;
+    }
+}
+
+// Hardware reset callback
+void NfcApps::cbReset(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("TagDetect: %s status = %d id = %d\n", __func__, status, id);
+
+    if (status != TAGS_STATUS_OK || id != TAGS_ID_RESET) {
+        _state = STATE_ERROR;
+    }
+    else {
+        _log.i("TagDetect: NFC stack and HW reseted\n");
+        _state = STATE_DISCOVER;
+    }
+}
+
+// Discover target callback
+void NfcApps::cbDiscover(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("TagDetect: %s status = %d id = %d\n", __func__, status, id);
+
+    if (status != TAGS_STATUS_OK || id != TAGS_ID_DISCOVER) {
+        _state = STATE_ERROR;
+    }
+    else {
+        _log.i("TagDetect: NFC stack discovering tags...\n");
+        _state = STATE_DISCOVERING;
+    }
+}
+
+// Discover notification on tag detected callback
+void NfcApps::cbDiscoverNtf(uint8_t status, uint16_t id, void *data)
+{
+    NfcTagsIntf *pTag;
+    uint8_t len, type;
+    uint8_t *buf;
+
+    _log.d("TagDetect: %s status = %d id = %d\n", __func__, status, id);
+
+    if (status != TAGS_STATUS_OK || id != TAGS_ID_DISCOVER_ACTIVATED) {
+        _state = STATE_ERROR;
+    }
+    else {
+        pTag = _tags.getInterface();
+        if (pTag != NULL) {
+            type = pTag->getType();
+            _log.i("TagDetect: tag type %d detected\n", type);
+            len = pTag->getNfcidLen();
+            buf = pTag->getNfcidBuf();
+            _log.bi("TagDetect: tag NFCID = ", buf, len);
+            // NDEF read is only implemented for tag type 2
+            // and 4 at the moment
+            if (type == TAGS_TYPE_2 || type == TAGS_TYPE_4) {
+                _state = STATE_NDEF;
+            }
+            else {
+                _state = STATE_DEACTIVATE;
+            }
+        }
+        else {
+            _log.i("TagDetect: unknown tag type detected\n");
+            _state = STATE_DEACTIVATE;
+        }
+    }
+}
+
+// NDEF message callback
+void NfcApps::cbNdef(uint8_t status, uint16_t id, void *data)
+{
+    tTAGS_NDEF *ndef = (tTAGS_NDEF*)data;
+    tNDEF_RECORD rec;
+    NfcNdef parser;
+
+    _log.d("TagDetect: %s status = %d id = %d\n", __func__, status, id);
+
+    if (status != TAGS_STATUS_OK || id != TAGS_ID_READ_NDEF || ndef == NULL) {
+        _log.i("TagDetect: no NDEF message\n");
+    }
+    else {
+        // records point into the message buffer
+        parser.init(ndef->buf, ndef->len);
+        while (parser.getRecord(&rec) == NDEF_STATUS_OK) {
+            _log.i("TagDetect: NDEF record TNF %d\n", rec.tnf);
+            _log.bi("TagDetect: type = ", rec.type, rec.type_len);
+            _log.bi("TagDetect: payload = ", rec.payload, rec.payload_len);
+        }
+    }
+    _state = STATE_DEACTIVATE;
+}
+
+// Tag deactivation callback
+void NfcApps::cbDeactivate(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("TagDetect: %s status = %d id = %d\n", __func__, status, id);
+
+    if (status != TAGS_STATUS_OK || id != TAGS_ID_DEACTIVATE) {
+        _state = STATE_ERROR;
+    }
+    else {
+        _state = STATE_DISCOVERING;
+    }
+}
+
+/**********************************************
+ *           Sketch runtime
+ *
+ * _log: logger (serial)
+ * _i2c: I2C bus the NFC chipset is wired on
+ * _pn7120: NXP PN7120 NFC chipset
+ * _nci: NFC Connection Interface (NFC Forum)
+ * _tags: tag API wrapper to drive NCI chipset
+ * _app: sketch implementation
+ **********************************************/
+
+NfcLog _log(NFC_LOG_LEVEL_INFO);
+NfcI2c_wire _i2c(Wire, NFC_I2C_CLOCK_FAST);
+NfcHw_pn7120 _pn7120(_log, _i2c, PN7120_IRQ, PN7120_RESET, PN7120_I2C_ADDRESS);
+NfcNci _nci(_log, _pn7120);
+NfcTags _tags(_log, _nci);
+NfcApps _app(_log, _tags);
+
+// the setup function runs once when you press reset or power the board
+void setup(void)
+{
+    // add a delay for the serial bus to be mounted
+    delay(2000);
+
+    // init all layers from bottom to top
+    // logger, hw, nci, tags, and state machine
+    _log.init(230400);
+    _pn7120.init();
+    _nci.init(&_tags);
+    _tags.init(&_app);
+    _app.init();
+}
+
+// the loop function runs over and over again forever
+void loop(void)
+{
+    // handle sketch events (state machine based)
+    _app.handleEvent();
+
+    // handle tags class events (state machine based),
+    // it sends the next command
+    _tags.handleEvent();
+
+    // handle NCI events (state machine based),
+    // it may block waiting for NFC controller
+    // response or event, passed on to _tags
+    _nci.handleEvent();
+}
+
@@ -51,7 +51,7 @@
  *      NFC controller hardware configuration
  *
  * - NXP PN7120 NFC chipset
- * - Connected with I2C + IRQ + RESET
+ * - Connected with I2C (Fast-mode) + IRQ + RESET
  *********************************************/
 
 #define PN7120_IRQ          2  // pin 2 configured as input for IRQ
@@ -247,6 +247,7 @@ void NfcApps::cbDeactivate(uint8_t status, uint16_t id, void *data)
  *           Sketch runtime
  *
  * _log: logger (serial)
+ * _i2c: I2C bus the NFC chipset is wired on
  * _pn7120: NXP PN7120 NFC chipset
  * _nci: NFC Connection Interface (NFC Forum)
  * _tags: tag API wrapper to drive NCI chipset
@@ -254,7 +255,8 @@ void NfcApps::cbDeactivate(uint8_t status, uint16_t id, void *data)
  **********************************************/
 
 NfcLog _log(NFC_LOG_LEVEL_INFO);
-NfcHw_pn7120 _pn7120(_log, PN7120_IRQ, PN7120_RESET, PN7120_I2C_ADDRESS);
+NfcI2c_wire _i2c(Wire, NFC_I2C_CLOCK_FAST);
+NfcHw_pn7120 _pn7120(_log, _i2c, PN7120_IRQ, PN7120_RESET, PN7120_I2C_ADDRESS);
 NfcNci _nci(_log, _pn7120);
 NfcTags _tags(_log, _nci);
 NfcApps _app(_log, _tags);
@@ -280,12 +282,13 @@ void loop(void)
     // handle sketch events (state machine based)
     _app.handleEvent();
 
-    // handle tags class events (state machine based)
+    // handle tags class events (state machine based),
+    // it sends the next command
     _tags.handleEvent();
 
     // handle NCI events (state machine based),
     // it may block waiting for NFC controller
-    // response or event
+    // response or event, passed on to _tags
     _nci.handleEvent();
 }
 
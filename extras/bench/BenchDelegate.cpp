@@ -0,0 +1,102 @@
+/*
+ * BenchDelegate.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Callback call cost, in host time rather than simulated time, so
+// results depend on the machine: a virtual NfcTagsCb call, as before
+// the delegates, a delegate bound to a member function, as subscribe()
+// does, and one bound to a virtual NfcTagsCb function, as init() does.
+// The objects are reached through volatile pointers so that the
+// compiler can not devirtualize the calls, best of a few runs.
+
+#include <chrono>
+#include "NfcTest.h"
+
+#define CALLS   50000000
+#define RUNS    5
+
+class BenchApp : public NfcTagsCb
+{
+    public:
+        BenchApp(void) : count(0) {;}
+        void __attribute__((noinline)) cbDump(uint8_t s, uint16_t id, void *d) {count++;}
+        void __attribute__((noinline)) onDump(uint8_t s, uint16_t id, void *d) {count++;}
+
+    public:
+        volatile uint32_t count;
+};
+
+static BenchApp app;
+static NfcTagsCb * volatile p_cb = &app;
+static NfcDelegate delegates[2];
+static NfcDelegate * volatile p_delegates = delegates;
+
+static double now(void)
+{
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ns per call, best run
+static double benchVirtual(void)
+{
+    double best = 0, start, time;
+    uint32_t i, r;
+
+    for (r = 0; r < RUNS; r++) {
+        NfcTagsCb *cb = p_cb;
+        start = now();
+        for (i = 0; i < CALLS; i++) {
+            cb->cbDump(TAGS_STATUS_OK, TAGS_ID_DUMP, NULL);
+        }
+        time = (now() - start) / CALLS;
+        best = (r == 0 || time < best) ? time : best;
+    }
+    return best;
+}
+
+static double benchDelegate(uint8_t n)
+{
+    double best = 0, start, time;
+    uint32_t i, r;
+
+    for (r = 0; r < RUNS; r++) {
+        const NfcDelegate& cb = p_delegates[n];
+        start = now();
+        for (i = 0; i < CALLS; i++) {
+            cb(TAGS_STATUS_OK, TAGS_ID_DUMP, NULL);
+        }
+        time = (now() - start) / CALLS;
+        best = (r == 0 || time < best) ? time : best;
+    }
+    return best;
+}
+
+int main(void)
+{
+    delegates[0] = NfcDelegate::bind<BenchApp, &BenchApp::onDump>(&app);
+    delegates[1] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbDump>(&app);
+
+    printf("callback                          ns/call\n");
+    printf("virtual NfcTagsCb                 %7.2f\n", benchVirtual());
+    printf("delegate, member function         %7.2f\n", benchDelegate(0));
+    printf("delegate, virtual NfcTagsCb       %7.2f\n", benchDelegate(1));
+
+    return app.count == 3U * CALLS * RUNS ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+/*
+ * BenchHw.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Host time per NCI frame with the generic NfcHw interface and with
+// the controller selected at build time, so results depend on the
+// machine: a type 2 tag dumped over and over through the simulated
+// bus of the controller, the time per READ command and response,
+// best of a few runs. The bus simulation is included and the same
+// in both builds. Built once per configuration by the makefile with
+// BENCH_HW_NAME and its NFC_CONFIG_HW_xxx flag.
+
+#include <chrono>
+#include "NfcTest.h"
+
+#ifndef BENCH_HW_NAME
+#define BENCH_HW_NAME   "generic"
+#endif
+
+#define DUMPS   500
+#define RUNS    5
+
+static double now(void)
+{
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ns per frame, best run, 0 if the dump failed
+static double benchBus(uint8_t bus)
+{
+    double best = 0, start, time;
+    uint32_t d, r;
+
+    for (r = 0; r < RUNS; r++) {
+        NfcTest t(bus);
+        NfcSimType2 tag(45);
+
+        if (!t.start(&tag)) {
+            return 0;
+        }
+        start = now();
+        for (d = 0; d < DUMPS; d++) {
+            t.app.clear();
+            t.tags.cmdDump();
+            while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+                ;
+            }
+            if (t.app.status[TAGS_EVT_DUMP] != TAGS_STATUS_OK) {
+                return 0;
+            }
+        }
+        time = (now() - start) / tag.reads;
+        if (best == 0 || time < best) {
+            best = time;
+        }
+    }
+    return best;
+}
+
+static void benchPrint(const char *name, uint8_t bus)
+{
+    printf("%-8s  %-4s  %9.0f\n", BENCH_HW_NAME, name, benchBus(bus));
+}
+
+int main(void)
+{
+#if defined(NFC_CONFIG_HW_PN7120)
+    benchPrint("I2C", NFC_TEST_BUS_I2C);
+#elif defined(NFC_CONFIG_HW_SPI)
+    benchPrint("SPI", NFC_TEST_BUS_SPI);
+#elif defined(NFC_CONFIG_HW_UART)
+    benchPrint("UART", NFC_TEST_BUS_UART);
+#else
+    benchPrint("I2C", NFC_TEST_BUS_I2C);
+    benchPrint("SPI", NFC_TEST_BUS_SPI);
+    benchPrint("UART", NFC_TEST_BUS_UART);
+#endif
+
+    return 0;
+}
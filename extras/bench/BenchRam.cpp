@@ -0,0 +1,73 @@
+/*
+ * BenchRam.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// RAM held by the stack objects for one library configuration, built
+// once per configuration by the makefile with BENCH_RAM_NAME and its
+// NFC_CONFIG_xxx flags. An NTAG216 is dumped and a type 4 NDEF message
+// read, when built, to check the configuration works.
+
+#include "NfcTest.h"
+
+#ifndef BENCH_RAM_NAME
+#define BENCH_RAM_NAME  "default"
+#endif
+
+static const char* benchDump(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(231);
+
+    t.tags.setProbe(true);
+    if (!t.start(&tag) || t.tags.cmdDump() != TAGS_STATUS_OK) {
+        return "failed";
+    }
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    return (t.app.status[TAGS_EVT_DUMP] == TAGS_STATUS_OK && t.app.dump_len == tag.size) ? "ok" : "failed";
+}
+
+static const char* benchNdef(void)
+{
+#if NFC_CONFIG_TAG_TYPE4
+    static uint8_t buf[1024];
+    NfcTest t;
+    NfcSimType4 tag(255, 1000);
+
+    if (!t.start(&tag) || t.tags.cmdReadNdef(buf, sizeof(buf)) != TAGS_STATUS_OK ||
+        !t.run(TAGS_EVT_NDEF, 1)) {
+        return "failed";
+    }
+    return (t.app.status[TAGS_EVT_NDEF] == TAGS_STATUS_OK && t.app.ndef.len == 1000) ? "ok" : "failed";
+#else
+    return "-";
+#endif
+}
+
+int main(void)
+{
+    const char *dump = benchDump();
+    const char *ndef = benchNdef();
+
+    printf("%-30s  %6u  %7u  %-6s  %s\n", BENCH_RAM_NAME,
+           (uint32_t)sizeof(NfcNci), (uint32_t)sizeof(NfcTags), dump, ndef);
+
+    return (strcmp(dump, "failed") == 0 || strcmp(ndef, "failed") == 0) ? 1 : 0;
+}
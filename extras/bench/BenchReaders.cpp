@@ -0,0 +1,121 @@
+/*
+ * BenchReaders.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Several controllers served from one loop: each reader dumps its
+// NTAG213 over and over for RUN_TIME ms of simulated time, the last
+// controller being slow (long RF exchanges, as with a weak field).
+// The controllers share an I2C Fast-mode bus, one transfer at once.
+// The blocking loop waits for each response in turn, as the single
+// reader sketches do, NfcReaders only reads the controllers which
+// have a packet ready, round-robin or as long as one is ready.
+
+#include "NfcTest.h"
+
+#define RUN_TIME        2000    // ms
+#define SLOW_RF_TIME    20000   // us
+
+static const tNFC_SIM_BUS i2c_bus = {NFC_I2C_CLOCK_FAST, 9, 9 + 2};
+
+enum {
+    LOOP_BLOCKING = 0,
+    LOOP_ROUND_ROBIN,
+    LOOP_IRQ
+};
+
+static const char *loop_names[] = {"blocking", "round-robin", "irq"};
+
+static void bench(uint8_t loop, uint8_t num)
+{
+    NfcTest *t[NFC_READERS_MAX];
+    NfcSimType2 *tag[NFC_READERS_MAX];
+    NfcLog log(NFC_LOG_LEVEL_OFF);
+    NfcReaders readers(log, loop == LOOP_IRQ ? NFC_READERS_IRQ : NFC_READERS_ROUND_ROBIN);
+    uint32_t dumps[NFC_READERS_MAX];
+    uint32_t i, start;
+
+    for (i = 0; i < num; i++) {
+        t[i] = new NfcTest();
+        tag[i] = new NfcSimType2();
+        t[i]->hw.bus = i2c_bus;
+        if (i + 1 == num && num > 1) {
+            t[i]->ctrl.config.rf_time = SLOW_RF_TIME;
+        }
+        t[i]->start(tag[i]);
+        t[i]->tags.cmdDump();
+        readers.add(t[i]->nci, t[i]->tags);
+        dumps[i] = 0;
+    }
+
+    start = millis();
+    while (millis() - start < RUN_TIME) {
+        // next dump as soon as one completes
+        for (i = 0; i < num; i++) {
+            if (t[i]->app.done) {
+                dumps[i] += (t[i]->app.status[TAGS_EVT_DUMP] == TAGS_STATUS_OK);
+                t[i]->app.done = false;
+                t[i]->tags.cmdDump();
+            }
+        }
+
+        if (loop == LOOP_BLOCKING) {
+            for (i = 0; i < num; i++) {
+                t[i]->tags.handleEvent();
+                if (t[i]->nci.isBusy()) {
+                    t[i]->nci.handleEvent();
+                }
+            }
+        }
+        else {
+            readers.handleEvent();
+        }
+        yield();
+    }
+
+    printf("%-12s  %u     ", loop_names[loop], num);
+    for (i = 0; i < NFC_READERS_MAX; i++) {
+        if (i < num) {
+            printf("  %5u", dumps[i]);
+        }
+        else {
+            printf("       ");
+        }
+    }
+    printf("\n");
+
+    for (i = 0; i < num; i++) {
+        delete t[i];
+        delete tag[i];
+    }
+}
+
+int main(void)
+{
+    uint8_t loop, num;
+
+    printf("dumps per reader in %u ms, the last reader is slow\n", RUN_TIME);
+    printf("loop          readers  #1     #2     #3     #4\n");
+    for (loop = LOOP_BLOCKING; loop <= LOOP_IRQ; loop++) {
+        for (num = 1; num <= NFC_READERS_MAX; num++) {
+            bench(loop, num);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * BenchTransport.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// NCI transport throughput: the same tag sessions over NfcHw_pn7120
+// (I2C Fast-mode), NfcHw_spi (7 MHz) and NfcHw_uart (921600 bauds),
+// against the simulated controller with its default timings. The
+// packet level NfcSimHw gives the time spent out of the bus.
+//
+// Session A reads a 2000 bytes NDEF message from a type 4 tag (MLe
+// 255, long data packets), session B dumps an NTAG216 type 2 tag
+// (short packets, one READ per 16 bytes).
+
+#include "NfcTest.h"
+
+#define NDEF_LEN    2000
+
+static const char *bus_names[] = {"none", "I2C 400 kHz", "SPI 7 MHz", "UART 921600"};
+
+static uint32_t benchNdef(uint8_t bus, uint32_t *bytes)
+{
+    static uint8_t buf[NDEF_LEN + 16];
+    NfcTest t(bus);
+    NfcSimType4 tag(255, NDEF_LEN);
+    uint32_t start;
+
+    if (!t.start(&tag)) {
+        return 0;
+    }
+    start = micros();
+    t.tags.cmdReadNdef(buf, sizeof(buf));
+    if (!t.run(TAGS_EVT_NDEF, 1, 10000) || t.app.ndef.len != NDEF_LEN) {
+        return 0;
+    }
+    *bytes = NDEF_LEN;
+    return micros() - start;
+}
+
+static uint32_t benchDump(uint8_t bus, uint32_t *bytes)
+{
+    NfcTest t(bus);
+    NfcSimType2 tag(231);
+    uint32_t start;
+
+    t.tags.setProbe(true);
+    if (!t.start(&tag)) {
+        return 0;
+    }
+    start = micros();
+    t.tags.cmdDump();
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1, 10000)) {
+        ;
+    }
+    if (t.app.status[TAGS_EVT_DUMP] != TAGS_STATUS_OK) {
+        return 0;
+    }
+    *bytes = t.app.dump_len;
+    return micros() - start;
+}
+
+int main(void)
+{
+    uint32_t bus, time, bytes, base_ndef, base_dump;
+
+    printf("transport     session  bytes  time (us)  bytes/s  bus (us)\n");
+    base_ndef = base_dump = 0;
+    for (bus = NFC_TEST_BUS_NONE; bus <= NFC_TEST_BUS_UART; bus++) {
+        bytes = 0;
+        time = benchNdef(bus, &bytes);
+        base_ndef = (bus == NFC_TEST_BUS_NONE) ? time : base_ndef;
+        printf("%-12s  A        %5u  %9u  %7u  %8u\n", bus_names[bus], bytes, time,
+               time ? (uint32_t)((uint64_t)bytes * 1000000 / time) : 0, time - base_ndef);
+
+        bytes = 0;
+        time = benchDump(bus, &bytes);
+        base_dump = (bus == NFC_TEST_BUS_NONE) ? time : base_dump;
+        printf("%-12s  B        %5u  %9u  %7u  %8u\n", bus_names[bus], bytes, time,
+               time ? (uint32_t)((uint64_t)bytes * 1000000 / time) : 0, time - base_dump);
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * BenchType1.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Type 1 dump commands: RID, RALL, RSEG, READ8 and READ sent to dump
+// Topaz tags, with the simulated dump time over the packet level
+// NfcSimHw. The controller payload is then cut to 64 bytes, RALL and
+// RSEG do not fit and the tags are read byte or block wise.
+
+#include "NfcTest.h"
+
+static void benchDump(const char *name, uint8_t hr0, uint32_t blocks, bool formatted,
+                      uint8_t max_payload = 0)
+{
+    NfcTest t;
+    NfcSimType1 tag(hr0, blocks, formatted);
+    uint32_t start, time, cmds;
+
+    t.ctrl.config.max_payload = max_payload;
+    if (!t.start(&tag)) {
+        printf("%-22s  failed\n", name);
+        return;
+    }
+    start = micros();
+    t.tags.cmdDump();
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    time = micros() - start;
+    if (t.app.status[TAGS_EVT_DUMP] != TAGS_STATUS_OK) {
+        printf("%-22s  failed\n", name);
+        return;
+    }
+    cmds = tag.rid + tag.rall + tag.rseg + tag.read8 + tag.read;
+    printf("%-22s  %5u  %3u  %4u  %4u  %5u  %4u  %4u  %9u\n", name, t.app.dump_len,
+           tag.rid, tag.rall, tag.rseg, tag.read8, tag.read, cmds, time);
+}
+
+int main(void)
+{
+    printf("tag                     bytes  RID  RALL  RSEG  READ8  READ  cmds  time (us)\n");
+    benchDump("Topaz 96 (static)", 0x11, 15, true);
+    benchDump("  payload 64", 0x11, 15, true, 64);
+    benchDump("Topaz 512 (dynamic)", 0x12, 64, true);
+    benchDump("  payload 64", 0x12, 64, true, 64);
+    benchDump("dynamic, 72 blocks", 0x12, 72, true);
+    benchDump("  payload 64", 0x12, 72, true, 64);
+    benchDump("Topaz 512 unformatted", 0x12, 64, false);
+    benchDump("  payload 64", 0x12, 64, false, 64);
+
+    return 0;
+}
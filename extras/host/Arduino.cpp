@@ -0,0 +1,177 @@
+/*
+ * Arduino.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <SPI.h>
+
+HardwareSerial Serial;
+TwoWire Wire;
+SPIClass SPI;
+
+static uint32_t host_time = 0;      // simulated time, us
+static uint32_t host_step = 1;      // yield() time step, us
+static HostPin *host_pins[256];     // devices driving the pins
+
+void hostAttachPin(uint8_t pin, HostPin *dev)
+{
+    host_pins[pin] = dev;
+}
+
+void hostAdvance(uint32_t us)
+{
+    host_time += us;
+}
+
+void hostSetYieldStep(uint32_t us)
+{
+    host_step = us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    if (host_pins[pin] != NULL) {
+        host_pins[pin]->write(pin, val);
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    return host_pins[pin] != NULL ? host_pins[pin]->read(pin) : LOW;
+}
+
+unsigned long millis(void)
+{
+    return host_time / 1000;
+}
+
+unsigned long micros(void)
+{
+    return host_time;
+}
+
+void delay(unsigned long ms)
+{
+    host_time += ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    host_time += us;
+}
+
+void yield(void)
+{
+    host_time += host_step;
+}
+
+size_t Print::print(const char *str)
+{
+    if (_out) {
+        fputs(str, stdout);
+    }
+    return strlen(str);
+}
+
+size_t Print::print(char c)
+{
+    if (_out) {
+        putchar(c);
+    }
+    return 1;
+}
+
+size_t Print::print(unsigned char val, int base)
+{
+    return print((unsigned long)val, base);
+}
+
+size_t Print::print(int val, int base)
+{
+    // negative numbers are printed in decimal only, as Arduino does
+    if (base == DEC && val < 0) {
+        return print('-') + print((unsigned long)-(long)val, base);
+    }
+    return print((unsigned long)(unsigned int)val, base);
+}
+
+size_t Print::print(unsigned int val, int base)
+{
+    return print((unsigned long)val, base);
+}
+
+size_t Print::print(long val, int base)
+{
+    if (base == DEC && val < 0) {
+        return print('-') + print((unsigned long)-val, base);
+    }
+    return print((unsigned long)val, base);
+}
+
+size_t Print::print(unsigned long val, int base)
+{
+    char buf[8 * sizeof(long) + 1];
+    char *p = &buf[sizeof(buf) - 1];
+
+    *p = '\0';
+    do {
+        *--p = "0123456789ABCDEF"[val % base];
+        val /= base;
+    } while (val != 0);
+
+    return print(p);
+}
+
+size_t Stream::readBytes(uint8_t *buf, size_t len)
+{
+    size_t num = 0;
+    uint32_t start = micros();
+
+    // bytes as they come, until the timeout
+    while (num < len) {
+        if (available()) {
+            buf[num++] = read();
+        }
+        else if (micros() - start >= _timeout * 1000) {
+            break;
+        }
+        else {
+            yield();
+        }
+    }
+
+    return num;
+}
+
+void SPIClass::transfer(void *buf, size_t len)
+{
+    uint8_t *p = (uint8_t *)buf;
+
+    while (len--) {
+        *p = transfer(*p);
+        p++;
+    }
+}
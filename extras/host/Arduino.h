@@ -0,0 +1,119 @@
+/*
+ * Arduino.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HOST_ARDUINO_H__
+#define __NFC_HOST_ARDUINO_H__
+
+// Minimal Arduino core for host builds of the library, used by the
+// tests and benchmarks in extras/. Time is simulated: micros() only
+// moves when delay(), yield() or hostAdvance() is called, so that runs
+// are reproducible. Simulated devices drive pins through HostPin.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define DEC             10
+#define HEX             16
+#define BIN             2
+
+#define F(str)          (str)
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+// pins driven by a simulated device
+class HostPin
+{
+    public:
+        virtual int read(uint8_t pin) = 0;
+        virtual void write(uint8_t pin, uint8_t val) = 0;
+};
+
+// attach a device to a pin, NULL to detach
+void hostAttachPin(uint8_t pin, HostPin *dev);
+// move simulated time forward, in microseconds
+void hostAdvance(uint32_t us);
+// simulated time step of yield(), in microseconds, 1 by default
+void hostSetYieldStep(uint32_t us);
+
+class Print
+{
+    public:
+        size_t print(const char *str);
+        size_t print(char c);
+        size_t print(unsigned char val, int base = DEC);
+        size_t print(int val, int base = DEC);
+        size_t print(unsigned int val, int base = DEC);
+        size_t print(long val, int base = DEC);
+        size_t print(unsigned long val, int base = DEC);
+        size_t println(const char *str) {return print(str) + print('\n');}
+        // output enabled, stdout
+        void setOutput(bool on) {_out = on;}
+
+    protected:
+        Print() : _out(false) {;}
+        bool _out;
+};
+
+class Stream : public Print
+{
+    public:
+        virtual int available(void) {return 0;}
+        virtual int read(void) {return -1;}
+        virtual size_t write(uint8_t val) {return write(&val, 1);}
+        virtual size_t write(const uint8_t *buf, size_t len) {return len;}
+        virtual size_t readBytes(uint8_t *buf, size_t len);
+        void setTimeout(unsigned long ms) {_timeout = ms;}
+        virtual void flush(void) {;}
+
+    protected:
+        Stream() : _timeout(1000) {;}
+        unsigned long _timeout;
+};
+
+class HardwareSerial : public Stream
+{
+    public:
+        HardwareSerial() {;}
+        virtual void begin(unsigned long baud) {;}
+        operator bool() {return true;}
+};
+
+extern HardwareSerial Serial;
+
+#endif /* __NFC_HOST_ARDUINO_H__ */
@@ -0,0 +1,496 @@
+/*
+ * NfcSim.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcSim.h"
+
+// controller RF states
+#define SIM_STATE_IDLE          0
+#define SIM_STATE_DISCOVERY     1
+#define SIM_STATE_ACTIVE        2
+
+// RF timeout of a mute tag, us
+#define SIM_RF_TIMEOUT          5000
+
+// CORE_INIT_RSP: status | features | interfaces | max logical
+// connections | max routing table | max control payload | max
+// large parameters | manufacturer
+static const uint8_t sim_init_rsp[] = {
+    NCI_STATUS_OK, 0x00, 0x00, 0x00, 0x00,
+    2, NCI_INTERFACE_FRAME, NCI_INTERFACE_ISO_DEP,
+    1, 0x00, 0x00, 0xFF, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+NfcSimController::NfcSimController(void) : _tag(NULL)
+{
+    config.max_payload = 0xFF;
+    config.credits = 1;
+    config.credits_late = false;
+    config.credit_time = 0;
+    config.cmd_time = 100;
+    config.rf_time = 500;
+    config.rf_byte_time = 10;
+    reset();
+}
+
+void NfcSimController::reset(void)
+{
+    packets = data_packets = rsp_segments = 0;
+    max_segment = flow_errors = activations = 0;
+    _state = SIM_STATE_IDLE;
+    _discovering = false;
+    _credits = 0;
+    _busy = micros();
+    _head = _num = _pos = 0;
+    _cmd_len = 0;
+}
+
+void NfcSimController::setTag(NfcSimTag *tag)
+{
+    _tag = tag;
+
+    // a tag removed is noticed on the next exchange with it,
+    // a tag brought in is activated while the controller polls
+    if (_tag != NULL && _state == SIM_STATE_DISCOVERY) {
+        activate();
+    }
+}
+
+uint8_t NfcSimController::getMaxPayload(void)
+{
+    return config.max_payload != 0 ? config.max_payload : 0xFF;
+}
+
+void NfcSimController::queue(uint8_t hdr0, uint8_t hdr1, const uint8_t payload[], uint32_t len)
+{
+    tNFC_SIM_PACKET *p;
+
+    if (_num == NFC_SIM_QUEUE_SIZE) {
+        printf("NfcSim: packet queue full\n");
+        return;
+    }
+
+    // packets are ready in order, once the controller is done
+    p = &_queue[(_head + _num) % NFC_SIM_QUEUE_SIZE];
+    p->time = _busy;
+    p->len = NCI_MSG_HDR_SIZE + len;
+    p->buf[0] = hdr0;
+    p->buf[1] = hdr1;
+    p->buf[2] = len;
+    memcpy(&p->buf[NCI_MSG_HDR_SIZE], payload, len);
+    _num++;
+}
+
+void NfcSimController::ntf(uint8_t gid, uint8_t oid, const uint8_t payload[], uint32_t len)
+{
+    queue((NCI_MT_NTF << NCI_MT_SHIFT) | gid, oid, payload, len);
+}
+
+void NfcSimController::rsp(uint8_t gid, uint8_t oid, uint8_t status)
+{
+    queue((NCI_MT_RSP << NCI_MT_SHIFT) | gid, oid, &status, 1);
+}
+
+void NfcSimController::giveCredit(void)
+{
+    uint8_t buf[] = {1, NCI_CID_RF_STATIC, 1};
+
+    // the host owns the credit once it has read the notification
+    if (config.credits == NCI_CREDITS_UNLIMITED) {
+        return;
+    }
+    ntf(NCI_GID_CORE, NCI_MSG_CORE_CONN_CREDITS, buf, sizeof(buf));
+}
+
+void NfcSimController::activate(void)
+{
+    uint8_t buf[NCI_PACKET_SIZE];
+    uint32_t len;
+
+    // the tag gives its RF parameters, the controller its own
+    len = _tag->activate(buf);
+    buf[4] = config.max_payload;
+    buf[5] = config.credits;
+    _credits = config.credits;
+    _cmd_len = 0;
+    _state = SIM_STATE_ACTIVE;
+    activations++;
+
+    _busy += config.rf_time;
+    ntf(NCI_GID_RF_MANAGE, NCI_MSG_RF_INTF_ACTIVATED, buf, len);
+}
+
+void NfcSimController::write(const uint8_t buf[], uint32_t len)
+{
+    // the controller handles packets one after the other
+    if ((int32_t)(micros() - _busy) > 0) {
+        _busy = micros();
+    }
+    packets++;
+
+    if ((buf[0] & NCI_MT_MASK) == NCI_MT_DATA) {
+        handleData(buf, len);
+    }
+    else {
+        handleCmd(buf, len);
+    }
+}
+
+void NfcSimController::handleCmd(const uint8_t buf[], uint32_t len)
+{
+    uint8_t gid, oid, type;
+    uint8_t deact[NCI_RF_PARAM_SIZE_DEACTIVATE_NTF];
+    uint8_t reset[] = {NCI_STATUS_OK, 0x10, NCI_RESET_TYPE_KEEP_CFG};
+
+    gid = buf[0] & NCI_GID_MASK;
+    oid = buf[1] & NCI_OID_MASK;
+    _busy += config.cmd_time;
+
+    if (gid == NCI_GID_CORE && oid == NCI_MSG_CORE_RESET) {
+        // the reset drops the pending packets
+        _head = _num = _pos = 0;
+        _state = SIM_STATE_IDLE;
+        _discovering = false;
+        queue((NCI_MT_RSP << NCI_MT_SHIFT) | gid, oid, reset, sizeof(reset));
+    }
+    else if (gid == NCI_GID_CORE && oid == NCI_MSG_CORE_INIT) {
+        queue((NCI_MT_RSP << NCI_MT_SHIFT) | gid, oid, sim_init_rsp, sizeof(sim_init_rsp));
+    }
+    else if (gid == NCI_GID_RF_MANAGE && oid == NCI_MSG_RF_DISCOVER_MAP) {
+        rsp(gid, oid, NCI_STATUS_OK);
+    }
+    else if (gid == NCI_GID_RF_MANAGE && oid == NCI_MSG_RF_DISCOVER) {
+        rsp(gid, oid, NCI_STATUS_OK);
+        _state = SIM_STATE_DISCOVERY;
+        _discovering = true;
+        if (_tag != NULL) {
+            activate();
+        }
+    }
+    else if (gid == NCI_GID_RF_MANAGE && oid == NCI_MSG_RF_DEACTIVATE) {
+        // response then notification, polling again if asked to
+        type = len > NCI_MSG_HDR_SIZE ? buf[NCI_MSG_HDR_SIZE] : NCI_DEACTIVATE_TYPE_IDLE;
+        rsp(gid, oid, NCI_STATUS_OK);
+        deact[0] = type;
+        deact[1] = 0;
+        ntf(gid, oid, deact, sizeof(deact));
+        _cmd_len = 0;
+        if (type == NCI_DEACTIVATE_TYPE_DISCOVERY && _discovering) {
+            _state = SIM_STATE_DISCOVERY;
+            if (_tag != NULL) {
+                activate();
+            }
+        }
+        else {
+            _state = SIM_STATE_IDLE;
+            _discovering = false;
+        }
+    }
+    else {
+        printf("NfcSim: unknown command %02x %02x\n", buf[0], buf[1]);
+        rsp(gid, oid, NCI_STATUS_UNKNOWN_OID);
+    }
+}
+
+void NfcSimController::handleData(const uint8_t buf[], uint32_t len)
+{
+    uint8_t err[NCI_CORE_PARAM_SIZE_INTF_ERR_NTF] = {NCI_STATUS_TIMEOUT, NCI_CID_RF_STATIC};
+    uint32_t size, rsp_len, off, seg;
+    bool last;
+
+    size = buf[NCI_OFFSET_LEN];
+    last = (buf[0] & NCI_PBF_MASK) == NCI_PBF_NO_OR_LAST;
+    data_packets++;
+    if (size > max_segment) {
+        max_segment = size;
+    }
+    if (size > getMaxPayload()) {
+        printf("NfcSim: %d bytes data packet larger than %d\n", size, getMaxPayload());
+    }
+
+    // flow control, one credit per data packet, those whose
+    // notification is still to be read are not known to the host
+    if (config.credits != NCI_CREDITS_UNLIMITED) {
+        if (_credits == 0) {
+            flow_errors++;
+        }
+        else {
+            _credits--;
+        }
+    }
+
+    if (_state != SIM_STATE_ACTIVE) {
+        printf("NfcSim: data packet without active tag\n");
+        return;
+    }
+
+    // reassemble the command, the credit of a segment is
+    // given back once it has been sent to the tag
+    if (_cmd_len + size > NFC_SIM_DATA_SIZE) {
+        printf("NfcSim: data message too large\n");
+        _cmd_len = 0;
+        return;
+    }
+    memcpy(&_cmd[_cmd_len], &buf[NCI_MSG_HDR_SIZE], size);
+    _cmd_len += size;
+    if (!last || !config.credits_late) {
+        giveCredit();
+    }
+    if (!last) {
+        return;
+    }
+
+    // exchange with the tag, if still in the field
+    rsp_len = (_tag != NULL) ? _tag->exchange(_cmd, _cmd_len, _rsp) : NFC_SIM_NO_RESPONSE;
+    if (_tag != NULL) {
+        _tag->exchanges++;
+    }
+    if (rsp_len == NFC_SIM_NO_RESPONSE) {
+        _busy += SIM_RF_TIMEOUT;
+        ntf(NCI_GID_CORE, NCI_MSG_CORE_INTF_ERR_STATUS, err, sizeof(err));
+    }
+    else {
+        _busy += config.rf_time + config.rf_byte_time * (_cmd_len + rsp_len);
+
+        // segmented at the maximum payload, an empty response
+        // still takes one packet
+        off = 0;
+        do {
+            seg = rsp_len - off > getMaxPayload() ? getMaxPayload() : rsp_len - off;
+            queue((off + seg < rsp_len) ? NCI_PBF_ST_CONT : NCI_PBF_NO_OR_LAST,
+                  0, &_rsp[off], seg);
+            rsp_segments++;
+            off += seg;
+        } while (off < rsp_len);
+    }
+    _cmd_len = 0;
+    if (config.credits_late) {
+        _busy += config.credit_time;
+        giveCredit();
+    }
+}
+
+bool NfcSimController::ready(void)
+{
+    return _num != 0 && (int32_t)(micros() - _queue[_head].time) >= 0;
+}
+
+uint32_t NfcSimController::read(uint8_t buf[], uint32_t len)
+{
+    tNFC_SIM_PACKET *p;
+    uint32_t size;
+
+    if (_num == 0) {
+        return 0;
+    }
+
+    // bytes of the head packet, it is dropped once all read
+    p = &_queue[_head];
+    size = p->len - _pos;
+    if (size > len) {
+        size = len;
+    }
+    memcpy(buf, &p->buf[_pos], size);
+    _pos += size;
+    if (_pos == p->len) {
+        if (p->buf[0] == ((NCI_MT_NTF << NCI_MT_SHIFT) | NCI_GID_CORE) &&
+            p->buf[1] == NCI_MSG_CORE_CONN_CREDITS) {
+            _credits++;
+        }
+        _head = (_head + 1) % NFC_SIM_QUEUE_SIZE;
+        _num--;
+        _pos = 0;
+    }
+
+    return size;
+}
+
+uint32_t nfcSimBusTime(const tNFC_SIM_BUS& bus, uint32_t len)
+{
+    uint64_t bits;
+
+    bits = (uint64_t)len * bus.byte_bits + bus.transfer_bits;
+    return (uint32_t)((bits * 1000000 + bus.bit_rate - 1) / bus.bit_rate);
+}
+
+uint32_t NfcSimHw::write(uint8_t buf[], uint32_t len)
+{
+    _log.bv("NCI_TX: ", buf, len);
+    writes++;
+    if (bus.bit_rate != 0) {
+        hostAdvance(nfcSimBusTime(bus, len));
+    }
+    _ctrl.write(buf, len);
+    return len;
+}
+
+uint32_t NfcSimHw::read(uint8_t buf[], uint32_t len)
+{
+    wait();
+    if (bus.bit_rate != 0) {
+        hostAdvance(nfcSimBusTime(bus, len));
+    }
+    len = _ctrl.read(buf, len);
+    _log.bv("NCI_RX: ", buf, len);
+    return len;
+}
+
+void NfcSimHw::wait(void)
+{
+    while (!_ctrl.ready()) {
+        yield();
+    }
+}
+
+NfcSimI2c::NfcSimI2c(NfcSimController& ctrl, uint8_t irq, uint32_t clock) : _ctrl(ctrl)
+{
+    // address byte and ACKs, 9 bits per byte plus start and stop
+    _bus.bit_rate = clock;
+    _bus.byte_bits = 9;
+    _bus.transfer_bits = 9 + 2;
+    hostAttachPin(irq, this);
+}
+
+uint32_t NfcSimI2c::write(uint8_t address, const uint8_t buf[], uint32_t len)
+{
+    hostAdvance(nfcSimBusTime(_bus, len));
+    _ctrl.write(buf, len);
+    return len;
+}
+
+uint32_t NfcSimI2c::read(uint8_t address, uint8_t buf[], uint32_t len)
+{
+    hostAdvance(nfcSimBusTime(_bus, len));
+    return _ctrl.read(buf, len);
+}
+
+int NfcSimI2c::read(uint8_t pin)
+{
+    return _ctrl.ready() ? HIGH : LOW;
+}
+
+NfcSimSpi::NfcSimSpi(NfcSimController& ctrl, uint8_t cs, uint8_t irq, uint32_t clock) :
+    _ctrl(ctrl), _cs(cs), _irq(irq), _selected(false), _dir(0), _len(0)
+{
+    // 8 bits per byte, chip select setup and hold
+    _bus.bit_rate = clock;
+    _bus.byte_bits = 8;
+    _bus.transfer_bits = 8;
+    hostAttachPin(cs, this);
+    hostAttachPin(irq, this);
+}
+
+uint8_t NfcSimSpi::transfer(uint8_t val)
+{
+    uint8_t ret = 0;
+
+    hostAdvance(nfcSimBusTime(_bus, 1) - nfcSimBusTime(_bus, 0));
+    if (!_selected) {
+        return 0;
+    }
+
+    // direction byte first, then packet bytes either way
+    if (_dir == 0) {
+        _dir = val;
+    }
+    else if (_dir == NFC_SPI_HDR_WRITE) {
+        if (_len < sizeof(_buf)) {
+            _buf[_len++] = val;
+        }
+    }
+    else {
+        _ctrl.read(&ret, 1);
+    }
+
+    return ret;
+}
+
+void NfcSimSpi::transfer(void *buf, size_t len)
+{
+    // bulk reads in one go, the bus time is the same
+    if (_selected && _dir == NFC_SPI_HDR_READ) {
+        hostAdvance(nfcSimBusTime(_bus, len) - nfcSimBusTime(_bus, 0));
+        _ctrl.read((uint8_t *)buf, len);
+        return;
+    }
+    SPIClass::transfer(buf, len);
+}
+
+int NfcSimSpi::read(uint8_t pin)
+{
+    return (pin == _irq && _ctrl.ready()) ? HIGH : LOW;
+}
+
+void NfcSimSpi::write(uint8_t pin, uint8_t val)
+{
+    if (pin != _cs) {
+        return;
+    }
+
+    // chip select edges frame the transfers
+    if (val == LOW && !_selected) {
+        hostAdvance(nfcSimBusTime(_bus, 0));
+        _selected = true;
+        _dir = 0;
+        _len = 0;
+    }
+    else if (val == HIGH && _selected) {
+        _selected = false;
+        if (_dir == NFC_SPI_HDR_WRITE && _len != 0) {
+            _ctrl.write(_buf, _len);
+        }
+    }
+}
+
+NfcSimSerial::NfcSimSerial(NfcSimController& ctrl) : _ctrl(ctrl)
+{
+    _bus.bit_rate = NFC_UART_BAUD;
+    _bus.byte_bits = 10;
+    _bus.transfer_bits = 0;
+}
+
+void NfcSimSerial::begin(unsigned long baud)
+{
+    _bus.bit_rate = baud;
+}
+
+int NfcSimSerial::available(void)
+{
+    return _ctrl.ready() ? 1 : 0;
+}
+
+int NfcSimSerial::read(void)
+{
+    uint8_t val;
+
+    if (!_ctrl.ready()) {
+        return -1;
+    }
+    hostAdvance(nfcSimBusTime(_bus, 1));
+    _ctrl.read(&val, 1);
+    return val;
+}
+
+size_t NfcSimSerial::write(const uint8_t *buf, size_t len)
+{
+    hostAdvance(nfcSimBusTime(_bus, len));
+    _ctrl.write(buf, len);
+    return len;
+}
@@ -0,0 +1,210 @@
+/*
+ * NfcSim.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_SIM_H__
+#define __NFC_SIM_H__
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "Nfc.h"
+
+// Simulated NCI controller for host runs of the library. It answers
+// the NCI commands NfcTags sends, activates the simulated tag put in
+// its field and exchanges data packets with it: segmentation, credits
+// and RF errors as a controller does, with response delays in the
+// simulated time of the host Arduino core.
+
+// largest data message exchanged with a tag
+#define NFC_SIM_DATA_SIZE       4096
+// packets waiting to be read by the host
+#define NFC_SIM_QUEUE_SIZE      64
+// tag mute, the controller reports an RF timeout
+#define NFC_SIM_NO_RESPONSE     0xFFFFFFFF
+
+// simulated tag, see NfcSimTags.h
+class NfcSimTag
+{
+    public:
+        NfcSimTag(void) : exchanges(0) {;}
+        virtual ~NfcSimTag() {;}
+        // RF_INTF_ACTIVATED_NTF payload, returns its length
+        virtual uint32_t activate(uint8_t ntf[]) = 0;
+        // data message from the reader, returns the response
+        // length or NFC_SIM_NO_RESPONSE
+        virtual uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]) = 0;
+
+    public:
+        uint32_t exchanges;             // data messages exchanged
+};
+
+// controller behaviour and timings
+typedef struct {
+    uint8_t max_payload;    // data packet payload advertised, 0 for 255
+    uint8_t credits;        // credits on activation, 0xFF without flow control
+    bool credits_late;      // credits given back after the data response
+    uint32_t credit_time;   // late credits delay after the response, us
+    uint32_t cmd_time;      // control command processing, us
+    uint32_t rf_time;       // RF frame overhead, us
+    uint32_t rf_byte_time;  // RF time per byte, us
+} tNFC_SIM_CONFIG;
+
+// controller, transport independent: NCI packets in, bytes out
+class NfcSimController
+{
+    public:
+        NfcSimController(void);
+        // tag in the field, NULL when removed
+        void setTag(NfcSimTag *tag);
+        NfcSimTag* getTag(void) {return _tag;}
+        // power cycle, the controller waits for CORE_RESET_CMD
+        void reset(void);
+        // NCI packet from the host
+        void write(const uint8_t buf[], uint32_t len);
+        // a packet is ready to be read
+        bool ready(void);
+        // bytes of the packet ready, up to its end
+        uint32_t read(uint8_t buf[], uint32_t len);
+
+    public:
+        tNFC_SIM_CONFIG config;         // settings, used from the next command
+        uint32_t packets;               // packets received
+        uint32_t data_packets;          // data packets received
+        uint32_t rsp_segments;          // data packets sent
+        uint32_t max_segment;           // largest data packet payload received
+        uint32_t flow_errors;           // data packets received without credit
+        uint32_t activations;           // RF interface activations
+
+    private:
+        void ntf(uint8_t gid, uint8_t oid, const uint8_t payload[], uint32_t len);
+        void rsp(uint8_t gid, uint8_t oid, uint8_t status);
+        void queue(uint8_t hdr0, uint8_t hdr1, const uint8_t payload[], uint32_t len);
+        void handleCmd(const uint8_t buf[], uint32_t len);
+        void handleData(const uint8_t buf[], uint32_t len);
+        void activate(void);
+        void giveCredit(void);
+        uint8_t getMaxPayload(void);
+
+    private:
+        typedef struct {
+            uint32_t time;              // ready time, micros()
+            uint16_t len;
+            uint8_t buf[NCI_PACKET_SIZE];
+        } tNFC_SIM_PACKET;
+
+        NfcSimTag *_tag;
+        uint8_t _state;                 // NCI RF state
+        bool _discovering;              // RF_DISCOVER_CMD received
+        uint8_t _credits;               // credits the host knows it has
+        uint32_t _busy;                 // controller busy until, micros()
+        uint16_t _head, _num;           // packet queue
+        uint16_t _pos;                  // bytes of the head packet read
+        tNFC_SIM_PACKET _queue[NFC_SIM_QUEUE_SIZE];
+        uint32_t _cmd_len;              // data message being received
+        uint8_t _cmd[NFC_SIM_DATA_SIZE];
+        uint8_t _rsp[NFC_SIM_DATA_SIZE];
+};
+
+// bus timings, used by the bus simulations below
+typedef struct {
+    uint32_t bit_rate;      // bus clock or baud rate, 0 for no bus
+    uint32_t byte_bits;     // bits per byte on the wire
+    uint32_t transfer_bits; // bits of overhead per transfer
+} tNFC_SIM_BUS;
+
+// NFC controller hardware without bus driver, packets go straight
+// to the simulated controller, in bus time when set
+class NfcSimHw : public NfcHw
+{
+    public:
+        NfcSimHw(NfcLog& log, NfcSimController& ctrl) : NfcHw(log), _ctrl(ctrl), writes(0) {bus.bit_rate = 0;}
+        void init(void) {hardReset();}
+        uint32_t write(uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t buf[], uint32_t len);
+        void wait(void);
+        bool ready(void) {return _ctrl.ready();}
+        void powerDown(void) {;}
+        void powerUp(void) {_ctrl.reset();}
+
+    private:
+        NfcSimController& _ctrl;
+
+    public:
+        uint32_t writes;                // packets written
+        tNFC_SIM_BUS bus;               // transfer timings
+};
+
+// I2C bus with the controller as slave, one transfer per
+// NfcHw_pn7120 access: address byte, data bytes, ACKs
+class NfcSimI2c : public NfcI2c, public HostPin
+{
+    public:
+        NfcSimI2c(NfcSimController& ctrl, uint8_t irq, uint32_t clock = NFC_I2C_CLOCK_FAST);
+        void begin(void) {;}
+        uint32_t write(uint8_t address, const uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t address, uint8_t buf[], uint32_t len);
+        bool probe(uint8_t address) {return true;}
+        int read(uint8_t pin);
+        void write(uint8_t pin, uint8_t val) {;}
+
+    private:
+        NfcSimController& _ctrl;
+        tNFC_SIM_BUS _bus;
+};
+
+// SPI bus with the controller as slave, PN7160 direction byte
+// framing, chip select and IRQ lines through host pins
+class NfcSimSpi : public SPIClass, public HostPin
+{
+    public:
+        NfcSimSpi(NfcSimController& ctrl, uint8_t cs, uint8_t irq, uint32_t clock);
+        uint8_t transfer(uint8_t val);
+        void transfer(void *buf, size_t len);
+        int read(uint8_t pin);
+        void write(uint8_t pin, uint8_t val);
+
+    private:
+        NfcSimController& _ctrl;
+        tNFC_SIM_BUS _bus;
+        uint8_t _cs, _irq;
+        bool _selected;
+        uint8_t _dir;                   // direction byte, 0 until received
+        uint32_t _len;                  // packet bytes written
+        uint8_t _buf[NCI_PACKET_SIZE];
+};
+
+// high speed UART to the controller, 8N1
+class NfcSimSerial : public HardwareSerial
+{
+    public:
+        NfcSimSerial(NfcSimController& ctrl);
+        void begin(unsigned long baud);
+        int available(void);
+        int read(void);
+        size_t write(const uint8_t *buf, size_t len);
+
+    private:
+        NfcSimController& _ctrl;
+        tNFC_SIM_BUS _bus;
+};
+
+// time of a bus transfer, us
+uint32_t nfcSimBusTime(const tNFC_SIM_BUS& bus, uint32_t len);
+
+#endif /* __NFC_SIM_H__ */
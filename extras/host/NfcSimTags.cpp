@@ -0,0 +1,708 @@
+/*
+ * NfcSimTags.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcSimTags.h"
+
+// RF_INTF_ACTIVATED_NTF header: discovery id | interface | protocol |
+// mode | max payload | credits, the controller sets the last two
+static uint32_t setNtfHeader(uint8_t ntf[], uint8_t intf, uint8_t protocol, uint8_t mode)
+{
+    ntf[0] = 1;
+    ntf[1] = intf;
+    ntf[2] = protocol;
+    ntf[3] = mode;
+    ntf[4] = 0xFF;
+    ntf[5] = 1;
+    return 6;
+}
+
+// poll A technology parameters: SENS_RES | NFCID1 | SEL_RES
+static uint32_t setPollA(uint8_t ntf[], uint8_t sens_res0, const uint8_t uid[], uint8_t uid_len, uint8_t sak)
+{
+    uint8_t *p = ntf;
+
+    *p++ = 2 + 1 + uid_len + 1 + 1;
+    *p++ = sens_res0;
+    *p++ = 0x00;
+    *p++ = uid_len;
+    memcpy(p, uid, uid_len);
+    p += uid_len;
+    *p++ = 1;
+    *p++ = sak;
+    return p - ntf;
+}
+
+uint8_t nfcSimPattern(uint32_t offset)
+{
+    return (uint8_t)(offset * 7 + 1);
+}
+
+NfcSimType1::NfcSimType1(uint8_t hr0, uint32_t blocks, bool formatted) : hr0(hr0)
+{
+    static const uint8_t id[] = {0xA1, 0xB2, 0xC3, 0xD4};
+    uint32_t i;
+
+    rid = rall = rseg = read8 = read = 0;
+    memcpy(uid, id, sizeof(uid));
+    size = blocks * 8 > sizeof(mem) ? sizeof(mem) : blocks * 8;
+    for (i = 0; i < size; i++) {
+        mem[i] = nfcSimPattern(i);
+    }
+    memcpy(mem, uid, sizeof(uid));
+    if (formatted) {
+        // CC: magic | version | size in 8 bytes blocks | access
+        mem[8] = 0xE1;
+        mem[9] = 0x10;
+        mem[10] = blocks - 1;
+        mem[11] = 0x00;
+    }
+}
+
+uint32_t NfcSimType1::activate(uint8_t ntf[])
+{
+    uint8_t *p = ntf;
+
+    // Topaz: SENS_RES 0x0C00, UID0-3, no SEL_RES
+    p += setNtfHeader(p, NCI_INTERFACE_FRAME, NCI_PROTOCOL_T1T, NCI_DISCOVERY_TYPE_POLL_A);
+    *p++ = 2 + 1 + sizeof(uid) + 1;
+    *p++ = 0x0C;
+    *p++ = 0x00;
+    *p++ = sizeof(uid);
+    memcpy(p, uid, sizeof(uid));
+    p += sizeof(uid);
+    *p++ = 0;
+    *p++ = NCI_DISCOVERY_TYPE_POLL_A;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    return p - ntf;
+}
+
+uint32_t NfcSimType1::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    uint32_t addr, num;
+
+    // RID: HR0 | HR1 | UID0-3
+    if (cmd[0] == 0x78 && len == 7) {
+        rid++;
+        rsp[0] = hr0;
+        rsp[1] = 0x00;
+        memcpy(&rsp[2], uid, sizeof(uid));
+        num = 6;
+    }
+    // RALL: HR0 | HR1 | 120 bytes, static memory only
+    else if (cmd[0] == 0x00 && len == 7 && hr0 == 0x11 && !memcmp(&cmd[3], uid, sizeof(uid))) {
+        rall++;
+        rsp[0] = hr0;
+        rsp[1] = 0x00;
+        memcpy(&rsp[2], mem, 120);
+        num = 2 + 120;
+    }
+    // RSEG: segment address | 128 bytes
+    else if (cmd[0] == 0x10 && len == 14 && hr0 != 0x11 && !memcmp(&cmd[10], uid, sizeof(uid))) {
+        rseg++;
+        addr = (cmd[1] >> 4) * 128;
+        if (addr + 128 > size) {
+            goto nack;
+        }
+        rsp[0] = cmd[1];
+        memcpy(&rsp[1], &mem[addr], 128);
+        num = 1 + 128;
+    }
+    // READ8: block address | 8 bytes
+    else if (cmd[0] == 0x02 && len == 14 && hr0 != 0x11 && !memcmp(&cmd[10], uid, sizeof(uid))) {
+        read8++;
+        addr = cmd[1] * 8;
+        if (addr + 8 > size) {
+            goto nack;
+        }
+        rsp[0] = cmd[1];
+        memcpy(&rsp[1], &mem[addr], 8);
+        num = 1 + 8;
+    }
+    // READ: byte address | byte, first 128 bytes
+    else if (cmd[0] == 0x01 && len == 7 && !memcmp(&cmd[3], uid, sizeof(uid))) {
+        read++;
+        addr = cmd[1];
+        if (addr >= size) {
+            goto nack;
+        }
+        rsp[0] = cmd[1];
+        rsp[1] = mem[addr];
+        num = 1 + 1;
+    }
+    else {
+        goto nack;
+    }
+
+    rsp[num++] = NCI_STATUS_OK;
+    return num;
+
+nack:
+    rsp[0] = NCI_STATUS_RF_PROTOCOL_ERR;
+    return 1;
+}
+
+NfcSimType2::NfcSimType2(uint32_t pages) : nack_page(0), version(true), halted(false)
+{
+    static const uint8_t id[] = {0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66};
+    uint32_t i;
+
+    reads = writes = versions = activations = 0;
+    memcpy(uid, id, sizeof(uid));
+    size = pages * 4 > sizeof(mem) ? sizeof(mem) : pages * 4;
+    memset(mem, 0, size);
+
+    // UID0-2 | BCC0 | UID3-6 | BCC1, then CC with the data area size
+    for (i = 0; i < sizeof(uid); i++) {
+        mem[i < 3 ? i : i + 1] = uid[i];
+    }
+    mem[12] = 0xE1;
+    mem[13] = 0x10;
+    mem[14] = (size - 36) / 8;
+    mem[15] = 0x00;
+
+    // NTAG21x storage size reported by GET_VERSION
+    storage = (pages >= 231) ? 0x13 : (pages >= 135) ? 0x11 : 0x0F;
+}
+
+uint32_t NfcSimType2::activate(uint8_t ntf[])
+{
+    uint8_t *p = ntf;
+
+    // a halted tag answers the next selection
+    halted = false;
+    activations++;
+    p += setNtfHeader(p, NCI_INTERFACE_FRAME, NCI_PROTOCOL_T2T, NCI_DISCOVERY_TYPE_POLL_A);
+    p += setPollA(p, 0x44, uid, sizeof(uid), 0x00);
+    *p++ = NCI_DISCOVERY_TYPE_POLL_A;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    return p - ntf;
+}
+
+uint32_t NfcSimType2::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    uint32_t i;
+
+    if (halted) {
+        return NFC_SIM_NO_RESPONSE;
+    }
+
+    switch (cmd[0]) {
+        // READ: 4 pages, rolling over
+        case 0x30:
+            reads++;
+            for (i = 0; i < 16; i++) {
+                rsp[i] = mem[(cmd[1] * 4 + i) % size];
+            }
+            rsp[16] = NCI_STATUS_OK;
+            return 17;
+        // WRITE: ACK, or NACK on the page asked for
+        case 0xA2:
+            if (cmd[1] == nack_page || (uint32_t)cmd[1] * 4 + 4 > size) {
+                rsp[0] = 0x00;
+                rsp[1] = NCI_STATUS_OK;
+                return 2;
+            }
+            if (writes < sizeof(pages)) {
+                pages[writes] = cmd[1];
+            }
+            writes++;
+            memcpy(&mem[cmd[1] * 4], &cmd[2], 4);
+            rsp[0] = 0x0A;
+            rsp[1] = NCI_STATUS_OK;
+            return 2;
+        // GET_VERSION: NTAG21x, or NACK and halt as Ultralight does
+        case 0x60:
+        {
+            static const uint8_t ntag[] = {0x00, 0x04, 0x04, 0x02, 0x01, 0x00, 0x0F, 0x03};
+            versions++;
+            if (!version) {
+                halted = true;
+                rsp[0] = 0x00;
+                rsp[1] = NCI_STATUS_OK;
+                return 2;
+            }
+            memcpy(rsp, ntag, sizeof(ntag));
+            rsp[6] = storage;
+            rsp[sizeof(ntag)] = NCI_STATUS_OK;
+            return sizeof(ntag) + 1;
+        }
+        default:
+            rsp[0] = 0x00;
+            rsp[1] = NCI_STATUS_OK;
+            return 2;
+    }
+}
+
+NfcSimMifare::NfcSimMifare(void)
+{
+    auths = auth_fails = reads = mute = 0;
+    halted = false;
+}
+
+uint32_t NfcSimMifare::activate(uint8_t ntf[])
+{
+    static const uint8_t uid[] = {0xDE, 0xAD, 0xBE, 0xEF};
+    uint8_t *p = ntf;
+
+    // a halted card answers the next selection
+    halted = false;
+    p += setNtfHeader(p, NCI_INTERFACE_MIFARE, NCI_PROTOCOL_MIFARE, NCI_DISCOVERY_TYPE_POLL_A);
+    p += setPollA(p, 0x04, uid, sizeof(uid), 0x08);
+    *p++ = NCI_DISCOVERY_TYPE_POLL_A;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    return p - ntf;
+}
+
+uint32_t NfcSimMifare::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    uint32_t i;
+    uint8_t key;
+
+    if (halted) {
+        mute++;
+        return NFC_SIM_NO_RESPONSE;
+    }
+
+    // AUTHENTICATE: block | key selector | key
+    if (cmd[0] == 0x40) {
+        auths++;
+        key = (cmd[1] / 4 == 1) ? 0xA0 : 0xFF;
+        rsp[0] = 0x40;
+        rsp[1] = (cmd[3] == key) ? 0x00 : 0x03;
+        if (rsp[1] != 0x00) {
+            auth_fails++;
+            halted = true;
+        }
+        return 2;
+    }
+
+    // XCHG_DATA READ: block filled with its number
+    if (cmd[0] == 0x10 && cmd[1] == 0x30) {
+        reads++;
+        rsp[0] = 0x10;
+        for (i = 0; i < 16; i++) {
+            rsp[1 + i] = cmd[2];
+        }
+        rsp[17] = NCI_STATUS_OK;
+        return 18;
+    }
+
+    rsp[0] = 0x10;
+    rsp[1] = 0x00;
+    rsp[2] = NCI_STATUS_OK;
+    return 3;
+}
+
+NfcSimType3::NfcSimType3(uint8_t nbr, uint8_t nbw, uint16_t nmaxb) : nbr(nbr), nbw(nbw)
+{
+    static const uint8_t id[] = {0x01, 0x2E, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+    uint32_t i, sum;
+
+    checks = updates = max_blocks = 0;
+    memcpy(idm, id, sizeof(idm));
+    size = (1 + nmaxb) * 16U > sizeof(mem) ? sizeof(mem) : (1 + nmaxb) * 16U;
+    for (i = 16; i < size; i++) {
+        mem[i] = nfcSimPattern(i - 16);
+    }
+
+    // attribute information block: version | Nbr | Nbw | Nmaxb |
+    // RFU | WriteF | RWFlag | Ln | checksum
+    memset(mem, 0, 16);
+    mem[0] = 0x10;
+    mem[1] = nbr;
+    mem[2] = nbw;
+    mem[3] = nmaxb >> 8;
+    mem[4] = nmaxb;
+    mem[10] = 0x01;
+    for (i = 0, sum = 0; i < 14; i++) {
+        sum += mem[i];
+    }
+    mem[14] = sum >> 8;
+    mem[15] = sum;
+}
+
+uint32_t NfcSimType3::activate(uint8_t ntf[])
+{
+    uint8_t *p = ntf;
+    uint32_t i;
+
+    // poll F: bit rate | SENSF_RES without its response code
+    p += setNtfHeader(p, NCI_INTERFACE_FRAME, NCI_PROTOCOL_T3T, NCI_DISCOVERY_TYPE_POLL_F);
+    *p++ = 2 + 18;
+    *p++ = 1;
+    *p++ = 18;
+    memcpy(p, idm, sizeof(idm));
+    p += sizeof(idm);
+    for (i = 0; i < 10; i++) {
+        *p++ = 0xA0 + i;
+    }
+    *p++ = NCI_DISCOVERY_TYPE_POLL_F;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    return p - ntf;
+}
+
+uint32_t NfcSimType3::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    uint16_t blocks[16];
+    uint32_t i, n, off, num;
+    bool bad;
+
+    // LEN | code | IDm | ...
+    if (len < 14 || cmd[0] != len || memcmp(&cmd[2], idm, sizeof(idm))) {
+        rsp[0] = NCI_STATUS_RF_PROTOCOL_ERR;
+        return 1;
+    }
+    num = 0;
+    rsp[num++] = 0;
+    rsp[num++] = cmd[1] + 1;
+    memcpy(&rsp[num], idm, sizeof(idm));
+    num += sizeof(idm);
+
+    // services | blocks | block list elements, 2 or 3 bytes each
+    n = cmd[13];
+    n = n > 16 ? 16 : n;
+    if (n > max_blocks) {
+        max_blocks = n;
+    }
+    off = 14;
+    bad = false;
+    for (i = 0; i < n; i++) {
+        if (cmd[off] & 0x80) {
+            blocks[i] = cmd[off + 1];
+            off += 2;
+        }
+        else {
+            blocks[i] = cmd[off + 1] | (cmd[off + 2] << 8);
+            off += 3;
+        }
+        bad |= (blocks[i] + 1) * 16U > size;
+    }
+
+    // CHECK: status flags | blocks | data
+    if (cmd[1] == 0x06) {
+        checks++;
+        if (n > nbr || bad) {
+            rsp[num++] = 0x01;
+            rsp[num++] = 0xA2;
+        }
+        else {
+            rsp[num++] = 0x00;
+            rsp[num++] = 0x00;
+            rsp[num++] = n;
+            for (i = 0; i < n; i++) {
+                memcpy(&rsp[num], &mem[blocks[i] * 16], 16);
+                num += 16;
+            }
+        }
+    }
+    // UPDATE: status flags
+    else if (cmd[1] == 0x08) {
+        updates++;
+        if (n > nbw || bad) {
+            rsp[num++] = 0x01;
+            rsp[num++] = 0xA2;
+        }
+        else {
+            for (i = 0; i < n; i++, off += 16) {
+                memcpy(&mem[blocks[i] * 16], &cmd[off], 16);
+            }
+            rsp[num++] = 0x00;
+            rsp[num++] = 0x00;
+        }
+    }
+    // POLLING and others: IDm only
+    else {
+        rsp[num++] = 0x00;
+        rsp[num++] = 0x00;
+    }
+
+    rsp[0] = num;
+    rsp[num++] = NCI_STATUS_OK;
+    return num;
+}
+
+NfcSimType4::NfcSimType4(uint16_t mle, uint16_t nlen, uint8_t mode) : mode(mode), file(0)
+{
+    static const uint8_t cc_file[] = {
+        0x00, 0x0F, 0x20, 0x00, 0x00, 0x00, 0xFF,
+        0x04, 0x06, 0xE1, 0x04, 0x10, 0x00, 0x00, 0xFF
+    };
+    // FSCI 8, FWI 7, SFGI 0, one historical byte
+    static const uint8_t ats_res[] = {5, 0x78, 0x80, 0x70, 0x02, 0x80};
+    // PUPI, application data, 106 kbps, FSCI 8 and ISO 14443-4,
+    // FWI 7 and NAD/CID support
+    static const uint8_t sensb_res[] = {
+        11, 0x0B, 0x01, 0x02, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x71
+    };
+    // MBLI 0, CID 0, no higher layer response
+    static const uint8_t attrib_res[] = {1, 0x00};
+    uint32_t i;
+
+    reads = updates = max_read = 0;
+
+    memcpy(ats, ats_res, sizeof(ats_res));
+    ats_len = sizeof(ats_res);
+    memcpy(sensb, sensb_res, sizeof(sensb_res));
+    sensb_len = sizeof(sensb_res);
+    memcpy(attrib, attrib_res, sizeof(attrib_res));
+    attrib_len = sizeof(attrib_res);
+
+    // CC: length | version | MLe | MLc | NDEF file control TLV
+    memcpy(cc, cc_file, sizeof(cc));
+    cc[3] = mle >> 8;
+    cc[4] = mle;
+    ndef_size = sizeof(ndef);
+    cc[11] = ndef_size >> 8;
+    cc[12] = ndef_size;
+
+    // NLEN | NDEF message
+    nlen = nlen > sizeof(ndef) - 2 ? sizeof(ndef) - 2 : nlen;
+    ndef[0] = nlen >> 8;
+    ndef[1] = nlen;
+    for (i = 0; i < nlen; i++) {
+        ndef[2 + i] = nfcSimPattern(i);
+    }
+}
+
+uint32_t NfcSimType4::activate(uint8_t ntf[])
+{
+    static const uint8_t uid[] = {0x04, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06};
+    uint8_t *p = ntf;
+
+    file = 0;
+    p += setNtfHeader(p, NCI_INTERFACE_ISO_DEP, NCI_PROTOCOL_ISO_DEP, mode);
+    if (mode == NCI_DISCOVERY_TYPE_POLL_B) {
+        *p++ = sensb_len;
+        memcpy(p, sensb, sensb_len);
+        p += sensb_len;
+    }
+    else {
+        p += setPollA(p, 0x44, uid, sizeof(uid), 0x20);
+    }
+    *p++ = mode;
+    *p++ = 0;
+    *p++ = 0;
+    if (mode == NCI_DISCOVERY_TYPE_POLL_B) {
+        *p++ = attrib_len;
+        memcpy(p, attrib, attrib_len);
+        p += attrib_len;
+    }
+    else {
+        *p++ = ats_len;
+        memcpy(p, ats, ats_len);
+        p += ats_len;
+    }
+    return p - ntf;
+}
+
+uint32_t NfcSimType4::status(uint8_t rsp[], uint32_t len, uint16_t sw)
+{
+    rsp[len++] = sw >> 8;
+    rsp[len++] = sw;
+    return len;
+}
+
+uint32_t NfcSimType4::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    const uint8_t *data;
+    uint32_t off, le, lc, size, fid;
+
+    if (len < 4) {
+        return status(rsp, 0, 0x6700);
+    }
+
+    switch (cmd[1]) {
+        // SELECT by name (NDEF application) or by file id
+        case 0xA4:
+            if (cmd[2] == 0x04) {
+                file = 1;
+                return status(rsp, 0, 0x9000);
+            }
+            fid = len >= 7 ? (cmd[5] << 8) | cmd[6] : 0;
+            file = (fid == 0xE103) ? 2 : (fid == 0xE104) ? 3 : 0;
+            return status(rsp, 0, file != 0 ? 0x9000 : 0x6A82);
+        // READ BINARY, short or extended Le
+        case 0xB0:
+            if (file < 2 || len < 5) {
+                return status(rsp, 0, 0x6986);
+            }
+            reads++;
+            off = (cmd[2] << 8) | cmd[3];
+            if (len == 7 && cmd[4] == 0) {
+                le = (cmd[5] << 8) | cmd[6];
+                le = le != 0 ? le : 65536;
+            }
+            else {
+                le = cmd[4] != 0 ? cmd[4] : 256;
+            }
+            if (le > max_read) {
+                max_read = le;
+            }
+            data = (file == 2) ? cc : ndef;
+            size = (file == 2) ? sizeof(cc) : ndef_size;
+            if (off > size) {
+                return status(rsp, 0, 0x6B00);
+            }
+            le = (off + le > size) ? size - off : le;
+            le = le > NFC_SIM_DATA_SIZE - 2 ? NFC_SIM_DATA_SIZE - 2 : le;
+            memcpy(rsp, &data[off], le);
+            return status(rsp, le, 0x9000);
+        // UPDATE BINARY, NDEF file only
+        case 0xD6:
+            if (file != 3 || len < 5) {
+                return status(rsp, 0, 0x6986);
+            }
+            updates++;
+            off = (cmd[2] << 8) | cmd[3];
+            lc = cmd[4];
+            if (off + lc > ndef_size || 5 + lc > len) {
+                return status(rsp, 0, 0x6A84);
+            }
+            memcpy(&ndef[off], &cmd[5], lc);
+            return status(rsp, 0, 0x9000);
+        // echo: CLA | INS | P1 | P2 | 00 | Lc (2) | data | Le (2)
+        case 0xEE:
+            if (len < 9 || cmd[4] != 0) {
+                return status(rsp, 0, 0x6700);
+            }
+            lc = (cmd[5] << 8) | cmd[6];
+            if (7 + lc + 2 != len) {
+                return status(rsp, 0, 0x6700);
+            }
+            memcpy(rsp, &cmd[7], lc);
+            return status(rsp, lc, 0x9000);
+        default:
+            return status(rsp, 0, 0x6D00);
+    }
+}
+
+NfcSimType5::NfcSimType5(uint32_t blocks, uint8_t block_size, uint8_t rmb, bool gsi) :
+    block_size(block_size), rmb(rmb), gsi(gsi)
+{
+    static const uint8_t id[] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x04, 0xE0};
+    uint32_t i;
+
+    cmds = max_blocks = 0;
+    memcpy(uid, id, sizeof(uid));
+    size = blocks * block_size > sizeof(mem) ? sizeof(mem) : blocks * block_size;
+    for (i = 0; i < size; i++) {
+        mem[i] = nfcSimPattern(i);
+    }
+}
+
+uint32_t NfcSimType5::activate(uint8_t ntf[])
+{
+    uint8_t *p = ntf;
+
+    // poll V: response flags | DSFID | UID
+    p += setNtfHeader(p, NCI_INTERFACE_FRAME, NCI_PROTOCOL_T5T, NCI_DISCOVERY_TYPE_POLL_ISO15693);
+    *p++ = 2 + sizeof(uid);
+    *p++ = 0x00;
+    *p++ = 0x00;
+    memcpy(p, uid, sizeof(uid));
+    p += sizeof(uid);
+    *p++ = NCI_DISCOVERY_TYPE_POLL_ISO15693;
+    *p++ = 0;
+    *p++ = 0;
+    *p++ = 0;
+    return p - ntf;
+}
+
+uint32_t NfcSimType5::exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[])
+{
+    uint32_t num, block, n;
+
+    cmds++;
+
+    // addressed commands only: flags | command | UID | parameters
+    if (len < 10 || cmd[0] != 0x22 || memcmp(&cmd[2], uid, sizeof(uid))) {
+        goto error;
+    }
+
+    num = 0;
+    rsp[num++] = 0x00;
+    switch (cmd[1]) {
+        // GET SYSTEM INFO: info flags | UID | DSFID | AFI | blocks | block size | IC
+        case 0x2B:
+            if (!gsi) {
+                rsp[1] = 0x01;
+                goto fail;
+            }
+            rsp[num++] = 0x0F;
+            memcpy(&rsp[num], uid, sizeof(uid));
+            num += sizeof(uid);
+            rsp[num++] = 0x00;
+            rsp[num++] = 0x00;
+            rsp[num++] = size / block_size - 1;
+            rsp[num++] = block_size - 1;
+            rsp[num++] = 0x01;
+            break;
+        // READ SINGLE BLOCK
+        case 0x20:
+            block = cmd[10];
+            if ((block + 1) * block_size > size) {
+                rsp[1] = 0x10;
+                goto fail;
+            }
+            memcpy(&rsp[num], &mem[block * block_size], block_size);
+            num += block_size;
+            break;
+        // READ MULTIPLE BLOCKS: first block | blocks - 1
+        case 0x23:
+            block = cmd[10];
+            n = cmd[11] + 1;
+            if (n > max_blocks) {
+                max_blocks = n;
+            }
+            if (n > rmb) {
+                rsp[1] = 0x0F;
+                goto fail;
+            }
+            if ((block + n) * block_size > size) {
+                rsp[1] = 0x10;
+                goto fail;
+            }
+            memcpy(&rsp[num], &mem[block * block_size], n * block_size);
+            num += n * block_size;
+            break;
+        default:
+            rsp[1] = 0x01;
+            goto fail;
+    }
+
+    rsp[num++] = NCI_STATUS_OK;
+    return num;
+
+error:
+    rsp[1] = 0x0F;
+fail:
+    // error flag | error code
+    rsp[0] = 0x01;
+    rsp[2] = NCI_STATUS_OK;
+    return 3;
+}
@@ -0,0 +1,155 @@
+/*
+ * NfcSimTags.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_SIM_TAGS_H__
+#define __NFC_SIM_TAGS_H__
+
+#include "NfcSim.h"
+
+// Simulated tags of each type handled by the library, with the
+// commands its tag interfaces send. Memories are filled with a known
+// pattern, see nfcSimPattern(), and the commands counted so that
+// tests and benchmarks can check what went over the air.
+// Frame RF interface responses end with the controller status byte.
+
+// memory pattern of the simulated tags
+uint8_t nfcSimPattern(uint32_t offset);
+
+// Topaz type 1 tag, header ROM 0x11 for the 120 bytes static memory
+// read with RALL, any other for the dynamic memory read with RSEG
+class NfcSimType1 : public NfcSimTag
+{
+    public:
+        NfcSimType1(uint8_t hr0, uint32_t blocks, bool formatted = true);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint8_t mem[1024];
+        uint32_t size;
+        uint32_t rid, rall, rseg, read8, read;
+        uint8_t hr0;
+        uint8_t uid[4];
+};
+
+// NTAG21x like type 2 tag: 45 pages NTAG213, 135 NTAG215, 231 NTAG216
+class NfcSimType2 : public NfcSimTag
+{
+    public:
+        NfcSimType2(uint32_t pages = 45);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint8_t mem[1024];
+        uint32_t size;
+        uint32_t reads, writes;
+        uint8_t pages[256];         // pages written, in order, the first 256
+        uint8_t nack_page;          // WRITE NACKed on this page, 0 for none
+        uint8_t storage;            // GET_VERSION storage size
+        bool version;               // GET_VERSION answered, else NACKed and halted
+        bool halted;                // mute until activated again
+        uint32_t versions;          // GET_VERSION received
+        uint32_t activations;
+        uint8_t uid[7];
+};
+
+// Mifare Classic 1K over the NXP Mifare RF interface, sector 1 only
+// opens with key A0A1A2A3A4A5, the others with FFFFFFFFFFFF. The card
+// halts on a failed authentication and stays mute until activated
+// again, as a real card does.
+class NfcSimMifare : public NfcSimTag
+{
+    public:
+        NfcSimMifare(void);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint32_t auths, auth_fails, reads, mute;
+        bool halted;
+};
+
+// FeliCa Lite like type 3 tag, nbr/nbw blocks per CHECK/UPDATE
+class NfcSimType3 : public NfcSimTag
+{
+    public:
+        NfcSimType3(uint8_t nbr, uint8_t nbw, uint16_t nmaxb);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint8_t mem[1040];
+        uint32_t size;
+        uint32_t checks, updates, max_blocks;
+        uint8_t nbr, nbw;
+        uint8_t idm[8];
+};
+
+// ISO-DEP type 4 tag with the NFC Forum NDEF application, mle is
+// the CC MLe and nlen the NDEF message length. A proprietary echo
+// APDU (INS 0xEE) returns its extended length command data.
+// Activated on NFC-A with its ATS, or on NFC-B with its SENSB_RES and
+// ATTRIB response. The parameters are notified as set, length bytes
+// included, so that tests can give other or truncated ones.
+class NfcSimType4 : public NfcSimTag
+{
+    public:
+        NfcSimType4(uint16_t mle, uint16_t nlen, uint8_t mode = NCI_DISCOVERY_TYPE_POLL_A);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint8_t mode;               // NCI_DISCOVERY_TYPE_POLL_A or _B
+        uint8_t sensb[16];          // length | PUPI | app data | protocol info
+        uint8_t sensb_len;
+        uint8_t ats[32];            // length | T0 | TA | TB | TC | historical bytes
+        uint8_t ats_len;
+        uint8_t attrib[16];         // length | MBLI, CID | higher layer response
+        uint8_t attrib_len;
+        uint8_t cc[15];
+        uint8_t ndef[4096];
+        uint32_t ndef_size;         // NDEF file size
+        uint32_t reads, updates, max_read;
+        uint8_t file;               // file selected
+
+    private:
+        uint32_t status(uint8_t rsp[], uint32_t len, uint16_t sw);
+};
+
+// ISO 15693 type 5 tag, rmb blocks at most per READ MULTIPLE
+// BLOCKS, 0 when not supported
+class NfcSimType5 : public NfcSimTag
+{
+    public:
+        NfcSimType5(uint32_t blocks, uint8_t block_size, uint8_t rmb, bool gsi = true);
+        uint32_t activate(uint8_t ntf[]);
+        uint32_t exchange(const uint8_t cmd[], uint32_t len, uint8_t rsp[]);
+
+    public:
+        uint8_t mem[2048];
+        uint32_t size;
+        uint32_t cmds, max_blocks;
+        uint8_t block_size, rmb;
+        bool gsi;
+        uint8_t uid[8];
+};
+
+#endif /* __NFC_SIM_TAGS_H__ */
@@ -0,0 +1,150 @@
+/*
+ * NfcTest.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcTest.h"
+
+uint32_t nfc_test_failures = 0;
+
+void NfcTestApp::cbDump(uint8_t s, uint16_t id, void *d)
+{
+    tTAGS_DUMP *p_dump = (tTAGS_DUMP *)d;
+
+    record(TAGS_EVT_DUMP, s, d);
+    if (s == TAGS_STATUS_OK && p_dump != NULL && dump_len + p_dump->len <= sizeof(dump)) {
+        memcpy(&dump[dump_len], p_dump->buf, p_dump->len);
+        dump_len += p_dump->len;
+    }
+    done = (s != TAGS_STATUS_OK || p_dump == NULL || !p_dump->more);
+}
+
+void NfcTestApp::cbNdef(uint8_t s, uint16_t id, void *d)
+{
+    record(TAGS_EVT_NDEF, s, d);
+    memset(&ndef, 0, sizeof(ndef));
+    if (d != NULL) {
+        ndef = *(tTAGS_NDEF *)d;
+    }
+}
+
+void NfcTestApp::cbApdu(uint8_t s, uint16_t id, void *d)
+{
+    record(TAGS_EVT_APDU, s, d);
+    memset(&apdu, 0, sizeof(apdu));
+    if (d != NULL) {
+        apdu = *(tTAGS_APDU *)d;
+    }
+}
+
+void NfcTestApp::cbRead(uint8_t s, uint16_t id, void *d)
+{
+    record(TAGS_EVT_READ, s, d);
+    memset(&read, 0, sizeof(read));
+    if (d != NULL) {
+        read = *(tTAGS_READ *)d;
+    }
+}
+
+NfcTest::NfcTest(uint8_t bus, uint8_t level) :
+    log(level), hw(log, ctrl),
+    i2c(ctrl, NFC_TEST_PIN_I2C_IRQ),
+    spi(ctrl, NFC_TEST_PIN_SPI_CS, NFC_TEST_PIN_SPI_IRQ, NFC_SPI_CLOCK),
+    serial(ctrl),
+    hw_i2c(log, i2c, NFC_TEST_PIN_I2C_IRQ, NFC_TEST_PIN_RESET, 0x28),
+    hw_spi(log, spi, NFC_TEST_PIN_SPI_CS, NFC_TEST_PIN_SPI_IRQ, NFC_TEST_PIN_RESET),
+    hw_uart(log, serial, NFC_TEST_PIN_RESET),
+    nci(log, getHw(bus)), tags(log, nci)
+{
+    Serial.setOutput(level != NFC_LOG_LEVEL_OFF);
+    getHw(bus).init();
+    nci.init(&tags);
+    tags.init(&app);
+}
+
+tNFC_HW& NfcTest::getHw(uint8_t bus)
+{
+#if defined(NFC_CONFIG_HW_PN7120)
+    return hw_i2c;
+#elif defined(NFC_CONFIG_HW_SPI)
+    return hw_spi;
+#elif defined(NFC_CONFIG_HW_UART)
+    return hw_uart;
+#else
+    switch (bus) {
+        case NFC_TEST_BUS_I2C:
+            return hw_i2c;
+        case NFC_TEST_BUS_SPI:
+            return hw_spi;
+        case NFC_TEST_BUS_UART:
+            return hw_uart;
+        default:
+            return hw;
+    }
+#endif
+}
+
+bool NfcTest::start(NfcSimTag *tag, uint8_t techs)
+{
+    ctrl.setTag(tag);
+    tags.setDiscoverTechs(techs);
+
+    if (tags.cmdReset() != TAGS_STATUS_OK || !run(TAGS_EVT_RESET, 1) ||
+        app.status[TAGS_EVT_RESET] != TAGS_STATUS_OK) {
+        return false;
+    }
+    if (tags.cmdDiscover() != TAGS_STATUS_OK || !run(TAGS_EVT_DISCOVER, 1)) {
+        return false;
+    }
+
+    return tag == NULL || run(TAGS_EVT_DISCOVER_NTF, 1);
+}
+
+void NfcTest::step(void)
+{
+    tags.handleEvent();
+    if (nci.isReady()) {
+        nci.handleEvent();
+    }
+    else {
+        yield();
+    }
+}
+
+bool NfcTest::run(uint8_t evt, uint32_t num, uint32_t ms)
+{
+    uint32_t start = millis();
+
+    while (app.count[evt] < num) {
+        if (millis() - start >= ms) {
+            return false;
+        }
+        step();
+    }
+
+    return true;
+}
+
+void NfcTest::idle(uint32_t ms)
+{
+    uint32_t start = millis();
+
+    while (millis() - start < ms) {
+        step();
+    }
+}
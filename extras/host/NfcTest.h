@@ -0,0 +1,140 @@
+/*
+ * NfcTest.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_TEST_H__
+#define __NFC_TEST_H__
+
+#include "NfcSimTags.h"
+
+// Library stack run against the simulated NFC controller, shared by
+// the host tests (extras/test, one program per file) and benchmarks
+// (extras/bench). A failed check prints its location, the test exit
+// status is the number of failures.
+
+extern uint32_t nfc_test_failures;
+
+#define TEST_CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            nfc_test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_EQ(a, b) \
+    do { \
+        long _a = (long)(a), _b = (long)(b); \
+        if (_a != _b) { \
+            printf("%s:%d: %s == %ld, expected %ld\n", __FILE__, __LINE__, #a, _a, _b); \
+            nfc_test_failures++; \
+        } \
+    } while (0)
+
+#define TEST_RESULT() \
+    (printf("%s: %s\n", __FILE__, nfc_test_failures == 0 ? "passed" : "FAILED"), (int)nfc_test_failures)
+
+// data packet payload of the connection: the one advertised by the
+// controller, 0 for 255, bounded by the NCI buffers of the build
+#define TEST_PAYLOAD(max) \
+    ((uint32_t)((max) == 0 || (max) > NCI_PAYLOAD_MAX ? NCI_PAYLOAD_MAX : (max)))
+
+// application callbacks, counted and kept per TAGS_EVT_xxx event,
+// the dumped bytes are gathered in dump[]
+class NfcTestApp : public NfcTagsCb
+{
+    public:
+        NfcTestApp(void) {clear();}
+        void clear(void) {memset(count, 0, sizeof(count)); memset(status, 0xFF, sizeof(status)); dump_len = 0; done = false;}
+        void cbReset(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_RESET, s, d);}
+        void cbDiscover(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_DISCOVER, s, d);}
+        void cbDiscoverNtf(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_DISCOVER_NTF, s, d);}
+        void cbDeactivate(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_DEACTIVATE, s, d);}
+        void cbRemoved(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_REMOVED, s, d);}
+        void cbDump(uint8_t s, uint16_t id, void *d);
+        void cbWrite(uint8_t s, uint16_t id, void *d) {record(TAGS_EVT_WRITE, s, d);}
+        void cbNdef(uint8_t s, uint16_t id, void *d);
+        void cbApdu(uint8_t s, uint16_t id, void *d);
+        void cbRead(uint8_t s, uint16_t id, void *d);
+
+    public:
+        uint32_t count[TAGS_EVT_NUM];   // callbacks called
+        uint8_t status[TAGS_EVT_NUM];   // last status
+        bool done;                      // dump completed
+        tTAGS_NDEF ndef;
+        tTAGS_APDU apdu;
+        tTAGS_READ read;
+        uint8_t dump[4096];
+        uint32_t dump_len;
+
+    private:
+        void record(uint8_t evt, uint8_t s, void *d) {count[evt]++; status[evt] = s;}
+};
+
+// transports between the library and the simulated controller
+enum {
+    NFC_TEST_BUS_NONE = 0,      // NfcSimHw, packets straight to the controller
+    NFC_TEST_BUS_I2C,           // NfcHw_pn7120 over NfcSimI2c, Fast-mode
+    NFC_TEST_BUS_SPI,           // NfcHw_spi over NfcSimSpi, 7 MHz
+    NFC_TEST_BUS_UART           // NfcHw_uart over NfcSimSerial, 921600 bauds
+};
+
+// host pins of the simulated controller lines
+#define NFC_TEST_PIN_I2C_IRQ    2
+#define NFC_TEST_PIN_SPI_IRQ    3
+#define NFC_TEST_PIN_SPI_CS     10
+#define NFC_TEST_PIN_RESET      4
+
+// library stack over the simulated controller, the application
+// loop is run in simulated time by run() and idle(); builds with
+// NFC_CONFIG_HW_xxx use that controller whatever the bus
+class NfcTest
+{
+    public:
+        NfcTest(uint8_t bus = NFC_TEST_BUS_NONE, uint8_t level = NFC_LOG_LEVEL_OFF);
+        // reset and discover, true once the tag put in the field,
+        // if any, is activated
+        bool start(NfcSimTag *tag, uint8_t techs = TAGS_TECH_DEFAULT);
+        // run the stack until the event count reaches num or
+        // ms of simulated time elapse, true if it did
+        bool run(uint8_t evt, uint32_t num, uint32_t ms = 1000);
+        // run the stack for ms of simulated time
+        void idle(uint32_t ms);
+        // one pass of the application loop
+        void step(void);
+
+    private:
+        tNFC_HW& getHw(uint8_t bus);
+
+    public:
+        NfcLog log;
+        NfcSimController ctrl;
+        NfcSimHw hw;
+        NfcSimI2c i2c;
+        NfcSimSpi spi;
+        NfcSimSerial serial;
+        NfcHw_pn7120 hw_i2c;
+        NfcHw_spi hw_spi;
+        NfcHw_uart hw_uart;
+        NfcNci nci;
+        NfcTags tags;
+        NfcTestApp app;
+};
+
+#endif /* __NFC_TEST_H__ */
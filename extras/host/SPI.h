@@ -0,0 +1,53 @@
+/*
+ * SPI.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HOST_SPI_H__
+#define __NFC_HOST_SPI_H__
+
+#include <Arduino.h>
+
+#define MSBFIRST    1
+#define LSBFIRST    0
+#define SPI_MODE0   0x00
+
+class SPISettings
+{
+    public:
+        SPISettings() : clock(4000000) {;}
+        SPISettings(uint32_t clock, uint8_t order, uint8_t mode) : clock(clock) {;}
+        uint32_t clock;
+};
+
+// host stand-in for the Arduino SPI library, transfers are
+// overridden by the simulated devices
+class SPIClass
+{
+    public:
+        SPIClass() {;}
+        virtual void begin(void) {;}
+        virtual void beginTransaction(SPISettings settings) {;}
+        virtual void endTransaction(void) {;}
+        virtual uint8_t transfer(uint8_t val) {return 0;}
+        virtual void transfer(void *buf, size_t len);
+};
+
+extern SPIClass SPI;
+
+#endif /* __NFC_HOST_SPI_H__ */
@@ -0,0 +1,48 @@
+/*
+ * Wire.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HOST_WIRE_H__
+#define __NFC_HOST_WIRE_H__
+
+#include <Arduino.h>
+
+// host stand-in for the Arduino I2C library, no slave answers:
+// the host tests attach their bus through NfcI2c instead, read
+// requests are counted
+class TwoWire : public Stream
+{
+    public:
+        TwoWire() : requests(0), requested(0) {;}
+        void begin(void) {;}
+        void setClock(uint32_t clock) {;}
+        void beginTransmission(uint8_t address) {;}
+        uint8_t endTransmission(bool stop = true) {return 2;}
+        uint8_t requestFrom(uint8_t address, uint8_t len) {requests++; requested = len; return 0;}
+        size_t write(uint8_t val) {return 1;}
+        size_t write(const uint8_t *buf, size_t len) {return len;}
+
+    public:
+        uint32_t requests;      // requestFrom() calls
+        uint8_t requested;      // last length requested
+};
+
+extern TwoWire Wire;
+
+#endif /* __NFC_HOST_WIRE_H__ */
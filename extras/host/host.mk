@@ -0,0 +1,48 @@
+# Host build of the library with the simulated Arduino core and NFC
+# controller of extras/host, included by the extras/test and
+# extras/bench makefiles. Objects go to $(BUILD), per configuration:
+# targets built with other NFC_CONFIG_* flags compile the library
+# sources themselves, see nfc_link below.
+
+NFC_ROOT := $(abspath $(dir $(lastword $(MAKEFILE_LIST)))/../..)
+NFC_HOST := $(NFC_ROOT)/extras/host
+
+CXX ?= g++
+BUILD ?= build
+
+NFC_CXXFLAGS := -std=gnu++11 -O2 -g -Wall -Wno-unused-variable -Wno-unused-but-set-variable \
+                -I$(NFC_HOST) -I$(NFC_ROOT)/src
+NFC_SRCS := $(wildcard $(NFC_ROOT)/src/*/*.cpp) \
+            $(NFC_HOST)/Arduino.cpp $(NFC_HOST)/NfcSim.cpp $(NFC_HOST)/NfcSimTags.cpp \
+            $(NFC_HOST)/NfcTest.cpp
+NFC_OBJS := $(patsubst $(NFC_ROOT)/%.cpp,$(BUILD)/nfc/%.o,$(NFC_SRCS))
+
+.SECONDARY:
+
+# NfcLog.cpp relies on AVR register variables and pointer casts
+NFC_PERMISSIVE := -fpermissive -Wno-register -w
+
+$(BUILD)/nfc/%.o: $(NFC_ROOT)/%.cpp
+	@mkdir -p $(dir $@)
+	$(CXX) $(NFC_CXXFLAGS) $(CXXFLAGS) $(if $(findstring NfcLog,$<),$(NFC_PERMISSIVE)) -MMD -MP -c $< -o $@
+
+-include $(NFC_OBJS:.o=.d)
+
+# $(call nfc_link,output,sources,flags): program built with its own
+# library configuration, e.g. -DNFC_CONFIG_SHARED_INTF=1
+define nfc_link
+	@mkdir -p $(dir $(1))
+	$(CXX) $(NFC_CXXFLAGS) $(CXXFLAGS) $(3) -c $(NFC_ROOT)/src/log/NfcLog.cpp $(NFC_PERMISSIVE) -o $(1).log.o
+	$(CXX) $(NFC_CXXFLAGS) $(CXXFLAGS) $(3) $(2) $(filter-out %/NfcLog.cpp,$(NFC_SRCS)) $(1).log.o -o $(1)
+endef
+
+# library configurations built by the extras/bench hw and ram targets
+# and the extras/test test-configs one: NFC_FLAGS_<name>
+NFC_FLAGS_shared_buffer := -DNFC_CONFIG_NCI_SHARED_BUFFER=1
+NFC_FLAGS_shared_buffer_64 := $(NFC_FLAGS_shared_buffer) -DNFC_CONFIG_NCI_RX_SIZE=64 -DNFC_CONFIG_NCI_TX_SIZE=64
+NFC_FLAGS_shared_intf := -DNFC_CONFIG_SHARED_INTF=1
+NFC_FLAGS_type2 := -DNFC_CONFIG_TAG_TYPE1=0 -DNFC_CONFIG_TAG_TYPE3=0 -DNFC_CONFIG_TAG_TYPE4=0 \
+                   -DNFC_CONFIG_TAG_TYPE5=0 -DNFC_CONFIG_TAG_MIFARE=0
+NFC_FLAGS_no_state_names := -DNFC_CONFIG_STATE_NAMES=0
+NFC_FLAGS_type2_no_state_names := $(NFC_FLAGS_type2) $(NFC_FLAGS_no_state_names)
+NFC_FLAGS_ntag_shared := $(NFC_FLAGS_shared_buffer) $(NFC_FLAGS_shared_intf) $(NFC_FLAGS_type2)
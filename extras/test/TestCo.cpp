@@ -0,0 +1,140 @@
+/*
+ * TestCo.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Coroutine front-end, built with -std=gnu++20: a session awaiting
+// reset, discovery, activation, a read and the removal of the tag,
+// and the coroutine frames taken from the static pool.
+
+#include "NfcTest.h"
+#include "tags/NfcTagsCo.h"
+
+#ifndef NFC_TAGS_CO
+#error "NfcTagsCo needs a compiler with coroutine support"
+#endif
+
+// session steps, kept out of the coroutine frame
+static struct {
+    uint8_t reset, discover, read;
+    uint32_t activated, removed;
+    uint8_t buf[16];
+} s;
+
+static NfcTagsTask session(NfcTagsCo& co)
+{
+    s.reset = co_await co.reset();
+    s.discover = co_await co.discover();
+    co_await co.activated();
+    s.activated++;
+    s.read = co_await co.read(4, s.buf, sizeof(s.buf));
+    co_await co.removed();
+    s.removed++;
+}
+
+// nothing awaited, the frame is kept until the task is destroyed
+static NfcTagsTask empty(void)
+{
+    co_return;
+}
+
+// larger than a frame of the pool
+static NfcTagsTask large(NfcTagsCo& co)
+{
+    uint8_t buf[TAGS_CO_FRAME_SIZE];
+
+    co_await co.read(0, buf, sizeof(buf));
+}
+
+// commands sent from the task as the callbacks resume it
+static void testSession(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(45);
+    NfcTagsCo co(t.log, t.tags);
+    NfcTagsTask task;
+    uint32_t i;
+
+    memset(&s, 0, sizeof(s));
+    co.init();
+    t.tags.setPresenceCheck(10);
+    t.ctrl.setTag(&tag);
+
+    task = session(co);
+    TEST_CHECK(task.valid());
+    for (i = 0; i < 1000 && s.activated == 0; i++) {
+        t.step();
+    }
+    TEST_EQ(s.reset, TAGS_STATUS_OK);
+    TEST_EQ(s.discover, TAGS_STATUS_OK);
+    TEST_EQ(s.activated, 1);
+
+    // read completed, the task waits for the removal
+    for (i = 0; i < 1000 && s.read != TAGS_STATUS_OK; i++) {
+        t.step();
+    }
+    TEST_EQ(s.read, TAGS_STATUS_OK);
+    TEST_CHECK(memcmp(s.buf, &tag.mem[16], sizeof(s.buf)) == 0);
+    t.idle(100);
+    TEST_EQ(s.removed, 0);
+    TEST_CHECK(!task.done());
+
+    t.ctrl.setTag(NULL);
+    for (i = 0; i < 1000 && s.removed == 0; i++) {
+        t.step();
+        hostAdvance(100);
+    }
+    TEST_EQ(s.removed, 1);
+    TEST_CHECK(task.done());
+}
+
+// pool exhausted: the task is not valid and did not start, frames
+// are given back as tasks are destroyed
+static void testPool(void)
+{
+    NfcTest t;
+    NfcTagsCo co(t.log, t.tags);
+    NfcTagsTask tasks[TAGS_CO_FRAMES], task;
+    uint8_t i;
+
+    for (i = 0; i < TAGS_CO_FRAMES; i++) {
+        tasks[i] = empty();
+        TEST_CHECK(tasks[i].valid());
+        TEST_CHECK(tasks[i].done());
+    }
+    task = empty();
+    TEST_CHECK(!task.valid());
+    TEST_CHECK(task.done());
+
+    tasks[0] = NfcTagsTask();
+    task = empty();
+    TEST_CHECK(task.valid());
+
+    // frame too large whatever the frames left
+    task = NfcTagsTask();
+    task = large(co);
+    TEST_CHECK(!task.valid());
+}
+
+int main(void)
+{
+    testSession();
+    testPool();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,97 @@
+/*
+ * TestI2c.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// I2C backends: NfcHw_pn7120 over NfcI2c_loopback, the packets written
+// kept and the fed ones read with the IRQ line raised meanwhile, and
+// NfcI2c_wire reads bounded by the 8 bits TwoWire::requestFrom().
+
+#include "NfcTest.h"
+#include "hw/NfcI2c_loopback.h"
+#include "hw/NfcI2c_wire.h"
+
+#define PIN_IRQ     5
+#define PIN_RESET   6
+
+// IRQ raised while fed bytes are left
+class TestIrq : public HostPin
+{
+    public:
+        TestIrq(NfcI2c_loopback& i2c) : _i2c(i2c) {;}
+        int read(uint8_t pin) {return _i2c.available() != 0;}
+        void write(uint8_t pin, uint8_t val) {;}
+
+    private:
+        NfcI2c_loopback& _i2c;
+};
+
+// CORE_RESET_CMD written, CORE_RESET_RSP read as header then payload
+static void testLoopback(void)
+{
+    static uint8_t cmd[] = {0x20, 0x00, 0x01, 0x01};
+    static const uint8_t rsp[] = {0x40, 0x00, 0x03, 0x00, 0x11, 0x01};
+    NfcLog log(NFC_LOG_LEVEL_OFF);
+    NfcI2c_loopback i2c;
+    TestIrq irq(i2c);
+    NfcHw_pn7120 hw(log, i2c, PIN_IRQ, PIN_RESET, 0x28);
+    uint8_t buf[8];
+
+    hostAttachPin(PIN_IRQ, &irq);
+    hw.init();
+    TEST_CHECK(!hw.ready());
+
+    TEST_EQ(hw.write(cmd, sizeof(cmd)), sizeof(cmd));
+    TEST_EQ(i2c.getTxLen(), sizeof(cmd));
+    TEST_CHECK(memcmp(i2c.getTxBuf(), cmd, sizeof(cmd)) == 0);
+
+    TEST_EQ(i2c.feed(rsp, sizeof(rsp)), sizeof(rsp));
+    TEST_CHECK(hw.ready());
+    TEST_EQ(hw.read(buf, 3), 3);
+    TEST_EQ(hw.read(&buf[3], buf[2]), 3);
+    TEST_CHECK(memcmp(buf, rsp, sizeof(rsp)) == 0);
+    TEST_CHECK(!hw.ready());
+
+    // short read when less was fed
+    TEST_EQ(i2c.feed(rsp, 2), 2);
+    TEST_EQ(i2c.read(0x28, buf, 3), 2);
+    hostAttachPin(PIN_IRQ, NULL);
+}
+
+// reads above 255 bytes rejected before any request
+static void testWireRead(void)
+{
+    NfcI2c_wire i2c(Wire);
+    uint8_t buf[300];
+
+    Wire.requests = 0;
+    TEST_EQ(i2c.read(0x28, buf, 255), 0);
+    TEST_EQ(Wire.requests, 1);
+    TEST_EQ(Wire.requested, 255);
+    TEST_EQ(i2c.read(0x28, buf, 256), 0);
+    TEST_EQ(i2c.read(0x28, buf, sizeof(buf)), 0);
+    TEST_EQ(Wire.requests, 1);
+}
+
+int main(void)
+{
+    testLoopback();
+    testWireRead();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,89 @@
+/*
+ * TestMifare.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Mifare Classic dump, the card being activated again after each
+// failed authentication before the next key is tried.
+
+#include "NfcTest.h"
+
+static bool dump(NfcTest& t)
+{
+    if (t.tags.cmdDump() != TAGS_STATUS_OK) {
+        return false;
+    }
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    return t.app.done;
+}
+
+// sector 1 opens with the second key only
+static void testDumpKeys(void)
+{
+    NfcTest t;
+    NfcSimMifare tag;
+
+    TEST_CHECK(t.start(&tag));
+    TEST_CHECK(dump(t));
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(t.app.dump_len, 64 * 16);
+    TEST_EQ(tag.auth_fails, 1);
+    TEST_EQ(tag.mute, 0);
+    TEST_EQ(tag.reads, 64);
+    TEST_EQ(t.ctrl.activations, 2);
+    TEST_EQ(t.app.count[TAGS_EVT_DEACTIVATE], 0);
+    TEST_EQ(t.app.count[TAGS_EVT_DISCOVER_NTF], 1);
+
+    // the sector keys are kept for the session
+    t.app.clear();
+    TEST_CHECK(dump(t));
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(tag.auth_fails, 1);
+}
+
+// card removed while halted, the dump fails
+static void testDumpRemoved(void)
+{
+    NfcTest t;
+    NfcSimMifare tag;
+
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (tag.auth_fails == 0 && !t.app.done) {
+        t.step();
+    }
+    t.ctrl.setTag(NULL);
+    TEST_CHECK(t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1));
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_FAILED);
+    TEST_EQ(tag.mute, 0);
+
+    // discovery goes on
+    t.ctrl.setTag(&tag);
+    TEST_CHECK(t.run(TAGS_EVT_DISCOVER_NTF, 2));
+    TEST_CHECK(dump(t));
+}
+
+int main(void)
+{
+    testDumpKeys();
+    testDumpRemoved();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,226 @@
+/*
+ * TestNci.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// NCI data exchanges: flow control and segmentation against the
+// simulated controller, which counts the data packets it receives
+// without credit, and the event dispatch per received packet.
+
+#include "NfcTest.h"
+
+// echo APDU: CLA | INS | P1 | P2 | 00 | Lc | data | Le
+static uint32_t setEcho(uint8_t apdu[], uint32_t len)
+{
+    uint32_t i;
+
+    apdu[0] = 0x00;
+    apdu[1] = 0xEE;
+    apdu[2] = 0x00;
+    apdu[3] = 0x00;
+    apdu[4] = 0x00;
+    apdu[5] = len >> 8;
+    apdu[6] = len;
+    for (i = 0; i < len; i++) {
+        apdu[7 + i] = nfcSimPattern(i);
+    }
+    apdu[7 + len] = 0x00;
+    apdu[8 + len] = 0x00;
+    return 9 + len;
+}
+
+// segments of a command sent as credits are given back, the
+// controller segments the response alike, small enough for the
+// RX buffer of the builds with NFC_CONFIG_NCI_RX_SIZE set to 64
+static void testSegmentsCredits(bool late)
+{
+    static uint8_t apdu[1024], rsp[1024];
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t len;
+
+    t.ctrl.config.max_payload = 48;
+    t.ctrl.config.credits = 1;
+    t.ctrl.config.credits_late = late;
+    TEST_CHECK(t.start(&tag));
+
+    len = setEcho(apdu, 600);
+    TEST_EQ(t.tags.cmdExchangeApdu(apdu, len, rsp, sizeof(rsp)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_APDU], TAGS_STATUS_OK);
+    TEST_EQ(t.app.apdu.len, 600);
+    TEST_EQ(t.app.apdu.sw, 0x9000);
+    TEST_CHECK(memcmp(rsp, &apdu[7], 600) == 0);
+    TEST_EQ(t.ctrl.max_segment, 48);
+    TEST_EQ(t.ctrl.flow_errors, 0);
+}
+
+// single packet commands back to back, the credit of each one
+// being given back after its response
+static void testLateCredits(void)
+{
+    static uint8_t buf[1024];
+    NfcTest t;
+    NfcSimType4 tag(64, 500);
+
+    t.ctrl.config.credits = 1;
+    t.ctrl.config.credits_late = true;
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdReadNdef(buf, sizeof(buf)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_NDEF, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_NDEF], TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 500);
+    TEST_CHECK(tag.reads > 2);
+    TEST_EQ(t.ctrl.flow_errors, 0);
+}
+
+// empty ISO-DEP presence check frames wait for their credit too
+static void testPresenceCredits(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+
+    t.ctrl.config.credits = 1;
+    t.ctrl.config.credits_late = true;
+    t.ctrl.config.credit_time = 3000;
+    t.tags.setPresenceCheck(1);
+    TEST_CHECK(t.start(&tag));
+
+    t.idle(100);
+    TEST_CHECK(tag.exchanges > 10);
+    TEST_EQ(t.app.count[TAGS_EVT_REMOVED], 0);
+    TEST_EQ(t.ctrl.flow_errors, 0);
+}
+
+// no flow control: segments sent back to back
+static void testUnlimitedCredits(void)
+{
+    static uint8_t apdu[1024], rsp[1024];
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t len;
+
+    t.ctrl.config.max_payload = 56;
+    t.ctrl.config.credits = NCI_CREDITS_UNLIMITED;
+    TEST_CHECK(t.start(&tag));
+
+    len = setEcho(apdu, 900);
+    TEST_EQ(t.tags.cmdExchangeApdu(apdu, len, rsp, sizeof(rsp)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_APDU], TAGS_STATUS_OK);
+    TEST_EQ(t.app.apdu.len, 900);
+    TEST_EQ(t.ctrl.max_segment, 56);
+}
+
+// application loop of the examples, NfcNci::handleEvent() waits
+// for the next packet: passes until the dump callback, 1000 at most
+static uint32_t loopDump(NfcTest& t)
+{
+    uint32_t loops = 0;
+
+    while (!t.app.done && loops < 1000) {
+        t.tags.handleEvent();
+        if (!t.app.done) {
+            t.nci.handleEvent();
+        }
+        loops++;
+    }
+    return loops;
+}
+
+// one pass per packet received: the command following a response
+// is sent on the next pass, with the credit notification read
+// before the response
+static void testLoopsPerCommand(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(45);
+    uint32_t loops;
+
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    loops = loopDump(t);
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(tag.reads, 4);
+    TEST_EQ(loops, 2 * tag.reads);
+}
+
+// data segments seen by an NCI_EVT_DATA subscriber
+class NfcTestSegments
+{
+    public:
+        NfcTestSegments(void) : num(0), len(0) {;}
+        void cbData(uint8_t s, uint16_t id, void *d)
+        {
+            uint8_t *p = (uint8_t *)d;
+
+            // length | payload
+            num++;
+            if (s == NCI_STATUS_OK && p != NULL && len + p[0] <= sizeof(buf)) {
+                memcpy(&buf[len], &p[1], p[0]);
+                len += p[0];
+            }
+        }
+
+    public:
+        uint32_t num, len;
+        uint8_t buf[64];
+};
+
+// segments received one after the other without NfcTags running
+// in between, each one is seen before the next overwrites it
+static void testSegmentsBeforeTags(void)
+{
+    static const uint8_t read[] = {0x30, 0x04};
+    NfcTest t;
+    NfcSimType2 tag(45);
+    NfcTestSegments seg;
+    uint32_t i;
+
+    t.ctrl.config.max_payload = 6;
+    t.ctrl.config.credits = NCI_CREDITS_UNLIMITED;
+    TEST_CHECK(t.start(&tag));
+    for (i = 16; i < 32; i++) {
+        tag.mem[i] = nfcSimPattern(i);
+    }
+
+    // READ: 16 bytes and the status, three segments
+    t.nci.subscribe(NCI_EVT_DATA, NfcDelegate::bind<NfcTestSegments, &NfcTestSegments::cbData>(&seg));
+    TEST_EQ(t.nci.dataSend(NCI_CID_RF_STATIC, read, sizeof(read)), NCI_STATUS_OK);
+    for (i = 0; i < 10 && t.nci.isBusy(); i++) {
+        t.nci.handleEvent();
+    }
+    TEST_EQ(seg.num, 3);
+    TEST_EQ(seg.len, 17);
+    TEST_CHECK(memcmp(seg.buf, &tag.mem[16], 16) == 0);
+    TEST_EQ(seg.buf[16], NCI_STATUS_OK);
+}
+
+int main(void)
+{
+    testSegmentsCredits(false);
+    testSegmentsCredits(true);
+    testLateCredits();
+    testPresenceCredits();
+    testUnlimitedCredits();
+    testLoopsPerCommand();
+    testSegmentsBeforeTags();
+
+    return TEST_RESULT();
+}
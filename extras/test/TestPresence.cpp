@@ -0,0 +1,176 @@
+/*
+ * TestPresence.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Commands sent while a presence check is pending, held until the tag
+// answered, failed once it is removed. Tags activated again within the
+// debounce window, and deactivation held until the tag is removed.
+
+#include "NfcTest.h"
+#include "tags/NfcTagsJobs.h"
+
+// run the stack up to the next presence check, pending on return
+static bool checking(NfcTest& t)
+{
+    uint32_t i;
+
+    for (i = 0; i < 1000 && !t.nci.isBusy(); i++) {
+        t.step();
+        hostAdvance(100);
+    }
+    return t.nci.isBusy();
+}
+
+// NDEF read held by the check, then read
+static void testHeld(void)
+{
+    static uint8_t buf[512];
+    NfcTest t;
+    NfcSimType4 tag(255, 300);
+
+    t.tags.setPresenceCheck(10);
+    TEST_CHECK(t.start(&tag));
+
+    TEST_CHECK(checking(t));
+    TEST_EQ(t.tags.cmdReadNdef(buf, sizeof(buf)), TAGS_STATUS_OK);
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_REJECTED);
+    TEST_CHECK(t.run(TAGS_EVT_NDEF, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_NDEF], TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 300);
+    TEST_EQ(t.app.count[TAGS_EVT_REMOVED], 0);
+}
+
+// APDU held by the check of a removed tag fails after cbRemoved()
+static void testRemoved(void)
+{
+    static uint8_t apdu[] = {0x00, 0xA4, 0x04, 0x00, 0x00};
+    static uint8_t rsp[16];
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+
+    t.tags.setPresenceCheck(10);
+    TEST_CHECK(t.start(&tag));
+
+    t.ctrl.setTag(NULL);
+    TEST_CHECK(checking(t));
+    TEST_EQ(t.tags.cmdExchangeApdu(apdu, sizeof(apdu), rsp, sizeof(rsp)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_APDU], TAGS_STATUS_FAILED);
+    TEST_EQ(t.app.count[TAGS_EVT_REMOVED], 1);
+}
+
+// job started during a check completes, the next one runs after it
+static void testJobs(void)
+{
+    static uint8_t apdu[] = {0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00};
+    static uint8_t buf[512], rsp[16];
+    NfcTest t;
+    NfcSimType4 tag(255, 300);
+    NfcTagsJobs jobs(t.log, t.tags);
+    uint8_t read, select;
+
+    jobs.init(&t.app);
+    t.tags.setPresenceCheck(10);
+    TEST_CHECK(t.start(&tag));
+
+    TEST_CHECK(checking(t));
+    read = jobs.submitReadNdef(buf, sizeof(buf));
+    select = jobs.submitApdu(apdu, sizeof(apdu), rsp, sizeof(rsp));
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_EQ(jobs.getStatus(read), TAGS_STATUS_OK);
+    TEST_EQ(jobs.getStatus(select), TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 300);
+    TEST_EQ(t.app.apdu.sw, 0x9000);
+}
+
+// same tag activated again within the window is deactivated without
+// being notified, the window restarting as long as it comes back,
+// notified again once away for longer
+static void testDebounce(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t activations;
+
+    t.tags.setDebounce(500);
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdDeactivate(), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_DEACTIVATE, 1));
+    t.idle(200);
+    TEST_CHECK(t.ctrl.activations > 2);
+    TEST_EQ(t.app.count[TAGS_EVT_DISCOVER_NTF], 1);
+
+    // back within the window
+    t.ctrl.setTag(NULL);
+    t.idle(200);
+    activations = t.ctrl.activations;
+    t.ctrl.setTag(&tag);
+    t.idle(100);
+    TEST_CHECK(t.ctrl.activations > activations);
+    TEST_EQ(t.app.count[TAGS_EVT_DISCOVER_NTF], 1);
+
+    // back after the window
+    t.ctrl.setTag(NULL);
+    t.idle(600);
+    activations = t.ctrl.activations;
+    t.ctrl.setTag(&tag);
+    TEST_CHECK(t.run(TAGS_EVT_DISCOVER_NTF, 2));
+    TEST_EQ(t.app.status[TAGS_EVT_DISCOVER_NTF], TAGS_STATUS_OK);
+    TEST_EQ(t.ctrl.activations, activations + 1);
+}
+
+// deactivation held: the tag stays activated and is checked every
+// interval, cbDeactivate() once it is removed
+static void testHold(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t exchanges;
+
+    t.tags.setHold(50);
+    TEST_CHECK(t.start(&tag));
+
+    exchanges = tag.exchanges;
+    TEST_EQ(t.tags.cmdDeactivate(), TAGS_STATUS_OK);
+    t.idle(500);
+    TEST_EQ(t.app.count[TAGS_EVT_DEACTIVATE], 0);
+    TEST_EQ(t.ctrl.activations, 1);
+    TEST_CHECK(tag.exchanges - exchanges >= 8);
+
+    t.ctrl.setTag(NULL);
+    TEST_CHECK(t.run(TAGS_EVT_DEACTIVATE, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_DEACTIVATE], TAGS_STATUS_OK);
+
+    // discovering again
+    t.ctrl.setTag(&tag);
+    TEST_CHECK(t.run(TAGS_EVT_DISCOVER_NTF, 2));
+    TEST_EQ(t.ctrl.activations, 2);
+}
+
+int main(void)
+{
+    testHeld();
+    testRemoved();
+    testJobs();
+    testDebounce();
+    testHold();
+
+    return TEST_RESULT();
+}
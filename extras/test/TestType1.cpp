@@ -0,0 +1,87 @@
+/*
+ * TestType1.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Type 1 dumps in the fewest commands: RID once per activation, RALL
+// for static memory tags, RSEG per segment then READ8 for the blocks
+// left for dynamic memory ones. READ and READ8 alone when the RALL and
+// RSEG responses do not fit in the payload of the connection.
+
+#include "NfcTest.h"
+
+// RALL and RSEG response payloads: len | response | status
+#define RALL_PAYLOAD    124
+#define RSEG_PAYLOAD    131
+
+// dump the whole tag, the commands counted by the tag
+static void testDump(uint8_t hr0, uint32_t blocks, bool formatted, uint8_t max_payload,
+                     uint32_t rall, uint32_t rseg, uint32_t read8, uint32_t read)
+{
+    NfcTest t;
+    NfcSimType1 tag(hr0, blocks, formatted);
+    uint32_t size;
+
+    t.ctrl.config.max_payload = max_payload;
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    size = (hr0 == 0x11) ? 120 : tag.size;
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(t.app.dump_len, size);
+    TEST_CHECK(memcmp(t.app.dump, tag.mem, size) == 0);
+    TEST_EQ(tag.rid, 1);
+    TEST_EQ(tag.rall, rall);
+    TEST_EQ(tag.rseg, rseg);
+    TEST_EQ(tag.read8, read8);
+    TEST_EQ(tag.read, read);
+
+    // header ROM read once per activation
+    t.app.clear();
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(tag.rid, 1);
+}
+
+int main(void)
+{
+    bool rall = TEST_PAYLOAD(0) >= RALL_PAYLOAD;
+    bool rseg = TEST_PAYLOAD(0) >= RSEG_PAYLOAD;
+
+    // Topaz 96: static memory
+    testDump(0x11, 15, true, 0, rall, 0, 0, rall ? 0 : 120);
+    // Topaz 512: dynamic memory sized from the CC, 4 segments
+    // then 8 blocks when the CC tells 72 blocks
+    testDump(0x12, 64, true, 0, 0, rseg ? 4 : 0, rseg ? 0 : 64, 0);
+    testDump(0x12, 72, true, 0, 0, rseg ? 4 : 0, rseg ? 8 : 72, 0);
+    // Topaz 512 not formatted, 64 blocks assumed
+    testDump(0x12, 64, false, 0, 0, rseg ? 4 : 0, rseg ? 0 : 64, 0);
+
+    // RALL and RSEG do not fit, byte and block reads
+    testDump(0x11, 15, true, 64, 0, 0, 0, 120);
+    testDump(0x12, 72, true, 64, 0, 0, 72, 0);
+    testDump(0x12, 64, false, 64, 0, 0, 64, 0);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,531 @@
+/*
+ * TestType2.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Type 2 WRITE commands sent back to back as credits allow, NDEF
+// messages read from the blocks holding them only and written block
+// by block diff in a tear safe order, NTAG21x identified by GET_VERSION
+// and tags tapped again known from the NFCID cache.
+
+#include "NfcTest.h"
+
+// 16 blocks written from block 4, read back if verify
+static void testWrite(uint8_t credits, bool late, bool verify)
+{
+    static uint8_t buf[64];
+    NfcTest t;
+    NfcSimType2 tag;
+    uint32_t i;
+
+    t.ctrl.config.credits = credits;
+    t.ctrl.config.credits_late = late;
+    t.ctrl.config.credit_time = late ? 300 : 0;
+    TEST_CHECK(t.start(&tag));
+
+    for (i = 0; i < sizeof(buf); i++) {
+        buf[i] = nfcSimPattern(i);
+    }
+    TEST_EQ(t.tags.cmdWrite(4, buf, sizeof(buf), verify), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_WRITE, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_WRITE], TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 16);
+    TEST_CHECK(memcmp(&tag.mem[16], buf, sizeof(buf)) == 0);
+    TEST_EQ(t.ctrl.flow_errors, 0);
+}
+
+// a NACKed block fails the write
+static void testWriteNack(void)
+{
+    static uint8_t buf[32];
+    NfcTest t;
+    NfcSimType2 tag;
+
+    t.ctrl.config.credits = 2;
+    tag.nack_page = 6;
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdWrite(4, buf, sizeof(buf)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_WRITE, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_WRITE], TAGS_STATUS_FAILED);
+    TEST_EQ(t.ctrl.flow_errors, 0);
+}
+
+// NDEF TLV at addr of an NTAG216 data area, after a lock control
+// TLV and NULL TLVs, then the terminator
+static void setNdefTlv(NfcSimType2& tag, uint32_t addr, const uint8_t msg[], uint32_t len)
+{
+    static const uint8_t lock[] = {0x01, 0x03, 0xA0, 0x10, 0x44};
+    uint32_t p = 16;
+
+    if (addr >= p + sizeof(lock)) {
+        memcpy(&tag.mem[p], lock, sizeof(lock));
+        p += sizeof(lock);
+    }
+    while (p < addr) {
+        tag.mem[p++] = 0x00;
+    }
+    tag.mem[p++] = 0x03;
+    if (len < 0xFF) {
+        tag.mem[p++] = len;
+    }
+    else {
+        tag.mem[p++] = 0xFF;
+        tag.mem[p++] = len >> 8;
+        tag.mem[p++] = len;
+    }
+    memcpy(&tag.mem[p], msg, len);
+    tag.mem[p + len] = 0xFE;
+}
+
+// the tag memory has the NDEF TLV at addr and its terminator
+static bool isNdefTlv(NfcSimType2& tag, uint32_t addr, const uint8_t msg[], uint32_t len)
+{
+    uint32_t p = addr + 1;
+
+    if (tag.mem[addr] != 0x03) {
+        return false;
+    }
+    if (len < 0xFF) {
+        if (tag.mem[p++] != len) {
+            return false;
+        }
+    }
+    else if (tag.mem[p] != 0xFF || tag.mem[p + 1] != (len >> 8) || tag.mem[p + 2] != (len & 0xFF)) {
+        return false;
+    }
+    else {
+        p += 3;
+    }
+    return memcmp(&tag.mem[p], msg, len) == 0 && tag.mem[p + len] == 0xFE;
+}
+
+static uint8_t readNdef(NfcTest& t, uint8_t buf[], uint16_t size)
+{
+    if (t.tags.cmdReadNdef(buf, size) != TAGS_STATUS_OK ||
+        !t.run(TAGS_EVT_NDEF, t.app.count[TAGS_EVT_NDEF] + 1)) {
+        return TAGS_STATUS_FAILED;
+    }
+    return t.app.status[TAGS_EVT_NDEF];
+}
+
+static uint8_t writeNdef(NfcTest& t, const uint8_t buf[], uint16_t len, const tTAGS_NDEF *old)
+{
+    if (t.tags.cmdWriteNdef(buf, len, old) != TAGS_STATUS_OK ||
+        !t.run(TAGS_EVT_WRITE, t.app.count[TAGS_EVT_WRITE] + 1)) {
+        return TAGS_STATUS_FAILED;
+    }
+    return t.app.status[TAGS_EVT_WRITE];
+}
+
+// URI record after lock control and NULL TLVs: 2 READs, the record
+// is parsed in place
+static void testReadNdefUri(void)
+{
+    static const uint8_t uri[] = {
+        0xD1, 0x01, 0x0C, 'U', 0x04,
+        'e', 'x', 'a', 'm', 'p', 'l', 'e', '.', 'c', 'o', 'm'
+    };
+    static uint8_t rd[64];
+    NfcTest t;
+    NfcSimType2 tag(231);
+    NfcNdef ndef;
+    tNDEF_RECORD rec;
+
+    setNdefTlv(tag, 22, uri, sizeof(uri));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, sizeof(uri));
+    TEST_CHECK(memcmp(rd, uri, sizeof(uri)) == 0);
+    TEST_EQ(tag.reads, 2);
+
+    ndef.init(t.app.ndef.buf, t.app.ndef.len);
+    TEST_EQ(ndef.getRecord(&rec), NDEF_STATUS_OK);
+    TEST_EQ(rec.tnf, NDEF_TNF_WELL_KNOWN);
+    TEST_EQ(rec.type[0], NDEF_RTD_URI);
+    TEST_EQ(rec.payload_len, 12);
+    TEST_CHECK(rec.payload == &rd[4]);
+    TEST_EQ(ndef.getRecord(&rec), NDEF_STATUS_END);
+}
+
+// 3 bytes length: message up to byte 325, READs from block 3 to 79
+static void testReadNdefLong(void)
+{
+    static uint8_t msg[300], rd[512];
+    NfcTest t;
+    NfcSimType2 tag(231);
+    uint32_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = nfcSimPattern(i);
+    }
+    setNdefTlv(tag, 22, msg, sizeof(msg));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, sizeof(msg));
+    TEST_CHECK(memcmp(rd, msg, sizeof(msg)) == 0);
+    TEST_EQ(tag.reads, 20);
+
+    // buffer too small for the message
+    TEST_EQ(readNdef(t, rd, sizeof(msg) - 1), TAGS_STATUS_FAILED);
+}
+
+// no NDEF TLV before the terminator, NDEF TLV running past the data
+// area, tag not formatted
+static void testReadNdefErrors(void)
+{
+    static uint8_t msg[200], rd[256];
+    NfcTest t;
+    NfcSimType2 tag(45);
+
+    setNdefTlv(tag, 22, msg, 0);
+    tag.mem[22] = 0xFE;
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_FAILED);
+    TEST_EQ(tag.reads, 1);
+
+    // NTAG213 data area up to byte 160
+    setNdefTlv(tag, 22, msg, sizeof(msg));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_FAILED);
+
+    // the NDEF TLV was found, not its end: no write to it
+    TEST_CHECK(t.tags.cmdWriteNdef(msg, 8, NULL) != TAGS_STATUS_OK);
+
+    tag.mem[12] = 0x00;
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_FAILED);
+}
+
+// same length edits: only the blocks which differ are written, one
+// for a byte, two when the bytes changed span two blocks
+static void testWriteNdefEdit(void)
+{
+    static uint8_t msg[20], rd[64], wr[20];
+    NfcTest t;
+    NfcSimType2 tag(231);
+    tTAGS_NDEF old;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = nfcSimPattern(i);
+    }
+    setNdefTlv(tag, 22, msg, sizeof(msg));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    old = t.app.ndef;
+
+    // message from byte 24: byte 3 in block 6
+    memcpy(wr, msg, sizeof(wr));
+    wr[3] ^= 0xFF;
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 1);
+    TEST_EQ(tag.pages[0], 6);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, sizeof(wr)));
+
+    // bytes 7 and 8, blocks 7 and 8
+    memcpy(rd, wr, sizeof(wr));
+    wr[7] ^= 0xFF;
+    wr[8] ^= 0xFF;
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 3);
+    TEST_EQ(tag.pages[1], 7);
+    TEST_EQ(tag.pages[2], 8);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, sizeof(wr)));
+
+    // unchanged, nothing written
+    memcpy(rd, wr, sizeof(wr));
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 3);
+
+    // without the current message, every block as for a new length
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), NULL), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 3 + 8);
+    for (i = 0; i < 7; i++) {
+        TEST_EQ(tag.pages[3 + i], 5 + i);
+    }
+    TEST_EQ(tag.pages[10], 5);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, sizeof(wr)));
+}
+
+// length changes: the length is cleared first, the message and the
+// terminator written, then the length
+static void testWriteNdefResize(void)
+{
+    static uint8_t msg[20], rd[512], wr[300];
+    NfcTest t;
+    NfcSimType2 tag(231);
+    tTAGS_NDEF old;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = nfcSimPattern(i);
+    }
+    for (i = 0; i < sizeof(wr); i++) {
+        wr[i] = nfcSimPattern(i);
+    }
+    setNdefTlv(tag, 22, msg, sizeof(msg));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    old = t.app.ndef;
+
+    // 20 to 24 bytes: length block 5 cleared, message from byte 24,
+    // old terminator at 44 in block 11, new one at 48 in block 12
+    TEST_EQ(writeNdef(t, wr, 24, &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 4);
+    TEST_EQ(tag.pages[0], 5);
+    TEST_EQ(tag.pages[1], 11);
+    TEST_EQ(tag.pages[2], 12);
+    TEST_EQ(tag.pages[3], 5);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, 24));
+
+    // 24 to 300 bytes, the length takes 3 bytes over blocks 5 and 6:
+    // block 5 cleared, blocks 6 to 80 with the length MSB and LSB and
+    // the message, the terminator at 326 in block 81, then block 5
+    memcpy(rd, wr, 24);
+    old.len = 24;
+    tag.writes = 0;
+    TEST_EQ(writeNdef(t, wr, 300, &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 1 + 75 + 1 + 1);
+    TEST_EQ(tag.pages[0], 5);
+    TEST_EQ(tag.pages[1], 6);
+    TEST_EQ(tag.pages[75], 80);
+    TEST_EQ(tag.pages[76], 81);
+    TEST_EQ(tag.pages[77], 5);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, 300));
+
+    // and back to 1 byte: the new length in block 5 cleared first,
+    // message over the old length bytes, terminator at 32 in block 8
+    memcpy(rd, wr, 300);
+    old.len = 300;
+    tag.writes = 0;
+    TEST_EQ(writeNdef(t, wr, 8, &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 5);
+    TEST_EQ(tag.pages[0], 5);
+    TEST_EQ(tag.pages[1], 6);
+    TEST_EQ(tag.pages[2], 7);
+    TEST_EQ(tag.pages[3], 8);
+    TEST_EQ(tag.pages[4], 5);
+    TEST_CHECK(isNdefTlv(tag, 22, wr, 8));
+}
+
+// write torn after the first block, the NDEF message is then empty
+static void testWriteNdefTorn(void)
+{
+    static uint8_t msg[20], rd[512], wr[300];
+    NfcTest t;
+    NfcSimType2 tag(231);
+    tTAGS_NDEF old;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = nfcSimPattern(i);
+    }
+    for (i = 0; i < sizeof(wr); i++) {
+        wr[i] = nfcSimPattern(i + 1);
+    }
+    setNdefTlv(tag, 22, msg, sizeof(msg));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    old = t.app.ndef;
+
+    // 1 to 3 bytes length, block 6 with its MSB and LSB NACKed
+    tag.nack_page = 6;
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), &old), TAGS_STATUS_FAILED);
+    TEST_EQ(tag.pages[0], 5);
+    TEST_EQ(tag.mem[23], 0);
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 0);
+}
+
+// terminator in the length block: written with the length
+static void testWriteNdefShared(void)
+{
+    static uint8_t msg[20], rd[64], wr[1] = {0xD0};
+    NfcTest t;
+    NfcSimType2 tag(231);
+    tTAGS_NDEF old;
+    uint32_t i;
+
+    for (i = 0; i < sizeof(msg); i++) {
+        msg[i] = nfcSimPattern(i);
+    }
+    setNdefTlv(tag, 16, msg, sizeof(msg));
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(readNdef(t, rd, sizeof(rd)), TAGS_STATUS_OK);
+    old = t.app.ndef;
+
+    // 03 | 01 | D0 | FE in block 4, cleared then written
+    TEST_EQ(writeNdef(t, wr, sizeof(wr), &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 2);
+    TEST_EQ(tag.pages[0], 4);
+    TEST_EQ(tag.pages[1], 4);
+    TEST_CHECK(isNdefTlv(tag, 16, wr, sizeof(wr)));
+
+    // empty message
+    memcpy(rd, wr, sizeof(wr));
+    old.len = sizeof(wr);
+    TEST_EQ(writeNdef(t, wr, 0, &old), TAGS_STATUS_OK);
+    TEST_EQ(tag.writes, 4);
+    TEST_CHECK(isNdefTlv(tag, 16, wr, 0));
+}
+
+// dump of the activated tag, its length
+static uint32_t dump(NfcTest& t, NfcSimType2& tag)
+{
+    t.app.clear();
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_CHECK(memcmp(t.app.dump, tag.mem, t.app.dump_len) == 0);
+    return t.app.dump_len;
+}
+
+// NTAG21x identified from the GET_VERSION storage size, dumped up
+// to its last page
+static void testProbe(uint32_t pages, uint8_t storage)
+{
+    NfcTest t;
+    NfcSimType2 tag(pages);
+    const uint8_t *version;
+
+    TEST_EQ(tag.storage, storage);
+    t.tags.setProbe(true);
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(tag.versions, 1);
+    TEST_EQ(tag.activations, 1);
+
+    TEST_EQ(t.tags.getInterface()->getType(), TAGS_TYPE_2);
+    version = ((NfcTagsIntfType2 *)t.tags.getInterface())->getVersion();
+    TEST_CHECK(version != NULL);
+    if (version != NULL) {
+        TEST_EQ(version[6], storage);
+    }
+    TEST_EQ(dump(t, tag), pages * 4);
+}
+
+// tag without GET_VERSION: NACK, halted then activated again and
+// notified once, dumped with the static memory mapping
+static void testProbeUnsupported(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(45);
+
+    tag.version = false;
+    t.tags.setProbe(true);
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(tag.versions, 1);
+    TEST_EQ(tag.activations, 2);
+    TEST_EQ(t.app.count[TAGS_EVT_DISCOVER_NTF], 1);
+    TEST_EQ(t.app.status[TAGS_EVT_DISCOVER_NTF], TAGS_STATUS_OK);
+
+    TEST_CHECK(((NfcTagsIntfType2 *)t.tags.getInterface())->getVersion() == NULL);
+    TEST_EQ(dump(t, tag), 16 * 4);
+    TEST_EQ(tag.versions, 1);
+}
+
+// deactivated and activated again, the tag in the field then
+static void reactivate(NfcTest& t, NfcSimType2& tag)
+{
+    uint32_t num = t.app.count[TAGS_EVT_DISCOVER_NTF];
+
+    TEST_EQ(t.tags.cmdDeactivate(), TAGS_STATUS_OK);
+    t.ctrl.setTag(&tag);
+    TEST_CHECK(t.run(TAGS_EVT_DISCOVER_NTF, num + 1));
+    TEST_EQ(t.app.status[TAGS_EVT_DISCOVER_NTF], TAGS_STATUS_OK);
+}
+
+// tag activated again within the max age: not probed, its version
+// and the first bytes dumped known from the cache, until they expire
+static void testCacheHit(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(135);
+    const uint8_t *data;
+    uint16_t len = 0;
+
+    t.tags.setProbe(true);
+    t.tags.setCacheMaxAge(1000);
+    TEST_CHECK(t.start(&tag));
+    TEST_CHECK(t.tags.getCachedData(&len) == NULL);
+    TEST_EQ(dump(t, tag), 135 * 4);
+
+    reactivate(t, tag);
+    TEST_EQ(tag.versions, 1);
+    TEST_EQ(tag.activations, 2);
+    TEST_CHECK(((NfcTagsIntfType2 *)t.tags.getInterface())->getVersion() != NULL);
+    data = t.tags.getCachedData(&len);
+    TEST_CHECK(data != NULL);
+    TEST_EQ(len, TAGS_CACHE_DATA_SIZE);
+    TEST_CHECK(data != NULL && memcmp(data, tag.mem, TAGS_CACHE_DATA_SIZE) == 0);
+
+    // content too old, the tag is still identified
+    hostAdvance(1001 * 1000);
+    TEST_CHECK(t.tags.getCachedData(&len) == NULL);
+    reactivate(t, tag);
+    TEST_EQ(tag.versions, 1);
+    TEST_CHECK(t.tags.getCachedData(&len) == NULL);
+}
+
+// another NFCID misses the cache and is probed, the first tag is
+// still known
+static void testCacheMiss(void)
+{
+    NfcTest t;
+    NfcSimType2 tag(45), other(45);
+    uint16_t len = 0;
+
+    other.uid[6] ^= 0xFF;
+    t.tags.setProbe(true);
+    t.tags.setCacheMaxAge(1000);
+    TEST_CHECK(t.start(&tag));
+    TEST_EQ(dump(t, tag), 45 * 4);
+
+    reactivate(t, other);
+    TEST_EQ(other.versions, 1);
+    TEST_CHECK(t.tags.getCachedData(&len) == NULL);
+
+    reactivate(t, tag);
+    TEST_EQ(tag.versions, 1);
+    TEST_CHECK(t.tags.getCachedData(&len) != NULL);
+    TEST_EQ(len, TAGS_CACHE_DATA_SIZE);
+}
+
+int main(void)
+{
+    testWrite(1, false, false);
+    testWrite(1, true, false);
+    testWrite(4, true, true);
+    testWrite(NCI_CREDITS_UNLIMITED, false, true);
+    testWriteNack();
+    testReadNdefUri();
+    testReadNdefLong();
+    testReadNdefErrors();
+    testWriteNdefEdit();
+    testWriteNdefResize();
+    testWriteNdefTorn();
+    testWriteNdefShared();
+    testProbe(45, 0x0F);
+    testProbe(135, 0x11);
+    testProbe(231, 0x13);
+    testProbeUnsupported();
+    testCacheHit();
+    testCacheMiss();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,55 @@
+/*
+ * TestType3.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Type 3 CHECK commands sized after the maximum payload of the
+// connection, 0 standing for 255 bytes.
+
+#include "NfcTest.h"
+
+// 40 blocks dumped, blocks per CHECK command
+static void testCheckSize(uint8_t max_payload, uint32_t blocks)
+{
+    NfcTest t;
+    NfcSimType3 tag(15, 1, 40);
+
+    t.ctrl.config.max_payload = max_payload;
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(t.app.dump_len, tag.size);
+    TEST_CHECK(memcmp(t.app.dump, tag.mem, tag.size) == 0);
+    TEST_EQ(tag.max_blocks, blocks);
+}
+
+int main(void)
+{
+    // 0 and 255 bounded by the NCI buffers of the build, the
+    // CHECK response is 14 bytes and 16 per block
+    testCheckSize(0, (TEST_PAYLOAD(0) - 14) / 16);
+    testCheckSize(255, (TEST_PAYLOAD(255) - 14) / 16);
+    testCheckSize(48, 2);
+    testCheckSize(32, 1);
+
+    return TEST_RESULT();
+}
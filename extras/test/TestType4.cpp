@@ -0,0 +1,370 @@
+/*
+ * TestType4.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// ISO-DEP exchanges: extended length APDUs split in data packets both
+// ways, and the NDEF read steps with their error paths. Activation on
+// NFC-A and NFC-B: ATS, SENSB_RES and ATTRIB response parsed into the
+// card capabilities, as given or truncated.
+
+#include "NfcTest.h"
+
+static uint8_t buf[4096], rsp[4096];
+
+// controller data packets payload, the responses are segmented alike
+// and fit in the RX buffer of the builds with NFC_CONFIG_NCI_RX_SIZE
+// set to 64
+#define SEGMENT     56
+
+// READ BINARY Le, bounded when a response has to fit in a packet
+#if NCI_RX_BUFFER_SIZE < NCI_PACKET_SIZE
+#define LE_MAX      (NCI_RX_BUFFER_SIZE - NCI_MSG_HDR_SIZE - 2)
+#else
+#define LE_MAX      0xFFFF
+#endif
+
+// extended length echo APDU: 00 EE 00 00 | 00 Lc (2) | data | Le (2)
+static uint32_t setEcho(uint8_t apdu[], uint32_t len)
+{
+    uint32_t i;
+
+    apdu[0] = 0x00;
+    apdu[1] = 0xEE;
+    apdu[2] = 0x00;
+    apdu[3] = 0x00;
+    apdu[4] = 0x00;
+    apdu[5] = len >> 8;
+    apdu[6] = len;
+    for (i = 0; i < len; i++) {
+        apdu[7 + i] = nfcSimPattern(i);
+    }
+    apdu[7 + len] = 0x00;
+    apdu[8 + len] = 0x00;
+    return 9 + len;
+}
+
+// command segmented, response reassembled by the NCI receive path
+static void testExtendedApdu(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t len;
+
+    t.ctrl.config.max_payload = SEGMENT;
+    TEST_CHECK(t.start(&tag));
+
+    len = setEcho(buf, 2000);
+    TEST_EQ(t.tags.cmdExchangeApdu(buf, len, rsp, sizeof(rsp)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_APDU], TAGS_STATUS_OK);
+    TEST_EQ(t.app.apdu.sw, 0x9000);
+    TEST_EQ(t.app.apdu.len, 2000);
+    TEST_CHECK(memcmp(rsp, &buf[7], 2000) == 0);
+    TEST_EQ(t.ctrl.data_packets, (len + SEGMENT - 1) / SEGMENT);
+    TEST_EQ(t.ctrl.rsp_segments, (2000 + 2 + 1 + SEGMENT - 1) / SEGMENT);
+    TEST_EQ(t.ctrl.max_segment, SEGMENT);
+}
+
+// response larger than the buffer
+static void testApduOverflow(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    uint32_t len;
+
+    TEST_CHECK(t.start(&tag));
+
+    len = setEcho(buf, 600);
+    TEST_EQ(t.tags.cmdExchangeApdu(buf, len, rsp, 300), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_APDU, 1));
+    TEST_CHECK(t.app.status[TAGS_EVT_APDU] != TAGS_STATUS_OK);
+}
+
+// NDEF message read in chunks of READ BINARY, extended Le above 256
+static void testNdefChunks(uint16_t mle, uint16_t chunk, uint32_t max_read)
+{
+    NfcTest t;
+    NfcSimType4 tag(mle, 3000);
+
+    t.tags.setNdefChunkSize(chunk);
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdReadNdef(buf, sizeof(buf)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_NDEF, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_NDEF], TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 3000);
+    TEST_CHECK(memcmp(buf, &tag.ndef[2], 3000) == 0);
+    TEST_EQ(tag.max_read, max_read < LE_MAX ? max_read : LE_MAX);
+}
+
+// NDEF read of a tag whose CC or NLEN is patched, status expected
+static void testNdefError(uint8_t off, uint8_t val, bool nlen, uint16_t size, uint8_t expected)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 100);
+
+    if (nlen) {
+        tag.ndef[off] = val;
+    }
+    else {
+        tag.cc[off] = val;
+    }
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdReadNdef(buf, size), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_NDEF, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_NDEF], expected);
+}
+
+// frame waiting and guard times of FWI and SFGI n, in us
+#define ISO_DEP_TIME(n)     (((4096UL << (n)) * 25) / 339)
+
+// tag activated again with its parameters changed
+static tNCI_RF_INTF* reactivate(NfcTest& t)
+{
+    uint32_t num = t.app.count[TAGS_EVT_DISCOVER_NTF];
+
+    TEST_EQ(t.tags.cmdDeactivate(), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_DISCOVER_NTF, num + 1));
+    TEST_EQ(t.app.status[TAGS_EVT_DISCOVER_NTF], TAGS_STATUS_OK);
+    return t.tags.getInterface()->getRfIntf();
+}
+
+// ATS: T0 | [TA] | [TB] | [TC] | historical bytes, the interface bytes
+// missing read as their defaults
+static void testAts(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    tNCI_RF_INTF *rf;
+    tNCI_ACT_PARAMS_PA *ats;
+
+    TEST_CHECK(t.start(&tag));
+    rf = t.tags.getInterface()->getRfIntf();
+    ats = &rf->activation.params.poll_a;
+    TEST_EQ(rf->activation.type, NCI_DISCOVERY_TYPE_POLL_A);
+    TEST_EQ(ats->fsci, 8);
+    TEST_EQ(ats->ta, 0x80);
+    TEST_EQ(ats->fwi, 7);
+    TEST_EQ(ats->sfgi, 0);
+    TEST_EQ(ats->tc, 0x02);
+    TEST_EQ(ats->hist_len, 1);
+    TEST_EQ(ats->hist[0], 0x80);
+    TEST_EQ(rf->activation.fsc, 256);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(7));
+    TEST_EQ(rf->activation.sfgt, 0);
+    TEST_EQ(t.tags.getInterface()->getNfcidLen(), 7);
+
+    // T0 and historical bytes
+    memcpy(tag.ats, "\x04\x05\x11\x22\x33", 5);
+    tag.ats_len = 5;
+    rf = reactivate(t);
+    TEST_EQ(ats->fsci, 5);
+    TEST_EQ(ats->ta, 0);
+    TEST_EQ(ats->fwi, 4);
+    TEST_EQ(ats->tc, 0x02);
+    TEST_EQ(ats->hist_len, 3);
+    TEST_CHECK(memcmp(ats->hist, "\x11\x22\x33", 3) == 0);
+    TEST_EQ(rf->activation.fsc, 64);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(4));
+
+    // TB only, start-up frame guard time
+    memcpy(tag.ats, "\x02\x25\x95", 3);
+    tag.ats_len = 3;
+    rf = reactivate(t);
+    TEST_EQ(ats->fwi, 9);
+    TEST_EQ(ats->sfgi, 5);
+    TEST_EQ(ats->hist_len, 0);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(9));
+    TEST_EQ(rf->activation.sfgt, ISO_DEP_TIME(5));
+
+    // FSCI and FWI RFU
+    memcpy(tag.ats, "\x02\x2D\xF0", 3);
+    rf = reactivate(t);
+    TEST_EQ(rf->activation.fsc, 256);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(4));
+}
+
+// ATS cut short by its length or the parameters length
+static void testAtsTruncated(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16);
+    tNCI_RF_INTF *rf;
+    tNCI_ACT_PARAMS_PA *ats;
+
+    // TA, TB and TC announced, not there
+    memcpy(tag.ats, "\x01\x78", 2);
+    tag.ats_len = 2;
+    TEST_CHECK(t.start(&tag));
+    rf = t.tags.getInterface()->getRfIntf();
+    ats = &rf->activation.params.poll_a;
+    TEST_EQ(ats->fsci, 8);
+    TEST_EQ(ats->ta, 0);
+    TEST_EQ(ats->fwi, 4);
+    TEST_EQ(ats->tc, 0x02);
+    TEST_EQ(ats->hist_len, 0);
+
+    // length beyond the parameters, TB and after cut
+    memcpy(tag.ats, "\x05\x78\x80\x70\x02\x80", 6);
+    tag.ats_len = 3;
+    rf = reactivate(t);
+    TEST_EQ(ats->fsci, 8);
+    TEST_EQ(ats->ta, 0x80);
+    TEST_EQ(ats->fwi, 4);
+    TEST_EQ(ats->tc, 0x02);
+    TEST_EQ(ats->hist_len, 0);
+
+    // empty ATS
+    tag.ats[0] = 0;
+    tag.ats_len = 1;
+    rf = reactivate(t);
+    TEST_EQ(ats->fsci, 2);
+    TEST_EQ(rf->activation.fsc, 32);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(4));
+
+    // no parameters, not ISO-DEP capabilities
+    tag.ats_len = 0;
+    rf = reactivate(t);
+    TEST_EQ(rf->activation.fsc, 0);
+    TEST_EQ(rf->activation.fwt, 0);
+}
+
+// NFC-B: PUPI as NFCID, application data and protocol info from the
+// SENSB_RES, ATTRIB response, then the NDEF read over it
+static void testPollB(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 100, NCI_DISCOVERY_TYPE_POLL_B);
+    tNCI_RF_INTF *rf;
+    tNCI_RF_PARAMS_PB *sensb;
+    tNCI_ACT_PARAMS_PB *attrib;
+
+    memcpy(&tag.sensb[5], "\xA1\xA2\xA3\xA4", 4);
+    TEST_CHECK(t.start(&tag, TAGS_TECH_B));
+    rf = t.tags.getInterface()->getRfIntf();
+    sensb = &rf->specific.params.poll_b;
+    attrib = &rf->activation.params.poll_b;
+    TEST_EQ(rf->specific.type, NCI_DISCOVERY_TYPE_POLL_B);
+    TEST_CHECK(memcmp(sensb->pupi, "\x0B\x01\x02\x03", 4) == 0);
+    TEST_CHECK(memcmp(sensb->app_data, "\xA1\xA2\xA3\xA4", 4) == 0);
+    TEST_EQ(sensb->prot_info_len, 3);
+    TEST_CHECK(memcmp(sensb->prot_info, "\x00\x81\x71", 3) == 0);
+    TEST_EQ(t.tags.getInterface()->getNfcidLen(), 4);
+    TEST_CHECK(t.tags.getInterface()->getNfcidBuf() == sensb->pupi);
+    TEST_EQ(rf->activation.type, NCI_DISCOVERY_TYPE_POLL_B);
+    TEST_EQ(attrib->mbli, 0);
+    TEST_EQ(attrib->cid, 0);
+    TEST_EQ(attrib->hlr_len, 0);
+    TEST_EQ(rf->activation.fsc, 256);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(7));
+    TEST_EQ(rf->activation.sfgt, 0);
+
+    TEST_EQ(t.tags.cmdReadNdef(buf, sizeof(buf)), TAGS_STATUS_OK);
+    TEST_CHECK(t.run(TAGS_EVT_NDEF, 1));
+    TEST_EQ(t.app.status[TAGS_EVT_NDEF], TAGS_STATUS_OK);
+    TEST_EQ(t.app.ndef.len, 100);
+
+    // protocol info with SFGI, ATTRIB response with MBLI, CID and
+    // higher layer response
+    tag.sensb[0] = 12;
+    tag.sensb[12] = 0x50;
+    tag.sensb_len = 13;
+    memcpy(tag.attrib, "\x04\x21\xB1\xB2\xB3", 5);
+    tag.attrib_len = 5;
+    rf = reactivate(t);
+    TEST_EQ(sensb->prot_info_len, 4);
+    TEST_EQ(rf->activation.sfgt, ISO_DEP_TIME(5));
+    TEST_EQ(attrib->mbli, 2);
+    TEST_EQ(attrib->cid, 1);
+    TEST_EQ(attrib->hlr_len, 3);
+    TEST_CHECK(memcmp(attrib->hlr, "\xB1\xB2\xB3", 3) == 0);
+}
+
+// SENSB_RES and ATTRIB response cut short, the fields missing cleared
+// and the capabilities read as their defaults
+static void testPollBTruncated(void)
+{
+    NfcTest t;
+    NfcSimType4 tag(255, 16, NCI_DISCOVERY_TYPE_POLL_B);
+    tNCI_RF_INTF *rf;
+    tNCI_RF_PARAMS_PB *sensb;
+    tNCI_ACT_PARAMS_PB *attrib;
+
+    // length beyond the parameters, within the application data
+    tag.sensb_len = 7;
+    memcpy(tag.attrib, "\x04\x21\xB1\xB2\xB3", 5);
+    tag.attrib_len = 3;
+    TEST_CHECK(t.start(&tag, TAGS_TECH_B));
+    rf = t.tags.getInterface()->getRfIntf();
+    sensb = &rf->specific.params.poll_b;
+    attrib = &rf->activation.params.poll_b;
+    TEST_CHECK(memcmp(sensb->pupi, "\x00\x00\x00\x00", 4) == 0);
+    TEST_EQ(sensb->prot_info_len, 0);
+    TEST_EQ(rf->activation.fsc, 32);
+    TEST_EQ(rf->activation.fwt, ISO_DEP_TIME(4));
+    TEST_EQ(attrib->mbli, 2);
+    TEST_EQ(attrib->cid, 1);
+    TEST_EQ(attrib->hlr_len, 1);
+    TEST_EQ(attrib->hlr[0], 0xB1);
+
+    // protocol info of a single byte
+    tag.sensb[0] = 9;
+    tag.sensb_len = 10;
+    rf = reactivate(t);
+    TEST_CHECK(memcmp(sensb->pupi, "\x0B\x01\x02\x03", 4) == 0);
+    TEST_EQ(sensb->prot_info_len, 1);
+    TEST_EQ(rf->activation.fsc, 32);
+
+    // empty ATTRIB response
+    tag.attrib[0] = 0;
+    tag.attrib_len = 1;
+    rf = reactivate(t);
+    TEST_EQ(attrib->mbli, 0);
+    TEST_EQ(attrib->cid, 0);
+    TEST_EQ(attrib->hlr_len, 0);
+}
+
+int main(void)
+{
+    testExtendedApdu();
+    testApduOverflow();
+
+    testNdefChunks(0x1000, 0, 3000);
+    testNdefChunks(0x1000, 1000, 1000);
+    testNdefChunks(0x1000, 200, 200);
+    testNdefChunks(255, 1000, 255);
+
+    // CC: version 3.0, no read access, MLe 0
+    testNdefError(2, 0x30, false, sizeof(buf), TAGS_STATUS_FAILED);
+    testNdefError(13, 0xFF, false, sizeof(buf), TAGS_STATUS_FAILED);
+    testNdefError(3, 0x00, false, sizeof(buf), TAGS_STATUS_OK);
+    testNdefError(4, 0x00, false, sizeof(buf), TAGS_STATUS_FAILED);
+    // NLEN: larger than the file, than the buffer, empty message
+    testNdefError(0, 0xFF, true, sizeof(buf), TAGS_STATUS_FAILED);
+    testNdefError(1, 100, true, 50, TAGS_STATUS_FAILED);
+    testNdefError(1, 0, true, sizeof(buf), TAGS_STATUS_OK);
+
+    testAts();
+    testAtsTruncated();
+    testPollB();
+    testPollBTruncated();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,56 @@
+/*
+ * TestType5.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Type 5 Read Multiple Blocks sized after the maximum payload of the
+// connection, whatever its size.
+
+#include "NfcTest.h"
+
+// 64 blocks dumped, blocks per Read Multiple Blocks, none when a
+// single block fits
+static void testReadSize(uint8_t max_payload, uint8_t block_size, uint32_t blocks)
+{
+    NfcTest t;
+    NfcSimType5 tag(64, block_size, 64);
+
+    t.ctrl.config.max_payload = max_payload;
+    TEST_CHECK(t.start(&tag));
+
+    TEST_EQ(t.tags.cmdDump(), TAGS_STATUS_OK);
+    while (!t.app.done && t.run(TAGS_EVT_DUMP, t.app.count[TAGS_EVT_DUMP] + 1)) {
+        ;
+    }
+    TEST_EQ(t.app.status[TAGS_EVT_DUMP], TAGS_STATUS_OK);
+    TEST_EQ(t.app.dump_len, tag.size);
+    TEST_CHECK(memcmp(t.app.dump, tag.mem, tag.size) == 0);
+    TEST_EQ(tag.max_blocks, blocks);
+}
+
+int main(void)
+{
+    // 0 bounded by the NCI buffers of the build, the response is
+    // 2 bytes and the blocks
+    testReadSize(0, 4, (TEST_PAYLOAD(0) - 2) / 4);
+    testReadSize(58, 4, 14);
+    testReadSize(58, 16, 3);
+    testReadSize(34, 32, 0);
+
+    return TEST_RESULT();
+}
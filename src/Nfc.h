@@ -25,8 +25,16 @@
 
 #include "log/NfcLog.h"
 #include "hw/NfcHw.h"
+#include "hw/NfcI2c.h"
+#include "hw/NfcI2c_wire.h"
 #include "hw/NfcHw_pn7120.h"
+#include "hw/NfcHw_spi.h"
+#include "hw/NfcHw_uart.h"
 #include "nci/NfcNci.h"
 #include "tags/NfcTags.h"
+#include "tags/NfcReaders.h"
+#include "tags/NfcTagsJobs.h"
+#include "tags/NfcTagsCo.h"
+#include "ndef/NfcNdef.h"
 
 #endif /* __NFC_H__ */
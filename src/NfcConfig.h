@@ -0,0 +1,112 @@
+/*
+ * NfcConfig.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_CONFIG_H__
+#define __NFC_CONFIG_H__
+
+// Features built, all by default. Small boards define those they do
+// not need to 0 at build time, e.g. -DNFC_CONFIG_TAG_TYPE1=0, so that
+// their code and tables are left out of the image.
+
+// tag types handled by NfcTags
+#ifndef NFC_CONFIG_TAG_TYPE1
+#define NFC_CONFIG_TAG_TYPE1    1   // Topaz
+#endif
+#ifndef NFC_CONFIG_TAG_TYPE2
+#define NFC_CONFIG_TAG_TYPE2    1   // Ultralight, NTAG
+#endif
+#ifndef NFC_CONFIG_TAG_TYPE3
+#define NFC_CONFIG_TAG_TYPE3    1   // FeliCa
+#endif
+#ifndef NFC_CONFIG_TAG_TYPE4
+#define NFC_CONFIG_TAG_TYPE4    1   // ISO-DEP
+#endif
+#ifndef NFC_CONFIG_TAG_TYPE5
+#define NFC_CONFIG_TAG_TYPE5    1   // ISO 15693
+#endif
+#ifndef NFC_CONFIG_TAG_MIFARE
+#define NFC_CONFIG_TAG_MIFARE   1   // Mifare classic
+#endif
+
+#if !NFC_CONFIG_TAG_TYPE1 && !NFC_CONFIG_TAG_TYPE2 && !NFC_CONFIG_TAG_TYPE3 && \
+    !NFC_CONFIG_TAG_TYPE4 && !NFC_CONFIG_TAG_TYPE5 && !NFC_CONFIG_TAG_MIFARE
+#error "NfcConfig: at least one tag type has to be built"
+#endif
+
+// polling technologies and their NCI parameters parsers, those of
+// the tag types built by default. NFC-B only carries ISO-DEP cards.
+#ifndef NFC_CONFIG_TECH_A
+#define NFC_CONFIG_TECH_A       (NFC_CONFIG_TAG_TYPE1 || NFC_CONFIG_TAG_TYPE2 || \
+                                 NFC_CONFIG_TAG_TYPE4 || NFC_CONFIG_TAG_MIFARE)
+#endif
+#ifndef NFC_CONFIG_TECH_B
+#define NFC_CONFIG_TECH_B       NFC_CONFIG_TAG_TYPE4
+#endif
+#ifndef NFC_CONFIG_TECH_F
+#define NFC_CONFIG_TECH_F       NFC_CONFIG_TAG_TYPE3
+#endif
+#ifndef NFC_CONFIG_TECH_V
+#define NFC_CONFIG_TECH_V       NFC_CONFIG_TAG_TYPE5
+#endif
+
+// NCI packet buffers, in bytes, header included. The largest NCI
+// packet (258 bytes) by default; smaller buffers cut the data
+// packets exchanged with the tags, and control packets which do
+// not fit are dropped. The RX buffer has to hold the activation
+// notification of the tags built, 64 bytes are enough for NTAGs.
+// The tag reads are sized after it, down to a single block, which
+// needs 34 bytes for type 3 tags and 37 for type 5 ones; the
+// responses to the APDUs of the application have to fit.
+#ifndef NFC_CONFIG_NCI_RX_SIZE
+#define NFC_CONFIG_NCI_RX_SIZE  258
+#endif
+#ifndef NFC_CONFIG_NCI_TX_SIZE
+#define NFC_CONFIG_NCI_TX_SIZE  258
+#endif
+
+// a single buffer for NCI commands and responses, 0 by default.
+// Data received is then only valid until the next command is
+// sent, which NfcTags and the tag interfaces comply with.
+#ifndef NFC_CONFIG_NCI_SHARED_BUFFER
+#define NFC_CONFIG_NCI_SHARED_BUFFER    0
+#endif
+
+// tag interfaces built in a single storage, 0 by default. The
+// interface of the activated tag is constructed there on each
+// activation: NfcTags then only takes the room of the largest one,
+// and the type 4 and Mifare classic settings apply from the next
+// activation.
+#ifndef NFC_CONFIG_SHARED_INTF
+#define NFC_CONFIG_SHARED_INTF  0
+#endif
+
+// state names printed by debug traces, left
+// out of the traces when not built
+#ifndef NFC_CONFIG_STATE_NAMES
+#define NFC_CONFIG_STATE_NAMES  1
+#endif
+
+#if NFC_CONFIG_STATE_NAMES
+#define NFC_STATE_NAME(names, state)    (names[state])
+#else
+#define NFC_STATE_NAME(names, state)    ""
+#endif
+
+#endif // __NFC_CONFIG_H__
@@ -24,17 +24,51 @@
 #include <Arduino.h>
 #include "log/NfcLog.h"
 
+// default power and reset timings in milliseconds
+#define NFC_HW_TIMING_RESET     10  // VEN low pulse width of a hard reset
+#define NFC_HW_TIMING_BOOT      10  // minimum delay after VEN high
+#define NFC_HW_TIMING_TIMEOUT   100 // maximum wait for the controller to boot
+
+// power and reset timings in milliseconds
+typedef struct
+{
+    uint16_t reset;     // VEN low pulse width of a hard reset
+    uint16_t boot;      // minimum delay after VEN high before first access
+    uint16_t timeout;   // maximum wait for the controller to be ready
+} tNFC_HW_TIMINGS;
+
 class NfcHw
 {
     public:
-        NfcHw(NfcLog& log) : _log(log) {;}
+        NfcHw(NfcLog& log) : _log(log), _boot_time(0)
+        {
+            _timings.reset = NFC_HW_TIMING_RESET;
+            _timings.boot = NFC_HW_TIMING_BOOT;
+            _timings.timeout = NFC_HW_TIMING_TIMEOUT;
+        }
         virtual void init(void) = 0;
-        virtual uint8_t write(uint8_t buf[], uint32_t len) = 0;
-        virtual uint8_t read(uint8_t buf[], uint32_t len) = 0;
+        virtual uint32_t write(uint8_t buf[], uint32_t len) = 0;
+        virtual uint32_t read(uint8_t buf[], uint32_t len) = 0;
         virtual void wait(void) = 0;
+        // non blocking check that the controller has a packet to read
+        virtual bool ready(void) = 0;
+        // switch the controller off (VEN low), its state is lost
+        virtual void powerDown(void) = 0;
+        // switch the controller on (VEN high) and wait for it to boot
+        virtual void powerUp(void) = 0;
+        // hard reset of the controller by toggling VEN
+        virtual void hardReset(void) {powerDown(); delay(_timings.reset); powerUp();}
+        // power and reset timings
+        void setTimings(const tNFC_HW_TIMINGS& timings) {_timings = timings;}
+        const tNFC_HW_TIMINGS& getTimings(void) {return _timings;}
+        // time in microseconds between VEN high and the controller
+        // being ready, as measured during the last power up
+        uint32_t getBootTime(void) {return _boot_time;}
 
     protected:
         NfcLog& _log;
+        tNFC_HW_TIMINGS _timings;
+        uint32_t _boot_time;
 };
 
 #endif /* __NFC_HW__ */
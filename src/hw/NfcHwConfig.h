@@ -0,0 +1,45 @@
+/*
+ * NfcHwConfig.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HW_CONFIG_H__
+#define __NFC_HW_CONFIG_H__
+
+// NFC controller driven by NfcNci, any NfcHw implementation by
+// default. Firmwares with a single controller type define one of
+// the following at build time so that it is called directly, without
+// virtual calls, NfcNci then only accepts that implementation:
+// NFC_CONFIG_HW_PN7120    NfcHw_pn7120 (see NfcI2cConfig.h too)
+// NFC_CONFIG_HW_SPI       NfcHw_spi
+// NFC_CONFIG_HW_UART      NfcHw_uart
+#if defined(NFC_CONFIG_HW_PN7120)
+#include "NfcHw_pn7120.h"
+typedef NfcHw_pn7120 tNFC_HW;
+#elif defined(NFC_CONFIG_HW_SPI)
+#include "NfcHw_spi.h"
+typedef NfcHw_spi tNFC_HW;
+#elif defined(NFC_CONFIG_HW_UART)
+#include "NfcHw_uart.h"
+typedef NfcHw_uart tNFC_HW;
+#else
+#include "NfcHw.h"
+typedef NfcHw tNFC_HW;
+#endif
+
+#endif /* __NFC_HW_CONFIG_H__ */
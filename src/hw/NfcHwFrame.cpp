@@ -0,0 +1,55 @@
+/*
+ * NfcHwFrame.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcHwFrame.h"
+
+// NCI header size and length field offset (see NfcNci.h)
+#define FRAME_HDR_SIZE      3
+#define FRAME_OFFSET_LEN    2
+
+bool NfcHwFrame::received(const uint8_t buf[], uint32_t len)
+{
+    // collect header bytes
+    while (len != 0 && _pos < FRAME_HDR_SIZE) {
+        _hdr[_pos++] = *buf++;
+        len--;
+        if (_pos == FRAME_HDR_SIZE) {
+            _size = FRAME_HDR_SIZE + _hdr[FRAME_OFFSET_LEN];
+        }
+    }
+    _pos += len;
+
+    // check packet completion
+    if (_size != 0 && _pos >= _size) {
+        reset();
+        return true;
+    }
+
+    return false;
+}
+
+uint32_t NfcHwFrame::remaining(void)
+{
+    if (_size == 0) {
+        return FRAME_HDR_SIZE - _pos;
+    }
+
+    return _size - _pos;
+}
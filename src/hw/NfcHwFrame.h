@@ -0,0 +1,52 @@
+/*
+ * NfcHwFrame.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HW_FRAME_H__
+#define __NFC_HW_FRAME_H__
+
+#include <Arduino.h>
+
+// NCI packet framing for stream transports (SPI, UART) which, unlike
+// I2C, have to know where a packet ends. Bytes are accounted as they
+// are received: the packet size is known once its 3 byte header is
+// received (payload length at offset 2). No hardware access is done
+// here so that the framing can be exercised on a host.
+class NfcHwFrame
+{
+    public:
+        NfcHwFrame(void) {reset();}
+        // forget the packet in progress
+        void reset(void) {_pos = 0; _size = 0;}
+        // true when no packet is in progress
+        bool idle(void) {return _pos == 0;}
+        // account for received bytes, returns true when they
+        // complete the packet in progress
+        bool received(const uint8_t buf[], uint32_t len);
+        // bytes still expected for the packet in progress,
+        // the header size when the header is not complete
+        uint32_t remaining(void);
+
+    private:
+        uint16_t _pos;      // bytes received in the packet
+        uint16_t _size;     // packet size, 0 until header is received
+        uint8_t _hdr[3];    // packet header
+};
+
+#endif /* __NFC_HW_FRAME_H__ */
@@ -18,7 +18,6 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-#include <Wire.h>
 #include "NfcHw_pn7120.h"
 
 void NfcHw_pn7120::init(void)
@@ -27,55 +26,83 @@ void NfcHw_pn7120::init(void)
     pinMode(_irq, INPUT);
     pinMode(_reset, OUTPUT);
 
-    // VEN (reset) has to be HIGH
-    digitalWrite(_reset, HIGH);
-    delay(10);
-
     // join i2c bus
-    Wire.begin();
+    _i2c.begin();
+
+    // hard reset, VEN (reset) is left HIGH
+    hardReset();
 }
 
-uint8_t NfcHw_pn7120::write(uint8_t buf[], uint32_t len)
+void NfcHw_pn7120::powerDown(void)
 {
-    uint32_t written = 0;
+    // VEN LOW switches the controller off
+    digitalWrite(_reset, LOW);
+}
 
-    // print buffer
-    _log.bv("NCI_TX: ", buf, len);
+void NfcHw_pn7120::powerUp(void)
+{
+    uint32_t start, elapsed;
+    bool ready;
+
+    // VEN HIGH boots the controller
+    digitalWrite(_reset, HIGH);
+    start = micros();
 
-    // i2c transfer starts with slave address (7 upper bytes only),
-    // then transmit the NCI packet
-    Wire.beginTransmission(_address);
-    while (len--) {
-        Wire.write(*buf++);
-        written++;
+    // the controller is ready as soon as it acknowledges its address
+    do {
+        ready = _i2c.probe(_address);
+        elapsed = micros() - start;
+    } while (!ready && elapsed < (uint32_t)_timings.timeout * 1000);
+    _boot_time = elapsed;
+
+    if (!ready) {
+        _log.e("NfcHw_pn7120: controller not ready after %d ms\n", _timings.timeout);
+    }
+    else {
+        _log.d("NfcHw_pn7120: controller ready after %l us\n", elapsed);
     }
-    Wire.endTransmission();
 
-    return written;
+    // honour the minimum boot delay
+    elapsed = micros() - start;
+    if (elapsed < (uint32_t)_timings.boot * 1000) {
+        delay(_timings.boot - elapsed / 1000);
+    }
 }
 
-uint8_t NfcHw_pn7120::read(uint8_t buf[], uint32_t len)
+uint32_t NfcHw_pn7120::write(uint8_t buf[], uint32_t len)
+{
+    // print buffer
+    _log.bv("NCI_TX: ", buf, len);
+
+    // transmit the NCI packet in one i2c transfer
+    return _i2c.write(_address, buf, len);
+}
+
+uint32_t NfcHw_pn7120::read(uint8_t buf[], uint32_t len)
 {
     // wait for response to be ready
     wait();
 
-    // read response
-    Wire.requestFrom(_address, len);
-    do {
-        *buf++ = Wire.read();
-    } while (Wire.available());
+    // read response in one i2c transfer
+    len = _i2c.read(_address, buf, len);
 
     // print response
-    _log.bv("NCI_RX: ", (uint8_t *)(buf-len), len);
+    _log.bv("NCI_RX: ", buf, len);
 
     return len;
 }
 
+bool NfcHw_pn7120::ready(void)
+{
+    return digitalRead(_irq);
+}
+
 void NfcHw_pn7120::wait(void)
 {
-    /* poll irq */
+    /* poll irq, without sleeping so that the response
+     * is read as soon as the controller raises it */
     while (!digitalRead(_irq)) {
-        delay(10);
+        yield();
     }
 }
 
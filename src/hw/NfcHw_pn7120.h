@@ -24,18 +24,23 @@
 #include <Arduino.h>
 #include "log/NfcLog.h"
 #include "NfcHw.h"
+#include "NfcI2cConfig.h"
 
-class NfcHw_pn7120 : public NfcHw
+class NfcHw_pn7120 final : public NfcHw
 {
     public:
-        NfcHw_pn7120(NfcLog& log, uint8_t irq, uint8_t reset, uint8_t address) :
-            NfcHw(log), _irq(irq), _reset(reset), _address(address) {;}
+        NfcHw_pn7120(NfcLog& log, tNFC_I2C& i2c, uint8_t irq, uint8_t reset, uint8_t address) :
+            NfcHw(log), _i2c(i2c), _irq(irq), _reset(reset), _address(address) {;}
         void init(void);
-        uint8_t write(uint8_t buf[], uint32_t len);
-        uint8_t read(uint8_t buf[], uint32_t len);
+        uint32_t write(uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t buf[], uint32_t len);
         void wait(void);
+        bool ready(void);
+        void powerDown(void);
+        void powerUp(void);
 
     private:
+        tNFC_I2C& _i2c;
         uint8_t _irq;
         uint8_t _reset;
         uint8_t _address;
@@ -0,0 +1,123 @@
+/*
+ * NfcHw_spi.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcHw_spi.h"
+
+void NfcHw_spi::init(void)
+{
+    // initialize chip select, interrupt and reset lines
+    pinMode(_cs, OUTPUT);
+    digitalWrite(_cs, HIGH);
+    pinMode(_irq, INPUT);
+    pinMode(_reset, OUTPUT);
+
+    // join spi bus
+    _spi.begin();
+
+    // hard reset, VEN (reset) is left HIGH
+    hardReset();
+}
+
+void NfcHw_spi::powerDown(void)
+{
+    // VEN LOW switches the controller off
+    digitalWrite(_reset, LOW);
+    _frame.reset();
+}
+
+void NfcHw_spi::powerUp(void)
+{
+    uint32_t start;
+
+    // VEN HIGH boots the controller, which cannot be probed over SPI
+    digitalWrite(_reset, HIGH);
+    start = micros();
+    delay(_timings.boot);
+    _boot_time = micros() - start;
+}
+
+void NfcHw_spi::select(void)
+{
+    _spi.beginTransaction(_settings);
+    digitalWrite(_cs, LOW);
+}
+
+void NfcHw_spi::deselect(void)
+{
+    digitalWrite(_cs, HIGH);
+    _spi.endTransaction();
+}
+
+uint32_t NfcHw_spi::write(uint8_t buf[], uint32_t len)
+{
+    uint32_t i;
+
+    // print buffer
+    _log.bv("NCI_TX: ", buf, len);
+
+    // direction byte then the NCI packet, byte per byte
+    // as a bulk transfer would overwrite the buffer
+    select();
+    _spi.transfer(NFC_SPI_HDR_WRITE);
+    for (i = 0; i < len; i++) {
+        _spi.transfer(buf[i]);
+    }
+    deselect();
+
+    return len;
+}
+
+uint32_t NfcHw_spi::read(uint8_t buf[], uint32_t len)
+{
+    // start of packet: wait for it then send direction byte
+    if (_frame.idle()) {
+        wait();
+        select();
+        _spi.transfer(NFC_SPI_HDR_READ);
+    }
+
+    // clock the bytes in, in place
+    memset(buf, 0, len);
+    _spi.transfer(buf, len);
+
+    // release the bus once the packet is complete
+    if (_frame.received(buf, len)) {
+        deselect();
+    }
+
+    // print response
+    _log.bv("NCI_RX: ", buf, len);
+
+    return len;
+}
+
+bool NfcHw_spi::ready(void)
+{
+    // a packet in progress is still to be read
+    return !_frame.idle() || digitalRead(_irq);
+}
+
+void NfcHw_spi::wait(void)
+{
+    /* poll irq */
+    while (!digitalRead(_irq)) {
+        yield();
+    }
+}
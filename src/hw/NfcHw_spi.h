@@ -0,0 +1,70 @@
+/*
+ * NfcHw_spi.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HW_SPI_H__
+#define __NFC_HW_SPI_H__
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "log/NfcLog.h"
+#include "NfcHw.h"
+#include "NfcHwFrame.h"
+
+// SPI clock, up to 7 MHz for NXP PN7160
+#define NFC_SPI_CLOCK           7000000
+
+// SPI direction byte sent ahead of each transfer
+#define NFC_SPI_HDR_WRITE       0x7F
+#define NFC_SPI_HDR_READ        0xFF
+
+// NFC controller wired over SPI + IRQ + RESET (VEN), as NXP PN7160.
+// A packet is read within a single chip select assertion, which is
+// kept low between the header and payload reads of NfcNci.
+// SPI gives no way to probe the controller, the boot time is the
+// minimum boot delay.
+class NfcHw_spi final : public NfcHw
+{
+    public:
+        NfcHw_spi(NfcLog& log, SPIClass& spi, uint8_t cs, uint8_t irq, uint8_t reset,
+                  uint32_t clock = NFC_SPI_CLOCK) :
+            NfcHw(log), _spi(spi), _settings(clock, MSBFIRST, SPI_MODE0),
+            _cs(cs), _irq(irq), _reset(reset) {;}
+        void init(void);
+        uint32_t write(uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t buf[], uint32_t len);
+        void wait(void);
+        bool ready(void);
+        void powerDown(void);
+        void powerUp(void);
+
+    private:
+        void select(void);
+        void deselect(void);
+
+    private:
+        SPIClass& _spi;
+        SPISettings _settings;
+        NfcHwFrame _frame;
+        uint8_t _cs;
+        uint8_t _irq;
+        uint8_t _reset;
+};
+
+#endif /* __NFC_HW_SPI_H__ */
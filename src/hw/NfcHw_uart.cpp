@@ -0,0 +1,108 @@
+/*
+ * NfcHw_uart.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcHw_uart.h"
+
+void NfcHw_uart::init(void)
+{
+    // initialize reset line
+    pinMode(_reset, OUTPUT);
+
+    // open uart, reads time out as the controller
+    _serial.begin(_baud);
+    _serial.setTimeout(_timings.timeout);
+
+    // hard reset, VEN (reset) is left HIGH
+    hardReset();
+}
+
+void NfcHw_uart::powerDown(void)
+{
+    // VEN LOW switches the controller off
+    digitalWrite(_reset, LOW);
+}
+
+void NfcHw_uart::powerUp(void)
+{
+    uint32_t start;
+
+    // VEN HIGH boots the controller, which cannot be probed over UART
+    digitalWrite(_reset, HIGH);
+    start = micros();
+    delay(_timings.boot);
+    _boot_time = micros() - start;
+
+    // drop any noise received while booting
+    flush();
+}
+
+void NfcHw_uart::flush(void)
+{
+    while (_serial.available()) {
+        _serial.read();
+    }
+    _frame.reset();
+}
+
+uint32_t NfcHw_uart::write(uint8_t buf[], uint32_t len)
+{
+    // print buffer
+    _log.bv("NCI_TX: ", buf, len);
+
+    // transmit the NCI packet at once
+    return _serial.write(buf, len);
+}
+
+uint32_t NfcHw_uart::read(uint8_t buf[], uint32_t len)
+{
+    uint32_t received;
+
+    // start of packet: wait for it
+    if (_frame.idle()) {
+        wait();
+    }
+
+    // read response
+    received = _serial.readBytes(buf, len);
+    if (received != len) {
+        _log.e("NfcHw_uart: read timeout %d/%d\n", received, len);
+        flush();
+        return 0;
+    }
+    _frame.received(buf, len);
+
+    // print response
+    _log.bv("NCI_RX: ", buf, len);
+
+    return len;
+}
+
+bool NfcHw_uart::ready(void)
+{
+    return _serial.available();
+}
+
+void NfcHw_uart::wait(void)
+{
+    /* poll rx */
+    while (!_serial.available()) {
+        yield();
+    }
+}
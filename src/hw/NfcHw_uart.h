@@ -0,0 +1,62 @@
+/*
+ * NfcHw_uart.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_HW_UART_H__
+#define __NFC_HW_UART_H__
+
+#include <Arduino.h>
+#include "log/NfcLog.h"
+#include "NfcHw.h"
+#include "NfcHwFrame.h"
+
+// high speed UART default baud rate
+#define NFC_UART_BAUD           921600
+
+// NFC controller wired over high speed UART (HSU) + RESET (VEN).
+// NCI packets are sent as is on the UART, the end of a packet is
+// given by its header. Reads time out after the controller timeout
+// and the rest of a broken packet is dropped.
+// UART gives no way to probe the controller, the boot time is the
+// minimum boot delay.
+class NfcHw_uart final : public NfcHw
+{
+    public:
+        NfcHw_uart(NfcLog& log, HardwareSerial& serial, uint8_t reset,
+                   uint32_t baud = NFC_UART_BAUD) :
+            NfcHw(log), _serial(serial), _baud(baud), _reset(reset) {;}
+        void init(void);
+        uint32_t write(uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t buf[], uint32_t len);
+        void wait(void);
+        bool ready(void);
+        void powerDown(void);
+        void powerUp(void);
+
+    private:
+        void flush(void);
+
+    private:
+        HardwareSerial& _serial;
+        NfcHwFrame _frame;
+        uint32_t _baud;
+        uint8_t _reset;
+};
+
+#endif /* __NFC_HW_UART_H__ */
@@ -0,0 +1,49 @@
+/*
+ * NfcI2c.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_I2C_H__
+#define __NFC_I2C_H__
+
+#include <Arduino.h>
+
+// I2C bus clock definitions
+#define NFC_I2C_CLOCK_STANDARD  100000  // Standard-mode
+#define NFC_I2C_CLOCK_FAST      400000  // Fast-mode
+
+// I2C bus interface used by the NFC controller hardware objects.
+// Each transfer moves a whole buffer so that backends can rely on
+// bulk or DMA transfers instead of byte per byte accesses.
+class NfcI2c
+{
+    public:
+        NfcI2c(void) {;}
+        // join the bus as master
+        virtual void begin(void) = 0;
+        // write a buffer to the slave in one transfer,
+        // returns the number of bytes written
+        virtual uint32_t write(uint8_t address, const uint8_t buf[], uint32_t len) = 0;
+        // read a buffer from the slave in one transfer,
+        // returns the number of bytes read
+        virtual uint32_t read(uint8_t address, uint8_t buf[], uint32_t len) = 0;
+        // check that the slave acknowledges its address
+        virtual bool probe(uint8_t address) = 0;
+};
+
+#endif /* __NFC_I2C_H__ */
@@ -0,0 +1,40 @@
+/*
+ * NfcI2cConfig.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_I2C_CONFIG_H__
+#define __NFC_I2C_CONFIG_H__
+
+// I2C bus driven by NfcHw_pn7120, any NfcI2c implementation by
+// default. Firmwares with a single bus define one of the following
+// at build time so that it is called directly, without virtual calls:
+// NFC_CONFIG_I2C_WIRE     NfcI2c_wire
+// NFC_CONFIG_I2C_LOOPBACK NfcI2c_loopback
+#if defined(NFC_CONFIG_I2C_WIRE)
+#include "NfcI2c_wire.h"
+typedef NfcI2c_wire tNFC_I2C;
+#elif defined(NFC_CONFIG_I2C_LOOPBACK)
+#include "NfcI2c_loopback.h"
+typedef NfcI2c_loopback tNFC_I2C;
+#else
+#include "NfcI2c.h"
+typedef NfcI2c tNFC_I2C;
+#endif
+
+#endif /* __NFC_I2C_CONFIG_H__ */
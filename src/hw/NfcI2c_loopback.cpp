@@ -0,0 +1,61 @@
+/*
+ * NfcI2c_loopback.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcI2c_loopback.h"
+
+uint32_t NfcI2c_loopback::write(uint8_t address, const uint8_t buf[], uint32_t len)
+{
+    if (len > sizeof(_tx_buf)) {
+        len = sizeof(_tx_buf);
+    }
+    memcpy(_tx_buf, buf, len);
+    _tx_len = len;
+
+    return len;
+}
+
+uint32_t NfcI2c_loopback::read(uint8_t address, uint8_t buf[], uint32_t len)
+{
+    if (len > available()) {
+        len = available();
+    }
+    memcpy(buf, &_rx_buf[_rx_pos], len);
+    _rx_pos += len;
+
+    return len;
+}
+
+uint32_t NfcI2c_loopback::feed(const uint8_t buf[], uint32_t len)
+{
+    // drop bytes already read
+    if (_rx_pos != 0) {
+        memmove(_rx_buf, &_rx_buf[_rx_pos], available());
+        _rx_len -= _rx_pos;
+        _rx_pos = 0;
+    }
+
+    if (len > sizeof(_rx_buf) - _rx_len) {
+        len = sizeof(_rx_buf) - _rx_len;
+    }
+    memcpy(&_rx_buf[_rx_len], buf, len);
+    _rx_len += len;
+
+    return len;
+}
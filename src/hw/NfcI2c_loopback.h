@@ -0,0 +1,60 @@
+/*
+ * NfcI2c_loopback.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_I2C_LOOPBACK_H__
+#define __NFC_I2C_LOOPBACK_H__
+
+#include <Arduino.h>
+#include "NfcI2c.h"
+
+// loopback buffer size, one NCI packet
+#define NFC_I2C_LOOPBACK_SIZE   258
+
+// I2C bus implementation without hardware, for host side runs:
+// written buffers are kept for inspection and reads are served
+// from bytes previously fed as if sent by the slave
+class NfcI2c_loopback final : public NfcI2c
+{
+    public:
+        NfcI2c_loopback(void) : _tx_len(0), _rx_len(0), _rx_pos(0) {;}
+        void begin(void) {;}
+        uint32_t write(uint8_t address, const uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t address, uint8_t buf[], uint32_t len);
+        bool probe(uint8_t address) {return true;}
+
+    // loopback control
+    public:
+        // queue bytes to be returned by the next reads
+        uint32_t feed(const uint8_t buf[], uint32_t len);
+        // number of fed bytes not read yet
+        uint32_t available(void) {return _rx_len - _rx_pos;}
+        // last written buffer
+        const uint8_t* getTxBuf(void) {return _tx_buf;}
+        uint32_t getTxLen(void) {return _tx_len;}
+
+    private:
+        uint8_t _tx_buf[NFC_I2C_LOOPBACK_SIZE];
+        uint8_t _rx_buf[NFC_I2C_LOOPBACK_SIZE];
+        uint32_t _tx_len;
+        uint32_t _rx_len;
+        uint32_t _rx_pos;
+};
+
+#endif /* __NFC_I2C_LOOPBACK_H__ */
@@ -0,0 +1,68 @@
+/*
+ * NfcI2c_wire.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcI2c_wire.h"
+
+void NfcI2c_wire::begin(void)
+{
+    // join i2c bus, then switch clock
+    _wire.begin();
+    _wire.setClock(_clock);
+}
+
+uint32_t NfcI2c_wire::write(uint8_t address, const uint8_t buf[], uint32_t len)
+{
+    uint32_t written;
+
+    // i2c transfer starts with slave address (7 upper bytes only),
+    // then the whole buffer is queued at once
+    _wire.beginTransmission(address);
+    written = _wire.write(buf, len);
+    if (_wire.endTransmission() != 0) {
+        written = 0;
+    }
+
+    return written;
+}
+
+uint32_t NfcI2c_wire::read(uint8_t address, uint8_t buf[], uint32_t len)
+{
+    uint32_t received;
+
+    // a larger request would be truncated, nothing is read
+    if (len > NFC_I2C_WIRE_READ_MAX) {
+        return 0;
+    }
+
+    // request then drain the receive buffer at once
+    received = _wire.requestFrom(address, (uint8_t)len);
+    if (received > len) {
+        received = len;
+    }
+
+    return _wire.readBytes(buf, received);
+}
+
+bool NfcI2c_wire::probe(uint8_t address)
+{
+    // empty write, acknowledged only if the slave is alive
+    _wire.beginTransmission(address);
+    return _wire.endTransmission() == 0;
+}
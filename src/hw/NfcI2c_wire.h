@@ -0,0 +1,50 @@
+/*
+ * NfcI2c_wire.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_I2C_WIRE_H__
+#define __NFC_I2C_WIRE_H__
+
+#include <Arduino.h>
+#include <Wire.h>
+#include "NfcI2c.h"
+
+// largest read, TwoWire::requestFrom() counts bytes on 8 bits
+#define NFC_I2C_WIRE_READ_MAX   255
+
+// I2C bus implementation on top of an Arduino TwoWire object
+// (Wire, Wire1, etc.) running at the requested clock, reads larger
+// than NFC_I2C_WIRE_READ_MAX are rejected, NCI header and payload
+// are read apart
+class NfcI2c_wire final : public NfcI2c
+{
+    public:
+        NfcI2c_wire(TwoWire& wire, uint32_t clock = NFC_I2C_CLOCK_FAST) :
+            _wire(wire), _clock(clock) {;}
+        void begin(void);
+        uint32_t write(uint8_t address, const uint8_t buf[], uint32_t len);
+        uint32_t read(uint8_t address, uint8_t buf[], uint32_t len);
+        bool probe(uint8_t address);
+
+    private:
+        TwoWire& _wire;
+        uint32_t _clock;
+};
+
+#endif /* __NFC_I2C_WIRE_H__ */
@@ -0,0 +1,58 @@
+/*
+ * NfcDelegate.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_DELEGATE_H__
+#define __NFC_DELEGATE_H__
+
+#include <Arduino.h>
+
+// Callback delegate bound to an object member function with the
+// callback signature, e.g. to subscribe to a single NCI or tags
+// event: NfcDelegate::bind<App, &App::cbDump>(&app). It only holds
+// the object and a stub calling the member, copied by value and
+// never allocated, a call costs one indirect call. A delegate not
+// bound is a no-op.
+class NfcDelegate
+{
+    public:
+        NfcDelegate(void) : _p_obj(NULL), _p_stub(&nop) {;}
+        template <class T, void (T::*M)(uint8_t, uint16_t, void *)>
+        static NfcDelegate bind(T *p_obj) {return NfcDelegate(p_obj, &stub<T, M>);}
+        bool isBound(void) const {return _p_stub != &nop;}
+        void operator()(uint8_t status, uint16_t id, void *data) const {_p_stub(_p_obj, status, id, data);}
+
+    private:
+        typedef void (*tSTUB)(void *p_obj, uint8_t status, uint16_t id, void *data);
+        NfcDelegate(void *p_obj, tSTUB p_stub) : _p_obj(p_obj), _p_stub(p_stub) {;}
+        template <class T, void (T::*M)(uint8_t, uint16_t, void *)>
+        static void stub(void *p_obj, uint8_t status, uint16_t id, void *data)
+                        {(static_cast<T *>(p_obj)->*M)(status, id, data);}
+        static void nop(void *p_obj, uint8_t status, uint16_t id, void *data) {;}
+
+    private:
+        void *_p_obj;               // bound object
+        tSTUB _p_stub;              // calls its member function
+};
+
+// two pointers, nothing to free: binding can not allocate
+static_assert(sizeof(NfcDelegate) == sizeof(void *) + sizeof(void (*)(void)), "NfcDelegate has to hold two pointers");
+static_assert(__is_trivially_copyable(NfcDelegate), "NfcDelegate has to be trivially copyable");
+
+#endif // __NFC_DELEGATE_H__
@@ -20,19 +20,76 @@
 
 #include "NfcNci.h"
 
+#if NFC_CONFIG_NCI_SHARED_BUFFER
+#define getRxBuffer()       (_buf)
+#define getTxBuffer()       (_buf)
+#else
 #define getRxBuffer()       (_rx_buf)
 #define getTxBuffer()       (_tx_buf)
+#endif
 
-NfcNci::NfcNci(NfcLog& log, NfcHw& hw) :
-        _state(NCI_STATE_NONE), _log(log), _hw(hw)
+NfcNci::NfcNci(NfcLog& log, tNFC_HW& hw) :
+        _state(NCI_STATE_NONE), _busy(false), _credits(0), _log(log), _hw(hw)
 {
-    _cb = NULL;
     _data = NULL;
+    _tx_data = NULL;
+    _tx_left = 0;
+    _tx_pending = false;
+}
+
+void NfcNci::notify(uint8_t event, uint8_t status, uint16_t id, void *data)
+{
+    // queued, the callback is called once the packet is processed
+    if (!_queue.push(event, status, id, data)) {
+        _log.e("NCI error: event queue full, event %d dropped\n", event);
+    }
+}
+
+void NfcNci::init(NfcNciCb *cb)
+{
+    _cbs[NCI_EVT_CORE_RESET] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbCoreReset>(cb);
+    _cbs[NCI_EVT_CORE_INIT] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbCoreInit>(cb);
+    _cbs[NCI_EVT_RF_DISCOVER_MAP] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbRfDiscoverMap>(cb);
+    _cbs[NCI_EVT_RF_DISCOVER] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbRfDiscover>(cb);
+    _cbs[NCI_EVT_RF_DISCOVER_NTF] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbRfDiscoverNtf>(cb);
+    _cbs[NCI_EVT_RF_DEACTIVATE] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbRfDeactivate>(cb);
+    _cbs[NCI_EVT_RF_DEACTIVATE_NTF] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbRfDeactivateNtf>(cb);
+    _cbs[NCI_EVT_DATA] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbData>(cb);
+    _cbs[NCI_EVT_ERROR] = NfcDelegate::bind<NfcNciCb, &NfcNciCb::cbError>(cb);
+}
+
+bool NfcNci::dispatchEvent(void)
+{
+    tNCI_EVENT evt;
+
+    if (!_queue.pop(&evt)) {
+        return false;
+    }
+
+    // unknown events are reported as errors, events
+    // nobody subscribed to are dropped
+    if (evt.event >= NCI_EVT_NUM) {
+        evt.event = NCI_EVT_ERROR;
+    }
+    _cbs[evt.event](evt.status, evt.id, evt.data);
+
+    return true;
+}
+
+uint8_t NfcNci::send(uint8_t buf[], uint32_t len)
+{
+    uint8_t status;
+
+    // a response is pending once the packet is sent
+    status = _hw.write(buf, len) == len ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    _busy = (status == NCI_STATUS_OK);
+
+    return status;
 }
 
 uint32_t NfcNci::waitForEvent(uint8_t buf[])
 {
-    uint32_t len, ret;
+    uint32_t len, ret, size;
 
     // read header
     ret = _hw.read(buf, NCI_MSG_HDR_SIZE);
@@ -43,11 +100,27 @@ uint32_t NfcNci::waitForEvent(uint8_t buf[])
     // check length
     len = buf[NCI_OFFSET_LEN];
 
-    // read payload
-    ret = _hw.read(&buf[NCI_MSG_HDR_SIZE], len);
-    if (ret <= 0) {
+    // payload larger than the RX buffer, read and dropped
+    // by pieces, the caller checks the length
+    if (len + NCI_MSG_HDR_SIZE > NCI_RX_BUFFER_SIZE) {
+        ret = len + NCI_MSG_HDR_SIZE;
+        while (len != 0) {
+            size = (len > NCI_RX_BUFFER_SIZE - NCI_MSG_HDR_SIZE) ? NCI_RX_BUFFER_SIZE - NCI_MSG_HDR_SIZE : len;
+            if (_hw.read(&buf[NCI_MSG_HDR_SIZE], size) <= 0) {
+                break;
+            }
+            len -= size;
+        }
         goto end;
     }
+
+    // read payload, if any
+    if (len != 0) {
+        ret = _hw.read(&buf[NCI_MSG_HDR_SIZE], len);
+        if (ret <= 0) {
+            goto end;
+        }
+    }
     ret = len + NCI_MSG_HDR_SIZE;
 
 end:
@@ -55,14 +128,23 @@ end:
 }
 
 void NfcNci::handleEvent(void)
+{
+    // the events point into the RX buffer and the RF interface
+    // parameters, they are dispatched before the next packet
+    receiveEvent();
+    while (dispatchEvent()) {
+        ;
+    }
+}
+
+void NfcNci::receiveEvent(void)
 {
     uint8_t *p, *buf;
     uint8_t mt, pbf, gid, oid;
     uint32_t len;
 
-    // check callback object
-    if (_cb == NULL) {
-        _log.e("NCI error: no callback object registered\n");
+    // no event while the controller is switched off
+    if (_state == NCI_STATE_POWER_DOWN) {
         return;
     }
 
@@ -72,7 +154,7 @@ void NfcNci::handleEvent(void)
     len = waitForEvent(buf);
     if (len <= 0) {
         _log.e("NCI error: null event received\n");
-        _cb->cbError(NCI_STATUS_FAILED, UINT16_ID(mt, oid), NULL);
+        notify(NCI_EVT_ERROR, NCI_STATUS_FAILED, UINT16_ID(mt, oid), NULL);
         return;
     }
 
@@ -81,12 +163,25 @@ void NfcNci::handleEvent(void)
     NCI_MSG_PRS_HDR0(p, mt, pbf, gid);
     NCI_MSG_PRS_HDR1(p, oid);
 
-    // check HDR0
-    // FIXME: segmentation and reassembly message is not handled
-    // FIXME: data packet message not handled
-    if (pbf != NCI_PBF_NO_OR_LAST) {
+    // packet dropped, the pending data response is lost
+    if (len > NCI_RX_BUFFER_SIZE) {
+        _log.e("NCI error: %d bytes packet larger than the RX buffer\n", len);
+        if (mt == NCI_MT_DATA) {
+            _busy = false;
+            _tx_pending = false;
+            notify(NCI_EVT_DATA, NCI_STATUS_FAILED, UINT16_ID(mt, gid), NULL);
+        }
+        else {
+            notify(NCI_EVT_ERROR, NCI_STATUS_FAILED, UINT16_ID(mt, oid), NULL);
+        }
+        return;
+    }
+
+    // check HDR0, data messages may be segmented
+    // FIXME: segmentation of control messages is not handled
+    if (pbf != NCI_PBF_NO_OR_LAST && mt != NCI_MT_DATA) {
         _log.e("NCI error: segmentation and reassembly messages not handled yet\n");
-        _cb->cbError(NCI_STATUS_SYNTAX_ERROR, UINT16_ID(mt, oid), NULL);
+        notify(NCI_EVT_ERROR, NCI_STATUS_SYNTAX_ERROR, UINT16_ID(mt, oid), NULL);
         return;
     }
 
@@ -105,7 +200,7 @@ void NfcNci::handleEvent(void)
             case NCI_GID_EE_MANAGE:
             case NCI_GID_PROP:
             default:
-                _cb->cbError(NCI_STATUS_UNKNOWN_GID, UINT16_ID(mt, oid), NULL);
+                notify(NCI_EVT_ERROR, NCI_STATUS_UNKNOWN_GID, UINT16_ID(mt, oid), NULL);
                 break;
         }
     }
@@ -124,9 +219,11 @@ void NfcNci::handleDataEvent(uint8_t buf[], uint32_t len)
     p++;
 
     // FIXME: check event length = header + data length?
-    // process event
+    // process event, segments are notified as they are received
+    // and the response is pending until the last one
+    _busy = (pbf != NCI_PBF_NO_OR_LAST);
     _data = p;
-    _cb->cbData(NCI_STATUS_OK, UINT16_ID(mt, cid), _data);
+    notify(NCI_EVT_DATA, NCI_STATUS_OK, UINT16_ID(mt, cid) | (_busy ? NCI_DATA_ID_PBF : 0), _data);
 }
 
 void NfcNci::handleCoreEvent(uint8_t buf[], uint32_t len)
@@ -146,18 +243,19 @@ void NfcNci::handleCoreEvent(uint8_t buf[], uint32_t len)
     switch(mt) {
         // response message
         case NCI_MT_RSP:
+            _busy = false;
             switch (oid) {
                 case NCI_MSG_CORE_RESET:
                     status = rspCoreReset(p);
-                    _cb->cbCoreReset(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_CORE_RESET, status, UINT16_ID(mt, oid), _data);
                     break;
                 case NCI_MSG_CORE_INIT:
                     status = rspCoreInit(p);
-                    _cb->cbCoreInit(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_CORE_INIT, status, UINT16_ID(mt, oid), _data);
                     break;
                 default:
                     _log.e("NCI error: unhandled core event oid = %d\n", oid);
-                    _cb->cbError(NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
+                    notify(NCI_EVT_ERROR, NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
                     break;
             }
             break;
@@ -165,12 +263,20 @@ void NfcNci::handleCoreEvent(uint8_t buf[], uint32_t len)
         case NCI_MT_NTF:
             switch(oid) {
                 case NCI_MSG_CORE_CONN_CREDITS:
-                    // FIXME: ignore credits for the moment
-                    // only one request sent at a time
+                    // credits given back, nothing to notify
+                    ntfCoreConnCredits(p);
+                    break;
+                case NCI_MSG_CORE_INTF_ERR_STATUS:
+                    // data exchange failed, e.g. RF timeout, the
+                    // error stands for the pending data response
+                    status = ntfCoreIntfError(p);
+                    _busy = false;
+                    _tx_pending = false;
+                    notify(NCI_EVT_DATA, status, UINT16_ID(mt, oid), NULL);
                     break;
                 default:
                     _log.e("NCI error: unhandled core notification event oid = %d\n", oid);
-                    _cb->cbError(NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
+                    notify(NCI_EVT_ERROR, NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
                     break;
             }
     }
@@ -193,22 +299,23 @@ void NfcNci::handleRfEvent(uint8_t buf[], uint32_t len)
     switch(mt) {
         // response message
         case NCI_MT_RSP:
+            _busy = false;
             switch (oid) {
                 case NCI_MSG_RF_DISCOVER_MAP:
                     status = rspRfDiscoverMap(p);
-                    _cb->cbRfDiscoverMap(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_RF_DISCOVER_MAP, status, UINT16_ID(mt, oid), _data);
                     break;
                 case NCI_MSG_RF_DISCOVER:
                     status = rspRfDiscover(p);
-                    _cb->cbRfDiscover(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_RF_DISCOVER, status, UINT16_ID(mt, oid), _data);
                     break;
                 case NCI_MSG_RF_DEACTIVATE:
                     status = rspRfDeactivate(p);
-                    _cb->cbRfDeactivate(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_RF_DEACTIVATE, status, UINT16_ID(mt, oid), _data);
                     break;
                 default:
                     _log.e("NCI error: unhandled rf event oid = %d\n", oid);
-                    _cb->cbError(NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
+                    notify(NCI_EVT_ERROR, NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
                     break;
             }
             break;
@@ -217,29 +324,62 @@ void NfcNci::handleRfEvent(uint8_t buf[], uint32_t len)
             switch(oid) {
                 case NCI_MSG_RF_INTF_ACTIVATED:
                     status = ntfRfIntfActivated(p);
-                    _cb->cbRfDiscoverNtf(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_RF_DISCOVER_NTF, status, UINT16_ID(mt, oid), _data);
                     break;
                 case NCI_MSG_RF_DEACTIVATE:
                     status = ntfRfDeactivate(p);
-                    _cb->cbRfDeactivateNtf(status, UINT16_ID(mt, oid), _data);
+                    notify(NCI_EVT_RF_DEACTIVATE_NTF, status, UINT16_ID(mt, oid), _data);
                     break;
                 default:
                     _log.e("NCI error: unhandled rf event oid = %d\n", oid);
-                    _cb->cbError(NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
+                    notify(NCI_EVT_ERROR, NCI_STATUS_UNKNOWN_OID, UINT16_ID(mt, oid), NULL);
                     break;
             }
             break;
         default:
             _log.e("NCI error: unhandled rf event mt = %d\n", mt);
-            _cb->cbError(NCI_STATUS_SYNTAX_ERROR, UINT16_ID(mt, oid), NULL);
+            notify(NCI_EVT_ERROR, NCI_STATUS_SYNTAX_ERROR, UINT16_ID(mt, oid), NULL);
             break;
     }
 }
 
+void NfcNci::reset(void)
+{
+    // a controller fresh from power up does not need a hard reset
+    if (_state != NCI_STATE_NONE) {
+        _log.d("NCI: hard reset\n");
+        _hw.hardReset();
+        _state = NCI_STATE_NONE;
+        _busy = false;
+        _tx_pending = false;
+        _queue.clear();
+    }
+}
+
+void NfcNci::powerDown(void)
+{
+    _log.d("NCI: power down\n");
+    _hw.powerDown();
+    _state = NCI_STATE_POWER_DOWN;
+    _busy = false;
+    _tx_pending = false;
+    _queue.clear();
+}
+
+void NfcNci::powerUp(void)
+{
+    _log.d("NCI: power up\n");
+    _hw.powerUp();
+    _state = NCI_STATE_NONE;
+    _busy = false;
+    _tx_pending = false;
+    _queue.clear();
+}
+
 uint8_t NfcNci::cmdCoreReset(uint8_t type)
 {
     uint8_t *p, *buf;
-    uint8_t status, ret;
+    uint8_t status;
 
     // _log NCI message
     _log.d("NCI_CMD: NCI_MSG_CORE_RESET\n");
@@ -269,8 +409,7 @@ uint8_t NfcNci::cmdCoreReset(uint8_t type)
     UINT8_TO_STREAM(p, type);
 
     // send command
-    ret =_hw.write(buf, NCI_MSG_HDR_SIZE + NCI_CORE_PARAM_SIZE_RESET);
-    status = ret == (NCI_MSG_HDR_SIZE + NCI_CORE_PARAM_SIZE_RESET) ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    status = send(buf, NCI_MSG_HDR_SIZE + NCI_CORE_PARAM_SIZE_RESET);
 
 end:
     return status;
@@ -318,7 +457,7 @@ end:
 uint8_t NfcNci::cmdCoreInit(void)
 {
     uint8_t *p, *buf;
-    uint8_t len, ret, status;
+    uint8_t len, status;
 
     // _log NCI message
     _log.d("NCI_CMD: NCI_MSG_CORE_INIT\n");
@@ -340,8 +479,7 @@ uint8_t NfcNci::cmdCoreInit(void)
     UINT8_TO_STREAM(p, NCI_CORE_PARAM_SIZE_INIT);
     
     // send command
-    ret = _hw.write(buf, len);
-    status = ret == len ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    status = send(buf, len);
 
 end:
     return status;
@@ -383,10 +521,67 @@ end:
     return status;
 }
 
-uint8_t NfcNci::cmdRfDiscoverMap(uint8_t num, tNCI_DISCOVER_MAPS *p_maps)
+uint8_t NfcNci::ntfCoreIntfError(uint8_t buf[])
+{
+    uint8_t *p = buf;
+    uint8_t len, status;
+
+    // _log NCI message
+    _log.d("NCI_NTF: NCI_MSG_CORE_INTF_ERR_STATUS\n");
+
+    // check length
+    len = *p++;
+    if (len != NCI_CORE_PARAM_SIZE_INTF_ERR_NTF) {
+        status = NCI_STATUS_SYNTAX_ERROR;
+        goto end;
+    }
+
+    // error status | connection identifier
+    status = *p;
+    if (status == NCI_STATUS_OK) {
+        status = NCI_STATUS_FAILED;
+    }
+
+end:
+    return status;
+}
+
+void NfcNci::ntfCoreConnCredits(uint8_t buf[])
+{
+    uint8_t *p = buf;
+    uint8_t len, num, cid, credits;
+
+    // _log NCI message
+    _log.d("NCI_NTF: NCI_MSG_CORE_CONN_CREDITS\n");
+
+    // check length
+    len = *p++;
+    if (len < NCI_CORE_PARAM_SIZE_CONN_CREDITS_NTF) {
+        return;
+    }
+
+    // number of entries | (connection identifier | credits) * number
+    num = *p++;
+    while (num-- && len >= NCI_CORE_PARAM_SIZE_CONN_CREDITS_NTF) {
+        cid = *p++ & NCI_CID_MASK;
+        credits = *p++;
+        len -= 2;
+        if (cid == NCI_CID_RF_STATIC && _credits != NCI_CREDITS_UNLIMITED) {
+            _credits = (_credits + credits < NCI_CREDITS_UNLIMITED) ?
+                       _credits + credits : NCI_CREDITS_UNLIMITED - 1;
+        }
+    }
+
+    // send the packets waiting for credits, if any
+    if (_tx_pending && sendSegments() != NCI_STATUS_OK) {
+        notify(NCI_EVT_DATA, NCI_STATUS_FAILED, UINT16_ID(NCI_MT_DATA, NCI_CID_RF_STATIC), NULL);
+    }
+}
+
+uint8_t NfcNci::cmdRfDiscoverMap(uint8_t num, const tNCI_DISCOVER_MAPS *p_maps)
 {
     uint8_t *p, *buf, *p_size, *p_start;
-    uint8_t len, status, ret;
+    uint8_t len, status;
 
     // _log NCI message
     _log.d("NCI_CMD: NCI_MSG_RF_DISCOVER_MAP\n");
@@ -423,8 +618,7 @@ uint8_t NfcNci::cmdRfDiscoverMap(uint8_t num, tNCI_DISCOVER_MAPS *p_maps)
     len = NCI_MSG_HDR_SIZE + *p_size;
 
     // send command
-    ret = _hw.write(buf, len);
-    status = ret == len ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    status = send(buf, len);
 
 end:
     return status;
@@ -461,10 +655,10 @@ end:
     return status;
 }
 
-uint8_t NfcNci::cmdRfDiscover(uint8_t num, tNCI_DISCOVER_CONFS *p_confs)
+uint8_t NfcNci::cmdRfDiscover(uint8_t num, const tNCI_DISCOVER_CONFS *p_confs)
 {
     uint8_t *p, *buf, *p_size, *p_start;
-    uint8_t len, status, ret;
+    uint8_t len, status;
 
     // _log NCI message
     _log.d("NCI_CMD: NCI_MSG_RF_DISCOVER\n");
@@ -500,8 +694,7 @@ uint8_t NfcNci::cmdRfDiscover(uint8_t num, tNCI_DISCOVER_CONFS *p_confs)
     len = NCI_MSG_HDR_SIZE + *p_size;
 
     // send command
-    ret = _hw.write(buf, len);
-    status = ret == len ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    status = send(buf, len);
 
 end:
     return status;
@@ -544,9 +737,9 @@ end:
     return status;
 }
 
-void setRfTechSpecParams(uint8_t buf[], tNCI_RF_INTF *p_rf)
+static void setRfTechSpecParams(uint8_t buf[], uint8_t len, tNCI_RF_INTF *p_rf)
 {
-    uint8_t mode, len;
+    uint8_t mode;
 
     mode = p_rf->activation_mode;
     p_rf->specific.type = mode;
@@ -567,12 +760,194 @@ void setRfTechSpecParams(uint8_t buf[], tNCI_RF_INTF *p_rf)
             }
         }
             break;
+#if NFC_CONFIG_TECH_B
+        case NCI_DISCOVERY_TYPE_POLL_B:
+        {
+            tNCI_RF_PARAMS_PB *p_poll_b = &p_rf->specific.params.poll_b;
+            // SENSB_RES without its first byte, protocol info is 3 or
+            // 4 bytes long, left cleared when cut short by the length
+            memset(p_poll_b, 0, sizeof(tNCI_RF_PARAMS_PB));
+            if (*buf < len) {
+                len = *buf;
+            }
+            else {
+                len--;
+            }
+            buf++;
+            if (len < NCI_RF_PB_PUPI_LENGTH + NCI_RF_PB_APP_DATA_LENGTH) {
+                break;
+            }
+            memcpy(p_poll_b->pupi, buf, NCI_RF_PB_PUPI_LENGTH);
+            buf += NCI_RF_PB_PUPI_LENGTH;
+            memcpy(p_poll_b->app_data, buf, NCI_RF_PB_APP_DATA_LENGTH);
+            buf += NCI_RF_PB_APP_DATA_LENGTH;
+            len -= NCI_RF_PB_PUPI_LENGTH + NCI_RF_PB_APP_DATA_LENGTH;
+            if (len > NCI_RF_PB_PROT_INFO_LENGTH) {
+                len = NCI_RF_PB_PROT_INFO_LENGTH;
+            }
+            p_poll_b->prot_info_len = len;
+            memcpy(p_poll_b->prot_info, buf, len);
+        }
+            break;
+#endif
+#if NFC_CONFIG_TECH_F
+        case NCI_DISCOVERY_TYPE_POLL_F:
+        {
+            tNCI_RF_PARAMS_PF *p_poll_f = &p_rf->specific.params.poll_f;
+            p_poll_f->bit_rate = *buf++;
+            len = *buf++;
+            if (len > NCI_RF_PF_SENSF_RES_LENGTH) {
+                len = NCI_RF_PF_SENSF_RES_LENGTH;
+            }
+            p_poll_f->sensf_res_len = len;
+            memcpy(p_poll_f->sensf_res, buf, len);
+        }
+            break;
+#endif
+#if NFC_CONFIG_TECH_V
+        case NCI_DISCOVERY_TYPE_POLL_ISO15693:
+        {
+            tNCI_RF_PARAMS_PV *p_poll_v = &p_rf->specific.params.poll_v;
+            p_poll_v->res_flag = *buf++;
+            p_poll_v->dsfid = *buf++;
+            memcpy(p_poll_v->uid, buf, NCI_RF_PV_UID_LENGTH);
+        }
+            break;
+#endif
         // FIXME: implement other modes
         default:
             break;
     }
 }
 
+#if NFC_CONFIG_TAG_TYPE4
+// ISO 14443-4 definitions
+#define ATS_T0_TA               0x10
+#define ATS_T0_TB               0x20
+#define ATS_T0_TC               0x40
+#define ATS_FSCI_DEFAULT        2       // 32 bytes
+#define ATS_FWI_DEFAULT         4
+#define ATS_TC_DEFAULT          0x02    // CID supported
+#define ISO_DEP_FSCI_MAX        12      // 4096 bytes, above is RFU
+#define ISO_DEP_FSCI_RFU        8       // RFU values read as 256 bytes
+#define ISO_DEP_FWI_MAX         14      // 15 is RFU
+#define PB_PROT_INFO_FSCI       1       // offsets in the protocol info
+#define PB_PROT_INFO_FWI        2
+#define PB_PROT_INFO_SFGI       3
+
+static const uint16_t iso_dep_fsc[] = {16, 24, 32, 40, 48, 64, 96, 128, 256, 512, 1024, 2048, 4096};
+
+// 2^n * 4096 / fc, in us
+static uint32_t getIsoDepTime(uint8_t n)
+{
+    return ((4096UL << n) * 25) / 339;
+}
+
+static void setIsoDepParams(uint8_t fsci, uint8_t fwi, uint8_t sfgi, tNCI_ACT_PARAMS *p_act)
+{
+    if (fsci > ISO_DEP_FSCI_MAX) {
+        fsci = ISO_DEP_FSCI_RFU;
+    }
+    if (fwi > ISO_DEP_FWI_MAX) {
+        fwi = ATS_FWI_DEFAULT;
+    }
+    p_act->fsc = iso_dep_fsc[fsci];
+    p_act->fwt = getIsoDepTime(fwi);
+    p_act->sfgt = (sfgi == 0 || sfgi > ISO_DEP_FWI_MAX) ? 0 : getIsoDepTime(sfgi);
+}
+#endif
+
+static void setRfActivationParams(uint8_t buf[], uint8_t len, tNCI_RF_INTF *p_rf)
+{
+    uint8_t mode;
+#if NFC_CONFIG_TAG_TYPE4
+    uint8_t t0;
+    uint8_t *end;
+#endif
+
+    mode = p_rf->activation_mode;
+    p_rf->activation.type = mode;
+    p_rf->activation.fsc = 0;
+    p_rf->activation.fwt = 0;
+    p_rf->activation.sfgt = 0;
+
+#if NFC_CONFIG_TAG_TYPE4
+    // parameters depend on the RF interface
+    if (len == 0 || p_rf->interface != NCI_INTERFACE_ISO_DEP) {
+        return;
+    }
+
+    // RATS or ATTRIB response length, within the parameters
+    if (*buf < len) {
+        len = *buf;
+    }
+    else {
+        len--;
+    }
+    buf++;
+
+    switch(mode) {
+        case NCI_DISCOVERY_TYPE_POLL_A:
+        {
+            // ATS without its length byte: T0 | [TA] | [TB] | [TC] | historical bytes
+            tNCI_ACT_PARAMS_PA *p_poll_a = &p_rf->activation.params.poll_a;
+            end = buf + len;
+            t0 = len != 0 ? *buf++ : 0;
+            p_poll_a->fsci = len != 0 ? t0 & 0x0F : ATS_FSCI_DEFAULT;
+            p_poll_a->ta = (t0 & ATS_T0_TA) && buf < end ? *buf++ : 0;
+            p_poll_a->fwi = ATS_FWI_DEFAULT;
+            p_poll_a->sfgi = 0;
+            if ((t0 & ATS_T0_TB) && buf < end) {
+                p_poll_a->fwi = *buf >> 4;
+                p_poll_a->sfgi = *buf++ & 0x0F;
+            }
+            p_poll_a->tc = (t0 & ATS_T0_TC) && buf < end ? *buf++ : ATS_TC_DEFAULT;
+            len = buf < end ? end - buf : 0;
+            if (len > NCI_ACT_PA_HIST_LENGTH) {
+                len = NCI_ACT_PA_HIST_LENGTH;
+            }
+            p_poll_a->hist_len = len;
+            memcpy(p_poll_a->hist, buf, len);
+            setIsoDepParams(p_poll_a->fsci, p_poll_a->fwi, p_poll_a->sfgi, &p_rf->activation);
+        }
+            break;
+#if NFC_CONFIG_TECH_B
+        case NCI_DISCOVERY_TYPE_POLL_B:
+        {
+            // ATTRIB response: MBLI | CID | higher layer response, the
+            // card capabilities are in the SENSB_RES protocol info,
+            // the defaults without it
+            tNCI_ACT_PARAMS_PB *p_poll_b = &p_rf->activation.params.poll_b;
+            tNCI_RF_PARAMS_PB *p_sensb = &p_rf->specific.params.poll_b;
+            p_poll_b->mbli = len != 0 ? buf[0] >> 4 : 0;
+            p_poll_b->cid = len != 0 ? buf[0] & 0x0F : 0;
+            len = len > 1 ? len - 1 : 0;
+            if (len > NCI_ACT_PB_HLR_LENGTH) {
+                len = NCI_ACT_PB_HLR_LENGTH;
+            }
+            p_poll_b->hlr_len = len;
+            memcpy(p_poll_b->hlr, &buf[1], len);
+            if (p_rf->specific.type == NCI_DISCOVERY_TYPE_POLL_B &&
+                p_sensb->prot_info_len > PB_PROT_INFO_FWI) {
+                setIsoDepParams(p_sensb->prot_info[PB_PROT_INFO_FSCI] >> 4,
+                                p_sensb->prot_info[PB_PROT_INFO_FWI] >> 4,
+                                p_sensb->prot_info_len > PB_PROT_INFO_SFGI ?
+                                    p_sensb->prot_info[PB_PROT_INFO_SFGI] >> 4 : 0,
+                                &p_rf->activation);
+            }
+            else {
+                setIsoDepParams(ATS_FSCI_DEFAULT, ATS_FWI_DEFAULT, 0, &p_rf->activation);
+            }
+        }
+            break;
+#endif
+        // FIXME: implement other modes
+        default:
+            break;
+    }
+#endif
+}
+
 uint8_t NfcNci::ntfRfIntfActivated(uint8_t buf[])
 {
     uint8_t *p = buf;
@@ -600,18 +975,27 @@ uint8_t NfcNci::ntfRfIntfActivated(uint8_t buf[])
     _rf_intf.protocol = *p++;
     _rf_intf.activation_mode = *p++;
     _rf_intf.max_payload_size = *p++;
+    if (_rf_intf.max_payload_size == 0) {
+        // a maximum payload size of 0 stands for 255 bytes
+        _rf_intf.max_payload_size = 0xFF;
+    }
+    if (_rf_intf.max_payload_size > NCI_PAYLOAD_MAX) {
+        // data packets fit the buffers, both ways
+        _rf_intf.max_payload_size = NCI_PAYLOAD_MAX;
+    }
+    _tx_pending = false;
     _rf_intf.credits = *p++;
+    _credits = _rf_intf.credits;
     len = *p++;
     if (len != 0) {
-        setRfTechSpecParams(p, &_rf_intf);
+        setRfTechSpecParams(p, len, &_rf_intf);
         p += len;
     }
     _rf_intf.exchange_mode = *p++;
     _rf_intf.tx_bitrate = *p++;
     _rf_intf.rx_bitrate = *p++;
     len = *p++;
-
-    // FIXME: implement activation
+    setRfActivationParams(p, len, &_rf_intf);
     _data = (void *)&_rf_intf;
  
     // set state
@@ -627,7 +1011,7 @@ end:
 uint8_t NfcNci::cmdRfDeactivate(uint8_t type)
 {
     uint8_t *p, *buf;
-    uint8_t status, ret;
+    uint8_t status;
 
     // _log NCI message
     _log.d("NCI_CMD: NCI_MSG_RF_DEACTIVATE\n");
@@ -649,8 +1033,7 @@ uint8_t NfcNci::cmdRfDeactivate(uint8_t type)
     UINT8_TO_STREAM(p, type);
 
     // send command
-    ret = _hw.write(buf, NCI_MSG_HDR_SIZE + NCI_RF_PARAM_SIZE_DEACTIVATE);
-    status = ret == NCI_MSG_HDR_SIZE + NCI_RF_PARAM_SIZE_DEACTIVATE ? NCI_STATUS_OK : NCI_STATUS_FAILED;
+    status = send(buf, NCI_MSG_HDR_SIZE + NCI_RF_PARAM_SIZE_DEACTIVATE);
 
 end:
     return status;
@@ -683,8 +1066,9 @@ uint8_t NfcNci::rspRfDeactivate(uint8_t buf[])
         goto end;
     }
 
-    // set state
+    // set state, segments left are dropped
     _state = NCI_STATE_RFST_DISCOVERY;
+    _tx_pending = false;
 
     // no data
     _data = NULL;
@@ -726,38 +1110,78 @@ end:
     return status;
 }
 
-uint8_t NfcNci::dataSend(uint8_t cid, uint8_t *data, uint32_t len)
+uint8_t NfcNci::dataSend(uint8_t cid, const uint8_t *data, uint32_t len)
 {
-    uint8_t *p, *buf;
-    uint8_t status, ret, size;
+    uint8_t status;
 
     // _log NCI message
     _log.d("NCI_DATA: NCI_MSG_DATA_SEND\n");
 
     // check state
-    if (_state != NCI_STATE_RFST_POLL_ACTIVE) {
+    if (_state != NCI_STATE_RFST_POLL_ACTIVE || _tx_pending) {
         status = NCI_STATUS_REJECTED;
         goto end;
     }
 
-    // get TX buffer
-    buf = getTxBuffer();
-    p = buf;
-    size = NCI_MSG_HDR_SIZE + len;
-
-    // format data command error
-    NCI_DATA_BLD_HDR(p, NCI_MT_DATA, len);
-
-    // write data payload
-    while (len--) {
-        UINT8_TO_STREAM(p, *data++);
+    // messages larger than the maximum data packet payload are
+    // segmented, the segments sent as long as there are credits,
+    // the others once credits are given back
+    _tx_data = data;
+    _tx_left = len;
+    _tx_cid = cid;
+    _tx_pending = true;
+    status = sendSegments();
+
+    // the response is pending even if no packet could be sent yet
+    if (status == NCI_STATUS_OK) {
+        _busy = true;
     }
 
-    // send command
-    ret = _hw.write(buf, size);
-    status = ret == size ? NCI_STATUS_OK : NCI_STATUS_FAILED;
-
 end:
     return status;
 }
 
+uint8_t NfcNci::sendSegments(void)
+{
+    uint8_t *p, *buf;
+    uint8_t status, pbf;
+    uint32_t max, len, size;
+
+    // maximum payload size, never 0 once activated
+    max = _rf_intf.max_payload_size;
+
+    // one credit is consumed per data packet, the packets
+    // without credit are sent by ntfCoreConnCredits()
+    status = NCI_STATUS_OK;
+    while (_tx_pending && (_credits != 0 || _credits == NCI_CREDITS_UNLIMITED)) {
+        len = (_tx_left > max) ? max : _tx_left;
+        pbf = (_tx_left > max) ? 1 : 0;
+
+        // get TX buffer
+        buf = getTxBuffer();
+        p = buf;
+        size = NCI_MSG_HDR_SIZE + len;
+
+        // format data packet
+        NCI_DATA_PBLD_HDR(p, pbf, _tx_cid, len);
+
+        // write data payload
+        _tx_left -= len;
+        while (len--) {
+            UINT8_TO_STREAM(p, *_tx_data++);
+        }
+
+        // send packet
+        status = send(buf, size);
+        if (status != NCI_STATUS_OK) {
+            _tx_pending = false;
+            break;
+        }
+        _tx_pending = (_tx_left != 0);
+        if (_credits != NCI_CREDITS_UNLIMITED) {
+            _credits--;
+        }
+    }
+
+    return status;
+}
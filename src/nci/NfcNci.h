@@ -39,14 +39,24 @@
 #define __NFC_NCI_H__
 
 #include <Arduino.h>
-#include <functional>
+#include "NfcConfig.h"
 #include "log/NfcLog.h"
-#include "hw/NfcHw.h"
+#include "hw/NfcHwConfig.h"
+#include "nci/NfcNciQueue.h"
+#include "nci/NfcDelegate.h"
 
 /* NCI packet size */
 #define NCI_PACKET_SIZE     258
 #define NCI_MSG_HDR_SIZE    3   /* per NCI spec */
 
+/* NCI RX and TX buffers, see NfcConfig.h, the maximum
+ * data packet payload of the RF interface is cut so that
+ * packets fit them both ways */
+#define NCI_RX_BUFFER_SIZE  NFC_CONFIG_NCI_RX_SIZE
+#define NCI_TX_BUFFER_SIZE  NFC_CONFIG_NCI_TX_SIZE
+#define NCI_PAYLOAD_MAX     ((NCI_RX_BUFFER_SIZE < NCI_TX_BUFFER_SIZE ? \
+                              NCI_RX_BUFFER_SIZE : NCI_TX_BUFFER_SIZE) - NCI_MSG_HDR_SIZE)
+
 /* NCI length field offset */
 #define NCI_OFFSET_LEN      2
 
@@ -91,6 +101,12 @@
 #define NCI_CID_MASK        0x0F
 #define NCI_CID_RF_STATIC   0x00
 
+/* data event identifier flag, more segments of the message follow */
+#define NCI_DATA_ID_PBF     (NCI_PBF_ST_CONT << 8)
+
+/* initial number of credits, data flow control not used */
+#define NCI_CREDITS_UNLIMITED   0xFF
+
 /* builds byte0 of NCI Command and Notification packet */
 #define NCI_MSG_BLD_HDR0(p, mt, gid) \
     *(p)++ = (uint8_t) (((mt) << NCI_MT_SHIFT) | (gid));
@@ -190,6 +206,7 @@
 #define NCI_ID_NTF_RF_INTF_ACTIVATED    UINT16_ID(NCI_MT_NTF, NCI_MSG_RF_INTF_ACTIVATED)
 #define NCI_ID_RSP_RF_DEACTIVATE        UINT16_ID(NCI_MT_RSP, NCI_MSG_RF_DEACTIVATE)
 #define NCI_ID_NTF_RF_DEACTIVATE        UINT16_ID(NCI_MT_NTF, NCI_MSG_RF_DEACTIVATE)
+#define NCI_ID_NTF_CORE_INTF_ERR        UINT16_ID(NCI_MT_NTF, NCI_MSG_CORE_INTF_ERR_STATUS)
 
 /* NCI CORE_RESET_CMD */
 #define NCI_CORE_PARAM_SIZE_RESET       0x01
@@ -203,6 +220,12 @@
 #define NCI_CORE_INIT_RSP_OFFSET_NUM_INTF   0x05
 #define NCI_CORE_PARAM_SIZE_INIT_RSP        0x11
 
+/* NCI CORE_INTERFACE_ERROR_NTF */
+#define NCI_CORE_PARAM_SIZE_INTF_ERR_NTF    0x02
+
+/* NCI CORE_CONN_CREDITS_NTF */
+#define NCI_CORE_PARAM_SIZE_CONN_CREDITS_NTF 0x03
+
 /* NCI RF_DISCOVER_MAP_CMD */
 #define NCI_RF_PARAM_SIZE_DISCOVER_MAP_RSP  0x01
 
@@ -224,6 +247,8 @@
 #define NCI_PROTOCOL_T3T                0x03
 #define NCI_PROTOCOL_ISO_DEP            0x04
 #define NCI_PROTOCOL_NFC_DEP            0x05
+#define NCI_PROTOCOL_T5T                0x06    /* ISO 15693, NCI 2.0 */
+#define NCI_PROTOCOL_MIFARE             0x80    /* NXP proprietary */
 
 /* Discovery Types/Detected Technology and Mode */
 #define NCI_DISCOVERY_TYPE_POLL_A               0x00
@@ -262,6 +287,7 @@ typedef struct
 #define NCI_INTERFACE_NFC_DEP           3
 #define NCI_INTERFACE_MAX               NCI_INTERFACE_NFC_DEP
 #define NCI_INTERFACE_FIRST_VS          0x80
+#define NCI_INTERFACE_MIFARE            0x80    /* NXP proprietary */
 typedef uint8_t tNCI_INTF_TYPE;
 
 /* NCI Interface Mode */
@@ -300,19 +326,85 @@ typedef struct
     uint8_t sel_res;
 } tNCI_RF_PARAMS_PA;
 
+#define NCI_RF_PF_SENSF_RES_LENGTH  18
+#define NCI_RF_PF_NFCID2_LENGTH     8
+
+typedef struct
+{
+    uint8_t bit_rate;
+    uint8_t sensf_res_len;
+    uint8_t sensf_res[NCI_RF_PF_SENSF_RES_LENGTH]; // NFCID2 | PMm | [RD]
+} tNCI_RF_PARAMS_PF;
+
+#define NCI_RF_PB_PUPI_LENGTH       4
+#define NCI_RF_PB_APP_DATA_LENGTH   4
+#define NCI_RF_PB_PROT_INFO_LENGTH  4
+
+typedef struct
+{
+    uint8_t pupi[NCI_RF_PB_PUPI_LENGTH];
+    uint8_t app_data[NCI_RF_PB_APP_DATA_LENGTH];
+    uint8_t prot_info_len;
+    uint8_t prot_info[NCI_RF_PB_PROT_INFO_LENGTH];
+} tNCI_RF_PARAMS_PB;
+
+#define NCI_RF_PV_UID_LENGTH        8
+
+typedef struct
+{
+    uint8_t res_flag;
+    uint8_t dsfid;
+    uint8_t uid[NCI_RF_PV_UID_LENGTH];
+} tNCI_RF_PARAMS_PV;
+
 typedef struct
 {
     uint8_t type;
     union
     {
         tNCI_RF_PARAMS_PA poll_a;
+        tNCI_RF_PARAMS_PB poll_b;
+        tNCI_RF_PARAMS_PF poll_f;
+        tNCI_RF_PARAMS_PV poll_v;
     } params;
 } tNCI_RF_PARAMS;
 
+#define NCI_ACT_PA_HIST_LENGTH      15
+
+typedef struct
+{
+    uint8_t fsci;       // T0, card frame size integer
+    uint8_t ta;         // TA, bit rates, 0 if absent
+    uint8_t fwi;        // TB, frame waiting time integer
+    uint8_t sfgi;       // TB, start-up frame guard time integer
+    uint8_t tc;         // TC, NAD and CID support
+    uint8_t hist_len;
+    uint8_t hist[NCI_ACT_PA_HIST_LENGTH]; // historical bytes
+} tNCI_ACT_PARAMS_PA;   // ATS
+
+#define NCI_ACT_PB_HLR_LENGTH       15
+
+typedef struct
+{
+    uint8_t mbli;       // maximum buffer length index
+    uint8_t cid;        // card identifier
+    uint8_t hlr_len;
+    uint8_t hlr[NCI_ACT_PB_HLR_LENGTH];   // higher layer response
+} tNCI_ACT_PARAMS_PB;   // ATTRIB response
+
 typedef struct
 {
     uint8_t type;
-    void    *params = NULL; // FIXME: to be defined, not supported now
+    union
+    {
+        tNCI_ACT_PARAMS_PA poll_a;
+        tNCI_ACT_PARAMS_PB poll_b;
+    } params;
+    // ISO-DEP card capabilities, from the ATS on NFC-A and
+    // the SENSB_RES protocol info on NFC-B, 0 if not ISO-DEP
+    uint16_t fsc;       // card frame size in bytes
+    uint32_t fwt;       // frame waiting time in us
+    uint32_t sfgt;      // start-up frame guard time in us
 } tNCI_ACT_PARAMS;
 
 typedef struct
@@ -340,12 +432,14 @@ enum
     NCI_STATE_RFST_POLL_ACTIVE,
     NCI_STATE_RFST_W4_HOST_SELECT,
     NCI_STATE_RFST_LISTEN_SLEEP,
-    NCI_STATE_RFST_LISTEN_ACTIVE
+    NCI_STATE_RFST_LISTEN_ACTIVE,
+    NCI_STATE_POWER_DOWN
 };
 typedef uint8_t tNFC_STATE;
 
 // Callback object that clients have to implement
-// to be notified on response or event
+// to be notified on response or event, callbacks are
+// called from NfcNci::handleEvent() once the packet is processed
 class NfcNciCb 
 {
     public:
@@ -366,23 +460,52 @@ class NfcNciCb
 class NfcNci
 {
     public:
-        NfcNci(NfcLog& log, NfcHw& hw);
-        void init(NfcNciCb *cb) {_cb = cb;}
+        NfcNci(NfcLog& log, tNFC_HW& hw);
+        // subscribe the callback object to all the events
+        void init(NfcNciCb *cb);
+        // subscribe a delegate to a single NCI_EVT_xxx event,
+        // replacing the callback object one, if any
+        void subscribe(uint8_t event, NfcDelegate cb) {if (event < NCI_EVT_NUM) {_cbs[event] = cb;}}
+        // wait for a packet, process it and call the callback
+        // functions of the resulting events
         void handleEvent(void);
+        // non blocking check that handleEvent() has a packet to process
+        bool isReady(void) {return _state != NCI_STATE_POWER_DOWN && _hw.ready();}
+        // true while the response to the last command or data is pending
+        bool isBusy(void) {return _busy;}
+        // number of data packets the controller accepts before
+        // sending credits back, NCI_CREDITS_UNLIMITED without flow control
+        uint8_t getCredits(void) {return _credits;}
+        // hardware reset, the controller has to be reset and initialized again
+        void reset(void);
+        // switch the controller off and on, e.g. for deep sleep idle periods
+        void powerDown(void);
+        void powerUp(void);
         uint8_t cmdCoreReset(uint8_t type);
         uint8_t cmdCoreInit(void);
-        uint8_t cmdRfDiscoverMap(uint8_t num, tNCI_DISCOVER_MAPS* p_maps);
-        uint8_t cmdRfDiscover(uint8_t num, tNCI_DISCOVER_CONFS* p_confs);
+        uint8_t cmdRfDiscoverMap(uint8_t num, const tNCI_DISCOVER_MAPS* p_maps);
+        uint8_t cmdRfDiscover(uint8_t num, const tNCI_DISCOVER_CONFS* p_confs);
         uint8_t cmdRfDeactivate(uint8_t type);
-        uint8_t dataSend(uint8_t cid, uint8_t buf[], uint32_t len);
+        // send a data message, segmented when larger than the maximum
+        // payload size in which case buf has to remain valid until the
+        // response. The segments of the response are notified one by one
+        // to cbData(), id has NCI_DATA_ID_PBF set for all but the last one.
+        uint8_t dataSend(uint8_t cid, const uint8_t buf[], uint32_t len);
 
     private:
+        void notify(uint8_t event, uint8_t status, uint16_t id, void *data);
+        bool dispatchEvent(void);
+        void receiveEvent(void);
+        uint8_t send(uint8_t buf[], uint32_t len);
+        uint8_t sendSegments(void);
         uint32_t waitForEvent(uint8_t buf[]);
         void handleDataEvent(uint8_t buf[], uint32_t len);
         void handleCoreEvent(uint8_t buf[], uint32_t len);
         void handleRfEvent(uint8_t buf[], uint32_t len);
         uint8_t rspCoreReset(uint8_t buf[]);
         uint8_t rspCoreInit(uint8_t buf[]);
+        uint8_t ntfCoreIntfError(uint8_t buf[]);
+        void ntfCoreConnCredits(uint8_t buf[]);
         uint8_t rspRfDiscoverMap(uint8_t buf[]);
         uint8_t rspRfDiscover(uint8_t buf[]);
         uint8_t ntfRfIntfActivated(uint8_t buf[]);
@@ -390,12 +513,24 @@ class NfcNci
         uint8_t ntfRfDeactivate(uint8_t buf[]);
 
     private:
-        uint8_t _rx_buf[NCI_PACKET_SIZE];
-        uint8_t _tx_buf[NCI_PACKET_SIZE];
+#if NFC_CONFIG_NCI_SHARED_BUFFER
+        uint8_t _buf[NCI_RX_BUFFER_SIZE > NCI_TX_BUFFER_SIZE ?
+                     NCI_RX_BUFFER_SIZE : NCI_TX_BUFFER_SIZE]; // RX and TX buffer
+#else
+        uint8_t _rx_buf[NCI_RX_BUFFER_SIZE];
+        uint8_t _tx_buf[NCI_TX_BUFFER_SIZE];
+#endif
         tNFC_STATE _state;
+        bool _busy;
+        uint8_t _credits;               // RF static connection credits
+        const uint8_t *_tx_data;        // data message segments to send
+        uint32_t _tx_left;              // data message bytes to send
+        bool _tx_pending;               // data message packets to send
+        uint8_t _tx_cid;                // data message connection
         NfcLog& _log;
-        NfcHw& _hw;
-        NfcNciCb *_cb;
+        tNFC_HW& _hw;
+        NfcDelegate _cbs[NCI_EVT_NUM];  // event callbacks
+        NfcNciQueue _queue;             // events pending dispatch
         void *_data;
         tNCI_RESET _reset;              // reset response
         tNCI_RF_INTF _rf_intf;          // RF interface
@@ -0,0 +1,93 @@
+/*
+ * NfcNciQueue.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_NCI_QUEUE_H__
+#define __NFC_NCI_QUEUE_H__
+
+#include <Arduino.h>
+
+// event queue capacity, NfcNci queues the events of a received
+// packet and dispatches them before receiving the next one
+#define NCI_QUEUE_SIZE      4
+
+// NCI event definition, one per NfcNciCb callback function
+enum {
+    NCI_EVT_CORE_RESET = 0,
+    NCI_EVT_CORE_INIT,
+    NCI_EVT_RF_DISCOVER_MAP,
+    NCI_EVT_RF_DISCOVER,
+    NCI_EVT_RF_DISCOVER_NTF,
+    NCI_EVT_RF_DEACTIVATE,
+    NCI_EVT_RF_DEACTIVATE_NTF,
+    NCI_EVT_DATA,
+    NCI_EVT_ERROR,
+    NCI_EVT_NUM
+};
+
+// NCI event type definition
+typedef struct {
+    void *data;
+    uint16_t id;
+    uint8_t event;
+    uint8_t status;
+} tNCI_EVENT;
+
+// Fixed capacity FIFO of NCI events, no allocation
+class NfcNciQueue
+{
+    public:
+        NfcNciQueue(void) : _head(0), _count(0) {;}
+        bool isEmpty(void) {return _count == 0;}
+        void clear(void) {_head = 0; _count = 0;}
+        // add an event, false when the queue is full
+        bool push(uint8_t event, uint8_t status, uint16_t id, void *data)
+        {
+            tNCI_EVENT *p_evt;
+
+            if (_count == NCI_QUEUE_SIZE) {
+                return false;
+            }
+            p_evt = &_events[(_head + _count) % NCI_QUEUE_SIZE];
+            p_evt->event = event;
+            p_evt->status = status;
+            p_evt->id = id;
+            p_evt->data = data;
+            _count++;
+            return true;
+        }
+        // remove the oldest event, false when the queue is empty
+        bool pop(tNCI_EVENT *p_evt)
+        {
+            if (_count == 0) {
+                return false;
+            }
+            *p_evt = _events[_head];
+            _head = (_head + 1) % NCI_QUEUE_SIZE;
+            _count--;
+            return true;
+        }
+
+    private:
+        tNCI_EVENT _events[NCI_QUEUE_SIZE];
+        uint8_t _head;
+        uint8_t _count;
+};
+
+#endif /* __NFC_NCI_QUEUE_H__ */
@@ -0,0 +1,74 @@
+/*
+ * NfcNdef.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ndef/NfcNdef.h"
+
+uint8_t NfcNdef::getRecord(tNDEF_RECORD *rec)
+{
+    const uint8_t *p;
+    uint32_t len, left;
+
+    // check message end
+    if (_buf == NULL || _pos >= _len) {
+        return NDEF_STATUS_END;
+    }
+    p = &_buf[_pos];
+    left = _len - _pos;
+
+    // header | type length | payload length (1 or 4 bytes) | [id length]
+    len = 2 + ((p[0] & NDEF_FLAG_SR) ? 1 : 4) + ((p[0] & NDEF_FLAG_IL) ? 1 : 0);
+    if (left < len) {
+        goto corrupted;
+    }
+    rec->flags = *p & ~NDEF_TNF_MASK;
+    rec->tnf = *p++ & NDEF_TNF_MASK;
+    rec->type_len = *p++;
+    if (rec->flags & NDEF_FLAG_SR) {
+        rec->payload_len = *p++;
+    }
+    else {
+        rec->payload_len = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                           ((uint32_t)p[2] << 8) | p[3];
+        p += 4;
+    }
+    rec->id_len = (rec->flags & NDEF_FLAG_IL) ? *p++ : 0;
+    left -= len;
+
+    // type | id | payload
+    if (left < (uint32_t)rec->type_len + rec->id_len ||
+        left - rec->type_len - rec->id_len < rec->payload_len) {
+        goto corrupted;
+    }
+    rec->type = p;
+    p += rec->type_len;
+    rec->id = p;
+    p += rec->id_len;
+    rec->payload = p;
+    p += rec->payload_len;
+
+    // last record
+    _pos = (rec->flags & NDEF_FLAG_ME) ? _len : p - _buf;
+
+    return NDEF_STATUS_OK;
+
+corrupted:
+    _pos = _len;
+    return NDEF_STATUS_CORRUPTED;
+}
@@ -0,0 +1,86 @@
+/*
+ * NfcNdef.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_NDEF_H__
+#define __NFC_NDEF_H__
+
+#include <Arduino.h>
+
+// status definition
+enum {
+    NDEF_STATUS_OK = 0,
+    NDEF_STATUS_END,
+    NDEF_STATUS_CORRUPTED
+};
+
+// record header flags
+#define NDEF_FLAG_MB            0x80    // message begin
+#define NDEF_FLAG_ME            0x40    // message end
+#define NDEF_FLAG_CF            0x20    // chunk flag
+#define NDEF_FLAG_SR            0x10    // short record
+#define NDEF_FLAG_IL            0x08    // ID length present
+#define NDEF_TNF_MASK           0x07    // type name format
+
+// type name format definition
+enum {
+    NDEF_TNF_EMPTY = 0,
+    NDEF_TNF_WELL_KNOWN,
+    NDEF_TNF_MEDIA,
+    NDEF_TNF_URI,
+    NDEF_TNF_EXTERNAL,
+    NDEF_TNF_UNKNOWN,
+    NDEF_TNF_UNCHANGED
+};
+
+// well known record types (NFC Forum RTD)
+#define NDEF_RTD_TEXT           'T'
+#define NDEF_RTD_URI            'U'
+
+// NDEF record definition, type, id and payload point
+// into the message buffer, nothing is copied
+typedef struct {
+    uint8_t flags;
+    uint8_t tnf;
+    uint8_t type_len;
+    uint8_t id_len;
+    uint32_t payload_len;
+    const uint8_t *type;
+    const uint8_t *id;
+    const uint8_t *payload;
+} tNDEF_RECORD;
+
+// NDEF message parser, records are returned one by one
+// in place, the message buffer has to remain valid
+class NfcNdef
+{
+    public:
+        NfcNdef(void) : _buf(NULL), _len(0), _pos(0) {;}
+        // start parsing a message
+        void init(const uint8_t *buf, uint16_t len) {_buf = buf; _len = len; _pos = 0;}
+        // get next record, NDEF_STATUS_END once all records are parsed
+        uint8_t getRecord(tNDEF_RECORD *rec);
+
+    private:
+        const uint8_t *_buf;    // message
+        uint16_t _len;          // message length
+        uint16_t _pos;          // next record offset
+};
+
+#endif // __NFC_NDEF_H__
@@ -0,0 +1,76 @@
+/*
+ * NfcReaders.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "NfcReaders.h"
+
+uint8_t NfcReaders::add(NfcNci& nci, NfcTags& tags)
+{
+    if (_num == NFC_READERS_MAX) {
+        _log.e("NfcReaders: %s group full\n", __func__);
+        return TAGS_STATUS_REJECTED;
+    }
+
+    _p_nci[_num] = &nci;
+    _p_tags[_num] = &tags;
+    _num++;
+
+    return TAGS_STATUS_OK;
+}
+
+uint8_t NfcReaders::service(uint8_t index)
+{
+    // process the packet the controller has ready, if any
+    if (!_p_nci[index]->isReady()) {
+        return 0;
+    }
+    _p_nci[index]->handleEvent();
+
+    // let the state machine send its next command right away
+    _p_tags[index]->handleEvent();
+
+    return 1;
+}
+
+void NfcReaders::handleEvent(void)
+{
+    uint8_t i, index, serviced;
+
+    if (_num == 0) {
+        return;
+    }
+
+    // run the state machines, commands are sent by
+    // readers which are not waiting for a response
+    for (i = 0; i < _num; i++) {
+        _p_tags[i]->handleEvent();
+    }
+
+    // one packet per reader per pass, starting after the
+    // reader serviced first last time
+    do {
+        serviced = 0;
+        for (i = 0; i < _num; i++) {
+            index = (_next + i) % _num;
+            serviced += service(index);
+        }
+    } while (_policy == NFC_READERS_IRQ && serviced != 0);
+
+    _next = (_next + 1) % _num;
+}
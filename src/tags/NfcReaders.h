@@ -0,0 +1,73 @@
+/*
+ * NfcReaders.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_READERS_H__
+#define __NFC_READERS_H__
+
+#include <Arduino.h>
+#include "tags/NfcTagsDef.h"
+#include "tags/NfcTags.h"
+#include "log/NfcLog.h"
+#include "nci/NfcNci.h"
+
+// maximum number of readers in a group
+#define NFC_READERS_MAX         4
+
+// scheduling policy definition
+enum {
+    // each reader in turn runs its state machine and
+    // processes at most one packet if one is ready
+    NFC_READERS_ROUND_ROBIN = 0,
+    // readers with a packet ready are serviced, one packet
+    // each per pass, until none is ready
+    NFC_READERS_IRQ
+};
+
+// Reader group object which services several NFC stacks
+// (NfcNci + NfcTags pairs, one per controller) from a single
+// event loop. Packets are only read from controllers which
+// have one ready so that a slow controller never blocks the
+// others, and the readers are serviced in turn.
+class NfcReaders
+{
+    public:
+        NfcReaders(NfcLog& log, uint8_t policy = NFC_READERS_ROUND_ROBIN) :
+            _log(log), _policy(policy), _num(0), _next(0) {;}
+        // add a reader to the group, returns TAGS_STATUS_REJECTED
+        // when the group is full
+        uint8_t add(NfcNci& nci, NfcTags& tags);
+        // number of readers in the group
+        uint8_t getNum(void) {return _num;}
+        // service the readers, never blocks
+        void handleEvent(void);
+
+    private:
+        uint8_t service(uint8_t index);
+
+    private:
+        NfcLog& _log;                   // logging interface
+        uint8_t _policy;                // scheduling policy
+        uint8_t _num;                   // number of readers
+        uint8_t _next;                  // next reader to be serviced
+        NfcNci *_p_nci[NFC_READERS_MAX];
+        NfcTags *_p_tags[NFC_READERS_MAX];
+};
+
+#endif // __NFC_READERS_H__
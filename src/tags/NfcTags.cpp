@@ -20,44 +20,167 @@
 
 #include "NfcTags.h"
 
+// type 2 tag interface, the activated one when the
+// tag interfaces share their storage
+#if NFC_CONFIG_SHARED_INTF
+#define getTag2()           (*static_cast<NfcTagsIntfType2 *>(_p_tagIntf))
+#else
+#define getTag2()           (_tag2)
+#endif
+
 // NCI RF configuration for tag detection
-// Discover tag type 1, 2 and 3 in polling mode
-// with frame interface.
-// Poll tag detection RF mode A and F.
-tNCI_DISCOVER_MAPS discover_maps[] =
+// Discover tag type 1, 2, 3 and 5 in polling mode
+// with frame interface, tag type 4 with ISO-DEP
+// interface, and Mifare classic with the NXP
+// proprietary Mifare interface.
+// Poll tag detection RF mode A, F and V by default,
+// and B on demand.
+static const tNCI_DISCOVER_MAPS discover_maps[] =
 {
+#if NFC_CONFIG_TAG_TYPE1
     // T1T + poll mode + frame RF interface
     {
         NCI_PROTOCOL_T1T,
         NCI_INTERFACE_MODE_POLL,
         NCI_INTERFACE_FRAME
     },
+#endif
+#if NFC_CONFIG_TAG_TYPE2 || NFC_CONFIG_TAG_MIFARE
     // T2T + poll mode + frame RF interface
     {
         NCI_PROTOCOL_T2T,
         NCI_INTERFACE_MODE_POLL,
         NCI_INTERFACE_FRAME
     },
+#endif
+#if NFC_CONFIG_TAG_TYPE3
     // T3T + poll mode + frame RF interface
     {
         NCI_PROTOCOL_T3T,
         NCI_INTERFACE_MODE_POLL,
         NCI_INTERFACE_FRAME
-    }
+    },
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+    // T5T + poll mode + frame RF interface
+    {
+        NCI_PROTOCOL_T5T,
+        NCI_INTERFACE_MODE_POLL,
+        NCI_INTERFACE_FRAME
+    },
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+    // ISO-DEP + poll mode + ISO-DEP RF interface
+    {
+        NCI_PROTOCOL_ISO_DEP,
+        NCI_INTERFACE_MODE_POLL,
+        NCI_INTERFACE_ISO_DEP
+    },
+#endif
+#if NFC_CONFIG_TAG_MIFARE
+    // Mifare + poll mode + Mifare RF interface
+    {
+        NCI_PROTOCOL_MIFARE,
+        NCI_INTERFACE_MODE_POLL,
+        NCI_INTERFACE_MIFARE
+    },
+#endif
 };
 
-tNCI_DISCOVER_CONFS discover_confs[] =
+// Polling modes, only those of the technologies
+// given to setDiscoverTechs() are configured
+typedef struct
+{
+    uint8_t tech;
+    tNCI_DISCOVER_CONFS conf;
+} tTAGS_DISCOVER_CONFS;
+
+static const tTAGS_DISCOVER_CONFS discover_confs[] =
 {
+#if NFC_CONFIG_TECH_A
     // poll A + always
     {
-        NCI_DISCOVERY_TYPE_POLL_A,
-        NCI_DISCOVERY_FREQUENCY_ALWAYS
+        TAGS_TECH_A,
+        {NCI_DISCOVERY_TYPE_POLL_A, NCI_DISCOVERY_FREQUENCY_ALWAYS}
+    },
+#endif
+#if NFC_CONFIG_TECH_B
+    // poll B + always
+    {
+        TAGS_TECH_B,
+        {NCI_DISCOVERY_TYPE_POLL_B, NCI_DISCOVERY_FREQUENCY_ALWAYS}
     },
+#endif
+#if NFC_CONFIG_TECH_F
     // poll F + always
     {
-        NCI_DISCOVERY_TYPE_POLL_F,
-        NCI_DISCOVERY_FREQUENCY_ALWAYS
-    }
+        TAGS_TECH_F,
+        {NCI_DISCOVERY_TYPE_POLL_F, NCI_DISCOVERY_FREQUENCY_ALWAYS}
+    },
+#endif
+#if NFC_CONFIG_TECH_V
+    // poll V + always
+    {
+        TAGS_TECH_V,
+        {NCI_DISCOVERY_TYPE_POLL_ISO15693, NCI_DISCOVERY_FREQUENCY_ALWAYS}
+    },
+#endif
+};
+
+#define DISCOVER_CONFS_NUM  (sizeof(discover_confs) / sizeof(tTAGS_DISCOVER_CONFS))
+
+// Tag identification, the first entry matching the activated tag
+// gives its type. NFC-A parameters are compared when the mask is
+// not null, SENS_RES (ATQA) first byte, SEL_RES (SAK), then NFCID1
+// length and first byte (manufacturer) when not null. Entries with
+// TAGS_IDENTIFY_PROBE are probed with GET_VERSION if setProbe().
+#define TAGS_IDENTIFY_PROBE     0x01
+
+// Time for a tag halted during a dump to be activated again, in ms
+#define TAGS_REACTIVATE_TIME    500
+
+typedef struct
+{
+    uint8_t protocol;       // NCI protocol
+    uint8_t sens_res_mask;
+    uint8_t sens_res;
+    uint8_t sel_res_mask;
+    uint8_t sel_res;
+    uint8_t nfcid_len;
+    uint8_t nfcid0;
+    uint8_t type;           // TAGS_TYPE_xxx
+    uint8_t flags;
+} tTAGS_IDENTIFY;
+
+static const tTAGS_IDENTIFY identify_table[] =
+{
+    // Mifare classic activated on the Mifare RF interface
+#if NFC_CONFIG_TAG_MIFARE
+    {NCI_PROTOCOL_MIFARE,   0, 0,       0, 0,       0, 0,       TAGS_TYPE_MIFARE,   0},
+#endif
+    // ISO-DEP tag activated on the ISO-DEP RF interface
+#if NFC_CONFIG_TAG_TYPE4
+    {NCI_PROTOCOL_ISO_DEP,  0, 0,       0, 0,       0, 0,       TAGS_TYPE_4,        0},
+#endif
+    // Topaz, FeliCa and ISO 15693 tags on the frame RF interface
+#if NFC_CONFIG_TAG_TYPE1
+    {NCI_PROTOCOL_T1T,      0, 0,       0, 0,       0, 0,       TAGS_TYPE_1,        0},
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+    {NCI_PROTOCOL_T3T,      0, 0,       0, 0,       0, 0,       TAGS_TYPE_3,        0},
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+    {NCI_PROTOCOL_T5T,      0, 0,       0, 0,       0, 0,       TAGS_TYPE_5,        0},
+#endif
+    // Mifare classic on the frame RF interface, SAK bit 3, not
+    // taken for a tag of type 2 when Mifare classic is not built
+    {NCI_PROTOCOL_T2T,      0, 0,       0x08, 0x08, 0, 0,       TAGS_TYPE_MIFARE,   0},
+    // NXP Ultralight and NTAG, see NXP application notes AN1303 and AN1305
+#if NFC_CONFIG_TAG_TYPE2
+    {NCI_PROTOCOL_T2T,      0xFF, 0x44, 0, 0,       7, 0x04,    TAGS_TYPE_2,        TAGS_IDENTIFY_PROBE},
+    // other tags of type 2, whatever their UID
+    {NCI_PROTOCOL_T2T,      0, 0,       0, 0,       0, 0,       TAGS_TYPE_2,        0},
+#endif
 };
 
 // State definition
@@ -72,17 +195,36 @@ enum {
     TAGS_STATE_DISCOVER,
     TAGS_STATE_DISCOVER_NTF,
     TAGS_STATE_DISCOVER_ACTIVATED,
+    TAGS_STATE_DISCOVER_PROBE,
+    TAGS_STATE_DISCOVER_REACTIVATE,
+    TAGS_STATE_DISCOVER_REACTIVATE_NTF,
+    TAGS_STATE_DISCOVER_PRESENCE,
     // disconnect command states
     TAGS_STATE_DEACTIVATE,
     TAGS_STATE_DEACTIVATE_RSP,
     TAGS_STATE_DEACTIVATE_NTF,
+    TAGS_STATE_HOLD,
+    TAGS_STATE_HOLD_CHECK,
     // dump command states
     TAGS_STATE_DUMP,
-    TAGS_STATE_DUMP_RSP
+    TAGS_STATE_DUMP_RSP,
+    TAGS_STATE_DUMP_REACTIVATE,
+    TAGS_STATE_DUMP_REACTIVATE_NTF,
+    // read command states
+    TAGS_STATE_READ,
+    // power down command states
+    TAGS_STATE_POWER_DOWN,
+    // write command states
+    TAGS_STATE_WRITE,
+    // NDEF read command states
+    TAGS_STATE_READ_NDEF,
+    // APDU command states
+    TAGS_STATE_APDU
 };
 
 // State strings
-const char *nfcTagsStateToStr[] = {
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsStateToStr[] = {
     "TAGS_STATE_NONE",
     // reset command states
     "TAGS_STATE_INIT_RESET",
@@ -93,22 +235,108 @@ const char *nfcTagsStateToStr[] = {
     "TAGS_STATE_DISCOVER",
     "TAGS_STATE_DISCOVER_NTF",
     "TAGS_STATE_DISCOVER_ACTIVATED",
+    "TAGS_STATE_DISCOVER_PROBE",
+    "TAGS_STATE_DISCOVER_REACTIVATE",
+    "TAGS_STATE_DISCOVER_REACTIVATE_NTF",
+    "TAGS_STATE_DISCOVER_PRESENCE",
     // disconnect command states
     "TAGS_STATE_DEACTIVATE",
     "TAGS_STATE_DEACTIVATE_RSP",
     "TAGS_STATE_DEACTIVATE_NTF",
+    "TAGS_STATE_HOLD",
+    "TAGS_STATE_HOLD_CHECK",
     // dump command states
     "TAGS_STATE_DUMP",
-    "TAGS_STATE_DUMP_RSP"
+    "TAGS_STATE_DUMP_RSP",
+    "TAGS_STATE_DUMP_REACTIVATE",
+    "TAGS_STATE_DUMP_REACTIVATE_NTF",
+    // read command states
+    "TAGS_STATE_READ",
+    // power down command states
+    "TAGS_STATE_POWER_DOWN",
+    // write command states
+    "TAGS_STATE_WRITE",
+    // NDEF read command states
+    "TAGS_STATE_READ_NDEF",
+    // APDU command states
+    "TAGS_STATE_APDU"
 };
+#endif
 
 NfcTags::NfcTags(NfcLog& log, NfcNci& nci) :
-         _state(TAGS_STATE_NONE), _id(TAGS_ID_NONE),
-         _log(log), _nci(nci), _p_cb(NULL),
-         _tag2(log, nci), _tagMifare(log, nci)
+         _state(TAGS_STATE_NONE), _id(TAGS_ID_NONE), _techs(TAGS_TECH_DEFAULT), _probe(false),
+         _log(log), _nci(nci),
+#if !NFC_CONFIG_SHARED_INTF
+#if NFC_CONFIG_TAG_TYPE1
+         _tag1(log, nci),
+#endif
+#if NFC_CONFIG_TAG_TYPE2
+         _tag2(log, nci),
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+         _tag3(log, nci),
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+         _tag4(log, nci),
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+         _tag5(log, nci),
+#endif
+#if NFC_CONFIG_TAG_MIFARE
+         _tagMifare(log, nci),
+#endif
+#endif
+         _p_tagIntf(NULL)
 {
     _data = NULL;
-    _p_tagIntf = NULL;
+    _p_entry = NULL;
+    _cache_age = 0;
+    _cache_len = 0;
+    _debounce = 0;
+    _hold = 0;
+    _check = 0;
+    _check_time = 0;
+    _pending.id = TAGS_ID_NONE;
+    _seen = 0;
+    _seen_len = 0;
+#if NFC_CONFIG_SHARED_INTF
+    _chunk = 0;
+    _p_keys = NULL;
+    _num_keys = 0;
+#else
+#if NFC_CONFIG_TAG_TYPE1
+    _tag1.init(this);
+#endif
+#if NFC_CONFIG_TAG_TYPE2
+    getTag2().init(this);
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+    _tag3.init(this);
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+    _tag4.init(this);
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+    _tag5.init(this);
+#endif
+#if NFC_CONFIG_TAG_MIFARE
+    _tagMifare.init(this);
+#endif
+#endif
+}
+
+void NfcTags::init(NfcTagsCb *cb)
+{
+    _cbs[TAGS_EVT_RESET] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbReset>(cb);
+    _cbs[TAGS_EVT_DISCOVER] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbDiscover>(cb);
+    _cbs[TAGS_EVT_DISCOVER_NTF] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbDiscoverNtf>(cb);
+    _cbs[TAGS_EVT_DEACTIVATE] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbDeactivate>(cb);
+    _cbs[TAGS_EVT_REMOVED] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbRemoved>(cb);
+    _cbs[TAGS_EVT_DUMP] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbDump>(cb);
+    _cbs[TAGS_EVT_WRITE] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbWrite>(cb);
+    _cbs[TAGS_EVT_NDEF] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbNdef>(cb);
+    _cbs[TAGS_EVT_APDU] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbApdu>(cb);
+    _cbs[TAGS_EVT_READ] = NfcDelegate::bind<NfcTagsCb, &NfcTagsCb::cbRead>(cb);
 }
 
 void NfcTags::setNciResponse(uint8_t status, uint16_t id, void *data)
@@ -144,6 +372,11 @@ void NfcTags::cbError(uint8_t status, uint16_t id, void *data)
 
 void NfcTags::handleEvent(void)
 {
+    // nothing to send until the pending NCI response is received
+    if (_nci.isBusy()) {
+        return;
+    }
+
     // process event per command
     switch(_id) {
         case TAGS_ID_RESET:
@@ -158,6 +391,21 @@ void NfcTags::handleEvent(void)
         case TAGS_ID_DUMP:
             handleDump();
             break;
+        case TAGS_ID_READ:
+            handleRead();
+            break;
+        case TAGS_ID_WRITE:
+            handleWrite();
+            break;
+        case TAGS_ID_READ_NDEF:
+            handleReadNdef();
+            break;
+        case TAGS_ID_APDU:
+            handleApdu();
+            break;
+        case TAGS_ID_POWER_DOWN:
+            // nothing to do until powered up
+            break;
         default:
             _log.e("NfcTags: %s ignore unknown event %d\n", __func__, _id);
             break;
@@ -168,10 +416,12 @@ uint8_t NfcTags::cmdReset(void)
 {
     // reset command migth be sent at anytime
     // reset state accordingly
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+    _nci.reset();
     _state = TAGS_STATE_INIT_RESET;
     _id = TAGS_ID_RESET;
     _p_tagIntf = NULL;
+    _pending.id = TAGS_ID_NONE;
     return TAGS_STATUS_OK;
 }
 
@@ -179,7 +429,7 @@ void NfcTags::handleReset(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
     // reset command state machine
     switch (_state) {
@@ -204,8 +454,8 @@ void NfcTags::handleReset(void)
     // check status and notify
     if (status != NCI_STATUS_OK) {
         status = translateNciStatus(status);
-        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, nfcTagsStateToStr[_state], status);
-        _p_cb->cbReset(status, TAGS_ID_RESET, NULL);
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _cbs[TAGS_EVT_RESET](status, TAGS_ID_RESET, NULL);
     }
 } 
 
@@ -226,7 +476,7 @@ void NfcTags::cbCoreReset(uint8_t status, uint16_t id, void *data)
     }
 
     status = translateNciStatus(status);
-    _p_cb->cbDeactivate(status, TAGS_ID_RESET, NULL);
+    _cbs[TAGS_EVT_DEACTIVATE](status, TAGS_ID_RESET, NULL);
 }
 
 void NfcTags::cbCoreInit(uint8_t status, uint16_t id, void *data)
@@ -249,17 +499,17 @@ void NfcTags::cbCoreInit(uint8_t status, uint16_t id, void *data)
         status = translateNciStatus(status);
     }
 
-    _p_cb->cbReset(status, TAGS_ID_RESET, NULL);
+    _cbs[TAGS_EVT_RESET](status, TAGS_ID_RESET, NULL);
 }
 
 uint8_t NfcTags::cmdDiscover(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
-    // check state
-    if (_state != TAGS_STATE_INIT_DONE) {
+    // check state, at least one technology is polled
+    if (_state != TAGS_STATE_INIT_DONE || _techs == 0) {
         status = TAGS_STATUS_REJECTED;
         goto bail;
     }
@@ -276,8 +526,10 @@ bail:
 void NfcTags::handleDiscover(void)
 {
     uint8_t status;
-    
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    uint8_t i, num;
+    tNCI_DISCOVER_CONFS confs[DISCOVER_CONFS_NUM];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
     // discover command state machine
     switch(_state) {
@@ -287,14 +539,56 @@ void NfcTags::handleDiscover(void)
             break;
         case TAGS_STATE_DISCOVER:
             // send NCI discover command to activate polling
-            status = _nci.cmdRfDiscover(sizeof(discover_confs)/sizeof(tNCI_DISCOVER_CONFS), discover_confs);
+            // of the technologies selected
+            num = 0;
+            for (i = 0; i < DISCOVER_CONFS_NUM; i++) {
+                if (_techs & discover_confs[i].tech) {
+                    confs[num++] = discover_confs[i].conf;
+                }
+            }
+            status = _nci.cmdRfDiscover(num, confs);
             break;
         case TAGS_STATE_DISCOVER_NTF:
             // wait for tag detection
             status = NCI_STATUS_OK;
             break;
         case TAGS_STATE_DISCOVER_ACTIVATED:
-            // tags activated
+            // tags activated, idle ones checked every interval
+            status = NCI_STATUS_OK;
+            if (_check == 0 || _p_tagIntf == NULL || (uint32_t)(millis() - _check_time) < _check) {
+                break;
+            }
+            if (_p_tagIntf->checkPresence() == TAGS_STATUS_OK) {
+                _state = TAGS_STATE_DISCOVER_PRESENCE;
+            }
+            else {
+                _check_time = millis();
+            }
+            break;
+        case TAGS_STATE_DISCOVER_PRESENCE:
+            // presence check pending
+            if (_p_tagIntf->handlePresence() != TAGS_STATUS_OK) {
+                presence(TAGS_STATUS_FAILED);
+            }
+            status = NCI_STATUS_OK;
+            break;
+#if NFC_CONFIG_TAG_TYPE2
+        case TAGS_STATE_DISCOVER_PROBE:
+            // GET_VERSION sent to the new tag
+            if (getTag2().handleProbe() != TAGS_STATUS_OK) {
+                cbIntf(TAGS_STATUS_FAILED, TAGS_ID_DISCOVER_ACTIVATED, NULL);
+            }
+            status = NCI_STATUS_OK;
+            break;
+#endif
+        case TAGS_STATE_DISCOVER_REACTIVATE:
+            // tag not answering the probe is halted, deactivate
+            // it so that it is activated again
+            status = _nci.cmdRfDeactivate(NCI_DEACTIVATE_TYPE_DISCOVERY);
+            _state = TAGS_STATE_DISCOVER_REACTIVATE_NTF;
+            break;
+        case TAGS_STATE_DISCOVER_REACTIVATE_NTF:
+            // wait for deactivation
             status = NCI_STATUS_OK;
             break;
         default:
@@ -305,9 +599,9 @@ void NfcTags::handleDiscover(void)
 
     // check status and notify
     if (status != NCI_STATUS_OK) {
-        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, nfcTagsStateToStr[_state], status);
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
         status = translateNciStatus(status);
-        _p_cb->cbDiscover(status, TAGS_ID_DISCOVER, NULL);
+        _cbs[TAGS_EVT_DISCOVER](status, TAGS_ID_DISCOVER, NULL);
     }
 }
 
@@ -328,7 +622,7 @@ void NfcTags::cbRfDiscoverMap(uint8_t status, uint16_t id, void *data)
     }
 
     status = translateNciStatus(status);
-    _p_cb->cbDeactivate(status, TAGS_ID_DISCOVER, NULL);
+    _cbs[TAGS_EVT_DEACTIVATE](status, TAGS_ID_DISCOVER, NULL);
 }
 
 void NfcTags::cbRfDiscover(uint8_t status, uint16_t id, void *data)
@@ -351,15 +645,30 @@ void NfcTags::cbRfDiscover(uint8_t status, uint16_t id, void *data)
         status = translateNciStatus(status);
     }
 
-    _p_cb->cbDiscover(status, TAGS_ID_DISCOVER, NULL);
+    _cbs[TAGS_EVT_DISCOVER](status, TAGS_ID_DISCOVER, NULL);
 }
 
 
 void NfcTags::cbRfDiscoverNtf(uint8_t status, uint16_t id, void *data)
 {
+    bool probe;
+
     _log.d("NfcTags: %s status = %d id = %d\n", __func__, status, id);
     setNciResponse(status, id, data);
 
+    // tag halted during a dump activated again, the dump goes on
+    // with the interface as it was, any other tag fails it
+    if (_state == TAGS_STATE_DUMP_REACTIVATE_NTF) {
+        if (status == NCI_STATUS_OK && id == NCI_ID_NTF_RF_INTF_ACTIVATED && isSeen()) {
+            _log.i("NfcTags: tag activated again\n");
+            _state = TAGS_STATE_DUMP;
+            return;
+        }
+        _id = TAGS_ID_DISCOVER;
+        _state = TAGS_STATE_DISCOVER_NTF;
+        _cbs[TAGS_EVT_DUMP](TAGS_STATUS_FAILED, TAGS_ID_DUMP, NULL);
+    }
+
     if (status == NCI_STATUS_OK) {
         if (id == NCI_ID_NTF_RF_INTF_ACTIVATED) {
             _log.i("NfcTags: tag activated\n");
@@ -375,59 +684,215 @@ void NfcTags::cbRfDiscoverNtf(uint8_t status, uint16_t id, void *data)
         status = translateNciStatus(status);
     }
 
-    // identify tag found and notify application
-    identifyTag((tNCI_RF_INTF *)data);
-    _p_cb->cbDiscoverNtf(status, TAGS_ID_DISCOVER_ACTIVATED, NULL);
+    // identify tag found and notify application, once
+    // probed when it is not known yet
+    probe = identifyTag((tNCI_RF_INTF *)data);
+    if (status == TAGS_STATUS_OK && isBounce()) {
+        // same tag as last one, deactivated again
+        _p_tagIntf = NULL;
+        _state = TAGS_STATE_DISCOVER_REACTIVATE;
+        return;
+    }
+#if NFC_CONFIG_TAG_TYPE2
+    if (probe && status == TAGS_STATUS_OK && getTag2().cmdProbe() == TAGS_STATUS_OK) {
+        _state = TAGS_STATE_DISCOVER_PROBE;
+        return;
+    }
+#else
+    (void)probe;
+#endif
+    _check_time = millis();
+    _cbs[TAGS_EVT_DISCOVER_NTF](status, TAGS_ID_DISCOVER_ACTIVATED, NULL);
+}
+
+static bool matchTag(const tTAGS_IDENTIFY *p_id, tNCI_RF_INTF *rf_intf)
+{
+    tNCI_RF_PARAMS_PA *p_poll_a = &rf_intf->specific.params.poll_a;
+
+    if (p_id->protocol != rf_intf->protocol) {
+        return false;
+    }
+    if (p_id->sens_res_mask == 0 && p_id->sel_res_mask == 0 && p_id->nfcid_len == 0) {
+        return true;
+    }
+
+    // NFC-A parameters
+    if (rf_intf->specific.type != NCI_DISCOVERY_TYPE_POLL_A) {
+        return false;
+    }
+    if ((p_poll_a->sens_res[0] & p_id->sens_res_mask) != p_id->sens_res) {
+        return false;
+    }
+    if (p_id->sel_res_mask != 0 &&
+        (p_poll_a->sel_res_len == 0 || (p_poll_a->sel_res & p_id->sel_res_mask) != p_id->sel_res)) {
+        return false;
+    }
+    if (p_id->nfcid_len != 0 &&
+        (p_poll_a->nfcid_len != p_id->nfcid_len || p_poll_a->nfcid[0] != p_id->nfcid0)) {
+        return false;
+    }
+
+    return true;
 }
 
-#define UID_SIZE_DOUBLE     7
-#define UID_NXP             0x04
-#define BIT_MASK(val, bit)  (val & (1 << bit))
+NfcTagsIntf* NfcTags::getTagIntf(uint8_t type)
+{
+#if NFC_CONFIG_SHARED_INTF
+    NfcTagsIntf *p_intf;
+
+    // the interface is constructed again on each activation,
+    // in place of the previous one, with the settings kept
+    switch(type) {
+#if NFC_CONFIG_TAG_TYPE1
+        case TAGS_TYPE_1:
+            p_intf = new (_intf) NfcTagsIntfType1(_log, _nci);
+            break;
+#endif
+#if NFC_CONFIG_TAG_TYPE2
+        case TAGS_TYPE_2:
+            p_intf = new (_intf) NfcTagsIntfType2(_log, _nci);
+            break;
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+        case TAGS_TYPE_3:
+            p_intf = new (_intf) NfcTagsIntfType3(_log, _nci);
+            break;
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+        case TAGS_TYPE_4:
+            p_intf = new (_intf) NfcTagsIntfType4(_log, _nci);
+            static_cast<NfcTagsIntfType4 *>(p_intf)->setChunkSize(_chunk);
+            break;
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+        case TAGS_TYPE_5:
+            p_intf = new (_intf) NfcTagsIntfType5(_log, _nci);
+            break;
+#endif
+#if NFC_CONFIG_TAG_MIFARE
+        case TAGS_TYPE_MIFARE:
+            p_intf = new (_intf) NfcTagsIntfMifare(_log, _nci);
+            if (_p_keys != NULL) {      // else keep the default keys
+                static_cast<NfcTagsIntfMifare *>(p_intf)->setKeys(_p_keys, _num_keys);
+            }
+            break;
+#endif
+        default:
+            return NULL;
+    }
+    p_intf->init(this);
+
+    return p_intf;
+#else
+    switch(type) {
+#if NFC_CONFIG_TAG_TYPE1
+        case TAGS_TYPE_1:
+            return &_tag1;
+#endif
+#if NFC_CONFIG_TAG_TYPE2
+        case TAGS_TYPE_2:
+            return &_tag2;
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+        case TAGS_TYPE_3:
+            return &_tag3;
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+        case TAGS_TYPE_4:
+            return &_tag4;
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+        case TAGS_TYPE_5:
+            return &_tag5;
+#endif
+#if NFC_CONFIG_TAG_MIFARE
+        case TAGS_TYPE_MIFARE:
+            return &_tagMifare;
+#endif
+        default:
+            return NULL;
+    }
+#endif
+}
 
-void NfcTags::identifyTag(tNCI_RF_INTF *rf_intf)
+bool NfcTags::identifyTag(tNCI_RF_INTF *rf_intf)
 {
-    uint8_t b;
+    const tTAGS_IDENTIFY *p_id = NULL;
+    tTAGS_CACHE_ENTRY *p_entry;
+    uint8_t i;
 
+    _p_tagIntf = NULL;
+    _p_entry = NULL;
     if (rf_intf == NULL) {
-        return;
+        return false;
     }
 
-    // FIXME: Mifare Ultra Ligth tag type 2 only at the moment
-    // See NXP application note documents AN1303 and AN1305
-    if (rf_intf->specific.type == NCI_DISCOVERY_TYPE_POLL_A) {
-        if (rf_intf->specific.params.poll_a.nfcid_len == UID_SIZE_DOUBLE) {
-            if (rf_intf->specific.params.poll_a.nfcid[0] == UID_NXP) {
-                // card is a Mifare Ultra Ligth card
-                _tag2.initTag(rf_intf);
-                _p_tagIntf = &_tag2;
-            }
+    // first matching entry
+    for (i = 0; i < sizeof(identify_table) / sizeof(tTAGS_IDENTIFY); i++) {
+        if (matchTag(&identify_table[i], rf_intf)) {
+            p_id = &identify_table[i];
+            break;
         }
-        else if (rf_intf->specific.params.poll_a.sel_res_len == 1) {
-            b = rf_intf->specific.params.poll_a.sel_res;
-            if (BIT_MASK(b, 3) && BIT_MASK(b, 4)) {
-                // card is a Mifare classic card
-                _tagMifare.initTag(rf_intf);
-                _p_tagIntf = &_tagMifare;
-            }
+    }
+    if (p_id == NULL) {
+        return false;
+    }
+    // tag type not built
+    _p_tagIntf = getTagIntf(p_id->type);
+    if (_p_tagIntf == NULL) {
+        return false;
+    }
+    _p_tagIntf->initTag(rf_intf);
+
+    // tag tapped again, probe response known
+    p_entry = _cache.find(_p_tagIntf->getNfcidBuf(), _p_tagIntf->getNfcidLen());
+    if (p_entry != NULL && p_entry->type == p_id->type) {
+#if NFC_CONFIG_TAG_TYPE2
+        if (p_id->type == TAGS_TYPE_2 && p_entry->info_len == TAGS_T2_VERSION_SIZE) {
+            getTag2().setVersion(p_entry->info);
         }
+#endif
+        _p_entry = p_entry;
+        return false;
     }
-    else {
-        _p_tagIntf = NULL;
+
+    // new tag, probe it first if needed
+    if ((p_id->flags & TAGS_IDENTIFY_PROBE) && _probe) {
+        return true;
     }
+    p_entry = _cache.add(_p_tagIntf->getNfcidBuf(), _p_tagIntf->getNfcidLen());
+    if (p_entry != NULL) {
+        p_entry->type = p_id->type;
+    }
+    _p_entry = p_entry;
+
+    return false;
 }
 
 uint8_t NfcTags::cmdDeactivate(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
     switch(_state) {
         case TAGS_STATE_DISCOVER_ACTIVATED:
+        case TAGS_STATE_DISCOVER_PRESENCE:
         case TAGS_STATE_DUMP:
-            _state = TAGS_STATE_DEACTIVATE;
+        case TAGS_STATE_READ:
+        case TAGS_STATE_WRITE:
+        case TAGS_STATE_READ_NDEF:
+        case TAGS_STATE_APDU:
+            remember();
             _id = TAGS_ID_DEACTIVATE;
+            _pending.id = TAGS_ID_NONE;
             status = TAGS_STATUS_OK;
+            // idle tag kept activated until removed
+            if (_hold != 0 && _state == TAGS_STATE_DISCOVER_ACTIVATED && _p_tagIntf != NULL) {
+                _state = TAGS_STATE_HOLD;
+                break;
+            }
+            _state = TAGS_STATE_DEACTIVATE;
             _p_tagIntf = NULL;
             break;
         default:
@@ -442,7 +907,7 @@ void NfcTags::handleDeactivate(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
     // discover command state machine
     switch(_state) {
@@ -460,6 +925,28 @@ void NfcTags::handleDeactivate(void)
             _state = TAGS_STATE_DISCOVER_NTF;
             status = NCI_STATUS_OK;
             break;
+        case TAGS_STATE_HOLD:
+            // check presence every interval, deactivate
+            // tags which do not support it
+            status = NCI_STATUS_OK;
+            if ((uint32_t)(millis() - _seen) < _hold) {
+                break;
+            }
+            if (_p_tagIntf->checkPresence() == TAGS_STATUS_OK) {
+                _state = TAGS_STATE_HOLD_CHECK;
+            }
+            else {
+                _state = TAGS_STATE_DEACTIVATE;
+                _p_tagIntf = NULL;
+            }
+            break;
+        case TAGS_STATE_HOLD_CHECK:
+            // presence check pending
+            if (_p_tagIntf->handlePresence() != TAGS_STATUS_OK) {
+                presence(TAGS_STATUS_FAILED);
+            }
+            status = NCI_STATUS_OK;
+            break;
         default:
             // unhandled state
             status = NCI_STATUS_REJECTED;
@@ -468,9 +955,9 @@ void NfcTags::handleDeactivate(void)
 
     // check status and notify
     if (status != NCI_STATUS_OK) {
-        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, nfcTagsStateToStr[_state], status);
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
         status = translateNciStatus(status);
-        _p_cb->cbDeactivate(status, TAGS_ID_DEACTIVATE, NULL);
+        _cbs[TAGS_EVT_DEACTIVATE](status, TAGS_ID_DEACTIVATE, NULL);
     }
 }
 
@@ -481,7 +968,11 @@ void NfcTags::cbRfDeactivate(uint8_t status, uint16_t id, void *data)
 
     if (status == NCI_STATUS_OK) {
         if (id == NCI_ID_RSP_RF_DEACTIVATE) {
-            _state = TAGS_STATE_DEACTIVATE_RSP;
+            // deactivation after a probe or during a dump is not notified
+            if (_state != TAGS_STATE_DISCOVER_REACTIVATE_NTF &&
+                _state != TAGS_STATE_DUMP_REACTIVATE_NTF) {
+                _state = TAGS_STATE_DEACTIVATE_RSP;
+            }
             return;
         }
         else {
@@ -490,7 +981,7 @@ void NfcTags::cbRfDeactivate(uint8_t status, uint16_t id, void *data)
     }
 
     status = translateNciStatus(status);
-    _p_cb->cbDeactivate(status, TAGS_ID_DEACTIVATE, NULL);
+    _cbs[TAGS_EVT_DEACTIVATE](status, TAGS_ID_DEACTIVATE, NULL);
 }
 
 void NfcTags::cbRfDeactivateNtf(uint8_t status, uint16_t id, void *data)
@@ -499,6 +990,15 @@ void NfcTags::cbRfDeactivateNtf(uint8_t status, uint16_t id, void *data)
     setNciResponse(status, id, data);
 
     if (status == NCI_STATUS_OK) {
+        if (id == NCI_ID_NTF_RF_DEACTIVATE && _state == TAGS_STATE_DISCOVER_REACTIVATE_NTF) {
+            // deactivation after a probe, wait for activation again
+            _state = TAGS_STATE_DISCOVER_NTF;
+            return;
+        }
+        if (id == NCI_ID_NTF_RF_DEACTIVATE && _state == TAGS_STATE_DUMP_REACTIVATE_NTF) {
+            // deactivation during a dump, wait for activation again
+            return;
+        }
         if (id == NCI_ID_NTF_RF_DEACTIVATE) {
             _log.i("NfcTags: tag deactivated\n");
             // re-start discover loop
@@ -516,14 +1016,159 @@ void NfcTags::cbRfDeactivateNtf(uint8_t status, uint16_t id, void *data)
         status = translateNciStatus(status);
     }
 
-    _p_cb->cbDeactivate(status, TAGS_ID_DEACTIVATE, NULL);
+    _cbs[TAGS_EVT_DEACTIVATE](status, TAGS_ID_DEACTIVATE, NULL);
+}
+
+void NfcTags::remember(void)
+{
+    // last tag seen, for debounce
+    _seen = millis();
+    _seen_len = 0;
+    if (_p_tagIntf != NULL && _p_tagIntf->getNfcidBuf() != NULL &&
+        _p_tagIntf->getNfcidLen() <= TAGS_CACHE_UID_LENGTH) {
+        _seen_len = _p_tagIntf->getNfcidLen();
+        memcpy(_seen_uid, _p_tagIntf->getNfcidBuf(), _seen_len);
+    }
+}
+
+void NfcTags::presence(uint8_t status)
+{
+    // activated tag checked when idle, still there or
+    // removed, then deactivated to discover the next one
+    if (_state == TAGS_STATE_DISCOVER_PRESENCE) {
+        if (status == TAGS_STATUS_OK) {
+            _check_time = millis();
+            _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            release(TAGS_STATUS_OK);
+            return;
+        }
+        _log.i("NfcTags: tag removed\n");
+        remember();
+        _p_tagIntf = NULL;
+        _state = TAGS_STATE_DISCOVER_REACTIVATE;
+        _cbs[TAGS_EVT_REMOVED](TAGS_STATUS_OK, TAGS_ID_PRESENCE, NULL);
+        release(TAGS_STATUS_FAILED);
+        return;
+    }
+
+    if (_state != TAGS_STATE_HOLD_CHECK) {
+        return;
+    }
+
+    // still there, checked again after the interval,
+    // else removed and deactivated
+    if (status == TAGS_STATUS_OK) {
+        _seen = millis();
+        _state = TAGS_STATE_HOLD;
+    }
+    else {
+        _log.i("NfcTags: tag removed\n");
+        _seen = millis();
+        _state = TAGS_STATE_DEACTIVATE;
+        _p_tagIntf = NULL;
+    }
+}
+
+bool NfcTags::hold(uint8_t id)
+{
+    // one command held at a time, while a presence check is pending
+    if (_state != TAGS_STATE_DISCOVER_PRESENCE || _pending.id != TAGS_ID_NONE) {
+        return false;
+    }
+
+    memset(&_pending, 0, sizeof(_pending));
+    _pending.id = id;
+    return true;
+}
+
+void NfcTags::release(uint8_t status)
+{
+    tTAGS_PENDING cmd = _pending;
+    uint8_t evt;
+
+    if (cmd.id == TAGS_ID_NONE) {
+        return;
+    }
+    _pending.id = TAGS_ID_NONE;
+
+    // command held started now that the tag answered
+    if (status == TAGS_STATUS_OK) {
+        switch(cmd.id) {
+            case TAGS_ID_DUMP:
+                status = cmdDump();
+                break;
+            case TAGS_ID_READ:
+                status = cmdRead(cmd.block, cmd.buf, cmd.size);
+                break;
+            case TAGS_ID_WRITE:
+                status = cmd.ndef ? cmdWriteNdef(cmd.cmd, cmd.len, cmd.old) :
+                                    cmdWrite(cmd.block, cmd.cmd, cmd.len, cmd.verify);
+                break;
+            case TAGS_ID_READ_NDEF:
+                status = cmdReadNdef(cmd.buf, cmd.size);
+                break;
+            default:
+                status = cmdExchangeApdu(cmd.cmd, cmd.len, cmd.buf, cmd.size);
+                break;
+        }
+        if (status == TAGS_STATUS_OK) {
+            return;
+        }
+    }
+
+    // tag removed or command rejected, notified as its response
+    switch(cmd.id) {
+        case TAGS_ID_DUMP:
+            evt = TAGS_EVT_DUMP;
+            break;
+        case TAGS_ID_READ:
+            evt = TAGS_EVT_READ;
+            break;
+        case TAGS_ID_WRITE:
+            evt = TAGS_EVT_WRITE;
+            break;
+        case TAGS_ID_READ_NDEF:
+            evt = TAGS_EVT_NDEF;
+            break;
+        default:
+            evt = TAGS_EVT_APDU;
+            break;
+    }
+    _cbs[evt](status, cmd.id, NULL);
+}
+
+bool NfcTags::isSeen(void)
+{
+    // activated tag is the last one seen
+    return _p_tagIntf != NULL && _seen_len != 0 &&
+           _p_tagIntf->getNfcidLen() == _seen_len &&
+           memcmp(_p_tagIntf->getNfcidBuf(), _seen_uid, _seen_len) == 0;
+}
+
+bool NfcTags::isBounce(void)
+{
+    // last tag seen again within the debounce time
+    if (_debounce == 0 || !isSeen() || (uint32_t)(millis() - _seen) >= _debounce) {
+        return false;
+    }
+
+    // the window restarts as long as the tag stays
+    _log.i("NfcTags: same tag, ignored\n");
+    _seen = millis();
+    return true;
 }
 
 uint8_t NfcTags::cmdDump(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_DUMP)) {
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
 
     // check state
     if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
@@ -543,6 +1188,9 @@ uint8_t NfcTags::cmdDump(void)
         goto bail;
     }
 
+    // content cached again from the first block
+    _cache_len = 0;
+
     // prepare state machine
     _state = TAGS_STATE_DUMP;
     _id = TAGS_ID_DUMP;
@@ -556,23 +1204,504 @@ void NfcTags::handleDump(void)
 {
     uint8_t status;
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsStateToStr[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    switch(_state) {
+        case TAGS_STATE_DUMP:
+            status = (_p_tagIntf != NULL) ? _p_tagIntf->handleDump() : TAGS_STATUS_FAILED;
+            break;
+        case TAGS_STATE_DUMP_REACTIVATE:
+            // tag halted, deactivate it so that it is activated again
+            status = translateNciStatus(_nci.cmdRfDeactivate(NCI_DEACTIVATE_TYPE_DISCOVERY));
+            _state = TAGS_STATE_DUMP_REACTIVATE_NTF;
+            break;
+        case TAGS_STATE_DUMP_REACTIVATE_NTF:
+            // wait for activation, unless the tag was removed
+            status = TAGS_STATUS_OK;
+            if ((uint32_t)(millis() - _seen) >= TAGS_REACTIVATE_TIME) {
+                _log.e("NfcTags: tag not activated again\n");
+                _p_tagIntf = NULL;
+                status = TAGS_STATUS_FAILED;
+            }
+            break;
+        default:
+            status = TAGS_STATUS_REJECTED;
+            break;
+    }
+
+    // check status and notify
+    if (status != TAGS_STATUS_OK) {
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _id = TAGS_ID_DISCOVER;
+        _state = (_p_tagIntf != NULL) ? TAGS_STATE_DISCOVER_ACTIVATED : TAGS_STATE_DISCOVER_NTF;
+        _cbs[TAGS_EVT_DUMP](status, TAGS_ID_DUMP, NULL);
+    }
+}
+
+uint8_t NfcTags::cmdRead(uint16_t block, uint8_t *buf, uint16_t len)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_READ)) {
+        _pending.block = block;
+        _pending.buf = buf;
+        _pending.size = len;
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
+
+    // check state
+    if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check tag is activated
+    if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare tag interface, rejected by tags without read support
+    status = _p_tagIntf->cmdRead(block, buf, len);
+    if (status != TAGS_STATUS_OK) {
+        goto bail;
+    }
+
+    // prepare state machine
+    _state = TAGS_STATE_READ;
+    _id = TAGS_ID_READ;
+
+bail:
+    return status;
+}
+
+void NfcTags::handleRead(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
 
     // check state and tag interface
-    if (_state != TAGS_STATE_DUMP) {
+    if (_state != TAGS_STATE_READ) {
         status = TAGS_STATUS_REJECTED;
     }
     else if (_p_tagIntf == NULL) {
         status = TAGS_STATUS_FAILED;
     }
     else {
-        status = _p_tagIntf->handleDump();
+        status = _p_tagIntf->handleRead();
     }
 
     // check status and notify
     if (status != TAGS_STATUS_OK) {
-        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, nfcTagsStateToStr[_state], status);
-        _p_cb->cbDump(status, TAGS_ID_DUMP, NULL);
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _id = TAGS_ID_DISCOVER;
+        _state = TAGS_STATE_DISCOVER_ACTIVATED;
+        _cbs[TAGS_EVT_READ](status, TAGS_ID_READ, NULL);
+    }
+}
+
+uint8_t NfcTags::cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_WRITE)) {
+        _pending.block = block;
+        _pending.cmd = buf;
+        _pending.len = len;
+        _pending.verify = verify;
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
+
+    // check state
+    if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check tag is activated
+    if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare tag interface, rejected by tags without write support
+    status = _p_tagIntf->cmdWrite(block, buf, len, verify);
+    if (status != TAGS_STATUS_OK) {
+        goto bail;
+    }
+
+    // prepare state machine
+    _state = TAGS_STATE_WRITE;
+    _id = TAGS_ID_WRITE;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTags::cmdWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_WRITE)) {
+        _pending.ndef = true;
+        _pending.cmd = buf;
+        _pending.len = len;
+        _pending.old = old;
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
+
+    // check state
+    if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check tag is activated
+    if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare tag interface, rejected by tags without NDEF support
+    status = _p_tagIntf->cmdWriteNdef(buf, len, old);
+    if (status != TAGS_STATUS_OK) {
+        goto bail;
+    }
+
+    // prepare state machine, same as block write
+    _state = TAGS_STATE_WRITE;
+    _id = TAGS_ID_WRITE;
+
+bail:
+    return status;
+}
+
+void NfcTags::handleWrite(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // check state and tag interface
+    if (_state != TAGS_STATE_WRITE) {
+        status = TAGS_STATUS_REJECTED;
+    }
+    else if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+    }
+    else {
+        status = _p_tagIntf->handleWrite();
+    }
+
+    // check status and notify
+    if (status != TAGS_STATUS_OK) {
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _id = TAGS_ID_DISCOVER;
+        _state = TAGS_STATE_DISCOVER_ACTIVATED;
+        _cbs[TAGS_EVT_WRITE](status, TAGS_ID_WRITE, NULL);
+    }
+}
+
+uint8_t NfcTags::cmdReadNdef(uint8_t *buf, uint16_t size)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_READ_NDEF)) {
+        _pending.buf = buf;
+        _pending.size = size;
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
+
+    // check state
+    if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check tag is activated
+    if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare tag interface, rejected by tags without NDEF support
+    status = _p_tagIntf->cmdReadNdef(buf, size);
+    if (status != TAGS_STATUS_OK) {
+        goto bail;
+    }
+
+    // prepare state machine
+    _state = TAGS_STATE_READ_NDEF;
+    _id = TAGS_ID_READ_NDEF;
+
+bail:
+    return status;
+}
+
+void NfcTags::handleReadNdef(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // check state and tag interface
+    if (_state != TAGS_STATE_READ_NDEF) {
+        status = TAGS_STATUS_REJECTED;
+    }
+    else if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+    }
+    else {
+        status = _p_tagIntf->handleReadNdef();
+    }
+
+    // check status and notify
+    if (status != TAGS_STATUS_OK) {
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _id = TAGS_ID_DISCOVER;
+        _state = TAGS_STATE_DISCOVER_ACTIVATED;
+        _cbs[TAGS_EVT_NDEF](status, TAGS_ID_READ_NDEF, NULL);
+    }
+}
+
+uint8_t NfcTags::cmdExchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // started once the pending presence check completes
+    if (hold(TAGS_ID_APDU)) {
+        _pending.cmd = apdu;
+        _pending.len = len;
+        _pending.buf = rsp;
+        _pending.size = size;
+        status = TAGS_STATUS_OK;
+        goto bail;
+    }
+
+    // check state
+    if (_state != TAGS_STATE_DISCOVER_ACTIVATED) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check tag is activated
+    if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare tag interface, rejected by tags other than ISO-DEP
+    status = _p_tagIntf->cmdExchangeApdu(apdu, len, rsp, size);
+    if (status != TAGS_STATUS_OK) {
+        goto bail;
+    }
+
+    // prepare state machine
+    _state = TAGS_STATE_APDU;
+    _id = TAGS_ID_APDU;
+
+bail:
+    return status;
+}
+
+void NfcTags::handleApdu(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // check state and tag interface
+    if (_state != TAGS_STATE_APDU) {
+        status = TAGS_STATUS_REJECTED;
+    }
+    else if (_p_tagIntf == NULL) {
+        status = TAGS_STATUS_FAILED;
+    }
+    else {
+        status = _p_tagIntf->handleApdu();
+    }
+
+    // check status and notify
+    if (status != TAGS_STATUS_OK) {
+        _log.e("NfcTags: %s state = %s error status = %d\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state), status);
+        _id = TAGS_ID_DISCOVER;
+        _state = TAGS_STATE_DISCOVER_ACTIVATED;
+        _cbs[TAGS_EVT_APDU](status, TAGS_ID_APDU, NULL);
+    }
+}
+
+void NfcTags::cbIntf(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("NfcTags: %s status = %d id = %d\n", __func__, status, id);
+    _check_time = millis();
+
+    // back to the activated state (discover handler) once the command
+    // completes, before notifying so that the application may chain commands
+    switch(id) {
+#if NFC_CONFIG_TAG_TYPE2
+        case TAGS_ID_DISCOVER_ACTIVATED:
+            probed(status);
+            break;
+#endif
+        case TAGS_ID_PRESENCE:
+            presence(status);
+            break;
+        case TAGS_ID_DUMP:
+            if (status != TAGS_STATUS_OK || !((tTAGS_DUMP *)data)->more) {
+                _id = TAGS_ID_DISCOVER;
+                _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            }
+            cacheDump(status, (tTAGS_DUMP *)data);
+            _cbs[TAGS_EVT_DUMP](status, id, data);
+            break;
+        case TAGS_ID_REACTIVATE:
+            // tag halted during a dump, activated again before the
+            // dump goes on, the interface keeps its state
+            remember();
+            _state = TAGS_STATE_DUMP_REACTIVATE;
+            break;
+        case TAGS_ID_READ:
+            _id = TAGS_ID_DISCOVER;
+            _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            cacheRead(status, (tTAGS_READ *)data);
+            _cbs[TAGS_EVT_READ](status, id, data);
+            break;
+        case TAGS_ID_WRITE:
+            _id = TAGS_ID_DISCOVER;
+            _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            // content changed, even when the write failed half way
+            if (_p_entry != NULL) {
+                _p_entry->data_len = 0;
+            }
+            _cbs[TAGS_EVT_WRITE](status, id, data);
+            break;
+        case TAGS_ID_READ_NDEF:
+            _id = TAGS_ID_DISCOVER;
+            _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            _cbs[TAGS_EVT_NDEF](status, id, data);
+            break;
+        case TAGS_ID_APDU:
+            _id = TAGS_ID_DISCOVER;
+            _state = TAGS_STATE_DISCOVER_ACTIVATED;
+            _cbs[TAGS_EVT_APDU](status, id, data);
+            break;
+        default:
+            _log.e("NfcTags: %s ignore unknown event %d\n", __func__, id);
+            break;
+    }
+}
+
+#if NFC_CONFIG_TAG_TYPE2
+void NfcTags::probed(uint8_t status)
+{
+    tTAGS_CACHE_ENTRY *p_entry;
+
+    // remember the tag, with its version if it answered
+    p_entry = _cache.add(getTag2().getNfcidBuf(), getTag2().getNfcidLen());
+    if (p_entry != NULL) {
+        p_entry->type = TAGS_TYPE_2;
+        if (status == TAGS_STATUS_OK) {
+            memcpy(p_entry->info, getTag2().getVersion(), TAGS_T2_VERSION_SIZE);
+            p_entry->info_len = TAGS_T2_VERSION_SIZE;
+        }
+    }
+    _p_entry = p_entry;
+
+    if (status == TAGS_STATUS_OK) {
+        _state = TAGS_STATE_DISCOVER_ACTIVATED;
+        _check_time = millis();
+        _cbs[TAGS_EVT_DISCOVER_NTF](status, TAGS_ID_DISCOVER_ACTIVATED, NULL);
+    }
+    else {
+        // the tag is halted after a NACK, it is notified once
+        // activated again, identified from the cache then
+        _log.i("NfcTags: tag does not support GET_VERSION\n");
+        _p_tagIntf = NULL;
+        _state = TAGS_STATE_DISCOVER_REACTIVATE;
+    }
+}
+#endif
+
+const uint8_t* NfcTags::getCachedData(uint16_t *len)
+{
+    if (_p_tagIntf == NULL || _cache_age == 0 || len == NULL) {
+        return NULL;
+    }
+
+    return _cache.getData(_p_entry, _cache_age, len);
+}
+
+void NfcTags::cacheDump(uint8_t status, tTAGS_DUMP *p_dump)
+{
+    uint16_t len;
+
+    if (_p_entry == NULL || _cache_age == 0) {
+        return;
+    }
+
+    // content is only valid once the dump completes
+    _p_entry->data_len = 0;
+    if (status != TAGS_STATUS_OK) {
+        return;
+    }
+
+    // first bytes of the dump, the rest is dropped
+    len = p_dump->len;
+    if (_cache_len + len > TAGS_CACHE_DATA_SIZE) {
+        len = TAGS_CACHE_DATA_SIZE - _cache_len;
+    }
+    memcpy(&_p_entry->data[_cache_len], p_dump->buf, len);
+    _cache_len += len;
+
+    if (!p_dump->more) {
+        _p_entry->data_len = _cache_len;
+        _p_entry->time = millis();
+    }
+}
+
+void NfcTags::cacheRead(uint8_t status, tTAGS_READ *p_read)
+{
+    uint32_t offset;
+    uint16_t len;
+
+    if (_p_entry == NULL || _p_entry->data_len == 0 || status != TAGS_STATUS_OK) {
+        return;
+    }
+
+    // compare the blocks cached, content is fresh again
+    // if they did not change, dropped otherwise
+    offset = (uint32_t)p_read->block * _p_tagIntf->getBlockSize();
+    if (offset >= _p_entry->data_len) {
+        return;
+    }
+    len = p_read->len;
+    if (offset + len > _p_entry->data_len) {
+        len = _p_entry->data_len - offset;
+    }
+    if (memcmp(&_p_entry->data[offset], p_read->buf, len) == 0) {
+        _p_entry->time = millis();
+    }
+    else {
+        _p_entry->data_len = 0;
     }
 }
 
@@ -586,3 +1715,50 @@ void NfcTags::cbData(uint8_t status, uint16_t id, void *data)
     }
 }
 
+uint8_t NfcTags::cmdPowerDown(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // only when idle, i.e. no NCI response is pending
+    switch(_state) {
+        case TAGS_STATE_NONE:
+        case TAGS_STATE_INIT_DONE:
+        case TAGS_STATE_DISCOVER_NTF:
+        case TAGS_STATE_DISCOVER_ACTIVATED:
+            _nci.powerDown();
+            _state = TAGS_STATE_POWER_DOWN;
+            _id = TAGS_ID_POWER_DOWN;
+            _p_tagIntf = NULL;
+            status = TAGS_STATUS_OK;
+            break;
+        default:
+            status = TAGS_STATUS_REJECTED;
+            break;
+    }
+
+    return status;
+}
+
+uint8_t NfcTags::cmdPowerUp(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsStateToStr, _state));
+
+    // check state
+    if (_state != TAGS_STATE_POWER_DOWN) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // power up then go through the reset sequence
+    _nci.powerUp();
+    _state = TAGS_STATE_INIT_RESET;
+    _id = TAGS_ID_RESET;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
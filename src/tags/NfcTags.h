@@ -25,17 +25,48 @@
 #include "tags/NfcTagsDef.h"
 #include "tags/NfcTagsCb.h"
 #include "tags/NfcTagsIntf.h"
+#include "tags/NfcTagsCache.h"
+#include "nci/NfcDelegate.h"
 #include "log/NfcLog.h"
 #include "nci/NfcNci.h"
 
+// size of the storage shared by the tag interfaces built
+#define TAGS_INTF_MAX(a, b)     ((a) > (b) ? (a) : (b))
+#define TAGS_INTF_SIZE          TAGS_INTF_MAX(TAGS_INTF_MAX( \
+    TAGS_INTF_MAX(NFC_CONFIG_TAG_TYPE1 * sizeof(NfcTagsIntfType1), NFC_CONFIG_TAG_TYPE2 * sizeof(NfcTagsIntfType2)), \
+    TAGS_INTF_MAX(NFC_CONFIG_TAG_TYPE3 * sizeof(NfcTagsIntfType3), NFC_CONFIG_TAG_TYPE4 * sizeof(NfcTagsIntfType4))), \
+    TAGS_INTF_MAX(NFC_CONFIG_TAG_TYPE5 * sizeof(NfcTagsIntfType5), NFC_CONFIG_TAG_MIFARE * sizeof(NfcTagsIntfMifare)))
+
+// Command received while a presence check is pending, started
+// once the tag answered
+typedef struct {
+    uint8_t id;                 // TAGS_ID_xxx, TAGS_ID_NONE if none
+    bool ndef;                  // write of an NDEF message
+    bool verify;                // write read back
+    uint16_t block;             // read and write first block
+    const uint8_t *cmd;         // write data, NDEF message or APDU
+    uint16_t len;               // its length
+    uint8_t *buf;               // read, NDEF or response buffer
+    uint16_t size;              // its size
+    const tTAGS_NDEF *old;      // current NDEF message
+} tTAGS_PENDING;
+
 // Tag API object definition which interfaces with the NCI
 // and implements its callback to be notified on NCI response
-// or event
-class NfcTags : public NfcNciCb
+// or event, and the tag interfaces one to be notified when
+// tag commands complete
+class NfcTags : public NfcNciCb, public NfcTagsIntfCb
 {
     public:
         NfcTags(NfcLog& log, NfcNci& nci);
-        void init(NfcTagsCb *cb) {_p_cb = cb; _tag2.init(cb);}
+        // subscribe the callback object to all the events
+        void init(NfcTagsCb *cb);
+        // subscribe a delegate to a single TAGS_EVT_xxx event, replacing
+        // the callback object one, if any, so that applications only
+        // implement the events they need
+        void subscribe(uint8_t event, NfcDelegate cb) {if (event < TAGS_EVT_NUM) {_cbs[event] = cb;}}
+        // run the state machine, application callbacks are called
+        // from there and from NfcNci::handleEvent()
         void handleEvent(void);
 
     // public API
@@ -47,15 +78,96 @@ class NfcTags : public NfcNciCb
         // response is callback function cbDiscover()
         // notification when tag is found is function cbDiscoverNtf()
         uint8_t cmdDiscover(void);
+        // technologies polled by the next cmdDiscover(), TAGS_TECH_xxx
+        // mask, TAGS_TECH_DEFAULT (A, F and V) by default, those not
+        // built (see NfcConfig.h) are ignored
+        void setDiscoverTechs(uint8_t techs) {_techs = techs & TAGS_TECH_BUILT;}
+        // probe NXP tags of type 2 with GET_VERSION when first activated
+        // to know their product and size, tags which do not support it are
+        // activated again, false by default. The result is cached per
+        // NFCID so that tags tapped again are not probed.
+        void setProbe(bool probe) {_probe = probe;}
+        // keep the first TAGS_CACHE_DATA_SIZE bytes dumped per tag for
+        // max_age ms, 0 (default) to not keep any. Written tags drop
+        // their content, read blocks which differ too.
+        void setCacheMaxAge(uint32_t max_age) {_cache_age = max_age;}
+        // content of the activated tag as last dumped, e.g. from
+        // cbDiscoverNtf(), NULL if unknown or older than the max age.
+        // A cmdRead() of a few blocks (counter, signature) then checks
+        // the content is still valid, NULL if it is not.
+        const uint8_t* getCachedData(uint16_t *len);
         // command to deactivate an activated tag (found tag) and re-start
         // the discovering loop
         // response is callback function cbDeactivate()
         uint8_t cmdDeactivate(void);
+        // tags activated again within ms of the time the last deactivated
+        // tag was last seen, with the same NFCID, are not notified but
+        // deactivated again, 0 (default) to notify them all
+        void setDebounce(uint16_t ms) {_debounce = ms;}
+        // cmdDeactivate() keeps the tag activated and checks it is still
+        // in the field every interval ms, cbDeactivate() is called once it
+        // is removed, 0 (default) to deactivate right away. Tags without
+        // presence check are deactivated right away.
+        void setHold(uint16_t interval) {_hold = interval;}
+        // check the activated tag is still in the field when no command
+        // was completed for interval ms, 0 (default) to not check. Once
+        // removed cbRemoved() is called and discovering goes on. A command
+        // sent while a check is pending starts once the tag answered, or
+        // fails after cbRemoved(). Tags without presence check are not
+        // checked.
+        void setPresenceCheck(uint16_t interval) {_check = interval;}
         // get tag interface object for low level commands
         NfcTagsIntf* getInterface(void) {return _p_tagIntf;}
         // command to dump an activated (found) tag
         // response is callback function cbDump()
         uint8_t cmdDump(void);
+        // command to read len bytes, a multiple of the tag block size,
+        // from block of an activated (found) tag into buf, the buffer
+        // has to remain valid until the response
+        // response is callback function cbRead()
+        uint8_t cmdRead(uint16_t block, uint8_t *buf, uint16_t len);
+        // command to write len bytes, a multiple of the tag block size,
+        // from block of an activated (found) tag, the buffer has to remain
+        // valid until the response, verify reads the blocks back to check them
+        // response is callback function cbWrite()
+        uint8_t cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify = false);
+        // command to read the NDEF message of an activated (found) tag
+        // into buf, only the blocks holding the message are read, the
+        // records are then parsed in place with NfcNdef
+        // response is callback function cbNdef()
+        uint8_t cmdReadNdef(uint8_t *buf, uint16_t size);
+        // command to write a new NDEF message after cmdReadNdef(), old is
+        // the current message (as read or last written) so that only the
+        // blocks which differ are written, NULL to write them all. When the
+        // message length changes it is cleared first and written last.
+        // The buffers have to remain valid until the response
+        // response is callback function cbWrite()
+        uint8_t cmdWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old);
+        // command to send an APDU to an activated (found) ISO-DEP tag and
+        // receive the response data in rsp, the buffers have to remain valid
+        // until the response, extended length APDUs are supported
+        // response is callback function cbApdu()
+        uint8_t cmdExchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size);
+        // READ BINARY size used by cmdReadNdef() on type 4 tags,
+        // 0 (default) for the maximum the tag supports
+#if NFC_CONFIG_TAG_TYPE4 && NFC_CONFIG_SHARED_INTF
+        void setNdefChunkSize(uint16_t size) {_chunk = size;}
+#elif NFC_CONFIG_TAG_TYPE4
+        void setNdefChunkSize(uint16_t size) {_tag4.setChunkSize(size);}
+#endif
+        // keys tried to authenticate Mifare classic sectors, in order,
+        // the array has to remain valid
+#if NFC_CONFIG_TAG_MIFARE && NFC_CONFIG_SHARED_INTF
+        void setMifareKeys(const tTAGS_MIFARE_KEY keys[], uint8_t num) {_p_keys = keys; _num_keys = num;}
+#elif NFC_CONFIG_TAG_MIFARE
+        void setMifareKeys(const tTAGS_MIFARE_KEY keys[], uint8_t num) {_tagMifare.setKeys(keys, num);}
+#endif
+        // command to switch the NFC controller off for deep sleep idle
+        // periods, allowed when no command is pending, no callback
+        uint8_t cmdPowerDown(void);
+        // command to switch the NFC controller back on and reset it
+        // response is callback function cbReset()
+        uint8_t cmdPowerUp(void);
 
     private:
         // reset
@@ -71,8 +183,24 @@ class NfcTags : public NfcNciCb
         void handleDeactivate(void);
         void cbRfDeactivate(uint8_t status, uint16_t id, void *data);
         void cbRfDeactivateNtf(uint8_t status, uint16_t id, void *data);
+        void presence(uint8_t status);
+        void remember(void);
+        bool isSeen(void);
+        bool isBounce(void);
+        bool hold(uint8_t id);
+        void release(uint8_t status);
         // dump
         void handleDump(void);
+        // read
+        void handleRead(void);
+        // write
+        void handleWrite(void);
+        // NDEF read
+        void handleReadNdef(void);
+        // APDU
+        void handleApdu(void);
+        // tag interface callback
+        void cbIntf(uint8_t status, uint16_t id, void *data);
         // Data exchange callback
         void cbData(uint8_t status, uint16_t id, void *data);
         // error
@@ -80,19 +208,60 @@ class NfcTags : public NfcNciCb
         // internal stuff
         void setNciResponse(uint8_t status, uint16_t id, void *data);
         uint8_t translateNciStatus(uint8_t nci_status);
-        void identifyTag(tNCI_RF_INTF *rf_intf);
+        bool identifyTag(tNCI_RF_INTF *rf_intf);
+        NfcTagsIntf* getTagIntf(uint8_t type);
+        void probed(uint8_t status);
+        void cacheDump(uint8_t status, tTAGS_DUMP *p_dump);
+        void cacheRead(uint8_t status, tTAGS_READ *p_read);
 
     private:
         uint8_t _state;                 // internal state
         uint8_t _id;                    // command or event identifier
+        uint8_t _techs;                 // technologies polled
+        bool _probe;                    // probe tags on activation
         NfcLog& _log;                   // logging interface
         NfcNci& _nci;                   // NCI interface
-        NfcTagsCb *_p_cb;               // callback object
+        NfcDelegate _cbs[TAGS_EVT_NUM]; // event callbacks
         void *_data;                    // application data
         tTAGS_NCI_RSP _nciRsp;          // NCI response
+#if NFC_CONFIG_SHARED_INTF
+        uint8_t _intf[TAGS_INTF_SIZE] __attribute__((aligned)); // activated tag interface
+        uint16_t _chunk;                // type 4 NDEF chunk size
+        const tTAGS_MIFARE_KEY *_p_keys; // Mifare classic keys
+        uint8_t _num_keys;              // and their number
+#else
+#if NFC_CONFIG_TAG_TYPE1
+        NfcTagsIntfType1 _tag1;         // NFC Forum tag type 1
+#endif
+#if NFC_CONFIG_TAG_TYPE2
         NfcTagsIntfType2 _tag2;         // NFC Forum tag type 2
+#endif
+#if NFC_CONFIG_TAG_TYPE3
+        NfcTagsIntfType3 _tag3;         // NFC Forum tag type 3
+#endif
+#if NFC_CONFIG_TAG_TYPE4
+        NfcTagsIntfType4 _tag4;         // NFC Forum tag type 4
+#endif
+#if NFC_CONFIG_TAG_TYPE5
+        NfcTagsIntfType5 _tag5;         // NFC Forum tag type 5
+#endif
+#if NFC_CONFIG_TAG_MIFARE
         NfcTagsIntfMifare _tagMifare;   // NXP Mifare classic / plus tag
+#endif
+#endif
         NfcTagsIntf *_p_tagIntf;        // current tag interface
+        NfcTagsCache _cache;            // tags identified last
+        tTAGS_CACHE_ENTRY *_p_entry;    // current tag cache entry
+        uint32_t _cache_age;            // content max age, 0 if not kept
+        uint16_t _cache_len;            // content dumped so far
+        uint16_t _debounce;             // same tag suppression, ms
+        uint16_t _hold;                 // presence check interval, ms
+        uint16_t _check;                // same once activated, ms
+        uint32_t _check_time;           // tag last answered, millis()
+        tTAGS_PENDING _pending;         // command held by a presence check
+        uint32_t _seen;                 // last tag seen, millis()
+        uint8_t _seen_len;              // last tag NFCID length
+        uint8_t _seen_uid[TAGS_CACHE_UID_LENGTH]; // last tag NFCID
 };
 
 #endif // __NFC_TAGS_H__
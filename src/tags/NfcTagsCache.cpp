@@ -0,0 +1,108 @@
+/*
+ * NfcTagsCache.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsCache.h"
+
+void NfcTagsCache::clear(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < TAGS_CACHE_SIZE; i++) {
+        _entries[i].uid_len = 0;
+        _entries[i].data_len = 0;
+        _entries[i].rank = i;
+    }
+}
+
+void NfcTagsCache::touch(tTAGS_CACHE_ENTRY *p_entry)
+{
+    uint8_t i;
+
+    // entries used after this one age by one
+    for (i = 0; i < TAGS_CACHE_SIZE; i++) {
+        if (_entries[i].rank < p_entry->rank) {
+            _entries[i].rank++;
+        }
+    }
+    p_entry->rank = 0;
+}
+
+tTAGS_CACHE_ENTRY* NfcTagsCache::find(const uint8_t *uid, uint8_t len)
+{
+    uint8_t i;
+
+    if (uid == NULL || len == 0) {
+        return NULL;
+    }
+
+    for (i = 0; i < TAGS_CACHE_SIZE; i++) {
+        if (_entries[i].uid_len == len && memcmp(_entries[i].uid, uid, len) == 0) {
+            touch(&_entries[i]);
+            return &_entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+tTAGS_CACHE_ENTRY* NfcTagsCache::add(const uint8_t *uid, uint8_t len)
+{
+    tTAGS_CACHE_ENTRY *p_entry;
+    uint8_t i;
+
+    if (uid == NULL || len == 0 || len > TAGS_CACHE_UID_LENGTH) {
+        return NULL;
+    }
+
+    // same tag again, reuse its entry, else the least recently used
+    p_entry = find(uid, len);
+    if (p_entry == NULL) {
+        p_entry = &_entries[0];
+        for (i = 1; i < TAGS_CACHE_SIZE; i++) {
+            if (_entries[i].rank > p_entry->rank) {
+                p_entry = &_entries[i];
+            }
+        }
+        touch(p_entry);
+    }
+
+    p_entry->uid_len = len;
+    memcpy(p_entry->uid, uid, len);
+    p_entry->type = 0;
+    p_entry->info_len = 0;
+    p_entry->data_len = 0;
+
+    return p_entry;
+}
+
+const uint8_t* NfcTagsCache::getData(tTAGS_CACHE_ENTRY *p_entry, uint32_t max_age, uint16_t *len)
+{
+    // stale content is dropped, millis() wraps around
+    if (p_entry == NULL || p_entry->data_len == 0) {
+        return NULL;
+    }
+    if ((uint32_t)(millis() - p_entry->time) > max_age) {
+        p_entry->data_len = 0;
+        return NULL;
+    }
+
+    *len = p_entry->data_len;
+    return p_entry->data;
+}
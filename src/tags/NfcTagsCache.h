@@ -0,0 +1,75 @@
+/*
+ * NfcTagsCache.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_TAGS_CACHE_H__
+#define __NFC_TAGS_CACHE_H__
+
+#include <Arduino.h>
+
+// number of tags remembered, override at build time if needed
+#ifndef TAGS_CACHE_SIZE
+#define TAGS_CACHE_SIZE         4
+#endif
+
+// content remembered per tag, first bytes of the last dump
+#ifndef TAGS_CACHE_DATA_SIZE
+#define TAGS_CACHE_DATA_SIZE    64
+#endif
+
+#define TAGS_CACHE_UID_LENGTH   10  // longest NFCID, NFCID1 triple size
+#define TAGS_CACHE_INFO_LENGTH  8   // probe response, GET_VERSION
+
+// tag identification result and content
+typedef struct {
+    uint8_t uid_len;                        // 0 if the entry is free
+    uint8_t uid[TAGS_CACHE_UID_LENGTH];
+    uint8_t type;                           // TAGS_TYPE_xxx
+    uint8_t info_len;                       // 0 if not probed or no response
+    uint8_t info[TAGS_CACHE_INFO_LENGTH];   // probe response
+    uint8_t rank;                           // 0 for the entry used last
+    uint16_t data_len;                      // 0 if no content
+    uint32_t time;                          // millis() when read or checked
+    uint8_t data[TAGS_CACHE_DATA_SIZE];     // content from the first block
+} tTAGS_CACHE_ENTRY;
+
+// Cache of the tags identified last, keyed by NFCID, so that
+// tags tapped again are identified without probing them, and
+// their content is known before it is read again. The least
+// recently used entry is replaced when full.
+class NfcTagsCache
+{
+    public:
+        NfcTagsCache(void) {clear();}
+        void clear(void);
+        // entry of the tag, NULL if not cached, made the most recent
+        tTAGS_CACHE_ENTRY* find(const uint8_t *uid, uint8_t len);
+        // new entry for the tag, the least recently used one is replaced
+        tTAGS_CACHE_ENTRY* add(const uint8_t *uid, uint8_t len);
+        // content of the entry if read or checked within max_age ms
+        const uint8_t* getData(tTAGS_CACHE_ENTRY *p_entry, uint32_t max_age, uint16_t *len);
+
+    private:
+        void touch(tTAGS_CACHE_ENTRY *p_entry);
+
+    private:
+        tTAGS_CACHE_ENTRY _entries[TAGS_CACHE_SIZE];
+};
+
+#endif // __NFC_TAGS_CACHE_H__
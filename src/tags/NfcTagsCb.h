@@ -21,22 +21,36 @@
 #ifndef __NFC_TAGS_CB_H__
 #define __NFC_TAGS_CB_H__
 
-// Callback object that clients have to implement
-// to be notified on response or event
+// Callback object that clients implement to be notified
+// on response or event, only the callbacks needed have to
+// be overridden. NfcTags::subscribe() binds a member function
+// of any object to a single event instead.
 class NfcTagsCb
 {
     public:
         NfcTagsCb(void) {;}
         // Reset response callback function for cmdReset()
-        virtual void cbReset(uint8_t status, uint16_t id, void *data) = 0;
+        virtual void cbReset(uint8_t status, uint16_t id, void *data) {;}
         // Discover response callback function for cmdDiscover()
-        virtual void cbDiscover(uint8_t status, uint16_t id, void *data) = 0;
+        virtual void cbDiscover(uint8_t status, uint16_t id, void *data) {;}
         // Tag detection callback notification function for cmdDiscover()
-        virtual void cbDiscoverNtf(uint8_t status, uint16_t id, void *data) = 0;
+        virtual void cbDiscoverNtf(uint8_t status, uint16_t id, void *data) {;}
         // Deactivation response callback function for cmdDeactivate()
-        virtual void cbDeactivate(uint8_t status, uint16_t id, void *data) = 0;
+        virtual void cbDeactivate(uint8_t status, uint16_t id, void *data) {;}
+        // Tag removal notification function for setPresenceCheck()
+        virtual void cbRemoved(uint8_t status, uint16_t id, void *data) {;}
         // Dump response callback function for cmdDump()
-        virtual void cbDump(uint8_t status, uint16_t id, void *data) = 0;
+        virtual void cbDump(uint8_t status, uint16_t id, void *data) {;}
+        // Write response callback function for cmdWrite()
+        virtual void cbWrite(uint8_t status, uint16_t id, void *data) {;}
+        // NDEF message callback function for cmdReadNdef()
+        virtual void cbNdef(uint8_t status, uint16_t id, void *data) {;}
+        // APDU response callback function for cmdExchangeApdu()
+        virtual void cbApdu(uint8_t status, uint16_t id, void *data) {;}
+        // Read response callback function for cmdRead()
+        virtual void cbRead(uint8_t status, uint16_t id, void *data) {;}
+        // Job completion callback function for NfcTagsJobs, id is the handle
+        virtual void cbJob(uint8_t status, uint16_t id, void *data) {;}
 };
 
 #endif // __NFC_TAGS_CB_H__
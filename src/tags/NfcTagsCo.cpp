@@ -0,0 +1,211 @@
+/*
+ * NfcTagsCo.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsCo.h"
+
+#ifdef NFC_TAGS_CO
+
+// coroutine frames pool
+static uint8_t _frames[TAGS_CO_FRAMES][TAGS_CO_FRAME_SIZE] __attribute__((aligned));
+static bool _frames_used[TAGS_CO_FRAMES];
+
+void* NfcTagsTask::promise_type::operator new(size_t size) noexcept
+{
+    uint8_t i;
+
+    if (size > TAGS_CO_FRAME_SIZE) {
+        return NULL;
+    }
+    for (i = 0; i < TAGS_CO_FRAMES; i++) {
+        if (!_frames_used[i]) {
+            _frames_used[i] = true;
+            return _frames[i];
+        }
+    }
+    return NULL;
+}
+
+void NfcTagsTask::promise_type::operator delete(void *p)
+{
+    uint8_t i;
+
+    for (i = 0; i < TAGS_CO_FRAMES; i++) {
+        if (p == _frames[i]) {
+            _frames_used[i] = false;
+        }
+    }
+}
+
+NfcTagsTask& NfcTagsTask::operator=(NfcTagsTask&& task)
+{
+    if (this != &task) {
+        if (_handle) {
+            _handle.destroy();
+        }
+        _handle = task._handle;
+        task._handle = NULL;
+    }
+    return *this;
+}
+
+NfcTagsTask::~NfcTagsTask(void)
+{
+    if (_handle) {
+        _handle.destroy();
+    }
+}
+
+bool NfcTagsCoAwait::await_ready(void)
+{
+    return _co.ready(_wait, _status);
+}
+
+void NfcTagsCoAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    _co.suspend(_wait, handle);
+}
+
+uint8_t NfcTagsCoAwait::await_resume(void)
+{
+    return _co._status;
+}
+
+NfcTagsCo::NfcTagsCo(NfcLog& log, NfcTags& tags) :
+    _log(log), _tags(tags), _handle(NULL), _wait(TAGS_CO_WAIT_NONE),
+    _status(TAGS_STATUS_OK), _p_data(NULL), _active(false)
+{
+}
+
+bool NfcTagsCo::ready(uint8_t wait, uint8_t status)
+{
+    // rejected commands and events already there
+    // do not suspend the task
+    _status = status;
+    _p_data = NULL;
+    if (status != TAGS_STATUS_OK) {
+        return true;
+    }
+    if (wait == TAGS_CO_WAIT_ACTIVATED) {
+        return _active;
+    }
+    if (wait == TAGS_CO_WAIT_REMOVED) {
+        return !_active;
+    }
+    return false;
+}
+
+void NfcTagsCo::suspend(uint8_t wait, std::coroutine_handle<> handle)
+{
+    _log.d("NfcTagsCo: %s wait = %d\n", __func__, wait);
+    _wait = wait;
+    _handle = handle;
+}
+
+void NfcTagsCo::resume(uint8_t wait, uint8_t status, void *data)
+{
+    std::coroutine_handle<> handle = _handle;
+
+    if (!handle || _wait != wait) {
+        return;
+    }
+
+    // the task may await again before resume() returns
+    _handle = NULL;
+    _wait = TAGS_CO_WAIT_NONE;
+    _status = status;
+    _p_data = data;
+    handle.resume();
+}
+
+void NfcTagsCo::cbReset(uint8_t status, uint16_t id, void *data)
+{
+    _active = false;
+    resume(TAGS_CO_WAIT_RESET, status, data);
+}
+
+void NfcTagsCo::cbDiscover(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_DISCOVER, status, data);
+}
+
+void NfcTagsCo::cbDiscoverNtf(uint8_t status, uint16_t id, void *data)
+{
+    _active = (status == TAGS_STATUS_OK);
+    resume(TAGS_CO_WAIT_ACTIVATED, status, data);
+}
+
+void NfcTagsCo::cbDeactivate(uint8_t status, uint16_t id, void *data)
+{
+    _active = false;
+
+    // reset and discover failures are reported there too
+    if (id == TAGS_ID_RESET) {
+        resume(TAGS_CO_WAIT_RESET, status, data);
+        return;
+    }
+    if (id == TAGS_ID_DISCOVER) {
+        resume(TAGS_CO_WAIT_DISCOVER, status, data);
+        return;
+    }
+
+    // a command in progress on the tag fails
+    if (_wait >= TAGS_CO_WAIT_DUMP) {
+        resume(_wait, TAGS_STATUS_FAILED, NULL);
+        return;
+    }
+    if (_wait == TAGS_CO_WAIT_REMOVED) {
+        resume(TAGS_CO_WAIT_REMOVED, status, data);
+        return;
+    }
+    resume(TAGS_CO_WAIT_DEACTIVATE, status, data);
+}
+
+void NfcTagsCo::cbRemoved(uint8_t status, uint16_t id, void *data)
+{
+    _active = false;
+    resume(TAGS_CO_WAIT_REMOVED, status, data);
+}
+
+void NfcTagsCo::cbDump(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_DUMP, status, data);
+}
+
+void NfcTagsCo::cbRead(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_READ, status, data);
+}
+
+void NfcTagsCo::cbWrite(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_WRITE, status, data);
+}
+
+void NfcTagsCo::cbNdef(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_NDEF, status, data);
+}
+
+void NfcTagsCo::cbApdu(uint8_t status, uint16_t id, void *data)
+{
+    resume(TAGS_CO_WAIT_APDU, status, data);
+}
+
+#endif // NFC_TAGS_CO
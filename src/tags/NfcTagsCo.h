@@ -0,0 +1,193 @@
+/*
+ * NfcTagsCo.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_TAGS_CO_H__
+#define __NFC_TAGS_CO_H__
+
+// Optional C++20 coroutine front-end, only built by compilers
+// with coroutine support (e.g. GCC 10 and later with -std=c++20)
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define NFC_TAGS_CO
+
+#include <coroutine>
+#include <Arduino.h>
+#include "tags/NfcTagsDef.h"
+#include "tags/NfcTagsCb.h"
+#include "tags/NfcTags.h"
+#include "log/NfcLog.h"
+
+// coroutine frames are taken from a static pool, no heap is used:
+// number of frames (tasks alive at once) and size of each frame,
+// locals included, override at build time if needed
+#ifndef TAGS_CO_FRAMES
+#define TAGS_CO_FRAMES          2
+#endif
+#ifndef TAGS_CO_FRAME_SIZE
+#define TAGS_CO_FRAME_SIZE      256
+#endif
+
+// what a suspended task waits for
+enum {
+    TAGS_CO_WAIT_NONE = 0,
+    TAGS_CO_WAIT_RESET,
+    TAGS_CO_WAIT_DISCOVER,
+    TAGS_CO_WAIT_ACTIVATED,
+    TAGS_CO_WAIT_REMOVED,
+    TAGS_CO_WAIT_DEACTIVATE,
+    TAGS_CO_WAIT_DUMP,
+    TAGS_CO_WAIT_READ,
+    TAGS_CO_WAIT_WRITE,
+    TAGS_CO_WAIT_NDEF,
+    TAGS_CO_WAIT_APDU,
+};
+
+// Tag session coroutine, it starts right away and runs up to its
+// first co_await. Its frame is allocated from the static pool and
+// freed when the object is destroyed, valid() is false when the
+// pool was exhausted and the coroutine did not start.
+class NfcTagsTask
+{
+    public:
+        struct promise_type {
+            NfcTagsTask get_return_object(void) {return NfcTagsTask(std::coroutine_handle<promise_type>::from_promise(*this));}
+            static NfcTagsTask get_return_object_on_allocation_failure(void) {return NfcTagsTask();}
+            std::suspend_never initial_suspend(void) noexcept {return {};}
+            std::suspend_always final_suspend(void) noexcept {return {};}
+            void return_void(void) {;}
+            void unhandled_exception(void) {;}
+            static void* operator new(size_t size) noexcept;
+            static void operator delete(void *p);
+        };
+
+        NfcTagsTask(void) : _handle(NULL) {;}
+        NfcTagsTask(NfcTagsTask&& task) : _handle(task._handle) {task._handle = NULL;}
+        NfcTagsTask& operator=(NfcTagsTask&& task);
+        NfcTagsTask(const NfcTagsTask&) = delete;
+        NfcTagsTask& operator=(const NfcTagsTask&) = delete;
+        ~NfcTagsTask(void);
+        bool valid(void) {return (bool)_handle;}
+        bool done(void) {return !_handle || _handle.done();}
+
+    private:
+        explicit NfcTagsTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {;}
+        std::coroutine_handle<promise_type> _handle;
+};
+
+class NfcTagsCo;
+
+// Awaitable returned by NfcTagsCo commands, co_await gives the
+// command status, TAGS_STATUS_xxx, right away when it is rejected
+class NfcTagsCoAwait
+{
+    public:
+        NfcTagsCoAwait(NfcTagsCo& co, uint8_t wait, uint8_t status) : _co(co), _wait(wait), _status(status) {;}
+        bool await_ready(void);
+        void await_suspend(std::coroutine_handle<> handle);
+        uint8_t await_resume(void);
+
+    private:
+        NfcTagsCo& _co;
+        uint8_t _wait;              // TAGS_CO_WAIT_xxx
+        uint8_t _status;            // command status
+};
+
+// Coroutine object on top of NfcTags, a single task awaits the
+// commands in sequence instead of chaining them from callbacks:
+//
+//     NfcTagsTask session(NfcTagsCo& co) {
+//         co_await co.reset();
+//         co_await co.discover();
+//         for (;;) {
+//             co_await co.activated();
+//             if (co_await co.read(0, buf, 16) == TAGS_STATUS_OK) {...}
+//             co_await co.deactivate();
+//         }
+//     }
+//
+// The task is resumed from the NfcTags callbacks, that is from
+// NfcTags::handleEvent() called by loop() as usual, so that the
+// next command is sent as soon as the previous one completes.
+// Data passed to the callbacks (dump chunk, NDEF message) is
+// available through getData() until the next co_await. One task
+// awaits at a time, the application callback object is replaced.
+class NfcTagsCo : public NfcTagsCb
+{
+    public:
+        NfcTagsCo(NfcLog& log, NfcTags& tags);
+        void init(void) {_tags.init(this);}
+
+    // public API, see NfcTags commands for the parameters
+    public:
+        NfcTagsCoAwait reset(void) {return await(TAGS_CO_WAIT_RESET, _tags.cmdReset());}
+        NfcTagsCoAwait discover(void) {return await(TAGS_CO_WAIT_DISCOVER, _tags.cmdDiscover());}
+        // ready once a tag is activated, right away if one is
+        NfcTagsCoAwait activated(void) {return await(TAGS_CO_WAIT_ACTIVATED, TAGS_STATUS_OK);}
+        // ready once the activated tag is removed, see setPresenceCheck()
+        NfcTagsCoAwait removed(void) {return await(TAGS_CO_WAIT_REMOVED, TAGS_STATUS_OK);}
+        NfcTagsCoAwait deactivate(void) {return await(TAGS_CO_WAIT_DEACTIVATE, _tags.cmdDeactivate());}
+        // first chunk, then next() for the following ones while more is set
+        NfcTagsCoAwait dump(void) {return await(TAGS_CO_WAIT_DUMP, _tags.cmdDump());}
+        NfcTagsCoAwait next(void) {return await(TAGS_CO_WAIT_DUMP, TAGS_STATUS_OK);}
+        NfcTagsCoAwait read(uint16_t block, uint8_t *buf, uint16_t len) {return await(TAGS_CO_WAIT_READ, _tags.cmdRead(block, buf, len));}
+        NfcTagsCoAwait write(uint16_t block, const uint8_t *buf, uint16_t len, bool verify = false)
+                            {return await(TAGS_CO_WAIT_WRITE, _tags.cmdWrite(block, buf, len, verify));}
+        NfcTagsCoAwait readNdef(uint8_t *buf, uint16_t size) {return await(TAGS_CO_WAIT_NDEF, _tags.cmdReadNdef(buf, size));}
+        NfcTagsCoAwait writeNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old)
+                            {return await(TAGS_CO_WAIT_WRITE, _tags.cmdWriteNdef(buf, len, old));}
+        NfcTagsCoAwait exchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+                            {return await(TAGS_CO_WAIT_APDU, _tags.cmdExchangeApdu(apdu, len, rsp, size));}
+        // data of the last callback, NULL if none
+        void* getData(void) {return _p_data;}
+        // tags API for settings and interface
+        NfcTags& getTags(void) {return _tags;}
+
+    // NfcTags callbacks, they resume the awaiting task
+    public:
+        void cbReset(uint8_t status, uint16_t id, void *data);
+        void cbDiscover(uint8_t status, uint16_t id, void *data);
+        void cbDiscoverNtf(uint8_t status, uint16_t id, void *data);
+        void cbDeactivate(uint8_t status, uint16_t id, void *data);
+        void cbRemoved(uint8_t status, uint16_t id, void *data);
+        void cbDump(uint8_t status, uint16_t id, void *data);
+        void cbRead(uint8_t status, uint16_t id, void *data);
+        void cbWrite(uint8_t status, uint16_t id, void *data);
+        void cbNdef(uint8_t status, uint16_t id, void *data);
+        void cbApdu(uint8_t status, uint16_t id, void *data);
+
+    private:
+        friend class NfcTagsCoAwait;
+        NfcTagsCoAwait await(uint8_t wait, uint8_t status) {return NfcTagsCoAwait(*this, wait, status);}
+        bool ready(uint8_t wait, uint8_t status);
+        void suspend(uint8_t wait, std::coroutine_handle<> handle);
+        void resume(uint8_t wait, uint8_t status, void *data);
+
+    private:
+        NfcLog& _log;               // logging interface
+        NfcTags& _tags;             // tags API
+        std::coroutine_handle<> _handle; // awaiting task
+        uint8_t _wait;              // what it waits for, TAGS_CO_WAIT_xxx
+        uint8_t _status;            // status it is resumed with
+        void *_p_data;              // callback data
+        bool _active;               // tag activated
+};
+
+#endif // __cpp_impl_coroutine
+
+#endif // __NFC_TAGS_CO_H__
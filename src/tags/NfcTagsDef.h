@@ -21,6 +21,8 @@
 #ifndef __NFC_TAGS_DEF_H__
 #define __NFC_TAGS_DEF_H__
 
+#include "NfcConfig.h"
+
 // status definition
 enum {
     TAGS_STATUS_OK = 0,
@@ -35,9 +37,24 @@ enum {
     TAGS_TYPE_2,
     TAGS_TYPE_3,
     TAGS_TYPE_4,
-    TAGS_TYPE_MIFARE
+    TAGS_TYPE_MIFARE,
+    TAGS_TYPE_5
+};
+
+// discovery technologies definition, see setDiscoverTechs()
+enum {
+    TAGS_TECH_A = 0x01,
+    TAGS_TECH_B = 0x02,
+    TAGS_TECH_F = 0x04,
+    TAGS_TECH_V = 0x08
 };
 
+// technologies built, see NfcConfig.h
+#define TAGS_TECH_BUILT     ((NFC_CONFIG_TECH_A ? TAGS_TECH_A : 0) | (NFC_CONFIG_TECH_B ? TAGS_TECH_B : 0) | \
+                             (NFC_CONFIG_TECH_F ? TAGS_TECH_F : 0) | (NFC_CONFIG_TECH_V ? TAGS_TECH_V : 0))
+
+#define TAGS_TECH_DEFAULT   ((TAGS_TECH_A | TAGS_TECH_F | TAGS_TECH_V) & TAGS_TECH_BUILT)
+
 // NCI response type definition
 typedef struct {
     void *data;
@@ -45,6 +62,19 @@ typedef struct {
     uint8_t status;
 } tTAGS_NCI_RSP;
 
+// Mifare classic key definition
+#define TAGS_MIFARE_KEY_SIZE    6
+
+enum {
+    TAGS_MIFARE_KEY_A = 0,
+    TAGS_MIFARE_KEY_B
+};
+
+typedef struct {
+    uint8_t type;
+    uint8_t key[TAGS_MIFARE_KEY_SIZE];
+} tTAGS_MIFARE_KEY;
+
 // NCI response type definition
 typedef struct {
     uint8_t *buf;
@@ -52,6 +82,26 @@ typedef struct {
     uint8_t more;
 } tTAGS_DUMP;
 
+// NDEF message read from a tag
+typedef struct {
+    uint8_t *buf;
+    uint16_t len;
+} tTAGS_NDEF;
+
+// blocks read from a tag
+typedef struct {
+    uint16_t block;
+    uint8_t *buf;
+    uint16_t len;
+} tTAGS_READ;
+
+// APDU response, data then status word (SW1 | SW2)
+typedef struct {
+    uint8_t *buf;
+    uint16_t len;
+    uint16_t sw;
+} tTAGS_APDU;
+
 // Interface identifier
 enum {
     TAGS_ID_NONE = 0,
@@ -59,7 +109,29 @@ enum {
     TAGS_ID_DISCOVER,
     TAGS_ID_DISCOVER_ACTIVATED,
     TAGS_ID_DEACTIVATE,
-    TAGS_ID_DUMP
+    TAGS_ID_DUMP,
+    TAGS_ID_POWER_DOWN,
+    TAGS_ID_WRITE,
+    TAGS_ID_READ_NDEF,
+    TAGS_ID_APDU,
+    TAGS_ID_READ,
+    TAGS_ID_PRESENCE,
+    TAGS_ID_REACTIVATE
+};
+
+// Event identifier, one per NfcTagsCb callback function
+enum {
+    TAGS_EVT_RESET = 0,
+    TAGS_EVT_DISCOVER,
+    TAGS_EVT_DISCOVER_NTF,
+    TAGS_EVT_DEACTIVATE,
+    TAGS_EVT_REMOVED,
+    TAGS_EVT_DUMP,
+    TAGS_EVT_WRITE,
+    TAGS_EVT_NDEF,
+    TAGS_EVT_APDU,
+    TAGS_EVT_READ,
+    TAGS_EVT_NUM
 };
 
 #endif // __NFC_TAGS_DEF_H__
@@ -27,14 +27,28 @@
 #include "log/NfcLog.h"
 #include "nci/NfcNci.h"
 
+// Callback object implemented by NfcTags to be notified when a
+// tag interface command progresses or completes, NfcTags then
+// notifies the application with the matching NfcTagsCb function
+class NfcTagsIntfCb
+{
+    public:
+        NfcTagsIntfCb(void) {;}
+        virtual void cbIntf(uint8_t status, uint16_t id, void *data) = 0;
+};
+
 // Tag interface object to exchange with activated tags
 class NfcTagsIntf
 {
     public:
         NfcTagsIntf(NfcLog& log, NfcNci& nci) :
             _log(log), _nci(nci), _p_cb(NULL), _p_rf(NULL) {;}
-        void init(NfcTagsCb *cb) {_p_cb = cb;}
-        void initTag(tNCI_RF_INTF *rf) {_p_rf = rf;}
+        void init(NfcTagsIntfCb *cb) {_p_cb = cb;}
+        virtual void initTag(tNCI_RF_INTF *rf) {_p_rf = rf;}
+#if NFC_CONFIG_SHARED_INTF
+        // constructed in place by NfcTags, see NfcConfig.h
+        static void* operator new(size_t size, void *p) {return p;}
+#endif
 
     // public API
     public:
@@ -44,13 +58,52 @@ class NfcTagsIntf
         virtual uint8_t getNfcidLen(void) = 0;
         // get NFCID buffer
         virtual uint8_t* getNfcidBuf(void) = 0;
+        // get RF interface, with the technology and activation parameters
+        tNCI_RF_INTF* getRfIntf(void) {return _p_rf;}
         // command to dump an activated (found) tag
         // response is callback function cbDump()
         virtual uint8_t cmdDump(void) = 0;
+        // command to read len bytes from block into buf, for a few blocks
+        // (counter, signature) rather than a dump, not supported by all tags
+        // response is callback function cbRead()
+        virtual uint8_t cmdRead(uint16_t block, uint8_t *buf, uint16_t len)
+            {return TAGS_STATUS_REJECTED;}
+        // command to check the activated tag is still in the field with
+        // the cheapest exchange it supports, not supported by all tags
+        // response is NfcTagsIntfCb::cbIntf() with TAGS_ID_PRESENCE,
+        // TAGS_STATUS_OK if present
+        virtual uint8_t checkPresence(void) {return TAGS_STATUS_REJECTED;}
+        // block size in bytes of cmdRead() and cmdWrite(), 0 if not supported
+        virtual uint8_t getBlockSize(void) {return 0;}
+        // command to write len bytes from block, optionally read back
+        // to check them, not supported by all tags
+        // response is callback function cbWrite()
+        virtual uint8_t cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify)
+            {return TAGS_STATUS_REJECTED;}
+        // command to read the NDEF message into buf, only the blocks
+        // holding the message are read, not supported by all tags
+        // response is callback function cbNdef()
+        virtual uint8_t cmdReadNdef(uint8_t *buf, uint16_t size) {return TAGS_STATUS_REJECTED;}
+        // command to write a new NDEF message, old is the current message
+        // (previous read or write) so that only the blocks which differ are
+        // written, NULL to write them all, not supported by all tags
+        // response is callback function cbWrite()
+        virtual uint8_t cmdWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old)
+            {return TAGS_STATUS_REJECTED;}
+        // command to send an APDU and receive the response data in rsp,
+        // ISO-DEP tags only
+        // response is callback function cbApdu()
+        virtual uint8_t cmdExchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+            {return TAGS_STATUS_REJECTED;}
 
     // internal stuff
     public:
         virtual uint8_t handleDump(void) = 0;
+        virtual uint8_t handleRead(void) {return TAGS_STATUS_REJECTED;}
+        virtual uint8_t handlePresence(void) {return TAGS_STATUS_REJECTED;}
+        virtual uint8_t handleWrite(void) {return TAGS_STATUS_REJECTED;}
+        virtual uint8_t handleReadNdef(void) {return TAGS_STATUS_REJECTED;}
+        virtual uint8_t handleApdu(void) {return TAGS_STATUS_REJECTED;}
         virtual void handleData(uint8_t status, uint16_t id, void *data) = 0;
 
     // internal stuff
@@ -63,17 +116,70 @@ class NfcTagsIntf
         uint8_t _id;            // command
         NfcLog& _log;           // logging interface
         NfcNci& _nci;           // NCI interface
-        NfcTagsCb *_p_cb;       // callback object
+        NfcTagsIntfCb *_p_cb;   // callback object
         tNCI_RF_INTF *_p_rf;    // tag RF interface
         tTAGS_DUMP  _dump;      // dump structure
 };
 
+// Tag type 1 UID size in bytes, as used by the commands
+#define TAGS_T1_UID_SIZE        4
+
+// Tag interface object to exchange with activated tags of type 1
+// (see NFC Forum definition), this includes Innovision Topaz. Static
+// memory tags are read at once with RALL, dynamic memory ones by
+// segments of 128 bytes with RSEG, blocks past the last whole segment
+// with READ8. When the RALL or RSEG response does not fit in the maximum
+// payload of the connection, static memory is read byte by byte with READ
+// and dynamic memory block by block with READ8.
+class NfcTagsIntfType1 final : public NfcTagsIntf
+{
+    public:
+        NfcTagsIntfType1(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
+
+    // public API
+    public:
+        uint8_t getType(void);
+        uint8_t getNfcidLen(void);
+        uint8_t* getNfcidBuf(void);
+        uint8_t cmdDump(void);
+        uint8_t checkPresence(void);
+
+    // internal stuff
+    public:
+        uint8_t handleDump(void);
+        uint8_t handlePresence(void);
+        void handleData(uint8_t status, uint16_t id, void *data);
+
+    private:
+        void handleDataPresence(uint8_t status, uint16_t id, void *data);
+        uint8_t sendRead(void);
+        void handleDataRid(uint8_t status, uint16_t id, void *data);
+        void handleDataDump(uint8_t status, uint16_t id, void *data);
+        void notifyDump(uint8_t status, uint8_t *buf, uint8_t len);
+
+    private:
+        bool _rid;                      // RID response received
+        uint8_t _hr0;                   // header ROM byte 0
+        uint8_t _uid[TAGS_T1_UID_SIZE]; // UID0-3
+        uint16_t _block;                // next block to read
+        uint16_t _num_blocks;           // tag size in blocks
+        uint8_t _num;                   // blocks in the pending command, 0 for READ
+        uint8_t _byte;                  // next byte in the block for READ
+};
+
+// Tag type 2 block size in bytes
+#define TAGS_T2_BLOCK_SIZE      4
+// Tag type 2 GET_VERSION response size in bytes (NXP)
+#define TAGS_T2_VERSION_SIZE    8
+
 // Tag interface object to exchange with activated tags of type 2
 // (see NFC Forum definition), this includes NXP Mifare Ultra Ligth
-class NfcTagsIntfType2 : public NfcTagsIntf
+class NfcTagsIntfType2 final : public NfcTagsIntf
 {
     public:
         NfcTagsIntfType2(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
 
     // public API
     public:
@@ -81,25 +187,278 @@ class NfcTagsIntfType2 : public NfcTagsIntf
         uint8_t getNfcidLen(void);
         uint8_t* getNfcidBuf(void);
         uint8_t cmdDump(void);
+        uint8_t cmdRead(uint16_t block, uint8_t *buf, uint16_t len);
+        uint8_t checkPresence(void);
+        uint8_t getBlockSize(void) {return TAGS_T2_BLOCK_SIZE;}
+        uint8_t cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify);
+        uint8_t cmdReadNdef(uint8_t *buf, uint16_t size);
+        uint8_t cmdWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old);
+        // command to send GET_VERSION to identify NXP tags, tags which do
+        // not support it do not answer and have to be activated again
+        // response is NfcTagsIntfCb::cbIntf() with TAGS_ID_DISCOVER_ACTIVATED
+        uint8_t cmdProbe(void);
+        // GET_VERSION response, probed or cached, NULL if unknown,
+        // known products are then dumped up to their last block
+        const uint8_t* getVersion(void) {return _version_len != 0 ? _version : NULL;}
+        void setVersion(const uint8_t *version);
 
     // internal stuff
     public:
         uint8_t handleDump(void);
+        uint8_t handleRead(void);
+        uint8_t handlePresence(void);
+        uint8_t handleWrite(void);
+        uint8_t handleReadNdef(void);
+        uint8_t handleProbe(void);
         void handleData(uint8_t status, uint16_t id, void *data);
 
     private:
+        void handleDataProbe(uint8_t status, uint16_t id, void *data);
         void handleDataDump(uint8_t status, uint16_t id, void *data);
+        void handleDataRead(uint8_t status, uint16_t id, void *data);
+        void handleDataPresence(uint8_t status, uint16_t id, void *data);
+        void handleDataWrite(uint8_t status, uint16_t id, void *data);
+        void handleDataVerify(uint8_t status, uint16_t id, void *data);
+        void handleDataNdef(uint8_t status, uint16_t id, void *data);
+        uint8_t parseTlv(uint8_t b);
+        bool getNdefByte(uint16_t addr, const uint8_t *msg, uint16_t len,
+                         uint8_t lsize, bool clear, uint8_t *b);
+        bool getNdefWriteBlock(uint8_t *block, uint8_t data[]);
+        void notifyWrite(uint8_t status);
+        void notifyNdef(uint8_t status);
 
     private:
         uint8_t _block;
+        uint8_t _last_block;        // last block dumped
+        uint8_t _version_len;       // GET_VERSION response, 0 if unknown
+        uint8_t _version[TAGS_T2_VERSION_SIZE];
+        // read command, READ returns 4 blocks, only those
+        // asked for are copied to the buffer
+        tTAGS_READ _read;           // blocks read
+        uint16_t _rd_done;          // bytes read so far
+        // write command, WRITE commands are sent back to back as
+        // long as the controller has credits, acknowledges are
+        // received in order
+        const uint8_t *_wr_buf;     // data to write
+        uint16_t _wr_num;           // number of blocks to write
+        uint16_t _wr_sent;          // blocks sent
+        uint16_t _wr_acked;         // blocks acknowledged
+        uint16_t _wr_checked;       // blocks read back
+        uint8_t _wr_block;          // first block
+        bool _wr_verify;            // read back after write
+        // NDEF write command, blocks of the new NDEF TLV are
+        // compared with the current ones to only write changes
+        uint16_t _wr_len;           // new message length
+        const uint8_t *_wr_old;     // current message
+        uint16_t _wr_old_len;       // current message length
+        uint16_t _wr_next;          // next block to compare
+        uint8_t _wr_phase;          // write phase
+        bool _wr_resize;            // message length changes
+        // NDEF read command, TLVs are parsed as blocks are
+        // received and the NDEF TLV value copied to the buffer
+        tTAGS_NDEF _ndef;           // NDEF message
+        uint16_t _ndef_size;        // buffer size
+        uint16_t _ndef_end;         // data area end, in bytes
+        uint16_t _tlv_len;          // current TLV length left
+        uint8_t _tlv_state;         // TLV parser state
+        uint8_t _tlv_type;          // current TLV type
+        uint16_t _ndef_addr;        // NDEF TLV address, 0 if unknown
+        uint8_t _ndef_lsize;        // NDEF TLV length field size
+        uint8_t _ndef_prefix[TAGS_T2_BLOCK_SIZE]; // NDEF TLV block
+};
+
+// Tag type 3 block size in bytes and blocks per exchange, Check
+// responses and Update commands have to fit in a 255 bytes frame,
+// Check responses in a single NCI data packet
+#define TAGS_T3_BLOCK_SIZE      16
+#define TAGS_T3_CHECK_MAX       15
+#define TAGS_T3_UPDATE_MAX      12
+#define TAGS_T3_CMD_SIZE        (14 + TAGS_T3_UPDATE_MAX * (3 + TAGS_T3_BLOCK_SIZE))
+
+// Tag interface object to exchange with activated tags of type 3
+// (see NFC Forum definition), this includes Sony FeliCa Lite. Blocks
+// are accessed through the NDEF services, the attribute information
+// block gives how many blocks the tag accepts per Check (Nbr) and
+// Update (Nbw) command, each command carries as many as it allows.
+class NfcTagsIntfType3 final : public NfcTagsIntf
+{
+    public:
+        NfcTagsIntfType3(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
+
+    // public API
+    public:
+        uint8_t getType(void);
+        uint8_t getNfcidLen(void);
+        uint8_t* getNfcidBuf(void);
+        uint8_t cmdDump(void);
+        uint8_t checkPresence(void);
+        uint8_t cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify);
+
+    // internal stuff
+    public:
+        uint8_t handleDump(void);
+        uint8_t handlePresence(void);
+        uint8_t handleWrite(void);
+        void handleData(uint8_t status, uint16_t id, void *data);
+
+    private:
+        void handleDataPresence(uint8_t status, uint16_t id, void *data);
+        uint8_t sendCheck(uint16_t block, uint8_t num);
+        uint8_t sendUpdate(uint16_t block, uint8_t num, const uint8_t *data);
+        uint8_t *getRsp(uint8_t status, uint8_t buf[], uint8_t code, uint8_t len);
+        bool parseAttr(const uint8_t *attr);
+        uint8_t getNumBlocks(uint16_t left, uint8_t max, uint8_t card);
+        void handleDataDump(uint8_t status, uint16_t id, void *data);
+        void handleDataWrite(uint8_t status, uint16_t id, void *data);
+        void handleDataVerify(uint8_t status, uint16_t id, void *data);
+        void notifyWrite(uint8_t status);
+
+    private:
+        uint16_t _block;            // next block to read
+        uint8_t _num;               // blocks in the pending command
+        // attribute information block, valid for the session
+        bool _attr;                 // attribute block read
+        uint8_t _nbr;               // blocks per Check
+        uint8_t _nbw;               // blocks per Update
+        uint16_t _nmaxb;            // NDEF data area size in blocks
+        uint8_t _check_max;         // blocks per Check response packet
+        // write command
+        const uint8_t *_wr_buf;     // data to write
+        uint16_t _wr_block;         // first block
+        uint16_t _wr_num;           // number of blocks to write
+        uint16_t _wr_done;          // blocks written
+        uint16_t _wr_checked;       // blocks read back
+        bool _wr_verify;            // read back after write
+        uint8_t _cmd[TAGS_T3_CMD_SIZE]; // command frame, kept until sent
 };
 
+// Tag type 4 NDEF procedure buffers sizes
+#define TAGS_T4_CMD_SIZE        13  // longest command APDU, select NDEF application
+#define TAGS_T4_CC_SIZE         15  // capability container
+
+// Tag interface object to exchange with activated tags of type 4
+// (see NFC Forum definition) through the ISO-DEP RF interface, this
+// includes NXP DESFire and payment cards. Command APDUs larger than the
+// NCI maximum payload are segmented by NfcNci, response segments are
+// received straight into the caller buffer so that extended length
+// APDUs do not need a larger NCI buffer.
+class NfcTagsIntfType4 final : public NfcTagsIntf
+{
+    public:
+        NfcTagsIntfType4(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
+        // READ BINARY size used to read the NDEF file, 0 for
+        // the maximum the card supports (MLe)
+        void setChunkSize(uint16_t size) {_chunk = size;}
+
+    // public API
+    public:
+        uint8_t getType(void);
+        uint8_t getNfcidLen(void);
+        uint8_t* getNfcidBuf(void);
+        uint8_t cmdDump(void);
+        uint8_t checkPresence(void);
+        uint8_t cmdReadNdef(uint8_t *buf, uint16_t size);
+        uint8_t cmdExchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size);
+
+    // internal stuff
+    public:
+        uint8_t handleDump(void);
+        uint8_t handlePresence(void);
+        uint8_t handleReadNdef(void);
+        uint8_t handleApdu(void);
+        void handleData(uint8_t status, uint16_t id, void *data);
+
+    private:
+        void handleDataPresence(uint8_t status, uint16_t id, void *data);
+        uint8_t sendApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size);
+        uint8_t sendNdefApdu(void);
+        void receive(const uint8_t *buf, uint8_t len);
+        void handleDataNdef(uint8_t status);
+        void notifyNdef(uint8_t status);
+
+    private:
+        // APDU exchange, the status word is held back
+        // as the response is received
+        tTAGS_APDU _apdu;                   // response
+        uint16_t _rsp_size;                 // response buffer size
+        uint8_t _sw[2];                     // status word
+        uint8_t _sw_len;                    // status word bytes received
+        bool _overflow;                     // response buffer too small
+        const uint8_t *_cmd_buf;            // command APDU
+        uint16_t _cmd_len;                  // command APDU length
+        // NDEF read command, NFC Forum NDEF tag application
+        tTAGS_NDEF _ndef;                   // NDEF message
+        uint16_t _ndef_size;                // buffer size
+        uint16_t _nlen;                     // NDEF message length
+        uint16_t _mle;                      // maximum R-APDU data size
+        uint16_t _chunk;                    // READ BINARY size
+        uint8_t _step;                      // NDEF procedure step
+        uint8_t _cmd[TAGS_T4_CMD_SIZE];     // NDEF procedure command
+        uint8_t _cc[TAGS_T4_CC_SIZE];       // capability container
+};
+
+// Tag interface object to exchange with activated tags of type 5
+// (see NFC Forum definition) on the frame RF interface, this includes
+// ISO 15693 NXP ICODE, TI Tag-it and ST LRI labels. The memory size is
+// given by Get System Information, blocks are then read with Read
+// Multiple Blocks commands carrying as many blocks as fit in a data
+// packet. The count is halved when the tag rejects it and kept for the
+// session, down to Read Single Block commands.
+class NfcTagsIntfType5 final : public NfcTagsIntf
+{
+    public:
+        NfcTagsIntfType5(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
+
+    // public API
+    public:
+        uint8_t getType(void);
+        uint8_t getNfcidLen(void);
+        uint8_t* getNfcidBuf(void);
+        uint8_t cmdDump(void);
+        uint8_t checkPresence(void);
+
+    // internal stuff
+    public:
+        uint8_t handleDump(void);
+        uint8_t handlePresence(void);
+        void handleData(uint8_t status, uint16_t id, void *data);
+
+    private:
+        void handleDataPresence(uint8_t status, uint16_t id, void *data);
+        uint8_t sendCmd(uint8_t cmd);
+        uint8_t *getRsp(uint8_t status, uint8_t buf[], uint8_t *len);
+        void handleDataInfo(uint8_t status, uint16_t id, void *data);
+        void handleDataDump(uint8_t status, uint16_t id, void *data);
+        void notifyDump(uint8_t status, uint8_t *buf, uint8_t len);
+
+    private:
+        bool _info;             // system information read
+        uint16_t _num_blocks;   // tag size in blocks
+        uint8_t _block_size;    // block size in bytes
+        uint8_t _rmb_max;       // blocks per Read Multiple Blocks
+        uint16_t _block;        // next block to read
+        uint8_t _num;           // blocks in the pending command
+};
+
+// Mifare classic maximum number of sectors (4K)
+#define TAGS_MIFARE_SECTORS_MAX     40
+
 // Tag interface object to exchange with activated tags of type Mifare
-// (see NFC Forum definition), this includes NXP Mifare Classic and Plus
-class NfcTagsIntfMifare : public NfcTagsIntf
+// (see NFC Forum definition), this includes NXP Mifare Classic and Plus.
+// Sectors are authenticated through the NXP proprietary Mifare RF
+// interface with the keys given by setKeys(). The key that opened a
+// sector is kept for the session (tag activation) so that it is tried
+// first on the next access, and blocks of the sector authenticated last
+// are read without authenticating it again.
+class NfcTagsIntfMifare final : public NfcTagsIntf
 {
     public:
         NfcTagsIntfMifare(NfcLog& log, NfcNci& nci);
+        void initTag(tNCI_RF_INTF *rf);
+        void setKeys(const tTAGS_MIFARE_KEY keys[], uint8_t num) {_p_keys = keys; _num_keys = num;}
 
     // public API
     public:
@@ -112,6 +471,22 @@ class NfcTagsIntfMifare : public NfcTagsIntf
     public:
         uint8_t handleDump(void);
         void handleData(uint8_t status, uint16_t id, void *data);
+
+    private:
+        void handleDataAuth(uint8_t status, uint16_t id, void *data);
+        void handleDataDump(uint8_t status, uint16_t id, void *data);
+        void notifyDump(uint8_t status, uint8_t *buf, uint8_t len);
+        uint8_t getSector(uint16_t block);
+        uint8_t getKey(uint8_t sector);
+
+    private:
+        const tTAGS_MIFARE_KEY *_p_keys;            // authentication keys
+        uint8_t _num_keys;                          // number of keys
+        uint8_t _key;                               // key tried next
+        uint16_t _block;                            // block read next
+        uint16_t _num_blocks;                       // tag size in blocks
+        uint8_t _auth_sector;                       // authenticated sector
+        uint8_t _sector_key[TAGS_MIFARE_SECTORS_MAX]; // key cache
 };
 
 #endif // __NFC_TAGS_INTF__
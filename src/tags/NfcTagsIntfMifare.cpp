@@ -20,25 +20,102 @@
 
 #include "tags/NfcTagsIntf.h"
 
+#if NFC_CONFIG_TAG_MIFARE
+
 // state definition
 enum {
-    TAGS_INTF_MIFARE_STATE_NONE = 0
+    TAGS_INTF_MIFARE_STATE_NONE = 0,
+    // dump command states
+    TAGS_INTF_MIFARE_STATE_DUMP,
+    TAGS_INTF_MIFARE_STATE_DUMP_AUTH_RSP,
+    TAGS_INTF_MIFARE_STATE_DUMP_READ_RSP
 };
 
 // state strings
-const char *nfcTagsIntfMifare[] = {
-    "TAGS_INTF_MIFARE_STATE_NONE"
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfMifare[] = {
+    "TAGS_INTF_MIFARE_STATE_NONE",
+    // dump command states
+    "TAGS_INTF_MIFARE_STATE_DUMP",
+    "TAGS_INTF_MIFARE_STATE_DUMP_AUTH_RSP",
+    "TAGS_INTF_MIFARE_STATE_DUMP_READ_RSP"
 };
+#endif
 
 // event definition
 enum {
-    TAGS_INTF_MIFARE_ID_NONE
+    TAGS_INTF_MIFARE_ID_NONE,
+    TAGS_INTF_MIFARE_ID_DUMP
+};
+
+// NXP proprietary Mifare RF interface requests
+#define REQ_XCHG_DATA       0x10    // raw Mifare command
+#define REQ_AUTHENTICATE    0x40    // sector authentication
+
+// authentication key selector
+#define KEY_SELECT_B        0x80    // key B, key A otherwise
+#define KEY_SELECT_EMBEDDED 0x10    // key given in the request
+
+// Mifare classic commands
+#define CMD_READ            0x30
+
+// Mifare classic memory mapping definitions
+#define MEMORY_BLOCK_SIZE_BYTES     16  // 16 bytes per block
+#define MEMORY_SMALL_SECTORS        32  // sectors of 4 blocks, then 16
+#define MEMORY_SMALL_SECTOR_BLOCKS  4
+#define MEMORY_LARGE_SECTOR_BLOCKS  16
+#define MEMORY_BLOCKS_MINI          20  // 5 sectors
+#define MEMORY_BLOCKS_1K            64  // 16 sectors
+#define MEMORY_BLOCKS_4K            256 // 40 sectors
+
+// SAK definitions
+#define SAK_MINI            0x09
+#define SAK_4K_MASK         0x10
+
+// unknown key or sector
+#define KEY_NONE            0xFF
+#define SECTOR_NONE         0xFF
+
+// default keys: transport, MAD and NDEF keys
+static const tTAGS_MIFARE_KEY default_keys[] = {
+    {TAGS_MIFARE_KEY_A, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}},
+    {TAGS_MIFARE_KEY_A, {0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5}},
+    {TAGS_MIFARE_KEY_A, {0xD3, 0xF7, 0xD3, 0xF7, 0xD3, 0xF7}}
 };
 
 NfcTagsIntfMifare::NfcTagsIntfMifare(NfcLog& log, NfcNci& nci) :
     NfcTagsIntf(log, nci)
 {
     _state = TAGS_INTF_MIFARE_STATE_NONE;
+    _p_keys = default_keys;
+    _num_keys = sizeof(default_keys)/sizeof(tTAGS_MIFARE_KEY);
+    _num_blocks = MEMORY_BLOCKS_1K;
+    _auth_sector = SECTOR_NONE;
+    memset(_sector_key, KEY_NONE, sizeof(_sector_key));
+}
+
+void NfcTagsIntfMifare::initTag(tNCI_RF_INTF *rf)
+{
+    uint8_t sak;
+
+    NfcTagsIntf::initTag(rf);
+
+    // new session: nothing authenticated
+    _state = TAGS_INTF_MIFARE_STATE_NONE;
+    _auth_sector = SECTOR_NONE;
+    memset(_sector_key, KEY_NONE, sizeof(_sector_key));
+
+    // size from SAK, see NXP application note AN10833
+    sak = rf->specific.params.poll_a.sel_res;
+    if (sak == SAK_MINI) {
+        _num_blocks = MEMORY_BLOCKS_MINI;
+    }
+    else if (sak & SAK_4K_MASK) {
+        _num_blocks = MEMORY_BLOCKS_4K;
+    }
+    else {
+        _num_blocks = MEMORY_BLOCKS_1K;
+    }
 }
 
 uint8_t NfcTagsIntfMifare::getType(void)
@@ -68,28 +145,189 @@ uint8_t* NfcTagsIntfMifare::getNfcidBuf(void)
     return buf;
 }
 
+uint8_t NfcTagsIntfMifare::getSector(uint16_t block)
+{
+    if (block < MEMORY_SMALL_SECTORS * MEMORY_SMALL_SECTOR_BLOCKS) {
+        return block / MEMORY_SMALL_SECTOR_BLOCKS;
+    }
+
+    return MEMORY_SMALL_SECTORS +
+           (block - MEMORY_SMALL_SECTORS * MEMORY_SMALL_SECTOR_BLOCKS) / MEMORY_LARGE_SECTOR_BLOCKS;
+}
+
+uint8_t NfcTagsIntfMifare::getKey(uint8_t sector)
+{
+    // key which opened the sector during the session, if any
+    if (_sector_key[sector] != KEY_NONE) {
+        return _sector_key[sector];
+    }
+
+    return _key;
+}
+
 uint8_t NfcTagsIntfMifare::cmdDump(void)
 {
     uint8_t status;
 
-    _log.d("NfcTagsIntfMifare: %s state = %s\n", __func__, nfcTagsIntfMifare[_state]);
+    _log.d("NfcTagsIntfMifare: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfMifare, _state));
+
+    // check state
+    if (_state != TAGS_INTF_MIFARE_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
 
-    // FIXME: not implemented yet
-    return TAGS_STATUS_REJECTED;
+    // check keys
+    if (_p_keys == NULL || _num_keys == 0) {
+        status = TAGS_STATUS_FAILED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_MIFARE_ID_DUMP;
+    _state = TAGS_INTF_MIFARE_STATE_DUMP;
+    status = TAGS_STATUS_OK;
+
+    // reset block number and key
+    _block = 0;
+    _key = 0;
+
+bail:
+    return status;
 }
 
 uint8_t NfcTagsIntfMifare::handleDump(void)
 {
-    _log.d("NfcTagsIntfMifare: %s state = %s\n", __func__, nfcTagsIntfMifare[_state]);
+    uint8_t status, sector, key;
+    uint8_t buf[3 + TAGS_MIFARE_KEY_SIZE];
+
+    _log.d("NfcTagsIntfMifare: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfMifare, _state));
+
+    switch(_state) {
+        case TAGS_INTF_MIFARE_STATE_DUMP:
+            sector = getSector(_block);
+            if (sector == _auth_sector) {
+                // sector already opened, send read request
+                buf[0] = REQ_XCHG_DATA;
+                buf[1] = CMD_READ;
+                buf[2] = _block;
+                status = _nci.dataSend(NCI_CID_RF_STATIC, buf, 3);
+                _state = TAGS_INTF_MIFARE_STATE_DUMP_READ_RSP;
+            }
+            else {
+                // send authentication request with embedded key
+                key = getKey(sector);
+                buf[0] = REQ_AUTHENTICATE;
+                buf[1] = _block;
+                buf[2] = KEY_SELECT_EMBEDDED;
+                if (_p_keys[key].type == TAGS_MIFARE_KEY_B) {
+                    buf[2] |= KEY_SELECT_B;
+                }
+                memcpy(&buf[3], _p_keys[key].key, TAGS_MIFARE_KEY_SIZE);
+                status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+                _state = TAGS_INTF_MIFARE_STATE_DUMP_AUTH_RSP;
+            }
+            break;
+        case TAGS_INTF_MIFARE_STATE_DUMP_AUTH_RSP:
+        case TAGS_INTF_MIFARE_STATE_DUMP_READ_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_MIFARE_STATE_NONE:
+            // dump completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+        default:
+            status = NCI_STATUS_REJECTED;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        status = translateNciStatus(status);
+    }
 
-    // FIXME: not implemented yet
-    return TAGS_STATUS_REJECTED;
+    return status;
 }
 
 void NfcTagsIntfMifare::handleData(uint8_t status, uint16_t id, void *data)
 {
     _log.d("NfcTagsIntfMifare: %s status = %d id = %d\n", __func__, status, id);
 
-    // FIXME: not implemented yet
+    switch(_state) {
+        case TAGS_INTF_MIFARE_STATE_DUMP_AUTH_RSP:
+            handleDataAuth(status, id, data);
+            break;
+        case TAGS_INTF_MIFARE_STATE_DUMP_READ_RSP:
+            handleDataDump(status, id, data);
+            break;
+        default:
+            break;
+    }
+}
+
+void NfcTagsIntfMifare::handleDataAuth(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+    uint8_t sector = getSector(_block);
+
+    _log.d("NfcTagsIntfMifare: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | request | status
+    if (status == TAGS_STATUS_OK &&
+        buf[0] == 2 && buf[1] == REQ_AUTHENTICATE && buf[2] == 0) {
+        // sector opened, keep its key for the session
+        _sector_key[sector] = getKey(sector);
+        _auth_sector = sector;
+        _state = TAGS_INTF_MIFARE_STATE_DUMP;
+        return;
+    }
+
+    // authentication failed, try next key unless a cached key failed,
+    // the card halts and is activated again first, block and key kept
+    _auth_sector = SECTOR_NONE;
+    if (status == TAGS_STATUS_OK && _sector_key[sector] == KEY_NONE &&
+        ++_key < _num_keys) {
+        _log.d("NfcTagsIntfMifare: sector %d, trying key %d\n", sector, _key);
+        _state = TAGS_INTF_MIFARE_STATE_DUMP;
+        _p_cb->cbIntf(TAGS_STATUS_OK, TAGS_ID_REACTIVATE, NULL);
+        return;
+    }
+
+    _log.e("NfcTagsIntfMifare: sector %d authentication failed\n", sector);
+    notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+}
+
+void NfcTagsIntfMifare::handleDataDump(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfMifare: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | request | data | status
+    if (status != TAGS_STATUS_OK ||
+        buf[0] != (MEMORY_BLOCK_SIZE_BYTES + 2) || buf[1] != REQ_XCHG_DATA ||
+        buf[MEMORY_BLOCK_SIZE_BYTES + 2] != 0) {
+        notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+        return;
+    }
+
+    // next block, key search restarts from the first key
+    _block++;
+    _key = 0;
+    notifyDump(TAGS_STATUS_OK, &buf[2], MEMORY_BLOCK_SIZE_BYTES);
+}
+
+void NfcTagsIntfMifare::notifyDump(uint8_t status, uint8_t *buf, uint8_t len)
+{
+    _dump.buf = buf;
+    _dump.len = len;
+    _dump.more = (status == TAGS_STATUS_OK && _block < _num_blocks);
+    _state = _dump.more ? TAGS_INTF_MIFARE_STATE_DUMP : TAGS_INTF_MIFARE_STATE_NONE;
+
+    _p_cb->cbIntf(status, TAGS_ID_DUMP, &_dump);
 }
 
+#endif // NFC_CONFIG_TAG_MIFARE
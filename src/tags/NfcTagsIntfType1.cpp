@@ -0,0 +1,429 @@
+/*
+ * NfcTagsIntfType1.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsIntf.h"
+
+#if NFC_CONFIG_TAG_TYPE1
+
+// state definition
+enum {
+    TAGS_INTF_T1_STATE_NONE = 0,
+    // dump command states
+    TAGS_INTF_T1_STATE_RID,
+    TAGS_INTF_T1_STATE_RID_RSP,
+    TAGS_INTF_T1_STATE_DUMP,
+    TAGS_INTF_T1_STATE_DUMP_RSP,
+    // presence check states
+    TAGS_INTF_T1_STATE_PRESENCE,
+    TAGS_INTF_T1_STATE_PRESENCE_RSP
+};
+
+// state strings
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfType1[] = {
+    "TAGS_INTF_T1_STATE_NONE",
+    // dump command states
+    "TAGS_INTF_T1_STATE_RID",
+    "TAGS_INTF_T1_STATE_RID_RSP",
+    "TAGS_INTF_T1_STATE_DUMP",
+    "TAGS_INTF_T1_STATE_DUMP_RSP",
+    // presence check states
+    "TAGS_INTF_T1_STATE_PRESENCE",
+    "TAGS_INTF_T1_STATE_PRESENCE_RSP"
+};
+#endif
+
+// event definition
+enum {
+    TAGS_INTF_T1_ID_NONE,
+    TAGS_INTF_T1_ID_DUMP,
+    TAGS_INTF_T1_ID_PRESENCE
+};
+
+// tag type 1 commands, the NFCC appends the CRC
+#define CMD_RID             0x78
+#define CMD_RALL            0x00
+#define CMD_READ            0x01
+#define CMD_READ8           0x02
+#define CMD_RSEG            0x10
+#define CMD_RID_SIZE        7   // cmd | 0 | 0 | 0 | 0 | 0 | 0
+#define CMD_RALL_SIZE       7   // cmd | 0 | 0 | UID0-3
+#define CMD_READ_SIZE       7   // cmd | ADD | 0 | UID0-3
+#define CMD_READ8_SIZE      14  // cmd | ADD8 | 0 * 8 | UID0-3
+#define CMD_RSEG_SIZE       14  // cmd | ADDS | 0 * 8 | UID0-3
+
+// responses sizes, without the NCI status
+#define RSP_RID_SIZE        6   // HR0 | HR1 | UID0-3
+#define RSP_RALL_SIZE       122 // HR0 | HR1 | blocks 0 to 14
+#define RSP_READ_SIZE       2   // ADD | byte
+#define RSP_READ8_SIZE      9   // ADD8 | block
+#define RSP_RSEG_SIZE       129 // ADDS | segment
+#define RSP_PAYLOAD_SIZE(n) ((n) + 2) // len | response | status
+
+// header ROM, HR0 high nibble is 1 for tags of type 1
+// and low nibble tells the memory mapping
+#define HR0_TYPE_MASK       0xF0
+#define HR0_TYPE_1          0x10
+#define HR0_STATIC          0x11
+
+// tag type 1 memory mapping definitions
+#define MEMORY_BLOCK_SIZE_BYTES     8
+#define MEMORY_STATIC_BLOCKS        15  // 120 bytes read by RALL
+#define MEMORY_SEGMENT_BLOCKS       16  // 128 bytes read by RSEG
+#define MEMORY_DYNAMIC_BLOCKS       64  // Topaz 512 when not formatted
+
+// capability container definitions, block 1
+#define CC_BLOCK                    1
+#define CC_OFFSET                   8
+#define CC_MAGIC                    0xE1
+#define CC_OFFSET_MAGIC             0
+#define CC_OFFSET_SIZE              2   // memory size / 8 - 1
+
+NfcTagsIntfType1::NfcTagsIntfType1(NfcLog& log, NfcNci& nci) :
+    NfcTagsIntf(log, nci)
+{
+    _state = TAGS_INTF_T1_STATE_NONE;
+}
+
+void NfcTagsIntfType1::initTag(tNCI_RF_INTF *rf)
+{
+    NfcTagsIntf::initTag(rf);
+
+    // new tag, drop any command left pending on the previous one
+    // and read its header ROM again
+    _state = TAGS_INTF_T1_STATE_NONE;
+    _rid = false;
+    _hr0 = 0;
+}
+
+uint8_t NfcTagsIntfType1::getType(void)
+{
+    return TAGS_TYPE_1;
+}
+
+uint8_t NfcTagsIntfType1::getNfcidLen(void)
+{
+    uint8_t len = 0;
+
+    if(_p_rf != NULL) {
+        len = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_a.nfcid_len;
+    }
+
+    return len;
+}
+
+uint8_t* NfcTagsIntfType1::getNfcidBuf(void)
+{
+    uint8_t *buf = NULL;
+
+    if(_p_rf != NULL) {
+        buf = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_a.nfcid;
+    }
+
+    return buf;
+}
+
+uint8_t NfcTagsIntfType1::cmdDump(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType1: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType1, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T1_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the header ROM and UID are read
+    // once per session as the read commands need them
+    _id = TAGS_INTF_T1_ID_DUMP;
+    _state = _rid ? TAGS_INTF_T1_STATE_DUMP : TAGS_INTF_T1_STATE_RID;
+    status = TAGS_STATUS_OK;
+
+    // reset block number, the size of dynamic memory tags is
+    // known once the capability container is read
+    _block = 0;
+    _byte = 0;
+    _num_blocks = _hr0 == HR0_STATIC ? MEMORY_STATIC_BLOCKS : MEMORY_SEGMENT_BLOCKS;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType1::sendRead(void)
+{
+    uint8_t buf[CMD_RSEG_SIZE];
+    uint8_t len;
+
+    memset(buf, 0, sizeof(buf));
+    if (_hr0 == HR0_STATIC && _p_rf->max_payload_size >= RSP_PAYLOAD_SIZE(RSP_RALL_SIZE)) {
+        // whole static memory at once
+        buf[0] = CMD_RALL;
+        len = CMD_RALL_SIZE;
+        _num = MEMORY_STATIC_BLOCKS;
+    }
+    else if (_hr0 != HR0_STATIC && _num_blocks - _block >= MEMORY_SEGMENT_BLOCKS &&
+             _p_rf->max_payload_size >= RSP_PAYLOAD_SIZE(RSP_RSEG_SIZE)) {
+        // next whole segment, address is in the high nibble
+        buf[0] = CMD_RSEG;
+        buf[1] = (_block / MEMORY_SEGMENT_BLOCKS) << 4;
+        len = CMD_RSEG_SIZE;
+        _num = MEMORY_SEGMENT_BLOCKS;
+    }
+    else if (_hr0 == HR0_STATIC) {
+        // byte by byte when RALL does not fit in a packet, static
+        // memory tags have no READ8, the address is block | byte
+        buf[0] = CMD_READ;
+        buf[1] = (_block << 3) | _byte;
+        len = CMD_READ_SIZE;
+        _num = 0;
+    }
+    else {
+        // blocks past the last whole segment, or all of them when
+        // RSEG does not fit in a packet
+        buf[0] = CMD_READ8;
+        buf[1] = _block;
+        len = CMD_READ8_SIZE;
+        _num = 1;
+    }
+    memcpy(&buf[len - TAGS_T1_UID_SIZE], _uid, TAGS_T1_UID_SIZE);
+
+    return _nci.dataSend(NCI_CID_RF_STATIC, buf, len);
+}
+
+uint8_t NfcTagsIntfType1::handleDump(void)
+{
+    uint8_t status;
+    uint8_t buf[CMD_RID_SIZE];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType1, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T1_STATE_RID:
+            // send NCI RID command
+            memset(buf, 0, sizeof(buf));
+            buf[0] = CMD_RID;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T1_STATE_RID_RSP;
+            break;
+        case TAGS_INTF_T1_STATE_DUMP:
+            // send NCI read command
+            status = sendRead();
+            _state = TAGS_INTF_T1_STATE_DUMP_RSP;
+            break;
+        case TAGS_INTF_T1_STATE_RID_RSP:
+        case TAGS_INTF_T1_STATE_DUMP_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T1_STATE_NONE:
+        default:
+            // dump completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T1_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType1::handleData(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("NfcTagsIntfType1: %s status = %d id = %d\n", __func__, status, id);
+
+    switch(_state) {
+        case TAGS_INTF_T1_STATE_RID_RSP:
+            handleDataRid(status, id, data);
+            break;
+        case TAGS_INTF_T1_STATE_DUMP_RSP:
+            handleDataDump(status, id, data);
+            break;
+        case TAGS_INTF_T1_STATE_PRESENCE_RSP:
+            handleDataPresence(status, id, data);
+            break;
+        default:
+            break;
+    }
+}
+
+void NfcTagsIntfType1::handleDataRid(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType1: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | HR0 | HR1 | UID0-3 | status
+    if (status != TAGS_STATUS_OK || buf[0] != RSP_RID_SIZE + 1 ||
+        buf[RSP_RID_SIZE + 1] != 0 || (buf[1] & HR0_TYPE_MASK) != HR0_TYPE_1) {
+        notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+        return;
+    }
+    _hr0 = buf[1];
+    memcpy(_uid, &buf[3], TAGS_T1_UID_SIZE);
+    _rid = true;
+
+    // header ROM tells the memory mapping
+    _num_blocks = _hr0 == HR0_STATIC ? MEMORY_STATIC_BLOCKS : MEMORY_SEGMENT_BLOCKS;
+    _state = TAGS_INTF_T1_STATE_DUMP;
+}
+
+void NfcTagsIntfType1::handleDataDump(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+    uint8_t len, hdr;
+
+    _log.d("NfcTagsIntfType1: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | header | blocks | status, RALL
+    // header is HR0 | HR1, RSEG, READ8 and READ one is the address
+    if (_num == MEMORY_STATIC_BLOCKS) {
+        len = RSP_RALL_SIZE;
+        hdr = 2;
+    }
+    else {
+        len = _num == 0 ? RSP_READ_SIZE : _num == 1 ? RSP_READ8_SIZE : RSP_RSEG_SIZE;
+        hdr = 1;
+    }
+    if (status != TAGS_STATUS_OK || buf[0] != len + 1 || buf[len + 1] != 0) {
+        notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+        return;
+    }
+    buf += 1 + hdr;
+
+    // dynamic memory size is in the capability container,
+    // unformatted tags are assumed to be Topaz 512
+    if (_hr0 != HR0_STATIC && _block <= CC_BLOCK && _block + _num > CC_BLOCK) {
+        hdr = CC_OFFSET - _block * MEMORY_BLOCK_SIZE_BYTES;
+        if (buf[hdr + CC_OFFSET_MAGIC] == CC_MAGIC) {
+            _num_blocks = buf[hdr + CC_OFFSET_SIZE] + 1;
+        }
+        else {
+            _num_blocks = MEMORY_DYNAMIC_BLOCKS;
+        }
+    }
+    // READ returns a single byte, the block is complete after 8
+    if (_num == 0) {
+        _byte = (_byte + 1) % MEMORY_BLOCK_SIZE_BYTES;
+        _block += _byte == 0;
+        notifyDump(TAGS_STATUS_OK, buf, 1);
+        return;
+    }
+    _block += _num;
+
+    notifyDump(TAGS_STATUS_OK, buf, _num * MEMORY_BLOCK_SIZE_BYTES);
+}
+
+uint8_t NfcTagsIntfType1::checkPresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType1: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType1, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T1_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T1_ID_PRESENCE;
+    _state = TAGS_INTF_T1_STATE_PRESENCE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType1::handlePresence(void)
+{
+    uint8_t status;
+    uint8_t buf[CMD_RID_SIZE];
+
+    _log.d("NfcTagsIntfType1: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType1, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T1_STATE_PRESENCE:
+            // send NCI RID command, the shortest one
+            memset(buf, 0, sizeof(buf));
+            buf[0] = CMD_RID;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T1_STATE_PRESENCE_RSP;
+            break;
+        case TAGS_INTF_T1_STATE_PRESENCE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T1_STATE_NONE:
+        default:
+            // check completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T1_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType1::handleDataPresence(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType1: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // any RID response, RF errors and timeouts mean the tag is gone
+    if (status != TAGS_STATUS_OK || buf[0] != RSP_RID_SIZE + 1 || buf[RSP_RID_SIZE + 1] != 0) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T1_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_PRESENCE, NULL);
+}
+
+void NfcTagsIntfType1::notifyDump(uint8_t status, uint8_t *buf, uint8_t len)
+{
+    _dump.buf = buf;
+    _dump.len = len;
+    if (status == TAGS_STATUS_OK && _block < _num_blocks) {
+        _dump.more = 1;
+        _state = TAGS_INTF_T1_STATE_DUMP;
+    }
+    else {
+        _dump.more = 0;
+        _state = TAGS_INTF_T1_STATE_NONE;
+    }
+
+    _p_cb->cbIntf(status, TAGS_ID_DUMP, &_dump);
+}
+
+#endif // NFC_CONFIG_TAG_TYPE1
@@ -20,37 +20,152 @@
 
 #include "tags/NfcTagsIntf.h"
 
+#if NFC_CONFIG_TAG_TYPE2
+
 // state definition
 enum {
     TAGS_INTF_T2_STATE_NONE = 0,
     // dump command states
     TAGS_INTF_T2_STATE_DUMP,
-    TAGS_INTF_T2_STATE_DUMP_RSP
+    TAGS_INTF_T2_STATE_DUMP_RSP,
+    // read command states
+    TAGS_INTF_T2_STATE_READ,
+    TAGS_INTF_T2_STATE_READ_RSP,
+    // write command states
+    TAGS_INTF_T2_STATE_WRITE,
+    TAGS_INTF_T2_STATE_WRITE_RSP,
+    TAGS_INTF_T2_STATE_VERIFY,
+    TAGS_INTF_T2_STATE_VERIFY_RSP,
+    // NDEF read command states
+    TAGS_INTF_T2_STATE_NDEF,
+    TAGS_INTF_T2_STATE_NDEF_RSP,
+    // probe command states
+    TAGS_INTF_T2_STATE_PROBE,
+    TAGS_INTF_T2_STATE_PROBE_RSP,
+    // presence check states
+    TAGS_INTF_T2_STATE_PRESENCE,
+    TAGS_INTF_T2_STATE_PRESENCE_RSP
 };
 
 // state strings
-const char *nfcTagsIntfType2[] = {
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfType2[] = {
     "TAGS_INTF_T2_STATE_NONE",
-    // reset command states
+    // dump command states
     "TAGS_INTF_T2_STATE_DUMP",
-    "TAGS_INTF_T2_STATE_DUMP_RSP"
+    "TAGS_INTF_T2_STATE_DUMP_RSP",
+    // read command states
+    "TAGS_INTF_T2_STATE_READ",
+    "TAGS_INTF_T2_STATE_READ_RSP",
+    // write command states
+    "TAGS_INTF_T2_STATE_WRITE",
+    "TAGS_INTF_T2_STATE_WRITE_RSP",
+    "TAGS_INTF_T2_STATE_VERIFY",
+    "TAGS_INTF_T2_STATE_VERIFY_RSP",
+    // NDEF read command states
+    "TAGS_INTF_T2_STATE_NDEF",
+    "TAGS_INTF_T2_STATE_NDEF_RSP",
+    // probe command states
+    "TAGS_INTF_T2_STATE_PROBE",
+    "TAGS_INTF_T2_STATE_PROBE_RSP",
+    // presence check states
+    "TAGS_INTF_T2_STATE_PRESENCE",
+    "TAGS_INTF_T2_STATE_PRESENCE_RSP"
 };
+#endif
 
 // event definition
 enum {
     TAGS_INTF_T2_ID_NONE,
-    TAGS_INTF_T2_ID_DUMP
+    TAGS_INTF_T2_ID_DUMP,
+    TAGS_INTF_T2_ID_WRITE,
+    TAGS_INTF_T2_ID_NDEF,
+    TAGS_INTF_T2_ID_WRITE_NDEF,
+    TAGS_INTF_T2_ID_PROBE,
+    TAGS_INTF_T2_ID_READ,
+    TAGS_INTF_T2_ID_PRESENCE
+};
+
+// NDEF write phases, in order, for tear safety the first length
+// byte is cleared first when the length changes, a 1 byte length
+// of 0 which leaves an empty message, and written back last
+enum {
+    NDEF_WRITE_LENGTH_CLEAR = 0,
+    NDEF_WRITE_MESSAGE,
+    NDEF_WRITE_TERMINATOR,
+    NDEF_WRITE_LENGTH,
+    NDEF_WRITE_DONE
 };
 
 // tag type 2 commands
-#define CMD_READ    0x30
-#define CMD_WRITE   0xA2
+#define CMD_READ        0x30
+#define CMD_WRITE       0xA2
+#define CMD_GET_VERSION 0x60    // NXP
+
+// tag type 2 acknowledge, 4 bits, anything else is a NACK
+#define RSP_ACK         0x0A
+#define RSP_ACK_MASK    0x0F
 
 // tag type 2 memory mapping definitions
-#define MEMORY_BLOCK_SIZE_BYTES         4   // 4 bytes per block
+#define MEMORY_BLOCK_SIZE_BYTES         TAGS_T2_BLOCK_SIZE // 4 bytes per block
 #define MEMORY_READ_BLOCK               4   // read 4 blocks
 #define MEMORY_FIRST_BLOCK              0   // 1st block
 #define MEMORY_LAST_BLOCK               15  // last block for static memory mapping
+#define MEMORY_MAX_BLOCKS               256 // block number is 8 bits
+#define MEMORY_CC_BLOCK                 3   // capability container
+#define MEMORY_DATA_BLOCK               4   // 1st block of the data area
+
+// capability container definitions
+#define CC_MAGIC                        0xE1    // NDEF formatted
+#define CC_OFFSET_MAGIC                 0
+#define CC_OFFSET_SIZE                  2       // data area size / 8
+#define CC_SIZE_UNIT                    8
+
+// GET_VERSION response definitions
+#define VERSION_OFFSET_VENDOR           1
+#define VERSION_OFFSET_TYPE             2
+#define VERSION_OFFSET_SIZE             6
+
+// NXP products identified by GET_VERSION: vendor | type | storage size
+typedef struct {
+    uint8_t vendor;
+    uint8_t type;
+    uint8_t size;
+    uint8_t blocks;     // total number of blocks
+} tT2_PRODUCT;
+
+static const tT2_PRODUCT t2_products[] = {
+    {0x04, 0x03, 0x0B, 20},     // Ultralight EV1 MF0UL11
+    {0x04, 0x03, 0x0E, 41},     // Ultralight EV1 MF0UL21
+    {0x04, 0x04, 0x0B, 20},     // NTAG210
+    {0x04, 0x04, 0x0E, 41},     // NTAG212
+    {0x04, 0x04, 0x0F, 45},     // NTAG213
+    {0x04, 0x04, 0x11, 135},    // NTAG215
+    {0x04, 0x04, 0x13, 231}     // NTAG216
+};
+
+// TLV definitions
+#define TLV_TYPE_NULL                   0x00
+#define TLV_TYPE_NDEF                   0x03
+#define TLV_TYPE_TERMINATOR             0xFE
+#define TLV_LENGTH_3_BYTES              0xFF
+#define TLV_LENGTH_SIZE(len)            ((len) < TLV_LENGTH_3_BYTES ? 1 : 3)
+
+// TLV parser states
+enum {
+    TLV_STATE_TYPE = 0,
+    TLV_STATE_LENGTH,
+    TLV_STATE_LENGTH_MSB,
+    TLV_STATE_LENGTH_LSB,
+    TLV_STATE_VALUE
+};
+
+// TLV parser result
+enum {
+    TLV_MORE = 0,
+    TLV_DONE,
+    TLV_ERROR
+};
 
 NfcTagsIntfType2::NfcTagsIntfType2(NfcLog& log, NfcNci& nci) :
     NfcTagsIntf(log, nci)
@@ -58,6 +173,40 @@ NfcTagsIntfType2::NfcTagsIntfType2(NfcLog& log, NfcNci& nci) :
     _state = TAGS_INTF_T2_STATE_NONE;
 }
 
+void NfcTagsIntfType2::initTag(tNCI_RF_INTF *rf)
+{
+    NfcTagsIntf::initTag(rf);
+
+    // new tag, drop any command left pending on the previous one
+    // and forget where the NDEF message was found
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _ndef_addr = 0;
+    setVersion(NULL);
+}
+
+void NfcTagsIntfType2::setVersion(const uint8_t *version)
+{
+    uint8_t i;
+
+    // static memory mapping unless the product is known
+    _last_block = MEMORY_LAST_BLOCK;
+    _version_len = 0;
+    if (version == NULL) {
+        return;
+    }
+    memcpy(_version, version, TAGS_T2_VERSION_SIZE);
+    _version_len = TAGS_T2_VERSION_SIZE;
+
+    for (i = 0; i < sizeof(t2_products) / sizeof(tT2_PRODUCT); i++) {
+        if (t2_products[i].vendor == version[VERSION_OFFSET_VENDOR] &&
+            t2_products[i].type == version[VERSION_OFFSET_TYPE] &&
+            t2_products[i].size == version[VERSION_OFFSET_SIZE]) {
+            _last_block = t2_products[i].blocks - 1;
+            break;
+        }
+    }
+}
+
 uint8_t NfcTagsIntfType2::getType(void)
 {
     return TAGS_TYPE_2;
@@ -89,7 +238,7 @@ uint8_t NfcTagsIntfType2::cmdDump(void)
 {
     uint8_t status;
 
-    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, nfcTagsIntfType2[_state]);
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
 
     // check state
     if (_state != TAGS_INTF_T2_STATE_NONE) {
@@ -114,12 +263,12 @@ uint8_t NfcTagsIntfType2::handleDump(void)
     uint8_t status;
     uint8_t buf[2];
 
-    _log.d("NfcTags: %s state = %s\n", __func__, nfcTagsIntfType2[_state]);
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
 
     switch(_state) {
         case TAGS_INTF_T2_STATE_DUMP:
             // send NCI read command
-            if (_block <= (MEMORY_LAST_BLOCK + 1 - MEMORY_READ_BLOCK)) {
+            if (_block <= _last_block) {
                 buf[0] = CMD_READ;
                 buf[1] = _block;
                 status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
@@ -133,6 +282,11 @@ uint8_t NfcTagsIntfType2::handleDump(void)
             // do nothing, wait for response
             status = NCI_STATUS_OK;
             break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // dump completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
     }
 
     // check status and notify
@@ -141,7 +295,7 @@ uint8_t NfcTagsIntfType2::handleDump(void)
     }
 
     return status;
- 
+}
 
 void NfcTagsIntfType2::handleData(uint8_t status, uint16_t id, void *data)
 {
@@ -151,6 +305,31 @@ void NfcTagsIntfType2::handleData(uint8_t status, uint16_t id, void *data)
         case TAGS_INTF_T2_ID_DUMP:
             handleDataDump(status, id, data);
             break;
+        case TAGS_INTF_T2_ID_NDEF:
+            handleDataNdef(status, id, data);
+            break;
+        case TAGS_INTF_T2_ID_PROBE:
+            handleDataProbe(status, id, data);
+            break;
+        case TAGS_INTF_T2_ID_READ:
+            handleDataRead(status, id, data);
+            break;
+        case TAGS_INTF_T2_ID_PRESENCE:
+            handleDataPresence(status, id, data);
+            break;
+        case TAGS_INTF_T2_ID_WRITE:
+        case TAGS_INTF_T2_ID_WRITE_NDEF:
+            // acknowledges still in flight after a failure are dropped
+            if (_state == TAGS_INTF_T2_STATE_NONE) {
+                break;
+            }
+            if (_state == TAGS_INTF_T2_STATE_VERIFY_RSP) {
+                handleDataVerify(status, id, data);
+            }
+            else {
+                handleDataWrite(status, id, data);
+            }
+            break;
         default:
             break;
     }
@@ -171,7 +350,11 @@ void NfcTagsIntfType2::handleDataDump(uint8_t status, uint16_t id, void *data)
         // payload format is: len | data | status
         _dump.buf = &buf[1];
         _dump.len = buf[0] - 1;
-        if (_block < (MEMORY_LAST_BLOCK + 1 - MEMORY_READ_BLOCK)) {
+        // READ wraps around, blocks past the last one are not dumped
+        if (_block + MEMORY_READ_BLOCK > _last_block + 1) {
+            _dump.len = (_last_block + 1 - _block) * MEMORY_BLOCK_SIZE_BYTES;
+        }
+        if (_block + MEMORY_READ_BLOCK <= _last_block) {
             _dump.more = 1;
             _state = TAGS_INTF_T2_STATE_DUMP;
             _block += MEMORY_READ_BLOCK;
@@ -188,5 +371,764 @@ void NfcTagsIntfType2::handleDataDump(uint8_t status, uint16_t id, void *data)
         _state = TAGS_INTF_T2_STATE_NONE;
     }
 
-    _p_cb->cbDump(status, TAGS_ID_DUMP, &_dump);
+    _p_cb->cbIntf(status, TAGS_ID_DUMP, &_dump);
+}
+
+uint8_t NfcTagsIntfType2::cmdRead(uint16_t block, uint8_t *buf, uint16_t len)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T2_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // whole blocks only, within the 8 bits block number range
+    if (buf == NULL || len == 0 || (len % MEMORY_BLOCK_SIZE_BYTES) != 0 ||
+        block + len / MEMORY_BLOCK_SIZE_BYTES > MEMORY_MAX_BLOCKS) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T2_ID_READ;
+    _state = TAGS_INTF_T2_STATE_READ;
+    status = TAGS_STATUS_OK;
+
+    _read.block = block;
+    _read.buf = buf;
+    _read.len = len;
+    _rd_done = 0;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType2::handleRead(void)
+{
+    uint8_t status;
+    uint8_t buf[2];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T2_STATE_READ:
+            // send NCI read command, next block not read yet
+            buf[0] = CMD_READ;
+            buf[1] = _read.block + _rd_done / MEMORY_BLOCK_SIZE_BYTES;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T2_STATE_READ_RSP;
+            break;
+        case TAGS_INTF_T2_STATE_READ_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // read completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T2_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
 }
+
+void NfcTagsIntfType2::handleDataRead(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+    uint16_t len;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | data | status
+    if (status == TAGS_STATUS_OK &&
+        buf[0] == (MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1) &&
+        buf[MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1] == 0) {
+        len = _read.len - _rd_done;
+        if (len > MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES) {
+            len = MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES;
+        }
+        memcpy(&_read.buf[_rd_done], &buf[1], len);
+        _rd_done += len;
+        if (_rd_done < _read.len) {
+            _state = TAGS_INTF_T2_STATE_READ;
+            return;
+        }
+    }
+    else {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_READ, &_read);
+}
+
+uint8_t NfcTagsIntfType2::checkPresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T2_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T2_ID_PRESENCE;
+    _state = TAGS_INTF_T2_STATE_PRESENCE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType2::handlePresence(void)
+{
+    uint8_t status;
+    uint8_t buf[2];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T2_STATE_PRESENCE:
+            // send NCI read command of the first blocks, any tag has them
+            buf[0] = CMD_READ;
+            buf[1] = MEMORY_FIRST_BLOCK;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T2_STATE_PRESENCE_RSP;
+            break;
+        case TAGS_INTF_T2_STATE_PRESENCE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // check completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T2_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType2::handleDataPresence(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // any READ response, RF errors and timeouts mean the tag is gone
+    if (status != TAGS_STATUS_OK || buf[0] < 2 || buf[buf[0]] != 0) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_PRESENCE, NULL);
+}
+
+uint8_t NfcTagsIntfType2::cmdProbe(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T2_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T2_ID_PROBE;
+    _state = TAGS_INTF_T2_STATE_PROBE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType2::handleProbe(void)
+{
+    uint8_t status;
+    uint8_t buf[1];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T2_STATE_PROBE:
+            // send NCI GET_VERSION command
+            buf[0] = CMD_GET_VERSION;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T2_STATE_PROBE_RSP;
+            break;
+        case TAGS_INTF_T2_STATE_PROBE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // probe completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T2_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType2::handleDataProbe(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | version | status, tags without
+    // GET_VERSION answer a NACK or nothing at all
+    if (status == TAGS_STATUS_OK &&
+        buf[0] == TAGS_T2_VERSION_SIZE + 1 && buf[TAGS_T2_VERSION_SIZE + 1] == 0) {
+        setVersion(&buf[1]);
+    }
+    else {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_DISCOVER_ACTIVATED, NULL);
+}
+
+uint8_t NfcTagsIntfType2::cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T2_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // whole blocks only, within the 8 bits block number range
+    if (buf == NULL || len == 0 || (len % MEMORY_BLOCK_SIZE_BYTES) != 0 ||
+        block + len / MEMORY_BLOCK_SIZE_BYTES > MEMORY_MAX_BLOCKS) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T2_ID_WRITE;
+    _state = TAGS_INTF_T2_STATE_WRITE;
+    status = TAGS_STATUS_OK;
+
+    // the buffer has to remain valid until cbWrite()
+    _wr_buf = buf;
+    _wr_num = len / MEMORY_BLOCK_SIZE_BYTES;
+    _wr_block = block;
+    _wr_verify = verify;
+    _wr_sent = 0;
+    _wr_acked = 0;
+    _wr_checked = 0;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType2::handleWrite(void)
+{
+    uint8_t status;
+    uint8_t credits;
+    uint8_t buf[2 + MEMORY_BLOCK_SIZE_BYTES];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T2_STATE_WRITE:
+        case TAGS_INTF_T2_STATE_WRITE_RSP:
+            // send WRITE commands back to back while the controller
+            // has credits, the next ones once credits are given back
+            status = NCI_STATUS_OK;
+            credits = _nci.getCredits();
+            if (_wr_num == 0) {
+                // nothing to write
+                notifyWrite(TAGS_STATUS_OK);
+                break;
+            }
+            while (_wr_sent < _wr_num && status == NCI_STATUS_OK &&
+                   (credits == NCI_CREDITS_UNLIMITED || credits != 0)) {
+                buf[0] = CMD_WRITE;
+                if (_id == TAGS_INTF_T2_ID_WRITE_NDEF) {
+                    getNdefWriteBlock(&buf[1], &buf[2]);
+                }
+                else {
+                    buf[1] = _wr_block + _wr_sent;
+                    memcpy(&buf[2], &_wr_buf[_wr_sent * MEMORY_BLOCK_SIZE_BYTES], MEMORY_BLOCK_SIZE_BYTES);
+                }
+                status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+                _state = TAGS_INTF_T2_STATE_WRITE_RSP;
+                credits = _nci.getCredits();
+                _wr_sent++;
+            }
+            break;
+        case TAGS_INTF_T2_STATE_VERIFY:
+            // read back 4 blocks at once
+            buf[0] = CMD_READ;
+            buf[1] = _wr_block + _wr_checked;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, 2);
+            _state = TAGS_INTF_T2_STATE_VERIFY_RSP;
+            break;
+        case TAGS_INTF_T2_STATE_VERIFY_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // write completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T2_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType2::handleDataWrite(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | ACK or NACK | status
+    if (status != TAGS_STATUS_OK || buf[0] != 2 || buf[2] != 0 ||
+        (buf[1] & RSP_ACK_MASK) != RSP_ACK) {
+        _log.e("NfcTagsIntfType2: write %d of %d not acknowledged\n", _wr_acked + 1, _wr_num);
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+    _wr_acked++;
+
+    // all blocks written, read back or complete
+    if (_wr_acked == _wr_num) {
+        if (_wr_verify) {
+            _state = TAGS_INTF_T2_STATE_VERIFY;
+        }
+        else {
+            notifyWrite(TAGS_STATUS_OK);
+        }
+    }
+}
+
+void NfcTagsIntfType2::handleDataVerify(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+    uint16_t num;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | data | status
+    if (status != TAGS_STATUS_OK ||
+        buf[0] != (MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1) ||
+        buf[MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1] != 0) {
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+
+    // compare blocks read with the ones written
+    num = _wr_num - _wr_checked;
+    if (num > MEMORY_READ_BLOCK) {
+        num = MEMORY_READ_BLOCK;
+    }
+    if (memcmp(&buf[1], &_wr_buf[_wr_checked * MEMORY_BLOCK_SIZE_BYTES], num * MEMORY_BLOCK_SIZE_BYTES) != 0) {
+        _log.e("NfcTagsIntfType2: blocks %d to %d read back differ\n", _wr_block + _wr_checked, _wr_block + _wr_checked + num - 1);
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+    _wr_checked += num;
+
+    if (_wr_checked == _wr_num) {
+        notifyWrite(TAGS_STATUS_OK);
+    }
+    else {
+        _state = TAGS_INTF_T2_STATE_VERIFY;
+    }
+}
+
+void NfcTagsIntfType2::notifyWrite(uint8_t status)
+{
+    // the NDEF TLV length field now has the size of the new message
+    if (_id == TAGS_INTF_T2_ID_WRITE_NDEF && status == TAGS_STATUS_OK) {
+        _ndef_lsize = TLV_LENGTH_SIZE(_wr_len);
+    }
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_WRITE, NULL);
+}
+
+uint8_t NfcTagsIntfType2::cmdReadNdef(uint8_t *buf, uint16_t size)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T2_STATE_NONE || buf == NULL) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the capability container is read
+    // first along with the beginning of the data area
+    _id = TAGS_INTF_T2_ID_NDEF;
+    _state = TAGS_INTF_T2_STATE_NDEF;
+    status = TAGS_STATUS_OK;
+    _block = MEMORY_CC_BLOCK;
+
+    // reset TLV parser
+    _ndef.buf = buf;
+    _ndef.len = 0;
+    _ndef_size = size;
+    _ndef_end = 0;
+    _tlv_state = TLV_STATE_TYPE;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType2::handleReadNdef(void)
+{
+    uint8_t status;
+    uint8_t buf[2];
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T2_STATE_NDEF:
+            // send NCI read command
+            buf[0] = CMD_READ;
+            buf[1] = _block;
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T2_STATE_NDEF_RSP;
+            break;
+        case TAGS_INTF_T2_STATE_NDEF_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T2_STATE_NONE:
+        default:
+            // read completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T2_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType2::handleDataNdef(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+    uint16_t addr;
+    uint8_t i, tlv;
+
+    _log.d("NfcTagsIntfType2: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | data | status
+    if (status != TAGS_STATUS_OK ||
+        buf[0] != (MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1) ||
+        buf[MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES + 1] != 0) {
+        notifyNdef(TAGS_STATUS_FAILED);
+        return;
+    }
+    buf++;
+
+    // check the capability container, the data area follows
+    i = 0;
+    if (_block == MEMORY_CC_BLOCK) {
+        if (buf[CC_OFFSET_MAGIC] != CC_MAGIC) {
+            _log.e("NfcTagsIntfType2: tag is not NDEF formatted\n");
+            notifyNdef(TAGS_STATUS_FAILED);
+            return;
+        }
+        _ndef_end = MEMORY_DATA_BLOCK * MEMORY_BLOCK_SIZE_BYTES + buf[CC_OFFSET_SIZE] * CC_SIZE_UNIT;
+        i = MEMORY_BLOCK_SIZE_BYTES;
+    }
+
+    // parse TLVs up to the end of the NDEF one
+    addr = _block * MEMORY_BLOCK_SIZE_BYTES + i;
+    tlv = TLV_MORE;
+    for (; i < MEMORY_READ_BLOCK * MEMORY_BLOCK_SIZE_BYTES && addr < _ndef_end && tlv == TLV_MORE; i++, addr++) {
+        // keep the NDEF TLV location and the bytes before it
+        // in its block for the NDEF write command
+        if (_tlv_state == TLV_STATE_TYPE && buf[i] == TLV_TYPE_NDEF) {
+            _ndef_addr = addr;
+            memcpy(_ndef_prefix, &buf[i - addr % MEMORY_BLOCK_SIZE_BYTES], MEMORY_BLOCK_SIZE_BYTES);
+        }
+        tlv = parseTlv(buf[i]);
+    }
+
+    // message complete or read the next blocks, if any
+    if (tlv == TLV_DONE) {
+        notifyNdef(TAGS_STATUS_OK);
+    }
+    else if (tlv == TLV_ERROR || addr >= _ndef_end) {
+        notifyNdef(TAGS_STATUS_FAILED);
+    }
+    else {
+        _block += MEMORY_READ_BLOCK;
+        _state = TAGS_INTF_T2_STATE_NDEF;
+    }
+}
+
+uint8_t NfcTagsIntfType2::parseTlv(uint8_t b)
+{
+    switch(_tlv_state) {
+        case TLV_STATE_TYPE:
+            // NULL TLVs are padding, no NDEF TLV before the terminator
+            if (b == TLV_TYPE_TERMINATOR) {
+                _log.e("NfcTagsIntfType2: no NDEF message\n");
+                return TLV_ERROR;
+            }
+            if (b != TLV_TYPE_NULL) {
+                _tlv_type = b;
+                _tlv_state = TLV_STATE_LENGTH;
+            }
+            return TLV_MORE;
+        case TLV_STATE_LENGTH:
+            if (b == TLV_LENGTH_3_BYTES) {
+                _tlv_state = TLV_STATE_LENGTH_MSB;
+                return TLV_MORE;
+            }
+            _tlv_len = b;
+            break;
+        case TLV_STATE_LENGTH_MSB:
+            _tlv_len = b << 8;
+            _tlv_state = TLV_STATE_LENGTH_LSB;
+            return TLV_MORE;
+        case TLV_STATE_LENGTH_LSB:
+            _tlv_len |= b;
+            break;
+        case TLV_STATE_VALUE:
+        default:
+            // copy the NDEF message, skip other TLVs (lock
+            // and memory control, proprietary)
+            if (_tlv_type == TLV_TYPE_NDEF) {
+                _ndef.buf[_ndef.len++] = b;
+            }
+            if (--_tlv_len == 0) {
+                _tlv_state = TLV_STATE_TYPE;
+                return _tlv_type == TLV_TYPE_NDEF ? TLV_DONE : TLV_MORE;
+            }
+            return TLV_MORE;
+    }
+
+    // length parsed, check the message fits in the buffer
+    if (_tlv_type == TLV_TYPE_NDEF && _tlv_len > _ndef_size) {
+        _log.e("NfcTagsIntfType2: NDEF message of %d bytes too large\n", _tlv_len);
+        return TLV_ERROR;
+    }
+    if (_tlv_type == TLV_TYPE_NDEF) {
+        _ndef_lsize = (_tlv_state == TLV_STATE_LENGTH) ? 1 : 3;
+    }
+    if (_tlv_len == 0) {
+        _tlv_state = TLV_STATE_TYPE;
+        return _tlv_type == TLV_TYPE_NDEF ? TLV_DONE : TLV_MORE;
+    }
+    _tlv_state = TLV_STATE_VALUE;
+    return TLV_MORE;
+}
+
+void NfcTagsIntfType2::notifyNdef(uint8_t status)
+{
+    // no NDEF write to a TLV which could not be read
+    if (status != TAGS_STATUS_OK) {
+        _ndef_addr = 0;
+    }
+    _state = TAGS_INTF_T2_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_READ_NDEF, &_ndef);
+}
+
+uint8_t NfcTagsIntfType2::cmdWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old)
+{
+    uint8_t status;
+    uint8_t block, data[MEMORY_BLOCK_SIZE_BYTES];
+
+    _log.d("NfcTagsIntfType2: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType2, _state));
+
+    // check state, the NDEF TLV location is known from a previous read
+    if (_state != TAGS_INTF_T2_STATE_NONE || _ndef_addr == 0 || (buf == NULL && len != 0)) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // check the TLV and terminator fit in the data area
+    if (_ndef_addr + 1 + TLV_LENGTH_SIZE(len) + len + 1 > _ndef_end) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T2_ID_WRITE_NDEF;
+    _state = TAGS_INTF_T2_STATE_WRITE;
+    status = TAGS_STATUS_OK;
+
+    // the buffers have to remain valid until cbWrite(), without
+    // the current message every block of the new one is written
+    _wr_buf = buf;
+    _wr_len = len;
+    _wr_old = (old != NULL) ? old->buf : NULL;
+    _wr_old_len = (old != NULL) ? old->len : 0;
+    _wr_resize = (old == NULL || old->len != len || _ndef_lsize != TLV_LENGTH_SIZE(len));
+    _wr_verify = false;
+    _wr_sent = 0;
+    _wr_acked = 0;
+
+    // count the blocks to write
+    _wr_num = 0;
+    _wr_phase = _wr_resize ? NDEF_WRITE_LENGTH_CLEAR : NDEF_WRITE_MESSAGE;
+    _wr_next = 0;
+    while (getNdefWriteBlock(&block, data)) {
+        _wr_num++;
+    }
+    _wr_phase = _wr_resize ? NDEF_WRITE_LENGTH_CLEAR : NDEF_WRITE_MESSAGE;
+    _wr_next = 0;
+    _log.d("NfcTagsIntfType2: %s %d blocks to write\n", __func__, _wr_num);
+
+bail:
+    return status;
+}
+
+bool NfcTagsIntfType2::getNdefByte(uint16_t addr, const uint8_t *msg, uint16_t len,
+                                   uint8_t lsize, bool clear, uint8_t *b)
+{
+    uint16_t off;
+
+    // TLVs before the NDEF one are left unchanged
+    if (addr < _ndef_addr) {
+        *b = _ndef_prefix[addr % MEMORY_BLOCK_SIZE_BYTES];
+        return true;
+    }
+
+    // type | length (1 or 3 bytes) | message | terminator
+    off = addr - _ndef_addr;
+    if (off == 0) {
+        *b = TLV_TYPE_NDEF;
+    }
+    else if (off == 1) {
+        *b = clear ? 0 : (lsize == 1 ? len : TLV_LENGTH_3_BYTES);
+    }
+    else if (off <= lsize) {
+        *b = (off == 2) ? len >> 8 : len & 0xFF;
+    }
+    else if (off - 1 - lsize < len) {
+        *b = msg[off - 1 - lsize];
+    }
+    else if (off - 1 - lsize == len) {
+        *b = TLV_TYPE_TERMINATOR;
+    }
+    else {
+        // unknown content, past the terminator
+        *b = TLV_TYPE_NULL;
+        return false;
+    }
+
+    return true;
+}
+
+bool NfcTagsIntfType2::getNdefWriteBlock(uint8_t *block, uint8_t data[])
+{
+    uint16_t len_first, term, addr, b;
+    uint8_t lsize, i, old[MEMORY_BLOCK_SIZE_BYTES];
+    bool changed, known;
+
+    // blocks holding the first length byte and the terminator of the
+    // new TLV, the other length bytes are written with the message
+    lsize = TLV_LENGTH_SIZE(_wr_len);
+    len_first = (_ndef_addr + 1) / MEMORY_BLOCK_SIZE_BYTES;
+    term = (_ndef_addr + 1 + lsize + _wr_len) / MEMORY_BLOCK_SIZE_BYTES;
+
+    while (_wr_phase != NDEF_WRITE_DONE) {
+        // next block of the current phase, the terminator is
+        // written with the length when they share a block
+        switch(_wr_phase) {
+            case NDEF_WRITE_MESSAGE:
+                b = (_wr_next != 0) ? _wr_next : len_first + 1;
+                changed = (b < term);
+                break;
+            case NDEF_WRITE_TERMINATOR:
+                b = term;
+                changed = (_wr_next == 0 && term > len_first);
+                break;
+            case NDEF_WRITE_LENGTH_CLEAR:
+            case NDEF_WRITE_LENGTH:
+            default:
+                b = len_first;
+                changed = (_wr_next == 0);
+                break;
+        }
+        if (!changed) {
+            // phase completed
+            _wr_phase++;
+            _wr_next = 0;
+            continue;
+        }
+        _wr_next = b + 1;
+
+        // compare the new block with the current one, bytes past the
+        // current terminator are unknown
+        changed = (_wr_old == NULL);
+        for (i = 0; i < MEMORY_BLOCK_SIZE_BYTES; i++) {
+            addr = b * MEMORY_BLOCK_SIZE_BYTES + i;
+            known = getNdefByte(addr, _wr_old, _wr_old_len, _ndef_lsize, false, &old[i]);
+            if (getNdefByte(addr, _wr_buf, _wr_len, lsize, _wr_phase == NDEF_WRITE_LENGTH_CLEAR, &data[i]) &&
+                (!known || data[i] != old[i])) {
+                changed = true;
+            }
+        }
+
+        // the length block is always written when the length changes
+        if (changed || (_wr_resize && (_wr_phase == NDEF_WRITE_LENGTH_CLEAR || _wr_phase == NDEF_WRITE_LENGTH))) {
+            *block = b;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif // NFC_CONFIG_TAG_TYPE2
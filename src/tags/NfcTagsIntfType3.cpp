@@ -0,0 +1,643 @@
+/*
+ * NfcTagsIntfType3.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsIntf.h"
+
+#if NFC_CONFIG_TAG_TYPE3
+
+// state definition
+enum {
+    TAGS_INTF_T3_STATE_NONE = 0,
+    // dump command states
+    TAGS_INTF_T3_STATE_DUMP,
+    TAGS_INTF_T3_STATE_DUMP_RSP,
+    // write command states
+    TAGS_INTF_T3_STATE_ATTR,
+    TAGS_INTF_T3_STATE_ATTR_RSP,
+    TAGS_INTF_T3_STATE_WRITE,
+    TAGS_INTF_T3_STATE_WRITE_RSP,
+    TAGS_INTF_T3_STATE_VERIFY,
+    TAGS_INTF_T3_STATE_VERIFY_RSP,
+    // presence check states
+    TAGS_INTF_T3_STATE_PRESENCE,
+    TAGS_INTF_T3_STATE_PRESENCE_RSP
+};
+
+// state strings
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfType3[] = {
+    "TAGS_INTF_T3_STATE_NONE",
+    // dump command states
+    "TAGS_INTF_T3_STATE_DUMP",
+    "TAGS_INTF_T3_STATE_DUMP_RSP",
+    // write command states
+    "TAGS_INTF_T3_STATE_ATTR",
+    "TAGS_INTF_T3_STATE_ATTR_RSP",
+    "TAGS_INTF_T3_STATE_WRITE",
+    "TAGS_INTF_T3_STATE_WRITE_RSP",
+    "TAGS_INTF_T3_STATE_VERIFY",
+    "TAGS_INTF_T3_STATE_VERIFY_RSP",
+    // presence check states
+    "TAGS_INTF_T3_STATE_PRESENCE",
+    "TAGS_INTF_T3_STATE_PRESENCE_RSP"
+};
+#endif
+
+// event definition
+enum {
+    TAGS_INTF_T3_ID_NONE,
+    TAGS_INTF_T3_ID_DUMP,
+    TAGS_INTF_T3_ID_WRITE,
+    TAGS_INTF_T3_ID_PRESENCE
+};
+
+// tag type 3 commands and responses
+#define CMD_REQ_RESPONSE    0x04
+#define RSP_REQ_RESPONSE    0x05
+#define CMD_CHECK           0x06
+#define RSP_CHECK           0x07
+#define CMD_UPDATE          0x08
+#define RSP_UPDATE          0x09
+
+// frame format is: LEN | code | NFCID2 | ...
+#define FRAME_OFFSET_CODE       1
+#define FRAME_OFFSET_NFCID2     2
+#define FRAME_OFFSET_PARAMS     10
+// response parameters are: status flag 1 | status flag 2 | ...
+#define RSP_FLAGS_SIZE          2
+#define RSP_OFFSET_FLAG1        FRAME_OFFSET_PARAMS
+#define RSP_OFFSET_FLAG2        (FRAME_OFFSET_PARAMS + 1)
+// Check response payload size for n blocks: frame | status
+#define RSP_CHECK_SIZE(n)       (FRAME_OFFSET_PARAMS + RSP_FLAGS_SIZE + 1 + (n) * TAGS_T3_BLOCK_SIZE + 1)
+static_assert(NCI_RX_BUFFER_SIZE >= NCI_MSG_HDR_SIZE + RSP_CHECK_SIZE(1),
+              "NFC_CONFIG_NCI_RX_SIZE too small for type 3 tags");
+
+// NDEF services, the tag memory is mapped to them
+#define SERVICE_NDEF_READ       0x000B
+#define SERVICE_NDEF_WRITE      0x0009
+
+// block list element, 2 bytes for block numbers up to 255
+#define BLOCK_ELEM_2_BYTES      0x80    // service code list order 0
+#define BLOCK_ELEM_MAX_SHORT    0xFF
+
+// tag type 3 memory mapping definitions
+#define MEMORY_BLOCK_SIZE_BYTES TAGS_T3_BLOCK_SIZE  // 16 bytes per block
+#define MEMORY_ATTR_BLOCK       0                   // attribute information
+
+// attribute information block definitions
+#define ATTR_OFFSET_VERSION     0
+#define ATTR_OFFSET_NBR         1
+#define ATTR_OFFSET_NBW         2
+#define ATTR_OFFSET_NMAXB       3
+#define ATTR_OFFSET_CHECKSUM    14
+#define ATTR_VERSION_MAJOR      0x10    // mapping version 1.x
+#define ATTR_VERSION_MASK       0xF0
+
+NfcTagsIntfType3::NfcTagsIntfType3(NfcLog& log, NfcNci& nci) :
+    NfcTagsIntf(log, nci)
+{
+    _state = TAGS_INTF_T3_STATE_NONE;
+}
+
+void NfcTagsIntfType3::initTag(tNCI_RF_INTF *rf)
+{
+    NfcTagsIntf::initTag(rf);
+
+    // new tag, drop any command left pending on the previous one
+    // and read its attribute information block again
+    _state = TAGS_INTF_T3_STATE_NONE;
+    _attr = false;
+
+    // Check responses are not reassembled, they have to fit in
+    // the maximum payload of the connection along with the header
+    _check_max = TAGS_T3_CHECK_MAX;
+    if (rf->max_payload_size < RSP_CHECK_SIZE(TAGS_T3_CHECK_MAX)) {
+        _check_max = rf->max_payload_size > RSP_CHECK_SIZE(1) ?
+            (rf->max_payload_size - RSP_CHECK_SIZE(0)) / MEMORY_BLOCK_SIZE_BYTES : 1;
+    }
+}
+
+uint8_t NfcTagsIntfType3::getType(void)
+{
+    return TAGS_TYPE_3;
+}
+
+uint8_t NfcTagsIntfType3::getNfcidLen(void)
+{
+    uint8_t len = 0;
+
+    if(_p_rf != NULL &&
+       ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_f.sensf_res_len >= NCI_RF_PF_NFCID2_LENGTH) {
+        len = NCI_RF_PF_NFCID2_LENGTH;
+    }
+
+    return len;
+}
+
+uint8_t* NfcTagsIntfType3::getNfcidBuf(void)
+{
+    uint8_t *buf = NULL;
+
+    if(_p_rf != NULL) {
+        // NFCID2 is the first field of SENSF_RES
+        buf = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_f.sensf_res;
+    }
+
+    return buf;
+}
+
+static uint8_t setBlockElement(uint8_t *p, uint16_t block)
+{
+    if (block <= BLOCK_ELEM_MAX_SHORT) {
+        p[0] = BLOCK_ELEM_2_BYTES;
+        p[1] = block;
+        return 2;
+    }
+    p[0] = 0;
+    p[1] = block & 0xFF;
+    p[2] = block >> 8;
+    return 3;
+}
+
+uint8_t NfcTagsIntfType3::sendCheck(uint16_t block, uint8_t num)
+{
+    uint8_t i, k;
+
+    // Check command is: LEN | 0x06 | NFCID2 | 1 | service | num | block list
+    _cmd[FRAME_OFFSET_CODE] = CMD_CHECK;
+    memcpy(&_cmd[FRAME_OFFSET_NFCID2], getNfcidBuf(), NCI_RF_PF_NFCID2_LENGTH);
+    i = FRAME_OFFSET_PARAMS;
+    _cmd[i++] = 1;
+    _cmd[i++] = SERVICE_NDEF_READ & 0xFF;
+    _cmd[i++] = SERVICE_NDEF_READ >> 8;
+    _cmd[i++] = num;
+    for (k = 0; k < num; k++) {
+        i += setBlockElement(&_cmd[i], block + k);
+    }
+    _cmd[0] = i;
+    _num = num;
+
+    return _nci.dataSend(NCI_CID_RF_STATIC, _cmd, i);
+}
+
+uint8_t NfcTagsIntfType3::sendUpdate(uint16_t block, uint8_t num, const uint8_t *data)
+{
+    uint8_t i, k;
+
+    // Update command is: LEN | 0x08 | NFCID2 | 1 | service | num | block list | data
+    _cmd[FRAME_OFFSET_CODE] = CMD_UPDATE;
+    memcpy(&_cmd[FRAME_OFFSET_NFCID2], getNfcidBuf(), NCI_RF_PF_NFCID2_LENGTH);
+    i = FRAME_OFFSET_PARAMS;
+    _cmd[i++] = 1;
+    _cmd[i++] = SERVICE_NDEF_WRITE & 0xFF;
+    _cmd[i++] = SERVICE_NDEF_WRITE >> 8;
+    _cmd[i++] = num;
+    for (k = 0; k < num; k++) {
+        i += setBlockElement(&_cmd[i], block + k);
+    }
+    memcpy(&_cmd[i], data, num * MEMORY_BLOCK_SIZE_BYTES);
+    i += num * MEMORY_BLOCK_SIZE_BYTES;
+    _cmd[0] = i;
+    _num = num;
+
+    // the command is kept in _cmd as NfcNci may send it in segments
+    return _nci.dataSend(NCI_CID_RF_STATIC, _cmd, i);
+}
+
+uint8_t *NfcTagsIntfType3::getRsp(uint8_t status, uint8_t buf[], uint8_t code, uint8_t len)
+{
+    uint8_t *frame = &buf[1];
+
+    // payload format is: len | frame | status
+    if (translateNciStatus(status) != TAGS_STATUS_OK ||
+        buf[0] < FRAME_OFFSET_PARAMS + RSP_FLAGS_SIZE + 1 ||
+        buf[buf[0]] != 0 ||
+        frame[0] != buf[0] - 1 ||
+        frame[FRAME_OFFSET_CODE] != code ||
+        memcmp(&frame[FRAME_OFFSET_NFCID2], getNfcidBuf(), NCI_RF_PF_NFCID2_LENGTH) != 0) {
+        return NULL;
+    }
+
+    // the tag reports errors through its status flags
+    if (frame[RSP_OFFSET_FLAG1] != 0 || frame[RSP_OFFSET_FLAG2] != 0) {
+        _log.e("NfcTagsIntfType3: status flags %02x %02x\n", frame[RSP_OFFSET_FLAG1], frame[RSP_OFFSET_FLAG2]);
+        return NULL;
+    }
+
+    if (frame[0] != FRAME_OFFSET_PARAMS + RSP_FLAGS_SIZE + len) {
+        return NULL;
+    }
+
+    return &frame[FRAME_OFFSET_PARAMS + RSP_FLAGS_SIZE];
+}
+
+bool NfcTagsIntfType3::parseAttr(const uint8_t *attr)
+{
+    uint16_t sum = 0;
+    uint8_t i;
+
+    for (i = 0; i < ATTR_OFFSET_CHECKSUM; i++) {
+        sum += attr[i];
+    }
+    if (sum != ((attr[ATTR_OFFSET_CHECKSUM] << 8) | attr[ATTR_OFFSET_CHECKSUM + 1]) ||
+        (attr[ATTR_OFFSET_VERSION] & ATTR_VERSION_MASK) != ATTR_VERSION_MAJOR) {
+        _log.e("NfcTagsIntfType3: tag is not NDEF formatted\n");
+        return false;
+    }
+
+    // a tag accepts at least one block per command
+    _nbr = attr[ATTR_OFFSET_NBR] != 0 ? attr[ATTR_OFFSET_NBR] : 1;
+    _nbw = attr[ATTR_OFFSET_NBW] != 0 ? attr[ATTR_OFFSET_NBW] : 1;
+    _nmaxb = (attr[ATTR_OFFSET_NMAXB] << 8) | attr[ATTR_OFFSET_NMAXB + 1];
+
+    return true;
+}
+
+uint8_t NfcTagsIntfType3::getNumBlocks(uint16_t left, uint8_t max, uint8_t card)
+{
+    // as many blocks as the tag and the frame allow
+    if (card < max) {
+        max = card;
+    }
+
+    return left < max ? left : max;
+}
+
+uint8_t NfcTagsIntfType3::cmdDump(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType3: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T3_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the attribute information block
+    // is read first to know the data area size
+    _id = TAGS_INTF_T3_ID_DUMP;
+    _state = TAGS_INTF_T3_STATE_DUMP;
+    status = TAGS_STATUS_OK;
+    _block = MEMORY_ATTR_BLOCK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType3::handleDump(void)
+{
+    uint8_t status;
+    uint8_t num;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T3_STATE_DUMP:
+            // send Check command
+            if (_block == MEMORY_ATTR_BLOCK) {
+                num = 1;
+            }
+            else {
+                num = getNumBlocks(_nmaxb + 1 - _block, _check_max, _nbr);
+            }
+            status = sendCheck(_block, num);
+            _state = TAGS_INTF_T3_STATE_DUMP_RSP;
+            break;
+        case TAGS_INTF_T3_STATE_DUMP_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T3_STATE_NONE:
+        default:
+            // dump completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T3_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType3::handleData(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("NfcTagsIntfType3: %s status = %d id = %d\n", __func__, status, id);
+
+    // responses left after a failure are dropped
+    if (_state == TAGS_INTF_T3_STATE_NONE) {
+        return;
+    }
+
+    switch(_id) {
+        case TAGS_INTF_T3_ID_DUMP:
+            handleDataDump(status, id, data);
+            break;
+        case TAGS_INTF_T3_ID_WRITE:
+            if (_state == TAGS_INTF_T3_STATE_VERIFY_RSP) {
+                handleDataVerify(status, id, data);
+            }
+            else {
+                handleDataWrite(status, id, data);
+            }
+            break;
+        case TAGS_INTF_T3_ID_PRESENCE:
+            handleDataPresence(status, id, data);
+            break;
+        default:
+            break;
+    }
+}
+
+void NfcTagsIntfType3::handleDataDump(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf;
+
+    _log.d("NfcTagsIntfType3: %s status = %d id = %d\n", __func__, status, id);
+
+    buf = getRsp(status, (uint8_t*) data, RSP_CHECK, 1 + _num * MEMORY_BLOCK_SIZE_BYTES);
+    if (buf == NULL || buf[0] != _num) {
+        _dump.buf = NULL;
+        _dump.len = 0;
+        _dump.more = 0;
+        _state = TAGS_INTF_T3_STATE_NONE;
+        _p_cb->cbIntf(TAGS_STATUS_FAILED, TAGS_ID_DUMP, &_dump);
+        return;
+    }
+
+    // response data is: number of blocks | blocks
+    _dump.buf = &buf[1];
+    _dump.len = _num * MEMORY_BLOCK_SIZE_BYTES;
+    if (_block == MEMORY_ATTR_BLOCK) {
+        _attr = parseAttr(&buf[1]);
+    }
+    _block += _num;
+
+    // the data area follows the attribute information block
+    if (_attr && _block <= _nmaxb) {
+        _dump.more = 1;
+        _state = TAGS_INTF_T3_STATE_DUMP;
+    }
+    else {
+        _dump.more = 0;
+        _state = TAGS_INTF_T3_STATE_NONE;
+    }
+
+    _p_cb->cbIntf(TAGS_STATUS_OK, TAGS_ID_DUMP, &_dump);
+}
+
+uint8_t NfcTagsIntfType3::checkPresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType3: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T3_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T3_ID_PRESENCE;
+    _state = TAGS_INTF_T3_STATE_PRESENCE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType3::handlePresence(void)
+{
+    uint8_t status;
+    uint8_t buf[FRAME_OFFSET_PARAMS];
+
+    _log.d("NfcTagsIntfType3: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T3_STATE_PRESENCE:
+            // send Request Response command: LEN | 0x04 | NFCID2
+            buf[0] = FRAME_OFFSET_PARAMS;
+            buf[FRAME_OFFSET_CODE] = CMD_REQ_RESPONSE;
+            memcpy(&buf[FRAME_OFFSET_NFCID2], getNfcidBuf(), NCI_RF_PF_NFCID2_LENGTH);
+            status = _nci.dataSend(NCI_CID_RF_STATIC, buf, sizeof(buf));
+            _state = TAGS_INTF_T3_STATE_PRESENCE_RSP;
+            break;
+        case TAGS_INTF_T3_STATE_PRESENCE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T3_STATE_NONE:
+        default:
+            // check completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T3_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType3::handleDataPresence(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType3: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // payload format is: len | LEN | 0x05 | NFCID2 | mode | status
+    if (status != TAGS_STATUS_OK || buf[0] < FRAME_OFFSET_PARAMS + 1 || buf[buf[0]] != 0 ||
+        buf[1 + FRAME_OFFSET_CODE] != RSP_REQ_RESPONSE) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T3_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_PRESENCE, NULL);
+}
+
+uint8_t NfcTagsIntfType3::cmdWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType3: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T3_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // whole blocks only, within the data area if already known
+    if (buf == NULL || len == 0 || (len % MEMORY_BLOCK_SIZE_BYTES) != 0 ||
+        (_attr && (uint32_t) block + len / MEMORY_BLOCK_SIZE_BYTES > (uint32_t) _nmaxb + 1)) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the attribute information block
+    // is read first to know how many blocks an Update may carry
+    _id = TAGS_INTF_T3_ID_WRITE;
+    _state = _attr ? TAGS_INTF_T3_STATE_WRITE : TAGS_INTF_T3_STATE_ATTR;
+    status = TAGS_STATUS_OK;
+
+    // the buffer has to remain valid until cbWrite()
+    _wr_buf = buf;
+    _wr_block = block;
+    _wr_num = len / MEMORY_BLOCK_SIZE_BYTES;
+    _wr_verify = verify;
+    _wr_done = 0;
+    _wr_checked = 0;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType3::handleWrite(void)
+{
+    uint8_t status;
+    uint8_t num;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType3, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T3_STATE_ATTR:
+            status = sendCheck(MEMORY_ATTR_BLOCK, 1);
+            _state = TAGS_INTF_T3_STATE_ATTR_RSP;
+            break;
+        case TAGS_INTF_T3_STATE_WRITE:
+            num = getNumBlocks(_wr_num - _wr_done, TAGS_T3_UPDATE_MAX, _nbw);
+            status = sendUpdate(_wr_block + _wr_done, num,
+                                &_wr_buf[_wr_done * MEMORY_BLOCK_SIZE_BYTES]);
+            _state = TAGS_INTF_T3_STATE_WRITE_RSP;
+            break;
+        case TAGS_INTF_T3_STATE_VERIFY:
+            num = getNumBlocks(_wr_num - _wr_checked, _check_max, _nbr);
+            status = sendCheck(_wr_block + _wr_checked, num);
+            _state = TAGS_INTF_T3_STATE_VERIFY_RSP;
+            break;
+        case TAGS_INTF_T3_STATE_ATTR_RSP:
+        case TAGS_INTF_T3_STATE_WRITE_RSP:
+        case TAGS_INTF_T3_STATE_VERIFY_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T3_STATE_NONE:
+        default:
+            // write completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T3_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType3::handleDataWrite(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf;
+
+    _log.d("NfcTagsIntfType3: %s status = %d id = %d\n", __func__, status, id);
+
+    // attribute information block, check the blocks are in the data area
+    if (_state == TAGS_INTF_T3_STATE_ATTR_RSP) {
+        buf = getRsp(status, (uint8_t*) data, RSP_CHECK, 1 + MEMORY_BLOCK_SIZE_BYTES);
+        if (buf == NULL || buf[0] != 1 || !(_attr = parseAttr(&buf[1])) ||
+            (uint32_t) _wr_block + _wr_num > (uint32_t) _nmaxb + 1) {
+            notifyWrite(TAGS_STATUS_FAILED);
+            return;
+        }
+        _state = TAGS_INTF_T3_STATE_WRITE;
+        return;
+    }
+
+    // Update response has the status flags only
+    if (getRsp(status, (uint8_t*) data, RSP_UPDATE, 0) == NULL) {
+        _log.e("NfcTagsIntfType3: update of blocks %d to %d failed\n", _wr_block + _wr_done, _wr_block + _wr_done + _num - 1);
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+    _wr_done += _num;
+
+    // all blocks written, read back or complete
+    if (_wr_done < _wr_num) {
+        _state = TAGS_INTF_T3_STATE_WRITE;
+    }
+    else if (_wr_verify) {
+        _state = TAGS_INTF_T3_STATE_VERIFY;
+    }
+    else {
+        notifyWrite(TAGS_STATUS_OK);
+    }
+}
+
+void NfcTagsIntfType3::handleDataVerify(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf;
+
+    _log.d("NfcTagsIntfType3: %s status = %d id = %d\n", __func__, status, id);
+
+    buf = getRsp(status, (uint8_t*) data, RSP_CHECK, 1 + _num * MEMORY_BLOCK_SIZE_BYTES);
+    if (buf == NULL || buf[0] != _num) {
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+
+    // compare blocks read with the ones written
+    if (memcmp(&buf[1], &_wr_buf[_wr_checked * MEMORY_BLOCK_SIZE_BYTES], _num * MEMORY_BLOCK_SIZE_BYTES) != 0) {
+        _log.e("NfcTagsIntfType3: blocks %d to %d read back differ\n", _wr_block + _wr_checked, _wr_block + _wr_checked + _num - 1);
+        notifyWrite(TAGS_STATUS_FAILED);
+        return;
+    }
+    _wr_checked += _num;
+
+    if (_wr_checked == _wr_num) {
+        notifyWrite(TAGS_STATUS_OK);
+    }
+    else {
+        _state = TAGS_INTF_T3_STATE_VERIFY;
+    }
+}
+
+void NfcTagsIntfType3::notifyWrite(uint8_t status)
+{
+    // the attribute information block may have changed
+    if (_wr_block == MEMORY_ATTR_BLOCK) {
+        _attr = false;
+    }
+    _state = TAGS_INTF_T3_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_WRITE, NULL);
+}
+
+#endif // NFC_CONFIG_TAG_TYPE3
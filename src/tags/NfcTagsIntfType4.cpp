@@ -0,0 +1,574 @@
+/*
+ * NfcTagsIntfType4.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsIntf.h"
+
+#if NFC_CONFIG_TAG_TYPE4
+
+// state definition
+enum {
+    TAGS_INTF_T4_STATE_NONE = 0,
+    // APDU command states
+    TAGS_INTF_T4_STATE_APDU,
+    TAGS_INTF_T4_STATE_APDU_RSP,
+    // NDEF read command states
+    TAGS_INTF_T4_STATE_NDEF,
+    TAGS_INTF_T4_STATE_NDEF_RSP,
+    // presence check states
+    TAGS_INTF_T4_STATE_PRESENCE,
+    TAGS_INTF_T4_STATE_PRESENCE_RSP
+};
+
+// state strings
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfType4[] = {
+    "TAGS_INTF_T4_STATE_NONE",
+    // APDU command states
+    "TAGS_INTF_T4_STATE_APDU",
+    "TAGS_INTF_T4_STATE_APDU_RSP",
+    // NDEF read command states
+    "TAGS_INTF_T4_STATE_NDEF",
+    "TAGS_INTF_T4_STATE_NDEF_RSP",
+    // presence check states
+    "TAGS_INTF_T4_STATE_PRESENCE",
+    "TAGS_INTF_T4_STATE_PRESENCE_RSP"
+};
+#endif
+
+// event definition
+enum {
+    TAGS_INTF_T4_ID_NONE,
+    TAGS_INTF_T4_ID_APDU,
+    TAGS_INTF_T4_ID_NDEF,
+    TAGS_INTF_T4_ID_PRESENCE
+};
+
+// NDEF read procedure steps, in order
+enum {
+    NDEF_SELECT_APPLICATION = 0,
+    NDEF_SELECT_CC,
+    NDEF_READ_CC,
+    NDEF_SELECT_FILE,
+    NDEF_READ_NLEN,
+    NDEF_READ_FILE
+};
+
+// ISO 7816-4 commands
+#define APDU_CLA            0x00
+#define APDU_INS_SELECT     0xA4
+#define APDU_INS_READ       0xB0
+#define APDU_P1_BY_NAME     0x04
+#define APDU_P1_BY_ID       0x00
+#define APDU_P2_FIRST       0x00
+#define APDU_P2_NO_FCI      0x0C
+#define APDU_SW_OK          0x9000
+#define APDU_LE_SHORT_MAX   256
+#define APDU_SW_SIZE        2
+
+// the controller may send a READ BINARY response in a single packet,
+// it has to fit an RX buffer smaller than the largest NCI packet
+#if NCI_RX_BUFFER_SIZE < NCI_PACKET_SIZE
+#define T4_LE_MAX           (NCI_RX_BUFFER_SIZE - NCI_MSG_HDR_SIZE - APDU_SW_SIZE)
+#endif
+
+// NDEF tag application definitions
+static const uint8_t ndef_aid[] = {0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01};
+static const uint8_t cc_file[] = {0xE1, 0x03};
+#define CC_OFFSET_VERSION   2
+#define CC_OFFSET_MLE       3
+#define CC_OFFSET_TLV       7
+#define CC_VERSION_MAJOR    0x20    // mapping version 2.x
+#define CC_VERSION_MASK     0xF0
+#define CC_TLV_NDEF_FILE    0x04
+#define CC_TLV_FILE_ID      2       // offsets in the TLV
+#define CC_TLV_READ_ACCESS  6
+#define CC_ACCESS_GRANTED   0x00
+#define NLEN_SIZE           2
+
+NfcTagsIntfType4::NfcTagsIntfType4(NfcLog& log, NfcNci& nci) :
+    NfcTagsIntf(log, nci)
+{
+    _state = TAGS_INTF_T4_STATE_NONE;
+    _chunk = 0;
+}
+
+void NfcTagsIntfType4::initTag(tNCI_RF_INTF *rf)
+{
+    NfcTagsIntf::initTag(rf);
+
+    // new tag, drop any command left pending on the previous one
+    _state = TAGS_INTF_T4_STATE_NONE;
+
+    _log.d("NfcTagsIntfType4: FSC = %d FWT = %lu us SFGT = %lu us\n", rf->activation.fsc,
+           (unsigned long)rf->activation.fwt, (unsigned long)rf->activation.sfgt);
+}
+
+uint8_t NfcTagsIntfType4::getType(void)
+{
+    return TAGS_TYPE_4;
+}
+
+uint8_t NfcTagsIntfType4::getNfcidLen(void)
+{
+    uint8_t len = 0;
+
+    // NFCID1 on NFC-A, PUPI on NFC-B
+    if(_p_rf != NULL) {
+        if (_p_rf->specific.type == NCI_DISCOVERY_TYPE_POLL_B) {
+            len = NCI_RF_PB_PUPI_LENGTH;
+        }
+        else {
+            len = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_a.nfcid_len;
+        }
+    }
+
+    return len;
+}
+
+uint8_t* NfcTagsIntfType4::getNfcidBuf(void)
+{
+    uint8_t *buf = NULL;
+
+    if(_p_rf != NULL) {
+        if (_p_rf->specific.type == NCI_DISCOVERY_TYPE_POLL_B) {
+            buf = _p_rf->specific.params.poll_b.pupi;
+        }
+        else {
+            buf = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_a.nfcid;
+        }
+    }
+
+    return buf;
+}
+
+uint8_t NfcTagsIntfType4::cmdDump(void)
+{
+    // no memory to dump, files are accessed through APDUs
+    return TAGS_STATUS_REJECTED;
+}
+
+uint8_t NfcTagsIntfType4::handleDump(void)
+{
+    return TAGS_STATUS_REJECTED;
+}
+
+uint8_t NfcTagsIntfType4::cmdExchangeApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T4_STATE_NONE || apdu == NULL || len == 0) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the buffers have to
+    // remain valid until cbApdu()
+    _id = TAGS_INTF_T4_ID_APDU;
+    _state = TAGS_INTF_T4_STATE_APDU;
+    status = TAGS_STATUS_OK;
+    _cmd_buf = apdu;
+    _cmd_len = len;
+    _apdu.buf = rsp;
+    _rsp_size = (rsp != NULL) ? size : 0;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType4::handleApdu(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T4_STATE_APDU:
+            status = sendApdu(_cmd_buf, _cmd_len, _apdu.buf, _rsp_size);
+            _state = TAGS_INTF_T4_STATE_APDU_RSP;
+            break;
+        case TAGS_INTF_T4_STATE_APDU_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T4_STATE_NONE:
+        default:
+            // exchange completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T4_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+uint8_t NfcTagsIntfType4::sendApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+{
+    // reset response, NfcNci segments the command if needed
+    _apdu.buf = rsp;
+    _apdu.len = 0;
+    _apdu.sw = 0;
+    _rsp_size = size;
+    _sw_len = 0;
+    _overflow = false;
+
+    return _nci.dataSend(NCI_CID_RF_STATIC, apdu, len);
+}
+
+void NfcTagsIntfType4::receive(const uint8_t *buf, uint8_t len)
+{
+    // the last 2 bytes of the response are the status word,
+    // bytes are moved to the response buffer once 2 more
+    // bytes are received, without buffer they are dropped
+    while (len--) {
+        if (_sw_len == sizeof(_sw)) {
+            if (_apdu.len < _rsp_size) {
+                _apdu.buf[_apdu.len++] = _sw[0];
+            }
+            else if (_apdu.buf != NULL) {
+                _overflow = true;
+            }
+            _sw[0] = _sw[1];
+            _sw_len--;
+        }
+        _sw[_sw_len++] = *buf++;
+    }
+}
+
+void NfcTagsIntfType4::handleData(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType4: %s status = %d id = %d\n", __func__, status, id);
+
+    if (_state == TAGS_INTF_T4_STATE_PRESENCE_RSP) {
+        handleDataPresence(status, id, data);
+        return;
+    }
+    if (_state != TAGS_INTF_T4_STATE_APDU_RSP && _state != TAGS_INTF_T4_STATE_NDEF_RSP) {
+        return;
+    }
+
+    // payload format is: len | data, segment by segment
+    status = translateNciStatus(status);
+    if (status == TAGS_STATUS_OK && buf != NULL) {
+        receive(&buf[1], buf[0]);
+        if (id & NCI_DATA_ID_PBF) {
+            // more segments to come
+            return;
+        }
+        if (_sw_len != sizeof(_sw)) {
+            status = TAGS_STATUS_MESSAGE_CORRUPTED;
+        }
+        else if (_overflow) {
+            _log.e("NfcTagsIntfType4: response larger than %d bytes\n", _rsp_size);
+            status = TAGS_STATUS_FAILED;
+        }
+        _apdu.sw = (_sw[0] << 8) | _sw[1];
+    }
+    else if (status == TAGS_STATUS_OK) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    switch(_id) {
+        case TAGS_INTF_T4_ID_APDU:
+            _state = TAGS_INTF_T4_STATE_NONE;
+            _p_cb->cbIntf(status, TAGS_ID_APDU, &_apdu);
+            break;
+        case TAGS_INTF_T4_ID_NDEF:
+            handleDataNdef(status);
+            break;
+        default:
+            break;
+    }
+}
+
+uint8_t NfcTagsIntfType4::checkPresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T4_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T4_ID_PRESENCE;
+    _state = TAGS_INTF_T4_STATE_PRESENCE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType4::handlePresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T4_STATE_PRESENCE:
+            // send an empty data message, the NFCC sends an empty I-block
+            // the card acknowledges with an empty I-block too
+            status = _nci.dataSend(NCI_CID_RF_STATIC, NULL, 0);
+            _state = TAGS_INTF_T4_STATE_PRESENCE_RSP;
+            break;
+        case TAGS_INTF_T4_STATE_PRESENCE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T4_STATE_NONE:
+        default:
+            // check completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T4_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType4::handleDataPresence(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType4: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // any response, RF errors and timeouts mean the card is gone
+    if (status != TAGS_STATUS_OK || buf == NULL) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T4_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_PRESENCE, NULL);
+}
+
+uint8_t NfcTagsIntfType4::cmdReadNdef(uint8_t *buf, uint16_t size)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T4_STATE_NONE || buf == NULL) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, start with the NDEF application
+    _id = TAGS_INTF_T4_ID_NDEF;
+    _state = TAGS_INTF_T4_STATE_NDEF;
+    status = TAGS_STATUS_OK;
+    _step = NDEF_SELECT_APPLICATION;
+    _ndef.buf = buf;
+    _ndef.len = 0;
+    _ndef_size = size;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType4::handleReadNdef(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType4: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType4, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T4_STATE_NDEF:
+            status = sendNdefApdu();
+            _state = TAGS_INTF_T4_STATE_NDEF_RSP;
+            break;
+        case TAGS_INTF_T4_STATE_NDEF_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T4_STATE_NONE:
+        default:
+            // read completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T4_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+uint8_t NfcTagsIntfType4::sendNdefApdu(void)
+{
+    uint8_t *p = _cmd;
+    uint16_t offset, le;
+
+    // CLA | INS | P1 | P2 | [Lc | data] | [Le]
+    *p++ = APDU_CLA;
+    switch(_step) {
+        case NDEF_SELECT_APPLICATION:
+            *p++ = APDU_INS_SELECT;
+            *p++ = APDU_P1_BY_NAME;
+            *p++ = APDU_P2_FIRST;
+            *p++ = sizeof(ndef_aid);
+            memcpy(p, ndef_aid, sizeof(ndef_aid));
+            p += sizeof(ndef_aid);
+            *p++ = 0x00;
+            break;
+        case NDEF_SELECT_CC:
+        case NDEF_SELECT_FILE:
+            *p++ = APDU_INS_SELECT;
+            *p++ = APDU_P1_BY_ID;
+            *p++ = APDU_P2_NO_FCI;
+            *p++ = sizeof(cc_file);
+            if (_step == NDEF_SELECT_CC) {
+                memcpy(p, cc_file, sizeof(cc_file));
+            }
+            else {
+                memcpy(p, &_cc[CC_OFFSET_TLV + CC_TLV_FILE_ID], sizeof(cc_file));
+            }
+            p += sizeof(cc_file);
+            break;
+        case NDEF_READ_CC:
+        case NDEF_READ_NLEN:
+            *p++ = APDU_INS_READ;
+            *p++ = 0x00;
+            *p++ = 0x00;
+            *p++ = (_step == NDEF_READ_CC) ? TAGS_T4_CC_SIZE : NLEN_SIZE;
+            // the NDEF file length is read to the capability container
+            // buffer, no longer needed
+            return sendApdu(_cmd, p - _cmd, _cc, *(p - 1));
+        case NDEF_READ_FILE:
+        default:
+            // read the message straight into the application buffer,
+            // chunks larger than 256 bytes need an extended Le
+            offset = NLEN_SIZE + _ndef.len;
+            le = _nlen - _ndef.len;
+            if (_chunk != 0 && _chunk < le) {
+                le = _chunk;
+            }
+            if (_mle < le) {
+                le = _mle;
+            }
+#ifdef T4_LE_MAX
+            if (le > T4_LE_MAX) {
+                le = T4_LE_MAX;
+            }
+#endif
+            *p++ = APDU_INS_READ;
+            *p++ = offset >> 8;
+            *p++ = offset & 0xFF;
+            if (le > APDU_LE_SHORT_MAX) {
+                *p++ = 0x00;
+                *p++ = le >> 8;
+            }
+            *p++ = le & 0xFF;
+            return sendApdu(_cmd, p - _cmd, &_ndef.buf[_ndef.len], le);
+    }
+
+    // selection responses are not needed
+    return sendApdu(_cmd, p - _cmd, NULL, 0);
+}
+
+void NfcTagsIntfType4::handleDataNdef(uint8_t status)
+{
+    uint8_t *tlv;
+
+    _log.d("NfcTagsIntfType4: %s status = %d step = %d\n", __func__, status, _step);
+
+    if (status != TAGS_STATUS_OK || _apdu.sw != APDU_SW_OK) {
+        _log.e("NfcTagsIntfType4: NDEF step %d failed, sw = %x\n", _step, _apdu.sw);
+        notifyNdef(TAGS_STATUS_FAILED);
+        return;
+    }
+
+    switch(_step) {
+        case NDEF_READ_CC:
+            // CCLEN | mapping version | MLe | MLc | NDEF file control TLV
+            tlv = &_cc[CC_OFFSET_TLV];
+            _mle = (_cc[CC_OFFSET_MLE] << 8) | _cc[CC_OFFSET_MLE + 1];
+            if (_apdu.len != TAGS_T4_CC_SIZE ||
+                (_cc[CC_OFFSET_VERSION] & CC_VERSION_MASK) != CC_VERSION_MAJOR ||
+                tlv[0] != CC_TLV_NDEF_FILE || tlv[CC_TLV_READ_ACCESS] != CC_ACCESS_GRANTED ||
+                _mle == 0) {
+                _log.e("NfcTagsIntfType4: unsupported capability container\n");
+                notifyNdef(TAGS_STATUS_FAILED);
+                return;
+            }
+            break;
+        case NDEF_READ_NLEN:
+            _nlen = (_cc[0] << 8) | _cc[1];
+            if (_apdu.len != NLEN_SIZE || _nlen > _ndef_size) {
+                _log.e("NfcTagsIntfType4: NDEF message of %d bytes too large\n", _nlen);
+                notifyNdef(TAGS_STATUS_FAILED);
+                return;
+            }
+            if (_nlen == 0) {
+                notifyNdef(TAGS_STATUS_OK);
+                return;
+            }
+            break;
+        case NDEF_READ_FILE:
+            // read the next chunk until the message is complete
+            _ndef.len += _apdu.len;
+            if (_apdu.len == 0) {
+                notifyNdef(TAGS_STATUS_FAILED);
+            }
+            else if (_ndef.len >= _nlen) {
+                notifyNdef(TAGS_STATUS_OK);
+            }
+            else {
+                _state = TAGS_INTF_T4_STATE_NDEF;
+            }
+            return;
+        default:
+            break;
+    }
+
+    // next step
+    _step++;
+    _state = TAGS_INTF_T4_STATE_NDEF;
+}
+
+void NfcTagsIntfType4::notifyNdef(uint8_t status)
+{
+    _state = TAGS_INTF_T4_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_READ_NDEF, &_ndef);
+}
+
+#endif // NFC_CONFIG_TAG_TYPE4
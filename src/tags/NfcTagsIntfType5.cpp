@@ -0,0 +1,402 @@
+/*
+ * NfcTagsIntfType5.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsIntf.h"
+
+#if NFC_CONFIG_TAG_TYPE5
+
+// state definition
+enum {
+    TAGS_INTF_T5_STATE_NONE = 0,
+    // dump command states
+    TAGS_INTF_T5_STATE_INFO,
+    TAGS_INTF_T5_STATE_INFO_RSP,
+    TAGS_INTF_T5_STATE_DUMP,
+    TAGS_INTF_T5_STATE_DUMP_RSP,
+    // presence check states
+    TAGS_INTF_T5_STATE_PRESENCE,
+    TAGS_INTF_T5_STATE_PRESENCE_RSP
+};
+
+// state strings
+#if NFC_CONFIG_STATE_NAMES
+static const char *nfcTagsIntfType5[] = {
+    "TAGS_INTF_T5_STATE_NONE",
+    // dump command states
+    "TAGS_INTF_T5_STATE_INFO",
+    "TAGS_INTF_T5_STATE_INFO_RSP",
+    "TAGS_INTF_T5_STATE_DUMP",
+    "TAGS_INTF_T5_STATE_DUMP_RSP",
+    // presence check states
+    "TAGS_INTF_T5_STATE_PRESENCE",
+    "TAGS_INTF_T5_STATE_PRESENCE_RSP"
+};
+#endif
+
+// event definition
+enum {
+    TAGS_INTF_T5_ID_NONE,
+    TAGS_INTF_T5_ID_DUMP,
+    TAGS_INTF_T5_ID_PRESENCE
+};
+
+// ISO 15693 commands, addressed with the UID at high data rate,
+// the NFCC appends the CRC
+#define CMD_READ_SINGLE     0x20
+#define CMD_READ_MULTIPLE   0x23
+#define CMD_GET_INFO        0x2B
+#define CMD_FLAGS           0x22    // addressed | high data rate
+#define CMD_SIZE_MAX        12      // flags | cmd | UID | block | num - 1
+#define CMD_OFFSET_UID      2
+
+// response format is: flags | data, or flags | error code
+#define RSP_FLAG_ERROR      0x01
+#define RSP_HEADER_SIZE     1
+
+// Get System Information response data definitions
+#define INFO_DSFID          0x01
+#define INFO_AFI            0x02
+#define INFO_MEMORY_SIZE    0x04
+#define INFO_OFFSET_UID     1   // info flags | UID | ...
+#define INFO_BLOCK_SIZE_MASK 0x1F
+
+// tag type 5 memory mapping definitions, block numbers are 8 bits
+// without the protocol extension
+#define MEMORY_MAX_BLOCKS   256
+
+// largest block read alone: flags | block | status, in a packet
+static_assert(NCI_RX_BUFFER_SIZE >= NCI_MSG_HDR_SIZE + RSP_HEADER_SIZE + INFO_BLOCK_SIZE_MASK + 1 + 1,
+              "NFC_CONFIG_NCI_RX_SIZE too small for type 5 tags");
+
+NfcTagsIntfType5::NfcTagsIntfType5(NfcLog& log, NfcNci& nci) :
+    NfcTagsIntf(log, nci)
+{
+    _state = TAGS_INTF_T5_STATE_NONE;
+}
+
+void NfcTagsIntfType5::initTag(tNCI_RF_INTF *rf)
+{
+    NfcTagsIntf::initTag(rf);
+
+    // new tag, drop any command left pending on the previous one
+    // and read its system information again
+    _state = TAGS_INTF_T5_STATE_NONE;
+    _info = false;
+}
+
+uint8_t NfcTagsIntfType5::getType(void)
+{
+    return TAGS_TYPE_5;
+}
+
+uint8_t NfcTagsIntfType5::getNfcidLen(void)
+{
+    uint8_t len = 0;
+
+    if(_p_rf != NULL) {
+        len = NCI_RF_PV_UID_LENGTH;
+    }
+
+    return len;
+}
+
+uint8_t* NfcTagsIntfType5::getNfcidBuf(void)
+{
+    uint8_t *buf = NULL;
+
+    if(_p_rf != NULL) {
+        buf = ((tNCI_RF_INTF *)_p_rf)->specific.params.poll_v.uid;
+    }
+
+    return buf;
+}
+
+uint8_t NfcTagsIntfType5::cmdDump(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType5: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType5, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T5_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine, the system information is
+    // read once per session to get the memory size
+    _id = TAGS_INTF_T5_ID_DUMP;
+    _state = _info ? TAGS_INTF_T5_STATE_DUMP : TAGS_INTF_T5_STATE_INFO;
+    status = TAGS_STATUS_OK;
+    _block = 0;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType5::sendCmd(uint8_t cmd)
+{
+    uint8_t buf[CMD_SIZE_MAX];
+    uint8_t len;
+
+    buf[0] = CMD_FLAGS;
+    buf[1] = cmd;
+    memcpy(&buf[CMD_OFFSET_UID], getNfcidBuf(), NCI_RF_PV_UID_LENGTH);
+    len = CMD_OFFSET_UID + NCI_RF_PV_UID_LENGTH;
+    if (cmd != CMD_GET_INFO) {
+        buf[len++] = _block;
+    }
+    if (cmd == CMD_READ_MULTIPLE) {
+        buf[len++] = _num - 1;
+    }
+
+    return _nci.dataSend(NCI_CID_RF_STATIC, buf, len);
+}
+
+uint8_t *NfcTagsIntfType5::getRsp(uint8_t status, uint8_t buf[], uint8_t *len)
+{
+    // payload format is: len | flags | data | status
+    if (translateNciStatus(status) != TAGS_STATUS_OK ||
+        buf[0] < RSP_HEADER_SIZE + 1 || buf[buf[0]] != 0) {
+        return NULL;
+    }
+    if (buf[1] & RSP_FLAG_ERROR) {
+        _log.e("NfcTagsIntfType5: error code %02x\n", buf[0] > 2 ? buf[2] : 0);
+        return NULL;
+    }
+    *len = buf[0] - RSP_HEADER_SIZE - 1;
+
+    return &buf[1 + RSP_HEADER_SIZE];
+}
+
+uint8_t NfcTagsIntfType5::handleDump(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTags: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType5, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T5_STATE_INFO:
+            // send Get System Information command
+            status = sendCmd(CMD_GET_INFO);
+            _state = TAGS_INTF_T5_STATE_INFO_RSP;
+            break;
+        case TAGS_INTF_T5_STATE_DUMP:
+            // send read command, a single block one
+            // if the tag takes one block at a time
+            _num = _rmb_max;
+            if (_num > _num_blocks - _block) {
+                _num = _num_blocks - _block;
+            }
+            status = sendCmd(_num > 1 ? CMD_READ_MULTIPLE : CMD_READ_SINGLE);
+            _state = TAGS_INTF_T5_STATE_DUMP_RSP;
+            break;
+        case TAGS_INTF_T5_STATE_INFO_RSP:
+        case TAGS_INTF_T5_STATE_DUMP_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T5_STATE_NONE:
+        default:
+            // dump completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T5_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType5::handleData(uint8_t status, uint16_t id, void *data)
+{
+    _log.d("NfcTagsIntfType5: %s status = %d id = %d\n", __func__, status, id);
+
+    switch(_state) {
+        case TAGS_INTF_T5_STATE_INFO_RSP:
+            handleDataInfo(status, id, data);
+            break;
+        case TAGS_INTF_T5_STATE_DUMP_RSP:
+            handleDataDump(status, id, data);
+            break;
+        case TAGS_INTF_T5_STATE_PRESENCE_RSP:
+            handleDataPresence(status, id, data);
+            break;
+        default:
+            break;
+    }
+}
+
+void NfcTagsIntfType5::handleDataInfo(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf;
+    uint8_t len, i;
+    uint16_t max;
+
+    _log.d("NfcTagsIntfType5: %s status = %d id = %d\n", __func__, status, id);
+
+    // data format is: info flags | UID | [DSFID] | [AFI] | [memory size] | ...
+    buf = getRsp(status, (uint8_t*) data, &len);
+    i = INFO_OFFSET_UID + NCI_RF_PV_UID_LENGTH;
+    if (buf != NULL && (buf[0] & INFO_DSFID)) {
+        i++;
+    }
+    if (buf != NULL && (buf[0] & INFO_AFI)) {
+        i++;
+    }
+    if (buf == NULL || !(buf[0] & INFO_MEMORY_SIZE) || len < i + 2) {
+        _log.e("NfcTagsIntfType5: memory size unknown\n");
+        notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+        return;
+    }
+    _num_blocks = buf[i] + 1;
+    _block_size = (buf[i + 1] & INFO_BLOCK_SIZE_MASK) + 1;
+    _info = true;
+
+    // as many blocks as fit in a response packet along with the
+    // header and status, the responses are not reassembled, at
+    // least one block even if the payload is that small
+    max = 0;
+    if (_p_rf->max_payload_size > RSP_HEADER_SIZE + 1) {
+        max = (_p_rf->max_payload_size - RSP_HEADER_SIZE - 1) / _block_size;
+    }
+    if (max > MEMORY_MAX_BLOCKS - 1) {
+        max = MEMORY_MAX_BLOCKS - 1;
+    }
+    _rmb_max = max != 0 ? max : 1;
+
+    _state = TAGS_INTF_T5_STATE_DUMP;
+}
+
+void NfcTagsIntfType5::handleDataDump(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf;
+    uint8_t len;
+
+    _log.d("NfcTagsIntfType5: %s status = %d id = %d\n", __func__, status, id);
+
+    buf = getRsp(status, (uint8_t*) data, &len);
+    if (buf == NULL || len != _num * _block_size) {
+        // tag may not take that many blocks at once, retry
+        // with half of them and keep it for the session
+        if (_num > 1) {
+            _rmb_max = _num / 2;
+            _log.d("NfcTagsIntfType5: read %d blocks at once\n", _rmb_max);
+            _state = TAGS_INTF_T5_STATE_DUMP;
+            return;
+        }
+        notifyDump(TAGS_STATUS_FAILED, NULL, 0);
+        return;
+    }
+    _block += _num;
+
+    notifyDump(TAGS_STATUS_OK, buf, len);
+}
+
+uint8_t NfcTagsIntfType5::checkPresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType5: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType5, _state));
+
+    // check state
+    if (_state != TAGS_INTF_T5_STATE_NONE) {
+        status = TAGS_STATUS_REJECTED;
+        goto bail;
+    }
+
+    // prepare state machine
+    _id = TAGS_INTF_T5_ID_PRESENCE;
+    _state = TAGS_INTF_T5_STATE_PRESENCE;
+    status = TAGS_STATUS_OK;
+
+bail:
+    return status;
+}
+
+uint8_t NfcTagsIntfType5::handlePresence(void)
+{
+    uint8_t status;
+
+    _log.d("NfcTagsIntfType5: %s state = %s\n", __func__, NFC_STATE_NAME(nfcTagsIntfType5, _state));
+
+    switch(_state) {
+        case TAGS_INTF_T5_STATE_PRESENCE:
+            // send Get System Information command, addressed
+            status = sendCmd(CMD_GET_INFO);
+            _state = TAGS_INTF_T5_STATE_PRESENCE_RSP;
+            break;
+        case TAGS_INTF_T5_STATE_PRESENCE_RSP:
+            // do nothing, wait for response
+            status = NCI_STATUS_OK;
+            break;
+        case TAGS_INTF_T5_STATE_NONE:
+        default:
+            // check completed, nothing to do
+            status = NCI_STATUS_OK;
+            break;
+    }
+
+    // check status and notify
+    if (status != NCI_STATUS_OK) {
+        _state = TAGS_INTF_T5_STATE_NONE;
+        status = translateNciStatus(status);
+    }
+
+    return status;
+}
+
+void NfcTagsIntfType5::handleDataPresence(uint8_t status, uint16_t id, void *data)
+{
+    uint8_t *buf = (uint8_t*) data;
+
+    _log.d("NfcTagsIntfType5: %s status = %d id = %d\n", __func__, status, id);
+    status = translateNciStatus(status);
+
+    // any response, error ones included, RF errors and timeouts mean the tag is gone
+    if (status != TAGS_STATUS_OK || buf[0] < RSP_HEADER_SIZE + 1 || buf[buf[0]] != 0) {
+        status = TAGS_STATUS_FAILED;
+    }
+
+    _state = TAGS_INTF_T5_STATE_NONE;
+    _p_cb->cbIntf(status, TAGS_ID_PRESENCE, NULL);
+}
+
+void NfcTagsIntfType5::notifyDump(uint8_t status, uint8_t *buf, uint8_t len)
+{
+    _dump.buf = buf;
+    _dump.len = len;
+    if (status == TAGS_STATUS_OK && _block < _num_blocks) {
+        _dump.more = 1;
+        _state = TAGS_INTF_T5_STATE_DUMP;
+    }
+    else {
+        _dump.more = 0;
+        _state = TAGS_INTF_T5_STATE_NONE;
+    }
+
+    _p_cb->cbIntf(status, TAGS_ID_DUMP, &_dump);
+}
+
+#endif // NFC_CONFIG_TAG_TYPE5
@@ -0,0 +1,390 @@
+/*
+ * NfcTagsJobs.cpp
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "tags/NfcTagsJobs.h"
+
+NfcTagsJobs::NfcTagsJobs(NfcLog& log, NfcTags& tags) :
+    _log(log), _tags(tags), _p_cb(NULL), _head(0), _num(0), _handle(0),
+    _active(false), _running(false)
+{
+    uint8_t i;
+
+    for (i = 0; i < TAGS_JOBS_SIZE; i++) {
+        _jobs[i].handle = 0;
+        _jobs[i].type = TAGS_JOB_NONE;
+        _jobs[i].status = TAGS_JOB_UNKNOWN;
+    }
+}
+
+tTAGS_JOB* NfcTagsJobs::submit(uint8_t type)
+{
+    tTAGS_JOB *p_job;
+
+    if (_num == TAGS_JOBS_SIZE) {
+        _log.e("NfcTagsJobs: %s queue full\n", __func__);
+        return NULL;
+    }
+
+    // next free slot, handles are never 0
+    p_job = &_jobs[(_head + _num) % TAGS_JOBS_SIZE];
+    _num++;
+    if (++_handle == 0) {
+        _handle = 1;
+    }
+    p_job->handle = _handle;
+    p_job->type = type;
+    p_job->status = TAGS_JOB_PENDING;
+
+    return p_job;
+}
+
+uint8_t NfcTagsJobs::submitDump(void)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_DUMP);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitRead(uint16_t block, uint8_t *buf, uint16_t len)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_READ);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+    p_job->block = block;
+    p_job->buf = buf;
+    p_job->size = len;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_WRITE);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+    p_job->block = block;
+    p_job->cmd = buf;
+    p_job->len = len;
+    p_job->verify = verify;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitReadNdef(uint8_t *buf, uint16_t size)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_READ_NDEF);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+    p_job->buf = buf;
+    p_job->size = size;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_WRITE_NDEF);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+    p_job->cmd = buf;
+    p_job->len = len;
+    p_job->old = old;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_APDU);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+    p_job->cmd = apdu;
+    p_job->len = len;
+    p_job->buf = rsp;
+    p_job->size = size;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::submitDeactivate(void)
+{
+    tTAGS_JOB *p_job;
+    uint8_t handle;
+
+    p_job = submit(TAGS_JOB_DEACTIVATE);
+    if (p_job == NULL) {
+        return 0;
+    }
+    handle = p_job->handle;
+
+    run();
+    return handle;
+}
+
+uint8_t NfcTagsJobs::getStatus(uint8_t handle)
+{
+    uint8_t i;
+
+    for (i = 0; i < TAGS_JOBS_SIZE; i++) {
+        if (handle != 0 && _jobs[i].handle == handle) {
+            return _jobs[i].status;
+        }
+    }
+
+    return TAGS_JOB_UNKNOWN;
+}
+
+void NfcTagsJobs::cancel(void)
+{
+    // the running job completes
+    skip(_running ? 1 : 0, _num);
+}
+
+void NfcTagsJobs::run(void)
+{
+    tTAGS_JOB *p_job;
+    uint8_t status;
+
+    // jobs run one at a time on the activated tag, those
+    // rejected right away complete and the next one starts
+    drop();
+    while (_active && !_running && _num != 0) {
+        p_job = &_jobs[_head];
+        _log.d("NfcTagsJobs: %s job %d type %d\n", __func__, p_job->handle, p_job->type);
+        _running = true;
+        status = start(p_job);
+        if (status != TAGS_STATUS_OK) {
+            complete(status, NULL);
+        }
+    }
+}
+
+uint8_t NfcTagsJobs::start(tTAGS_JOB *p_job)
+{
+    switch(p_job->type) {
+        case TAGS_JOB_DUMP:
+            return _tags.cmdDump();
+        case TAGS_JOB_READ:
+            return _tags.cmdRead(p_job->block, p_job->buf, p_job->size);
+        case TAGS_JOB_WRITE:
+            return _tags.cmdWrite(p_job->block, p_job->cmd, p_job->len, p_job->verify);
+        case TAGS_JOB_READ_NDEF:
+            return _tags.cmdReadNdef(p_job->buf, p_job->size);
+        case TAGS_JOB_WRITE_NDEF:
+            return _tags.cmdWriteNdef(p_job->cmd, p_job->len, p_job->old);
+        case TAGS_JOB_APDU:
+            return _tags.cmdExchangeApdu(p_job->cmd, p_job->len, p_job->buf, p_job->size);
+        case TAGS_JOB_DEACTIVATE:
+            return _tags.cmdDeactivate();
+        default:
+            return TAGS_STATUS_REJECTED;
+    }
+}
+
+void NfcTagsJobs::complete(uint8_t status, void *data)
+{
+    tTAGS_JOB *p_job = &_jobs[_head];
+    uint8_t i, num = 0;
+
+    // jobs up to the next deactivation are cancelled after
+    // a failure, counted before the application may queue more
+    if (status != TAGS_STATUS_OK && p_job->type != TAGS_JOB_DEACTIVATE) {
+        for (i = 1; i < _num; i++) {
+            if (_jobs[(_head + i) % TAGS_JOBS_SIZE].type == TAGS_JOB_DEACTIVATE) {
+                break;
+            }
+            num++;
+        }
+    }
+
+    p_job->status = status;
+    _head = (_head + 1) % TAGS_JOBS_SIZE;
+    _num--;
+    _running = false;
+    _p_cb->cbJob(status, p_job->handle, data);
+
+    skip(0, num);
+    drop();
+}
+
+void NfcTagsJobs::skip(uint8_t first, uint8_t num)
+{
+    tTAGS_JOB *p_job;
+    uint8_t i;
+
+    // cancelled in place, dropped once at the head of the queue
+    for (i = first; i < _num && i < first + num; i++) {
+        p_job = &_jobs[(_head + i) % TAGS_JOBS_SIZE];
+        if (p_job->status == TAGS_JOB_PENDING) {
+            p_job->status = TAGS_JOB_CANCELLED;
+            _p_cb->cbJob(TAGS_JOB_CANCELLED, p_job->handle, NULL);
+        }
+    }
+}
+
+void NfcTagsJobs::drop(void)
+{
+    while (_num != 0 && _jobs[_head].status == TAGS_JOB_CANCELLED) {
+        _head = (_head + 1) % TAGS_JOBS_SIZE;
+        _num--;
+    }
+}
+
+void NfcTagsJobs::cbReset(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbReset(status, id, data);
+
+    // stack reset, the running job never completes
+    _active = false;
+    if (_running) {
+        complete(TAGS_STATUS_FAILED, NULL);
+    }
+}
+
+void NfcTagsJobs::cbDiscover(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbDiscover(status, id, data);
+}
+
+void NfcTagsJobs::cbDiscoverNtf(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbDiscoverNtf(status, id, data);
+
+    // jobs queued so far run on the new tag
+    _active = (status == TAGS_STATUS_OK);
+    run();
+}
+
+void NfcTagsJobs::cbDeactivate(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbDeactivate(status, id, data);
+
+    // next jobs wait for the next tag
+    _active = false;
+    if (_running) {
+        complete(_jobs[_head].type == TAGS_JOB_DEACTIVATE ? status : TAGS_STATUS_FAILED, data);
+    }
+}
+
+void NfcTagsJobs::cbRemoved(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbRemoved(status, id, data);
+
+    // tag gone, a deactivation is already done
+    _active = false;
+    if (_running) {
+        complete(TAGS_STATUS_FAILED, NULL);
+    }
+    drop();
+    if (_num != 0 && _jobs[_head].type == TAGS_JOB_DEACTIVATE) {
+        _running = true;
+        complete(TAGS_STATUS_OK, NULL);
+    }
+}
+
+void NfcTagsJobs::cbDump(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbDump(status, id, data);
+
+    // dumps complete with their last chunk
+    if (_running && _jobs[_head].type == TAGS_JOB_DUMP &&
+        (status != TAGS_STATUS_OK || data == NULL || !((tTAGS_DUMP *)data)->more)) {
+        complete(status, data);
+        run();
+    }
+}
+
+void NfcTagsJobs::cbRead(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbRead(status, id, data);
+
+    if (_running && _jobs[_head].type == TAGS_JOB_READ) {
+        complete(status, data);
+        run();
+    }
+}
+
+void NfcTagsJobs::cbWrite(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbWrite(status, id, data);
+
+    if (_running && (_jobs[_head].type == TAGS_JOB_WRITE || _jobs[_head].type == TAGS_JOB_WRITE_NDEF)) {
+        complete(status, data);
+        run();
+    }
+}
+
+void NfcTagsJobs::cbNdef(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbNdef(status, id, data);
+
+    if (_running && _jobs[_head].type == TAGS_JOB_READ_NDEF) {
+        complete(status, data);
+        run();
+    }
+}
+
+void NfcTagsJobs::cbApdu(uint8_t status, uint16_t id, void *data)
+{
+    _p_cb->cbApdu(status, id, data);
+
+    if (_running && _jobs[_head].type == TAGS_JOB_APDU) {
+        complete(status, data);
+        run();
+    }
+}
@@ -0,0 +1,134 @@
+/*
+ * NfcTagsJobs.h
+ *
+ * Copyright (c) Thomas Buhot. All right reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __NFC_TAGS_JOBS_H__
+#define __NFC_TAGS_JOBS_H__
+
+#include <Arduino.h>
+#include "tags/NfcTagsDef.h"
+#include "tags/NfcTagsCb.h"
+#include "tags/NfcTags.h"
+#include "log/NfcLog.h"
+
+// number of jobs queued, completed ones included until
+// their slot is reused, override at build time if needed
+#ifndef TAGS_JOBS_SIZE
+#define TAGS_JOBS_SIZE          8
+#endif
+
+// job status, TAGS_STATUS_xxx once completed
+#define TAGS_JOB_CANCELLED      0xFD    // skipped after a failed job
+#define TAGS_JOB_PENDING        0xFE    // queued or running
+#define TAGS_JOB_UNKNOWN        0xFF    // no such job, or slot reused
+
+// job type definition
+enum {
+    TAGS_JOB_NONE = 0,
+    TAGS_JOB_DUMP,
+    TAGS_JOB_READ,
+    TAGS_JOB_WRITE,
+    TAGS_JOB_READ_NDEF,
+    TAGS_JOB_WRITE_NDEF,
+    TAGS_JOB_APDU,
+    TAGS_JOB_DEACTIVATE
+};
+
+// queued command and its parameters
+typedef struct {
+    uint8_t handle;             // 0 if the slot was never used
+    uint8_t type;               // TAGS_JOB_xxx
+    uint8_t status;             // TAGS_JOB_PENDING until completed
+    bool verify;                // write read back
+    uint16_t block;             // read and write first block
+    const uint8_t *cmd;         // write data, NDEF message or APDU
+    uint16_t len;               // its length
+    uint8_t *buf;               // read, NDEF or response buffer
+    uint16_t size;              // its size
+    const tTAGS_NDEF *old;      // current NDEF message
+} tTAGS_JOB;
+
+// Job queue object on top of NfcTags, commands are submitted up
+// front and run back to back on the activated tag, in order, as
+// soon as one is activated. Each job gets a handle to poll its
+// status, cbJob() is called once it completes, after the command
+// callback (cbDump(), cbWrite(), ...). When a job fails the jobs
+// queued after it are cancelled up to the next deactivation, which
+// still runs so that discovering goes on. Buffers have to remain
+// valid until the job completes. The application callback object
+// is given to init() instead of NfcTags::init(), and commands
+// should not be sent to NfcTags directly while jobs are pending.
+class NfcTagsJobs : public NfcTagsCb
+{
+    public:
+        NfcTagsJobs(NfcLog& log, NfcTags& tags);
+        void init(NfcTagsCb *cb) {_p_cb = cb; _tags.init(this);}
+
+    // public API
+    public:
+        // queue a command, returns the job handle, 0 when the queue
+        // is full, see NfcTags commands for the parameters
+        uint8_t submitDump(void);
+        uint8_t submitRead(uint16_t block, uint8_t *buf, uint16_t len);
+        uint8_t submitWrite(uint16_t block, const uint8_t *buf, uint16_t len, bool verify = false);
+        uint8_t submitReadNdef(uint8_t *buf, uint16_t size);
+        uint8_t submitWriteNdef(const uint8_t *buf, uint16_t len, const tTAGS_NDEF *old);
+        uint8_t submitApdu(const uint8_t *apdu, uint16_t len, uint8_t *rsp, uint16_t size);
+        uint8_t submitDeactivate(void);
+        // status of a job, TAGS_JOB_PENDING until it completes
+        uint8_t getStatus(uint8_t handle);
+        // number of jobs queued, running one included
+        uint8_t getPending(void) {return _num;}
+        // cancel the jobs not started yet
+        void cancel(void);
+
+    // NfcTags callbacks, forwarded to the application
+    public:
+        void cbReset(uint8_t status, uint16_t id, void *data);
+        void cbDiscover(uint8_t status, uint16_t id, void *data);
+        void cbDiscoverNtf(uint8_t status, uint16_t id, void *data);
+        void cbDeactivate(uint8_t status, uint16_t id, void *data);
+        void cbRemoved(uint8_t status, uint16_t id, void *data);
+        void cbDump(uint8_t status, uint16_t id, void *data);
+        void cbRead(uint8_t status, uint16_t id, void *data);
+        void cbWrite(uint8_t status, uint16_t id, void *data);
+        void cbNdef(uint8_t status, uint16_t id, void *data);
+        void cbApdu(uint8_t status, uint16_t id, void *data);
+
+    private:
+        tTAGS_JOB* submit(uint8_t type);
+        void run(void);
+        uint8_t start(tTAGS_JOB *p_job);
+        void complete(uint8_t status, void *data);
+        void skip(uint8_t first, uint8_t num);
+        void drop(void);
+
+    private:
+        NfcLog& _log;               // logging interface
+        NfcTags& _tags;             // tags API
+        NfcTagsCb *_p_cb;           // application callback object
+        tTAGS_JOB _jobs[TAGS_JOBS_SIZE];
+        uint8_t _head;              // next job to run
+        uint8_t _num;               // jobs queued
+        uint8_t _handle;            // last handle given
+        bool _active;               // tag activated
+        bool _running;              // job at head started
+};
+
+#endif // __NFC_TAGS_JOBS_H__